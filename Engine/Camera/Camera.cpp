@@ -130,6 +130,25 @@ const Matrix Camera::GetViewProj() const
 	return m_ViewMatrix * m_ProjMatrix;
 }
 
+void Camera::GetFrustumPlanes(Plane outPlanes[6]) const
+{
+	//clip = p * ViewProj, so every clip coordinate is p dotted with a column
+	const Matrix viewProj = GetViewProj();
+	Vector4 column[4];
+	for (int i = 0; i < 4; ++i)
+	{
+		column[i] = Vector4(viewProj.M[0][i], viewProj.M[1][i], viewProj.M[2][i], viewProj.M[3][i]);
+	}
+
+	//-w <= x, y, z <= w
+	outPlanes[0] = Plane(column[3] + column[0]).GetNormalized();
+	outPlanes[1] = Plane(column[3] - column[0]).GetNormalized();
+	outPlanes[2] = Plane(column[3] + column[1]).GetNormalized();
+	outPlanes[3] = Plane(column[3] - column[1]).GetNormalized();
+	outPlanes[4] = Plane(column[3] - column[2]).GetNormalized();
+	outPlanes[5] = Plane(column[3] + column[2]).GetNormalized();
+}
+
 void Camera::LookAt(Vector& pos)
 {
 	m_Direction = pos - m_Position;
@@ -151,6 +170,11 @@ void Camera::Project(ProjectType type)
 	}
 }
 
+const Vector Camera::GetPosition() const
+{
+	return m_Position;
+}
+
 const Vector Camera::GetFoward()
 {
 	return m_Direction;
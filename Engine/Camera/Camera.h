@@ -31,6 +31,7 @@ public:
 	void SetDirection(Vector& direct);
 	void LookAt(Vector& pos);
 
+	const Vector GetPosition() const;
 	const Vector GetFoward();
 	const Vector GetRight();
 	const Vector GetUp();
@@ -42,6 +43,9 @@ public:
 	const Matrix GetProj() const;
 	const Matrix GetViewProj() const;
 
+	/* left, right, bottom, top, near, far planes of the view frustum in world space, facing inwards */
+	void GetFrustumPlanes(Plane outPlanes[6]) const;
+
 	void Update(float deltaTime);
 
 	void Move(Vector& vec);
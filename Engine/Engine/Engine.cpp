@@ -3,16 +3,20 @@
 #include "RenderSystem.h"
 #include "../RenderSystem/OpenGL/OpenGLRender.h"
 #include "InputManager.h"
+#include "JobSystem.h"
 
 #include <string>
 using namespace std;
 
 RayEngine::RayEngine() 
 	: m_bInitialized(false)
+	, m_JobSystem(nullptr)
 	, m_RenderSystem(nullptr)
 {
 	DEBUG_MESSAGE(RAY_MESSAGE, "RayEngine Start...");
 
+	m_JobSystem = new JobSystem();
+
 	m_RenderSystem = new OpenGLRenderSystem(1024, 768, "Ray Engine", false);
 
 	m_InputManager = new InputManager();
@@ -22,6 +26,7 @@ RayEngine::~RayEngine()
 {
 	R_DELETE(m_RenderSystem);
 	R_DELETE(m_InputManager);
+	R_DELETE(m_JobSystem);
 }
 
 bool RayEngine::Start()
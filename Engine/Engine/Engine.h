@@ -7,6 +7,7 @@
 class RenderSystem;
 class ShaderManager;
 class InputManager;
+class JobSystem;
 	
 class RayEngine
 {
@@ -28,6 +29,7 @@ public:
 
 private:
 	bool m_bInitialized;
+	JobSystem* m_JobSystem;
 	RenderSystem* m_RenderSystem;
 	InputManager* m_InputManager;
 };
@@ -0,0 +1,780 @@
+#include "Image.h"
+#include "../Math/RayMath.h"
+#include "../Tools/Inflate.h"
+#include "../Tools/MappedFile.h"
+#include "../Tools/RayUtils.h"
+#include <algorithm>
+#include <math.h>
+#include <string.h>
+
+Image::Image()
+	: m_Format(IF_RGBA8)
+	, m_Width(0)
+	, m_Height(0)
+{
+}
+
+uint32 Image::GetBlockBytes(ImageFormat format)
+{
+	switch (format)
+	{
+	case IF_BC1:
+	case IF_BC4:
+		return 8;
+	case IF_BC2:
+	case IF_BC3:
+	case IF_BC5:
+	case IF_BC7:
+		return 16;
+	default:
+		return 0;
+	}
+}
+
+size_t Image::GetLevelSize(ImageFormat format, uint32 width, uint32 height)
+{
+	const uint32 blockBytes = GetBlockBytes(format);
+	if (blockBytes == 0)
+		return (size_t)width * height * 4;
+
+	return (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+}
+
+static uint32 GetFullChainLength(uint32 width, uint32 height)
+{
+	uint32 levels = 1;
+	while (width > 1 || height > 1)
+	{
+		width = Math::Max(width / 2, 1u);
+		height = Math::Max(height / 2, 1u);
+		++levels;
+	}
+	return levels;
+}
+
+void Image::AllocateLevels(uint32 levelCount)
+{
+	m_Levels.resize(levelCount);
+	uint32 width = m_Width, height = m_Height;
+	size_t offset = 0;
+	for (auto& level : m_Levels)
+	{
+		level.m_Width = width;
+		level.m_Height = height;
+		level.m_Offset = offset;
+		level.m_Size = GetLevelSize(m_Format, width, height);
+		offset += level.m_Size;
+		width = Math::Max(width / 2, 1u);
+		height = Math::Max(height / 2, 1u);
+	}
+	m_Data.resize(offset);
+}
+
+static std::string GetExtension(const std::string& path)
+{
+	size_t dot = path.find_last_of('.');
+	std::string extension = dot == std::string::npos ? std::string() : path.substr(dot + 1);
+	std::transform(extension.begin(), extension.end(), extension.begin(), ::tolower);
+	return extension;
+}
+
+bool ImageLoader::Load(const std::string& path, Image& image)
+{
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "can't open image %s", path.c_str());
+		return false;
+	}
+
+	const std::string extension = GetExtension(path);
+	bool loaded = false;
+	if (extension == "png")
+	{
+		loaded = LoadPNG(file.GetData(), (size_t)file.GetSize(), image);
+	}
+	else if (extension == "tga")
+	{
+		loaded = LoadTGA(file.GetData(), (size_t)file.GetSize(), image);
+	}
+	else if (extension == "dds")
+	{
+		loaded = LoadDDS(file.GetData(), (size_t)file.GetSize(), image);
+	}
+	else
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "%s: unknown image type", path.c_str());
+		return false;
+	}
+
+	if (!loaded)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "%s could not be decoded", path.c_str());
+	}
+	return loaded;
+}
+
+//=============================================================================================
+// PNG
+//=============================================================================================
+
+static uint32 ReadBigEndian32(const uint8* data)
+{
+	return ((uint32)data[0] << 24) | ((uint32)data[1] << 16) | ((uint32)data[2] << 8) | data[3];
+}
+
+static uint32 ReadBigEndian16(const uint8* data)
+{
+	return ((uint32)data[0] << 8) | data[1];
+}
+
+/* the index'th sample of a scanline, at its full bit depth */
+static uint32 ReadSample(const uint8* row, uint32 index, uint32 depth)
+{
+	if (depth == 8)
+		return row[index];
+	if (depth == 16)
+		return ReadBigEndian16(row + index * 2);
+
+	const uint32 bit = index * depth;
+	const uint32 shift = 8 - depth - (bit & 7);
+	return (row[bit >> 3] >> shift) & ((1u << depth) - 1);
+}
+
+static uint8 PaethPredictor(int32 left, int32 up, int32 upLeft)
+{
+	const int32 estimate = left + up - upLeft;
+	const int32 toLeft = Math::Abs(estimate - left);
+	const int32 toUp = Math::Abs(estimate - up);
+	const int32 toUpLeft = Math::Abs(estimate - upLeft);
+	if (toLeft <= toUp && toLeft <= toUpLeft)
+		return (uint8)left;
+	return (uint8)(toUp <= toUpLeft ? up : upLeft);
+}
+
+static bool Unfilter(uint8* data, uint32 height, size_t stride, uint32 pixelBytes)
+{
+	const uint8* previous = nullptr;
+	for (uint32 y = 0; y < height; ++y)
+	{
+		uint8* row = data + y * (stride + 1);
+		const uint8 filter = row[0];
+		uint8* line = row + 1;
+
+		for (size_t i = 0; i < stride; ++i)
+		{
+			const int32 left = i >= pixelBytes ? line[i - pixelBytes] : 0;
+			const int32 up = previous != nullptr ? previous[i] : 0;
+			const int32 upLeft = previous != nullptr && i >= pixelBytes ? previous[i - pixelBytes] : 0;
+			switch (filter)
+			{
+			case 0: break;
+			case 1: line[i] = (uint8)(line[i] + left); break;
+			case 2: line[i] = (uint8)(line[i] + up); break;
+			case 3: line[i] = (uint8)(line[i] + ((left + up) >> 1)); break;
+			case 4: line[i] = (uint8)(line[i] + PaethPredictor(left, up, upLeft)); break;
+			default: return false;
+			}
+		}
+		previous = line;
+	}
+	return true;
+}
+
+bool ImageLoader::LoadPNG(const uint8* data, size_t size, Image& image)
+{
+	static const uint8 signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	if (size < sizeof(signature) || memcmp(data, signature, sizeof(signature)) != 0)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "not a PNG file");
+		return false;
+	}
+
+	uint32 width = 0, height = 0, depth = 0, colorType = 0, interlace = 0;
+	uint8 palette[256][4];
+	memset(palette, 0xFF, sizeof(palette));
+	bool hasKey = false;
+	uint32 key[3] = { 0, 0, 0 };
+	std::vector<uint8> compressed;
+
+	size_t position = sizeof(signature);
+	while (position + 12 <= size)
+	{
+		const uint32 length = ReadBigEndian32(data + position);
+		const uint8* type = data + position + 4;
+		const uint8* chunk = data + position + 8;
+		if (length > size - position - 12)
+		{
+			DEBUG_MESSAGE(RAY_ERROR, "truncated PNG chunk");
+			return false;
+		}
+
+		if (memcmp(type, "IHDR", 4) == 0 && length >= 13)
+		{
+			width = ReadBigEndian32(chunk);
+			height = ReadBigEndian32(chunk + 4);
+			depth = chunk[8];
+			colorType = chunk[9];
+			interlace = chunk[12];
+			if (chunk[10] != 0 || chunk[11] != 0)
+			{
+				DEBUG_MESSAGE(RAY_ERROR, "unknown PNG compression or filter method");
+				return false;
+			}
+		}
+		else if (memcmp(type, "PLTE", 4) == 0)
+		{
+			for (uint32 i = 0; i < length / 3 && i < 256; ++i)
+			{
+				palette[i][0] = chunk[i * 3];
+				palette[i][1] = chunk[i * 3 + 1];
+				palette[i][2] = chunk[i * 3 + 2];
+			}
+		}
+		else if (memcmp(type, "tRNS", 4) == 0)
+		{
+			if (colorType == 3)
+			{
+				for (uint32 i = 0; i < length && i < 256; ++i)
+				{
+					palette[i][3] = chunk[i];
+				}
+			}
+			else if (colorType == 0 && length >= 2)
+			{
+				hasKey = true;
+				key[0] = ReadBigEndian16(chunk);
+			}
+			else if (colorType == 2 && length >= 6)
+			{
+				hasKey = true;
+				key[0] = ReadBigEndian16(chunk);
+				key[1] = ReadBigEndian16(chunk + 2);
+				key[2] = ReadBigEndian16(chunk + 4);
+			}
+		}
+		else if (memcmp(type, "IDAT", 4) == 0)
+		{
+			compressed.insert(compressed.end(), chunk, chunk + length);
+		}
+		else if (memcmp(type, "IEND", 4) == 0)
+		{
+			break;
+		}
+		position += 12 + length;
+	}
+
+	uint32 channels = 0;
+	switch (colorType)
+	{
+	case 0: channels = 1; break;
+	case 2: channels = 3; break;
+	case 3: channels = 1; break;
+	case 4: channels = 2; break;
+	case 6: channels = 4; break;
+	}
+
+	const bool validDepth = depth == 8 || depth == 16 || ((colorType == 0 || colorType == 3) && (depth == 1 || depth == 2 || depth == 4));
+	if (width == 0 || height == 0 || width > 16384 || height > 16384 || channels == 0 || !validDepth || (colorType == 3 && depth == 16))
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "unsupported PNG: %ux%u, color type %u, %u bits", width, height, colorType, depth);
+		return false;
+	}
+	if (interlace != 0)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "interlaced PNGs aren't supported, save it without interlacing");
+		return false;
+	}
+
+	const uint32 pixelBits = channels * depth;
+	const size_t stride = ((size_t)width * pixelBits + 7) / 8;
+	const uint32 pixelBytes = Math::Max(pixelBits / 8, 1u);
+
+	std::vector<uint8> raw;
+	if (!Inflate(compressed.empty() ? nullptr : &compressed[0], compressed.size(), raw, height * (stride + 1))
+		|| raw.size() < height * (stride + 1))
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "corrupt PNG image data");
+		return false;
+	}
+	if (!Unfilter(&raw[0], height, stride, pixelBytes))
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "unknown PNG scanline filter");
+		return false;
+	}
+
+	image.m_Format = IF_RGBA8;
+	image.m_Width = width;
+	image.m_Height = height;
+	image.AllocateLevels(1);
+
+	const uint32 maxValue = (1u << depth) - 1;
+	for (uint32 y = 0; y < height; ++y)
+	{
+		const uint8* line = &raw[y * (stride + 1) + 1];
+		uint8* out = &image.m_Data[(size_t)(height - 1 - y) * width * 4];
+
+		for (uint32 x = 0; x < width; ++x, out += 4)
+		{
+			uint32 samples[4];
+			for (uint32 c = 0; c < channels; ++c)
+			{
+				samples[c] = ReadSample(line, x * channels + c, depth);
+			}
+
+			if (colorType == 3)
+			{
+				memcpy(out, palette[samples[0] & 0xFF], 4);
+				continue;
+			}
+
+			uint8 scaled[4];
+			for (uint32 c = 0; c < channels; ++c)
+			{
+				scaled[c] = (uint8)(depth == 16 ? samples[c] >> 8 : samples[c] * 255 / maxValue);
+			}
+
+			if (channels <= 2)
+			{
+				out[0] = out[1] = out[2] = scaled[0];
+				out[3] = channels == 2 ? scaled[1] : 255;
+				if (hasKey && samples[0] == key[0])
+				{
+					out[3] = 0;
+				}
+			}
+			else
+			{
+				out[0] = scaled[0];
+				out[1] = scaled[1];
+				out[2] = scaled[2];
+				out[3] = channels == 4 ? scaled[3] : 255;
+				if (hasKey && samples[0] == key[0] && samples[1] == key[1] && samples[2] == key[2])
+				{
+					out[3] = 0;
+				}
+			}
+		}
+	}
+	return true;
+}
+
+//=============================================================================================
+// TGA
+//=============================================================================================
+
+bool ImageLoader::LoadTGA(const uint8* data, size_t size, Image& image)
+{
+	if (size < 18)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "truncated TGA header");
+		return false;
+	}
+
+	const uint32 idLength = data[0];
+	const uint32 colorMapType = data[1];
+	const uint32 imageType = data[2];
+	const uint32 width = data[12] | (data[13] << 8);
+	const uint32 height = data[14] | (data[15] << 8);
+	const uint32 bits = data[16];
+	const uint32 descriptor = data[17];
+
+	const bool rle = imageType == 10 || imageType == 11;
+	const bool grey = imageType == 3 || imageType == 11;
+	const bool validBits = grey ? bits == 8 : (bits == 24 || bits == 32);
+	if (colorMapType != 0 || (imageType != 2 && imageType != 3 && !rle) || !validBits || width == 0 || height == 0)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "unsupported TGA: type %u, %u bits, color map %u", imageType, bits, colorMapType);
+		return false;
+	}
+
+	image.m_Format = IF_RGBA8;
+	image.m_Width = width;
+	image.m_Height = height;
+	image.AllocateLevels(1);
+
+	const uint32 pixelBytes = bits / 8;
+	const bool topDown = (descriptor & 0x20) != 0;
+	const bool rightToLeft = (descriptor & 0x10) != 0;
+	const uint8* in = data + 18 + idLength;
+	const uint8* end = data + size;
+
+	const uint32 pixelCount = width * height;
+	uint32 pixel = 0;
+	while (pixel < pixelCount)
+	{
+		uint32 run = 1;
+		bool repeat = false;
+		if (rle)
+		{
+			if (in >= end)
+				break;
+			repeat = (*in & 0x80) != 0;
+			run = (*in & 0x7F) + 1;
+			++in;
+		}
+
+		for (uint32 i = 0; i < run && pixel < pixelCount; ++i, ++pixel)
+		{
+			if (in + pixelBytes > end)
+			{
+				DEBUG_MESSAGE(RAY_ERROR, "truncated TGA image data");
+				return false;
+			}
+
+			const uint32 fileRow = pixel / width;
+			const uint32 fileColumn = pixel % width;
+			const uint32 row = topDown ? height - 1 - fileRow : fileRow;
+			const uint32 column = rightToLeft ? width - 1 - fileColumn : fileColumn;
+			uint8* out = &image.m_Data[((size_t)row * width + column) * 4];
+
+			if (grey)
+			{
+				out[0] = out[1] = out[2] = in[0];
+				out[3] = 255;
+			}
+			else
+			{
+				out[0] = in[2];
+				out[1] = in[1];
+				out[2] = in[0];
+				out[3] = pixelBytes == 4 ? in[3] : 255;
+			}
+
+			//a repeat packet holds one pixel for the whole run
+			if (!repeat || i + 1 == run)
+			{
+				in += pixelBytes;
+			}
+		}
+	}
+
+	if (pixel < pixelCount)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "truncated TGA image data");
+		return false;
+	}
+	return true;
+}
+
+//=============================================================================================
+// DDS
+//=============================================================================================
+
+static uint32 ReadLittleEndian32(const uint8* data)
+{
+	return data[0] | ((uint32)data[1] << 8) | ((uint32)data[2] << 16) | ((uint32)data[3] << 24);
+}
+
+static uint32 MakeFourCC(char a, char b, char c, char d)
+{
+	return (uint32)(uint8)a | ((uint32)(uint8)b << 8) | ((uint32)(uint8)c << 16) | ((uint32)(uint8)d << 24);
+}
+
+/* the 48 bits of 3 bit indices of a BC3 alpha or BC4 block, rows reversed */
+static void FlipAlphaBlock(uint8* block, uint32 rows)
+{
+	uint64 indices = 0;
+	memcpy(&indices, block + 2, 6);
+
+	uint64 flipped = indices;
+	for (uint32 row = 0; row < rows; ++row)
+	{
+		const uint64 bits = (indices >> (row * 12)) & 0xFFF;
+		flipped &= ~(0xFFFull << ((rows - 1 - row) * 12));
+		flipped |= bits << ((rows - 1 - row) * 12);
+	}
+	memcpy(block + 2, &flipped, 6);
+}
+
+static void FlipColorBlock(uint8* block, uint32 rows)
+{
+	std::reverse(block + 4, block + 4 + rows);
+}
+
+static void FlipExplicitAlphaBlock(uint8* block, uint32 rows)
+{
+	for (uint32 row = 0; row < rows / 2; ++row)
+	{
+		std::swap(block[row * 2], block[(rows - 1 - row) * 2]);
+		std::swap(block[row * 2 + 1], block[(rows - 1 - row) * 2 + 1]);
+	}
+}
+
+/**
+	flips a level of BC1-5 blocks: block rows are swapped and the pixel rows inside every block
+	reversed. Levels under 4 rows only flip the rows they use.
+**/
+static bool FlipBlockLevel(ImageFormat format, uint8* data, uint32 width, uint32 height)
+{
+	if (format == IF_BC7 || (height > 4 && height % 4 != 0))
+		return false;
+
+	const uint32 blockBytes = Image::GetBlockBytes(format);
+	const uint32 blocksX = (width + 3) / 4;
+	const uint32 blocksY = (height + 3) / 4;
+	const uint32 rows = Math::Min(height, 4u);
+	const size_t rowBytes = (size_t)blocksX * blockBytes;
+
+	for (uint32 y = 0; y < blocksY / 2; ++y)
+	{
+		std::swap_ranges(data + y * rowBytes, data + (y + 1) * rowBytes, data + (blocksY - 1 - y) * rowBytes);
+	}
+
+	for (uint32 i = 0; i < blocksX * blocksY; ++i)
+	{
+		uint8* block = data + (size_t)i * blockBytes;
+		switch (format)
+		{
+		case IF_BC1: FlipColorBlock(block, rows); break;
+		case IF_BC2: FlipExplicitAlphaBlock(block, rows); FlipColorBlock(block + 8, rows); break;
+		case IF_BC3: FlipAlphaBlock(block, rows); FlipColorBlock(block + 8, rows); break;
+		case IF_BC4: FlipAlphaBlock(block, rows); break;
+		case IF_BC5: FlipAlphaBlock(block, rows); FlipAlphaBlock(block + 8, rows); break;
+		default: break;
+		}
+	}
+	return true;
+}
+
+bool ImageLoader::LoadDDS(const uint8* data, size_t size, Image& image)
+{
+	if (size < 128 || ReadLittleEndian32(data) != MakeFourCC('D', 'D', 'S', ' ') || ReadLittleEndian32(data + 4) != 124)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "not a DDS file");
+		return false;
+	}
+
+	const uint32 flags = ReadLittleEndian32(data + 8);
+	const uint32 height = ReadLittleEndian32(data + 12);
+	const uint32 width = ReadLittleEndian32(data + 16);
+	const uint32 mipCount = ReadLittleEndian32(data + 28);
+	const uint32 tag = ReadLittleEndian32(data + 32);
+	const uint32 formatFlags = ReadLittleEndian32(data + 80);
+	const uint32 fourCC = ReadLittleEndian32(data + 84);
+	const uint32 bitCount = ReadLittleEndian32(data + 88);
+	const uint32 redMask = ReadLittleEndian32(data + 92);
+	const uint32 alphaMask = ReadLittleEndian32(data + 104);
+	const uint32 caps2 = ReadLittleEndian32(data + 112);
+
+	size_t offset = 128;
+	bool swizzleBGRA = false;
+	bool known = true;
+	ImageFormat format = IF_RGBA8;
+
+	if ((formatFlags & 0x4) != 0)
+	{
+		if (fourCC == MakeFourCC('D', 'X', 'T', '1')) format = IF_BC1;
+		else if (fourCC == MakeFourCC('D', 'X', 'T', '2') || fourCC == MakeFourCC('D', 'X', 'T', '3')) format = IF_BC2;
+		else if (fourCC == MakeFourCC('D', 'X', 'T', '4') || fourCC == MakeFourCC('D', 'X', 'T', '5')) format = IF_BC3;
+		else if (fourCC == MakeFourCC('A', 'T', 'I', '1') || fourCC == MakeFourCC('B', 'C', '4', 'U')) format = IF_BC4;
+		else if (fourCC == MakeFourCC('A', 'T', 'I', '2') || fourCC == MakeFourCC('B', 'C', '5', 'U')) format = IF_BC5;
+		else if (fourCC == MakeFourCC('D', 'X', '1', '0') && size >= 148)
+		{
+			const uint32 dxgiFormat = ReadLittleEndian32(data + 128);
+			const uint32 miscFlags = ReadLittleEndian32(data + 136);
+			const uint32 arraySize = ReadLittleEndian32(data + 140);
+			offset = 148;
+			switch (dxgiFormat)
+			{
+			case 28: case 29: format = IF_RGBA8; break;
+			case 87: case 91: format = IF_RGBA8; swizzleBGRA = true; break;
+			case 71: case 72: format = IF_BC1; break;
+			case 74: case 75: format = IF_BC2; break;
+			case 77: case 78: format = IF_BC3; break;
+			case 80: format = IF_BC4; break;
+			case 83: format = IF_BC5; break;
+			case 98: case 99: format = IF_BC7; break;
+			default: known = false; break;
+			}
+			known = known && arraySize <= 1 && (miscFlags & 0x4) == 0;
+		}
+		else
+		{
+			known = false;
+		}
+	}
+	else if ((formatFlags & 0x40) != 0 && bitCount == 32)
+	{
+		swizzleBGRA = redMask == 0x00FF0000;
+		known = redMask == 0x000000FF || swizzleBGRA;
+	}
+	else
+	{
+		known = false;
+	}
+
+	//cube maps and volumes aren't 2d images
+	if (!known || (caps2 & 0x200) != 0 || (caps2 & 0x200000) != 0 || width == 0 || height == 0)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "unsupported DDS: fourcc %08x, %u bits, caps2 %08x", fourCC, bitCount, caps2);
+		return false;
+	}
+
+	image.m_Format = format;
+	image.m_Width = width;
+	image.m_Height = height;
+	const uint32 levels = (flags & 0x20000) != 0 && mipCount > 0 ? Math::Min(mipCount, GetFullChainLength(width, height)) : 1;
+	image.AllocateLevels(levels);
+
+	if (size - offset < image.m_Data.size())
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "truncated DDS image data");
+		return false;
+	}
+	memcpy(&image.m_Data[0], data + offset, image.m_Data.size());
+
+	if (format == IF_RGBA8)
+	{
+		const bool opaque = (formatFlags & 0x40) != 0 && ((formatFlags & 0x1) == 0 || alphaMask == 0);
+		for (size_t i = 0; i < image.m_Data.size(); i += 4)
+		{
+			if (swizzleBGRA)
+			{
+				std::swap(image.m_Data[i], image.m_Data[i + 2]);
+			}
+			if (opaque)
+			{
+				image.m_Data[i + 3] = 255;
+			}
+		}
+	}
+
+	//DDS stores rows top down, except for the ones the engine wrote
+	if (tag == ImageBottomUpTag)
+		return true;
+
+	for (auto& level : image.m_Levels)
+	{
+		uint8* levelData = &image.m_Data[level.m_Offset];
+		if (format == IF_RGBA8)
+		{
+			const size_t rowBytes = (size_t)level.m_Width * 4;
+			for (uint32 y = 0; y < level.m_Height / 2; ++y)
+			{
+				std::swap_ranges(levelData + y * rowBytes, levelData + (y + 1) * rowBytes, levelData + (level.m_Height - 1 - y) * rowBytes);
+			}
+		}
+		else if (!FlipBlockLevel(format, levelData, level.m_Width, level.m_Height))
+		{
+			DEBUG_MESSAGE(RAY_ERROR, "DDS blocks of format %d, %ux%u can't be flipped, the image is upside down", (int)format, level.m_Width, level.m_Height);
+			break;
+		}
+	}
+	return true;
+}
+
+//=============================================================================================
+// Mip generation
+//=============================================================================================
+
+/**
+	8 bit to linear and back, built once before main so workers never race on it.
+	Encoding goes through a table fine enough to keep the darkest sRGB codes apart.
+**/
+struct GammaTables
+{
+	static const uint32 EncodeSize = 16384;
+
+	GammaTables()
+	{
+		for (uint32 i = 0; i < 256; ++i)
+		{
+			const float value = i / 255.0f;
+			m_SRGBToLinear[i] = value <= 0.04045f ? value / 12.92f : powf((value + 0.055f) / 1.055f, 2.4f);
+			m_UnormToFloat[i] = value;
+		}
+		for (uint32 i = 0; i < EncodeSize; ++i)
+		{
+			const float linear = (float)i / (EncodeSize - 1);
+			const float encoded = linear <= 0.0031308f ? linear * 12.92f : 1.055f * powf(linear, 1.0f / 2.4f) - 0.055f;
+			m_LinearToSRGB[i] = (uint8)(Math::Clamp(encoded, 0.0f, 1.0f) * 255.0f + 0.5f);
+		}
+	}
+
+	float m_SRGBToLinear[256];
+	float m_UnormToFloat[256];
+	uint8 m_LinearToSRGB[EncodeSize];
+};
+
+static const GammaTables s_GammaTables;
+
+static void EncodeTexel(const float* linear, bool sRGB, uint8* out)
+{
+	for (uint32 c = 0; c < 3; ++c)
+	{
+		const float value = Math::Clamp(linear[c], 0.0f, 1.0f);
+		out[c] = sRGB ? s_GammaTables.m_LinearToSRGB[(uint32)(value * (GammaTables::EncodeSize - 1) + 0.5f)] : (uint8)(value * 255.0f + 0.5f);
+	}
+	out[3] = (uint8)(Math::Clamp(linear[3], 0.0f, 1.0f) * 255.0f + 0.5f);
+}
+
+/**
+	halves a level, load(x, y) returns a source texel as linear RGBA. The averages are kept
+	as floats for the next level and encoded into dst for this one.
+**/
+template<typename LoadTexel>
+static void Downsample(const LoadTexel& load, uint32 srcWidth, uint32 srcHeight, uint32 dstWidth, uint32 dstHeight,
+	bool sRGB, float* linearOut, uint8* dst)
+{
+	const VectorRegister quarter = MakeVectorRegister(0.25f, 0.25f, 0.25f, 0.25f);
+	for (uint32 y = 0; y < dstHeight; ++y)
+	{
+		const uint32 y0 = Math::Min(y * 2, srcHeight - 1);
+		const uint32 y1 = Math::Min(y * 2 + 1, srcHeight - 1);
+		for (uint32 x = 0; x < dstWidth; ++x)
+		{
+			const uint32 x0 = Math::Min(x * 2, srcWidth - 1);
+			const uint32 x1 = Math::Min(x * 2 + 1, srcWidth - 1);
+
+			const VectorRegister top = VectorAdd(load(x0, y0), load(x1, y0));
+			const VectorRegister bottom = VectorAdd(load(x0, y1), load(x1, y1));
+			const VectorRegister average = VectorMultiply(VectorAdd(top, bottom), quarter);
+
+			float* texel = linearOut + ((size_t)y * dstWidth + x) * 4;
+			VectorStore(average, texel);
+			EncodeTexel(texel, sRGB, dst + ((size_t)y * dstWidth + x) * 4);
+		}
+	}
+}
+
+void ImageLoader::GenerateMips(Image& image, bool sRGB)
+{
+	if (image.IsCompressed() || image.m_Levels.empty())
+		return;
+
+	image.AllocateLevels(GetFullChainLength(image.m_Width, image.m_Height));
+	if (image.m_Levels.size() == 1)
+		return;
+
+	const float* toFloat = sRGB ? s_GammaTables.m_SRGBToLinear : s_GammaTables.m_UnormToFloat;
+	const uint8* source = &image.m_Data[0];
+	const uint32 sourceWidth = image.m_Width;
+
+	//the first reduction reads the 8 bit texels, the later ones the float averages
+	std::vector<float> previous((size_t)image.m_Levels[1].m_Width * image.m_Levels[1].m_Height * 4);
+	std::vector<float> current;
+	Downsample([&](uint32 x, uint32 y) -> VectorRegister
+		{
+			const uint8* texel = source + ((size_t)y * sourceWidth + x) * 4;
+			return MakeVectorRegister(toFloat[texel[0]], toFloat[texel[1]], toFloat[texel[2]], texel[3] / 255.0f);
+		},
+		image.m_Width, image.m_Height, image.m_Levels[1].m_Width, image.m_Levels[1].m_Height, sRGB, &previous[0],
+		&image.m_Data[image.m_Levels[1].m_Offset]);
+
+	for (size_t level = 2; level < image.m_Levels.size(); ++level)
+	{
+		const ImageLevel& src = image.m_Levels[level - 1];
+		const ImageLevel& dst = image.m_Levels[level];
+		current.resize((size_t)dst.m_Width * dst.m_Height * 4);
+
+		const float* linear = &previous[0];
+		const uint32 srcWidth = src.m_Width;
+		Downsample([&](uint32 x, uint32 y) -> VectorRegister
+			{
+				return VectorLoad(linear + ((size_t)y * srcWidth + x) * 4);
+			},
+			src.m_Width, src.m_Height, dst.m_Width, dst.m_Height, sRGB, &current[0], &image.m_Data[dst.m_Offset]);
+		previous.swap(current);
+	}
+}
@@ -0,0 +1,81 @@
+//=============================================================================================
+// Image: pixels decoded from PNG, TGA or DDS files, with their mip chain. Decoding and mip
+// generation only touch memory, so they run on worker threads, the renderer just copies the
+// levels into textures. Rows are stored bottom up, the order GL's texture origin expects.
+//=============================================================================================
+
+#pragma once
+#include "../Config/WindowPlatform.h"
+#include <string>
+#include <vector>
+
+enum ImageFormat
+{
+	IF_RGBA8,
+	IF_BC1,
+	IF_BC2,
+	IF_BC3,
+	IF_BC4,
+	IF_BC5,
+	IF_BC7,
+};
+
+/* DDS files carrying this in dwReserved1[0] already store their rows bottom up */
+static const uint32 ImageBottomUpTag = 0x50555952; //"RYUP"
+
+struct ImageLevel
+{
+	uint32 m_Width;
+	uint32 m_Height;
+	size_t m_Offset;
+	size_t m_Size;
+};
+
+/**
+ * Every level back to back in m_Data. Uncompressed images are always
+ * converted to RGBA8, compressed ones keep their 4x4 blocks.
+ */
+struct Image
+{
+	Image();
+
+	bool IsCompressed() const { return m_Format != IF_RGBA8; }
+	const uint8* GetLevelData(uint32 level) const { return &m_Data[m_Levels[level].m_Offset]; }
+	size_t GetTotalSize() const { return m_Data.size(); }
+
+	/* lays out levelCount levels from m_Format and the size, then sizes m_Data for them */
+	void AllocateLevels(uint32 levelCount);
+
+	/* bytes per 4x4 block, 0 for RGBA8 */
+	static uint32 GetBlockBytes(ImageFormat format);
+	static size_t GetLevelSize(ImageFormat format, uint32 width, uint32 height);
+
+	ImageFormat m_Format;
+	uint32 m_Width;
+	uint32 m_Height;
+	std::vector<ImageLevel> m_Levels;
+	std::vector<uint8> m_Data;
+};
+
+class ImageLoader
+{
+public:
+	/* picks the decoder from the extension, the file is mapped rather than read */
+	static bool Load(const std::string& path, Image& image);
+
+	/* 1, 2, 4, 8 or 16 bit channels of any color type, not interlaced */
+	static bool LoadPNG(const uint8* data, size_t size, Image& image);
+
+	/* true color and grey, raw or run length encoded */
+	static bool LoadTGA(const uint8* data, size_t size, Image& image);
+
+	/* BC1-5 and BC7 blocks, or 32 bit RGBA/BGRA, with the mips stored in the file */
+	static bool LoadDDS(const uint8* data, size_t size, Image& image);
+
+	/**
+	 * Box filters the first level of an RGBA8 image down to 1x1, replacing any
+	 * other levels. With sRGB the color channels are averaged as linear light,
+	 * alpha is always averaged as it is.
+	 */
+	static void GenerateMips(Image& image, bool sRGB);
+};
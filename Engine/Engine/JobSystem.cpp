@@ -0,0 +1,160 @@
+#include "JobSystem.h"
+#include "../Tools/RayUtils.h"
+#include <chrono>
+
+template<> JobSystem* Singleton<JobSystem>::m_pSingleton = nullptr;
+
+JobSystem::JobSystem(uint32 workerCount)
+	: m_BackgroundMicroseconds(0)
+	, m_bQuit(false)
+{
+	if (workerCount == 0)
+	{
+		uint32 hardwareThreads = std::thread::hardware_concurrency();
+		workerCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+	}
+
+	m_Stats.resize(workerCount + 1);
+	ResetStats();
+
+	for (uint32 i = 0; i < workerCount; ++i)
+	{
+		m_Workers.push_back(std::thread(&JobSystem::WorkerMain, this, i + 1));
+	}
+
+	DEBUG_MESSAGE(RAY_MESSAGE, "Job system: %u worker threads", workerCount);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_TaskMutex);
+		m_bQuit = true;
+	}
+	m_TaskCondition.notify_all();
+
+	for (auto& worker : m_Workers)
+	{
+		worker.join();
+	}
+}
+
+void JobSystem::ResetStats()
+{
+	for (auto& stats : m_Stats)
+	{
+		stats.m_Ranges = 0;
+		stats.m_Items = 0;
+		stats.m_BusyMilliseconds = 0.0;
+	}
+	m_BackgroundMicroseconds = 0;
+}
+
+void JobSystem::ParallelFor(uint32 count, uint32 grain, const RangeJob& job)
+{
+	if (count == 0)
+		return;
+
+	if (grain == 0)
+	{
+		uint32 ranges = GetThreadCount() * 4;
+		grain = (count + ranges - 1) / ranges;
+	}
+
+	std::atomic<uint32> pending((count + grain - 1) / grain);
+	{
+		std::lock_guard<std::mutex> lock(m_TaskMutex);
+		for (uint32 begin = 0; begin < count; begin += grain)
+		{
+			Task task;
+			task.m_Job = &job;
+			task.m_Begin = begin;
+			task.m_End = begin + grain < count ? begin + grain : count;
+			task.m_Pending = &pending;
+			m_Tasks.push_back(task);
+		}
+	}
+	m_TaskCondition.notify_all();
+
+	//help out until every range finished, the last ones may still run on workers
+	while (pending.load(std::memory_order_acquire) != 0)
+	{
+		if (!RunOne(0, false))
+		{
+			std::this_thread::yield();
+		}
+	}
+}
+
+void JobSystem::Submit(const BackgroundJob& job)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_TaskMutex);
+		m_BackgroundJobs.push_back(job);
+	}
+	m_TaskCondition.notify_one();
+}
+
+void JobSystem::WorkerMain(uint32 thread)
+{
+	while (RunOne(thread, true))
+	{
+	}
+}
+
+bool JobSystem::RunOne(uint32 thread, bool wait)
+{
+	//the thread in ParallelFor only helps with ranges, a long background job would stall it
+	const bool background = thread != 0;
+
+	Task task;
+	BackgroundJob job;
+	{
+		std::unique_lock<std::mutex> lock(m_TaskMutex);
+		if (wait)
+		{
+			m_TaskCondition.wait(lock, [this, background]() { return !m_Tasks.empty() || (background && !m_BackgroundJobs.empty()) || m_bQuit; });
+		}
+
+		if (!m_Tasks.empty())
+		{
+			task = m_Tasks.front();
+			m_Tasks.pop_front();
+		}
+		else if (background && !m_BackgroundJobs.empty())
+		{
+			job.swap(m_BackgroundJobs.front());
+			m_BackgroundJobs.pop_front();
+		}
+		else
+		{
+			return false;
+		}
+	}
+
+	if (job)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+		job();
+		auto end = std::chrono::high_resolution_clock::now();
+		m_BackgroundMicroseconds += (uint64)std::chrono::duration_cast<std::chrono::microseconds>(end - start).count();
+		return true;
+	}
+
+	Run(task, thread);
+	return true;
+}
+
+void JobSystem::Run(const Task& task, uint32 thread)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	(*task.m_Job)(task.m_Begin, task.m_End, thread);
+	auto end = std::chrono::high_resolution_clock::now();
+
+	JobThreadStats& stats = m_Stats[thread];
+	++stats.m_Ranges;
+	stats.m_Items += task.m_End - task.m_Begin;
+	stats.m_BusyMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+
+	task.m_Pending->fetch_sub(1, std::memory_order_release);
+}
@@ -0,0 +1,86 @@
+//=============================================================================================
+// JobSystem: a fixed pool of worker threads running ranges of parallel loops. The thread
+// calling ParallelFor takes part in the work as thread 0, so per-thread data can be indexed
+// with the thread index handed to every range. Background jobs (file loads, decoding) only
+// run on the workers, after the loop ranges queued at the time.
+//=============================================================================================
+
+#pragma once
+#include "../Tools/Singleton.h"
+#include "../Config/RayConifg.h"
+#include "../Config/WindowPlatform.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * Loop ranges accumulated until ResetStats, only written by the thread it
+ * belongs to while ParallelFor runs. Background jobs are counted apart.
+ */
+struct JobThreadStats
+{
+	uint32 m_Ranges;
+	uint32 m_Items;
+	double m_BusyMilliseconds;
+};
+
+class JobSystem : public Singleton<JobSystem>
+{
+public:
+	/* (begin, end, thread): processes items [begin, end) on thread [0, GetThreadCount()) */
+	typedef std::function<void(uint32, uint32, uint32)> RangeJob;
+	typedef std::function<void()> BackgroundJob;
+
+	/* workerCount 0 uses one worker per hardware thread besides the caller */
+	explicit JobSystem(uint32 workerCount = 0);
+	~JobSystem();
+
+	/**
+	 * Splits [0, count) into ranges of grain items (0 picks a grain giving every
+	 * thread a few ranges) and returns once all of them ran. Only one thread may
+	 * issue ParallelFor at a time, and jobs must not call it recursively.
+	 */
+	void ParallelFor(uint32 count, uint32 grain, const RangeJob& job);
+
+	/**
+	 * Queues a job and returns at once, the job must signal its own
+	 * completion. Jobs still queued when the system is destroyed are run.
+	 */
+	void Submit(const BackgroundJob& job);
+
+	uint32 GetThreadCount() const { return (uint32)m_Workers.size() + 1; }
+
+	const JobThreadStats& GetThreadStats(uint32 thread) const { return m_Stats[thread]; }
+	/* time spent in background jobs on all workers since ResetStats */
+	double GetBackgroundMilliseconds() const { return m_BackgroundMicroseconds.load() / 1000.0; }
+	/* call it outside ParallelFor, from the thread issuing it */
+	void ResetStats();
+
+private:
+	struct Task
+	{
+		const RangeJob* m_Job;
+		uint32 m_Begin;
+		uint32 m_End;
+		std::atomic<uint32>* m_Pending;
+	};
+
+	void WorkerMain(uint32 thread);
+	bool RunOne(uint32 thread, bool wait);
+	void Run(const Task& task, uint32 thread);
+
+private:
+	std::vector<std::thread> m_Workers;
+	std::vector<JobThreadStats> m_Stats;
+	std::atomic<uint64> m_BackgroundMicroseconds; //background jobs finish at any time, so it's shared
+
+	std::deque<Task> m_Tasks;
+	std::deque<BackgroundJob> m_BackgroundJobs;
+	std::mutex m_TaskMutex;
+	std::condition_variable m_TaskCondition;
+	bool m_bQuit;
+};
@@ -0,0 +1,97 @@
+#include "LodSelector.h"
+#include "../Camera/Camera.h"
+
+LodSelector::LodSelector()
+	: m_CameraPosition(0.0f, 0.0f, 0.0f)
+	, m_InvTanHalfFOV(1.0f)
+	, m_DeltaTime(0.0f)
+	, m_Hysteresis(0.1f)
+	, m_FadeTime(0.25f)
+	, m_FrameBudget(0.0f)
+	, m_MaxBias(2.0f)
+	, m_Bias(0.0f)
+	, m_BiasScale(1.0f)
+{
+}
+
+void LodSelector::BeginFrame(const Camera& camera, float deltaTime, float frameMilliseconds)
+{
+	m_CameraPosition = camera.GetPosition();
+	m_DeltaTime = deltaTime;
+
+	//the narrower of the two fields of view, so the size is relative to the short side of the screen
+	const float tanHalfFOV = Math::Tan(Math::DegreesToRadians(camera.GetFOV() * 0.5f));
+	const float ratio = camera.GetRatio();
+	m_InvTanHalfFOV = 1.0f / (ratio < 1.0f ? tanHalfFOV * ratio : tanHalfFOV);
+
+	/* walks up a level per second while over budget, back down with some headroom */
+	if (m_FrameBudget > 0.0f)
+	{
+		if (frameMilliseconds > m_FrameBudget)
+		{
+			m_Bias += deltaTime;
+		}
+		else if (frameMilliseconds < m_FrameBudget * 0.8f)
+		{
+			m_Bias -= deltaTime;
+		}
+		m_Bias = Math::Clamp(m_Bias, 0.0f, m_MaxBias);
+	}
+	else
+	{
+		m_Bias = 0.0f;
+	}
+	m_BiasScale = Math::Pow(2.0f, -m_Bias);
+}
+
+float LodSelector::GetScreenSize(const Vector& center, float radius) const
+{
+	const float distance = (center - m_CameraPosition).Size();
+	if (distance <= radius)
+		return BIG_NUMBER;
+
+	return radius * m_InvTanHalfFOV / distance;
+}
+
+uint32 LodSelector::Select(const LodChain& chain, const Vector& center, float radius, LodState& state) const
+{
+	const float size = GetScreenSize(center, radius) * m_BiasScale;
+	const uint32 lastLevel = chain.m_LevelCount - 1;
+
+	uint32 level;
+	if (state.m_Level == LodState::InvalidLevel)
+	{
+		//first selection, no band to stay in
+		level = 0;
+		while (level < lastLevel && size < chain.m_ScreenSize[level])
+		{
+			++level;
+		}
+	}
+	else
+	{
+		level = Math::Min((uint32)state.m_Level, lastLevel);
+		while (level > 0 && size > chain.m_ScreenSize[level - 1] * (1.0f + m_Hysteresis))
+		{
+			--level;
+		}
+		while (level < lastLevel && size < chain.m_ScreenSize[level] * (1.0f - m_Hysteresis))
+		{
+			++level;
+		}
+	}
+
+	if (state.m_Level != LodState::InvalidLevel && level != state.m_Level && m_FadeTime > 0.0f)
+	{
+		//changing again mid fade restarts from the level that was fading in
+		state.m_FadeFrom = state.m_Level;
+		state.m_Fade = 0.0f;
+	}
+	else if (state.IsFading())
+	{
+		state.m_Fade = Math::Min(state.m_Fade + m_DeltaTime / m_FadeTime, 1.0f);
+	}
+	state.m_Level = (uint8)level;
+
+	return level;
+}
@@ -0,0 +1,101 @@
+//=============================================================================================
+// LodSelector: picks a level of detail per object from its projected size on screen. Levels
+// only change once the size has moved past a hysteresis band around the threshold, and a
+// change can be cross-faded with a dither between the outgoing and incoming level. A global
+// bias coarsens every selection while the frame time is over budget.
+//=============================================================================================
+
+#pragma once
+#include "../Config/RayConifg.h"
+#include "../Config/WindowPlatform.h"
+#include "../Math/RayMath.h"
+
+class Camera;
+
+/**
+ * Screen size thresholds of a mesh's levels, finest first. Level i is used
+ * while the projected size is at least m_ScreenSize[i], the last level has
+ * no lower bound.
+ */
+struct LodChain
+{
+	static const uint32 MaxLevels = 4;
+
+	LodChain()
+		: m_LevelCount(1)
+	{
+		for (uint32 i = 0; i < MaxLevels; ++i)
+		{
+			m_ScreenSize[i] = 0.0f;
+		}
+	}
+
+	uint32 m_LevelCount;
+	float m_ScreenSize[MaxLevels];
+};
+
+/**
+ * Per object selection, carried from frame to frame. While m_Fade is below 1
+ * the object is between m_FadeFrom and m_Level.
+ */
+struct LodState
+{
+	static const uint8 InvalidLevel = 0xFF;
+
+	LodState()
+		: m_Level(InvalidLevel)
+		, m_FadeFrom(InvalidLevel)
+		, m_Fade(1.0f)
+	{
+	}
+
+	bool IsFading() const { return m_Fade < 1.0f; }
+
+	uint8 m_Level;
+	uint8 m_FadeFrom;
+	float m_Fade;
+};
+
+class LodSelector
+{
+public:
+	LodSelector();
+
+	/* fraction of a threshold the size has to move past it before the level changes */
+	void SetHysteresis(float band) { m_Hysteresis = band; }
+
+	/* length of a cross-fade in seconds, 0 switches levels at once */
+	void SetFadeTime(float seconds) { m_FadeTime = seconds; }
+
+	/* target frame time, 0 disables the bias */
+	void SetFrameBudget(float milliseconds) { m_FrameBudget = milliseconds; }
+
+	/* bias in levels, every 1.0 halves the size objects are selected with */
+	void SetMaxBias(float bias) { m_MaxBias = bias; }
+
+	/* takes the camera's projection and moves the bias toward the frame budget */
+	void BeginFrame(const Camera& camera, float deltaTime, float frameMilliseconds);
+
+	/* projected radius of a bounding sphere as a fraction of half the screen */
+	float GetScreenSize(const Vector& center, float radius) const;
+
+	/**
+	 * Updates the state of one object and returns its level. Only touches the
+	 * state passed in, so objects can be selected in parallel.
+	 */
+	uint32 Select(const LodChain& chain, const Vector& center, float radius, LodState& state) const;
+
+	float GetBias() const { return m_Bias; }
+
+private:
+	Vector m_CameraPosition;
+	float m_InvTanHalfFOV;
+	float m_DeltaTime;
+
+	float m_Hysteresis;
+	float m_FadeTime;
+	float m_FrameBudget;
+	float m_MaxBias;
+	float m_Bias;
+	float m_BiasScale;
+};
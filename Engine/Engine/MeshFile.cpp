@@ -0,0 +1,113 @@
+#include "MeshFile.h"
+#include "../Tools/RayUtils.h"
+
+/**
+	count elements of stride bytes at offset lie inside size bytes, written so a hostile offset can't wrap
+**/
+static bool FitsIn(uint64 offset, uint64 count, uint64 stride, uint64 size)
+{
+	return offset <= size && count <= (size - offset) / stride;
+}
+
+/**
+	first + count within total, without wrapping
+**/
+static bool RangeIn(uint32 first, uint32 count, uint32 total)
+{
+	return first <= total && count <= total - first;
+}
+
+MeshFile::MeshFile()
+	: m_Header(nullptr)
+{
+}
+
+bool MeshFile::Open(const std::string& path)
+{
+	Close();
+
+	if (!m_File.Open(path))
+		return false;
+
+	const uint64 size = m_File.GetSize();
+	const MeshFileHeader* header = (const MeshFileHeader*)m_File.GetData();
+	if (size < sizeof(MeshFileHeader) || header->m_Magic != MeshFileMagic)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "%s is not a cooked mesh", path.c_str());
+		Close();
+		return false;
+	}
+
+	const VertexProfile profile = VertexProfile::Unpack(header->m_VertexFormat);
+	if (header->m_Version != MeshFileVersion || !profile.IsValid() || header->m_VertexStride != profile.GetStride()
+		|| (header->m_IndexSize != sizeof(uint16) && header->m_IndexSize != sizeof(uint32)))
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "%s was cooked as version %u, format %u, recook it", path.c_str(), header->m_Version, header->m_VertexFormat);
+		Close();
+		return false;
+	}
+
+	if (header->m_FileSize != size
+		|| !FitsIn(header->m_SubMeshOffset, header->m_SubMeshCount, sizeof(MeshFileSubMesh), size)
+		|| !FitsIn(header->m_VertexOffset, header->m_VertexCount, header->m_VertexStride, size)
+		|| !FitsIn(header->m_IndexOffset, header->m_IndexCount, header->m_IndexSize, size))
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "%s is truncated", path.c_str());
+		Close();
+		return false;
+	}
+
+	//draws are built straight from the submesh table, a range past the blobs would read outside the pool allocation
+	const MeshFileSubMesh* subMeshes = (const MeshFileSubMesh*)(m_File.GetData() + header->m_SubMeshOffset);
+	for (uint32 i = 0; i < header->m_SubMeshCount; ++i)
+	{
+		const MeshFileSubMesh& subMesh = subMeshes[i];
+		if (!RangeIn(subMesh.m_BaseVertex, subMesh.m_VertexCount, header->m_VertexCount)
+			|| !RangeIn(subMesh.m_FirstIndex, subMesh.m_IndexCount, header->m_IndexCount))
+		{
+			DEBUG_MESSAGE(RAY_ERROR, "%s: submesh %u lies outside the mesh", path.c_str(), i);
+			Close();
+			return false;
+		}
+	}
+
+	m_Header = header;
+	return true;
+}
+
+void MeshFile::Close()
+{
+	m_Header = nullptr;
+	m_File.Close();
+}
+
+const MeshFileSubMesh* MeshFile::GetSubMeshes() const
+{
+	return (const MeshFileSubMesh*)(m_File.GetData() + m_Header->m_SubMeshOffset);
+}
+
+const void* MeshFile::GetVertices() const
+{
+	return m_File.GetData() + m_Header->m_VertexOffset;
+}
+
+const void* MeshFile::GetIndices() const
+{
+	return m_File.GetData() + m_Header->m_IndexOffset;
+}
+
+Box MeshFile::GetBounds() const
+{
+	return Box(Vector(m_Header->m_BoundsMin[0], m_Header->m_BoundsMin[1], m_Header->m_BoundsMin[2]),
+		Vector(m_Header->m_BoundsMax[0], m_Header->m_BoundsMax[1], m_Header->m_BoundsMax[2]));
+}
+
+Matrix MeshFile::GetDequantization() const
+{
+	Matrix dequantization = Matrix::Identity;
+	dequantization.M[0][0] = m_Header->m_PositionScale[0];
+	dequantization.M[1][1] = m_Header->m_PositionScale[1];
+	dequantization.M[2][2] = m_Header->m_PositionScale[2];
+	dequantization.SetOrigin(Vector(m_Header->m_PositionBias[0], m_Header->m_PositionBias[1], m_Header->m_PositionBias[2]));
+	return dequantization;
+}
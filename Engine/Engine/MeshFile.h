@@ -0,0 +1,85 @@
+//=============================================================================================
+// MeshFile: the cooked mesh format. A fixed header, a submesh table and aligned vertex and
+// index blobs laid out exactly as the gpu buffers want them, so a mapped file is uploaded
+// without any parsing. Written by MeshImporter, little endian.
+//=============================================================================================
+
+#pragma once
+#include "../Config/WindowPlatform.h"
+#include "../Math/RayMath.h"
+#include "../Tools/MappedFile.h"
+#include "VertexFormat.h"
+#include <string>
+
+static const uint32 MeshFileMagic = 0x48534D52; //"RMSH"
+static const uint32 MeshFileVersion = 3;
+static const uint32 MeshFileAlignment = 64;
+
+struct MeshFileHeader
+{
+	uint32 m_Magic;
+	uint32 m_Version;
+	uint32 m_VertexFormat; //VertexProfile::Pack
+	uint32 m_VertexStride;
+	uint32 m_VertexCount;
+	uint32 m_IndexCount;
+	uint32 m_SubMeshCount;
+	uint32 m_IndexSize; //2 when every submesh fits 16 bit indices, else 4
+
+	/* from the start of the file, each a multiple of MeshFileAlignment */
+	uint64 m_SubMeshOffset;
+	uint64 m_VertexOffset;
+	uint64 m_IndexOffset;
+	uint64 m_FileSize;
+
+	float m_BoundsMin[3];
+	float m_BoundsMax[3];
+
+	/* expands the stored positions, see VertexProfile::GetDequantization */
+	float m_PositionScale[3];
+	float m_PositionBias[3];
+};
+
+/**
+ * A range of the blobs drawn with one material. Indices are m_IndexSize
+ * bytes and relative to m_BaseVertex.
+ */
+struct MeshFileSubMesh
+{
+	uint32 m_BaseVertex;
+	uint32 m_VertexCount;
+	uint32 m_FirstIndex;
+	uint32 m_IndexCount;
+	float m_BoundsMin[3];
+	float m_BoundsMax[3];
+	char m_Name[40];
+};
+
+/**
+ * A cooked mesh mapped into memory. Open only checks the header, that the
+ * blobs lie inside the file and the submeshes inside the blobs, the data is
+ * paged in as it's read.
+ */
+class MeshFile
+{
+public:
+	MeshFile();
+
+	bool Open(const std::string& path);
+	void Close();
+
+	bool IsOpen() const { return m_Header != nullptr; }
+	const MeshFileHeader& GetHeader() const { return *m_Header; }
+	const MeshFileSubMesh* GetSubMeshes() const;
+	const void* GetVertices() const;
+	const void* GetIndices() const;
+	Box GetBounds() const;
+	VertexProfile GetVertexProfile() const { return VertexProfile::Unpack(m_Header->m_VertexFormat); }
+
+	/* stored to mesh space, goes in front of the world matrix */
+	Matrix GetDequantization() const;
+
+private:
+	MappedFile m_File;
+	const MeshFileHeader* m_Header;
+};
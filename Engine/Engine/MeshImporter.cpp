@@ -0,0 +1,1109 @@
+#include "MeshImporter.h"
+#include "../Tools/MappedFile.h"
+#include "../Tools/Json.h"
+#include "../Tools/RayUtils.h"
+#include <algorithm>
+#include <fstream>
+#include <math.h>
+#include <string.h>
+#include <unordered_map>
+
+/**
+	shared helpers
+**/
+static std::string GetExtension(const std::string& path)
+{
+	size_t dot = path.find_last_of('.');
+	if (dot == std::string::npos)
+		return std::string();
+
+	std::string extension = path.substr(dot + 1);
+	for (auto& c : extension)
+	{
+		c = (char)tolower(c);
+	}
+	return extension;
+}
+
+static std::string GetDirectory(const std::string& path)
+{
+	size_t slash = path.find_last_of("/\\");
+	return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+}
+
+/* area weighted vertex normals, for sources that don't have any */
+static void GenerateNormals(ImportedSubMesh& subMesh)
+{
+	for (auto& vertex : subMesh.m_Vertices)
+	{
+		vertex.m_Normal = Vector(0.0f, 0.0f, 0.0f);
+	}
+
+	for (size_t i = 0; i + 2 < subMesh.m_Indices.size(); i += 3)
+	{
+		MeshVertex& v0 = subMesh.m_Vertices[subMesh.m_Indices[i]];
+		MeshVertex& v1 = subMesh.m_Vertices[subMesh.m_Indices[i + 1]];
+		MeshVertex& v2 = subMesh.m_Vertices[subMesh.m_Indices[i + 2]];
+		Vector faceNormal = (v1.m_Position - v0.m_Position) ^ (v2.m_Position - v0.m_Position);
+		v0.m_Normal += faceNormal;
+		v1.m_Normal += faceNormal;
+		v2.m_Normal += faceNormal;
+	}
+
+	for (auto& vertex : subMesh.m_Vertices)
+	{
+		vertex.m_Normal = vertex.m_Normal.GetSafeNormal();
+	}
+}
+
+/**
+	OBJ
+**/
+namespace
+{
+	struct ObjVertexKey
+	{
+		uint32 m_Position;
+		uint32 m_UV;
+		uint32 m_Normal;
+
+		bool operator==(const ObjVertexKey& other) const
+		{
+			return m_Position == other.m_Position && m_UV == other.m_UV && m_Normal == other.m_Normal;
+		}
+	};
+
+	struct ObjVertexKeyHash
+	{
+		size_t operator()(const ObjVertexKey& key) const
+		{
+			return (size_t)(key.m_Position * 73856093u ^ key.m_UV * 19349663u ^ key.m_Normal * 83492791u);
+		}
+	};
+
+	static const uint32 ObjMissing = 0xFFFFFFFF;
+
+	/* the mapped file isn't terminated, so nothing here may read past 'end' */
+	class ObjReader
+	{
+	public:
+		ObjReader(const char* begin, const char* end)
+			: m_Cursor(begin)
+			, m_End(end)
+		{
+		}
+
+		bool AtEnd() const { return m_Cursor >= m_End; }
+		bool AtLineEnd() const { return m_Cursor >= m_End || *m_Cursor == '\n' || *m_Cursor == '\r' || *m_Cursor == '#'; }
+
+		void SkipSpaces()
+		{
+			while (m_Cursor < m_End && (*m_Cursor == ' ' || *m_Cursor == '\t'))
+			{
+				++m_Cursor;
+			}
+		}
+
+		void NextLine()
+		{
+			while (m_Cursor < m_End && *m_Cursor != '\n')
+			{
+				++m_Cursor;
+			}
+			if (m_Cursor < m_End)
+			{
+				++m_Cursor;
+			}
+		}
+
+		std::string ReadToken()
+		{
+			SkipSpaces();
+			const char* start = m_Cursor;
+			while (m_Cursor < m_End && *m_Cursor != ' ' && *m_Cursor != '\t' && *m_Cursor != '\n' && *m_Cursor != '\r')
+			{
+				++m_Cursor;
+			}
+			return std::string(start, m_Cursor);
+		}
+
+		std::string ReadRestOfLine()
+		{
+			SkipSpaces();
+			const char* start = m_Cursor;
+			while (m_Cursor < m_End && *m_Cursor != '\n' && *m_Cursor != '\r')
+			{
+				++m_Cursor;
+			}
+			return std::string(start, m_Cursor);
+		}
+
+		bool ReadFloat(float& out)
+		{
+			SkipSpaces();
+
+			bool negative = false;
+			if (m_Cursor < m_End && (*m_Cursor == '-' || *m_Cursor == '+'))
+			{
+				negative = *m_Cursor++ == '-';
+			}
+
+			double value = 0.0;
+			int digits = 0;
+			while (m_Cursor < m_End && *m_Cursor >= '0' && *m_Cursor <= '9')
+			{
+				value = value * 10.0 + (*m_Cursor++ - '0');
+				++digits;
+			}
+
+			if (m_Cursor < m_End && *m_Cursor == '.')
+			{
+				++m_Cursor;
+				double scale = 0.1;
+				while (m_Cursor < m_End && *m_Cursor >= '0' && *m_Cursor <= '9')
+				{
+					value += (*m_Cursor++ - '0') * scale;
+					scale *= 0.1;
+					++digits;
+				}
+			}
+
+			if (digits == 0)
+				return false;
+
+			if (m_Cursor < m_End && (*m_Cursor == 'e' || *m_Cursor == 'E'))
+			{
+				++m_Cursor;
+				bool negativeExponent = false;
+				if (m_Cursor < m_End && (*m_Cursor == '-' || *m_Cursor == '+'))
+				{
+					negativeExponent = *m_Cursor++ == '-';
+				}
+
+				int exponent = 0;
+				while (m_Cursor < m_End && *m_Cursor >= '0' && *m_Cursor <= '9')
+				{
+					exponent = exponent * 10 + (*m_Cursor++ - '0');
+				}
+				value *= pow(10.0, negativeExponent ? -exponent : exponent);
+			}
+
+			out = (float)(negative ? -value : value);
+			return true;
+		}
+
+		/* an OBJ index, 1 based or negative from the end, resolved to 0 based */
+		bool ReadIndex(uint32 count, uint32& out)
+		{
+			bool negative = false;
+			if (m_Cursor < m_End && *m_Cursor == '-')
+			{
+				negative = true;
+				++m_Cursor;
+			}
+
+			int64 value = 0;
+			int digits = 0;
+			while (m_Cursor < m_End && *m_Cursor >= '0' && *m_Cursor <= '9')
+			{
+				value = value * 10 + (*m_Cursor++ - '0');
+				++digits;
+			}
+
+			if (digits == 0 || value == 0)
+				return false;
+
+			int64 index = negative ? (int64)count - value : value - 1;
+			if (index < 0 || index >= (int64)count)
+				return false;
+
+			out = (uint32)index;
+			return true;
+		}
+
+		/* v, v/vt, v//vn or v/vt/vn */
+		bool ReadFaceVertex(uint32 positionCount, uint32 uvCount, uint32 normalCount, ObjVertexKey& key)
+		{
+			key.m_UV = ObjMissing;
+			key.m_Normal = ObjMissing;
+
+			if (!ReadIndex(positionCount, key.m_Position))
+				return false;
+
+			if (m_Cursor < m_End && *m_Cursor == '/')
+			{
+				++m_Cursor;
+				if (m_Cursor < m_End && *m_Cursor != '/' && !ReadIndex(uvCount, key.m_UV))
+					return false;
+
+				if (m_Cursor < m_End && *m_Cursor == '/')
+				{
+					++m_Cursor;
+					if (!ReadIndex(normalCount, key.m_Normal))
+						return false;
+				}
+			}
+			return true;
+		}
+
+	private:
+		const char* m_Cursor;
+		const char* m_End;
+	};
+}
+
+bool MeshImporter::ImportOBJ(const std::string& path, ImportedMesh& mesh)
+{
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "can't open %s", path.c_str());
+		return false;
+	}
+
+	std::vector<Vector> positions;
+	std::vector<Vector> normals;
+	std::vector<float> uvs;
+
+	mesh.m_SubMeshes.clear();
+	mesh.m_SubMeshes.push_back(ImportedSubMesh());
+	std::unordered_map<ObjVertexKey, uint32, ObjVertexKeyHash> vertexMap;
+	std::vector<uint32> polygon;
+	bool missingNormals = false;
+	std::vector<bool> subMeshMissingNormals;
+
+	/* a group, object or material switch closes the current submesh unless it's still empty */
+	auto beginSubMesh = [&](const std::string& name)
+	{
+		if (!mesh.m_SubMeshes.back().m_Indices.empty())
+		{
+			subMeshMissingNormals.push_back(missingNormals);
+			mesh.m_SubMeshes.push_back(ImportedSubMesh());
+			vertexMap.clear();
+			missingNormals = false;
+		}
+		mesh.m_SubMeshes.back().m_Name = name;
+	};
+
+	const char* begin = (const char*)file.GetData();
+	ObjReader reader(begin, begin + file.GetSize());
+	for (uint32 line = 1; !reader.AtEnd(); ++line, reader.NextLine())
+	{
+		std::string keyword = reader.ReadToken();
+		if (keyword.empty() || keyword[0] == '#')
+			continue;
+
+		if (keyword == "v" || keyword == "vn")
+		{
+			Vector value;
+			if (!reader.ReadFloat(value.X) || !reader.ReadFloat(value.Y) || !reader.ReadFloat(value.Z))
+			{
+				DEBUG_MESSAGE(RAY_ERROR, "%s(%u): bad %s", path.c_str(), line, keyword.c_str());
+				return false;
+			}
+			(keyword == "v" ? positions : normals).push_back(value);
+		}
+		else if (keyword == "vt")
+		{
+			float u = 0.0f, v = 0.0f;
+			if (!reader.ReadFloat(u))
+			{
+				DEBUG_MESSAGE(RAY_ERROR, "%s(%u): bad vt", path.c_str(), line);
+				return false;
+			}
+			reader.ReadFloat(v); //v is optional
+			uvs.push_back(u);
+			uvs.push_back(v);
+		}
+		else if (keyword == "f")
+		{
+			ImportedSubMesh& subMesh = mesh.m_SubMeshes.back();
+			polygon.clear();
+			for (reader.SkipSpaces(); !reader.AtLineEnd(); reader.SkipSpaces())
+			{
+				ObjVertexKey key;
+				if (!reader.ReadFaceVertex((uint32)positions.size(), (uint32)uvs.size() / 2, (uint32)normals.size(), key))
+				{
+					DEBUG_MESSAGE(RAY_ERROR, "%s(%u): bad face", path.c_str(), line);
+					return false;
+				}
+
+				auto found = vertexMap.find(key);
+				if (found == vertexMap.end())
+				{
+					MeshVertex vertex;
+					vertex.m_Position = positions[key.m_Position];
+					vertex.m_Normal = key.m_Normal != ObjMissing ? normals[key.m_Normal] : Vector(0.0f, 0.0f, 0.0f);
+					vertex.m_UV[0] = key.m_UV != ObjMissing ? uvs[key.m_UV * 2] : 0.0f;
+					vertex.m_UV[1] = key.m_UV != ObjMissing ? uvs[key.m_UV * 2 + 1] : 0.0f;
+					missingNormals |= key.m_Normal == ObjMissing;
+
+					found = vertexMap.insert(std::make_pair(key, (uint32)subMesh.m_Vertices.size())).first;
+					subMesh.m_Vertices.push_back(vertex);
+				}
+				polygon.push_back(found->second);
+			}
+
+			for (size_t i = 2; i < polygon.size(); ++i)
+			{
+				subMesh.m_Indices.push_back(polygon[0]);
+				subMesh.m_Indices.push_back(polygon[i - 1]);
+				subMesh.m_Indices.push_back(polygon[i]);
+			}
+		}
+		else if (keyword == "o" || keyword == "g" || keyword == "usemtl")
+		{
+			beginSubMesh(reader.ReadRestOfLine());
+		}
+		//mtllib, s, l, p and anything else carries nothing we cook
+	}
+
+	if (mesh.m_SubMeshes.back().m_Indices.empty())
+	{
+		mesh.m_SubMeshes.pop_back();
+	}
+	else
+	{
+		subMeshMissingNormals.push_back(missingNormals);
+	}
+
+	for (size_t i = 0; i < mesh.m_SubMeshes.size(); ++i)
+	{
+		if (subMeshMissingNormals[i])
+		{
+			GenerateNormals(mesh.m_SubMeshes[i]);
+		}
+	}
+
+	DEBUG_MESSAGE(RAY_MESSAGE, "imported %s: %u submeshes", path.c_str(), (uint32)mesh.m_SubMeshes.size());
+	return !mesh.m_SubMeshes.empty();
+}
+
+/**
+	glTF
+**/
+namespace
+{
+	static const uint32 GlbMagic = 0x46546C67; //"glTF"
+	static const uint32 GlbChunkJSON = 0x4E4F534A;
+	static const uint32 GlbChunkBIN = 0x004E4942;
+
+	enum GltfComponentType
+	{
+		GCT_Byte = 5120,
+		GCT_UnsignedByte = 5121,
+		GCT_Short = 5122,
+		GCT_UnsignedShort = 5123,
+		GCT_UnsignedInt = 5125,
+		GCT_Float = 5126,
+	};
+
+	static const uint32 GltfTriangles = 4;
+
+	struct GltfBuffer
+	{
+		GltfBuffer()
+			: m_Data(nullptr)
+			, m_Size(0)
+		{
+		}
+
+		const uint8* m_Data;
+		uint64 m_Size;
+		std::vector<uint8> m_Decoded; //data uris
+	};
+
+	class GltfDocument
+	{
+	public:
+		GltfDocument(const std::string& path)
+			: m_Path(path)
+		{
+		}
+
+		~GltfDocument()
+		{
+			for (auto file : m_Files)
+			{
+				delete file;
+			}
+		}
+
+		bool Load()
+		{
+			if (!m_Source.Open(m_Path))
+			{
+				DEBUG_MESSAGE(RAY_ERROR, "can't open %s", m_Path.c_str());
+				return false;
+			}
+
+			const uint8* data = m_Source.GetData();
+			const uint64 size = m_Source.GetSize();
+			const char* json = (const char*)data;
+			uint64 jsonSize = size;
+			const uint8* binary = nullptr;
+			uint64 binarySize = 0;
+
+			/* a .glb is a 12 byte header followed by a JSON and an optional BIN chunk */
+			if (size >= 12 && *(const uint32*)data == GlbMagic)
+			{
+				const uint32 length = ((const uint32*)data)[2];
+				uint64 offset = 12;
+				while (offset + 8 <= size && offset + 8 <= length)
+				{
+					const uint32 chunkLength = *(const uint32*)(data + offset);
+					const uint32 chunkType = *(const uint32*)(data + offset + 4);
+					if (offset + 8 + chunkLength > size)
+						break;
+
+					if (chunkType == GlbChunkJSON)
+					{
+						json = (const char*)(data + offset + 8);
+						jsonSize = chunkLength;
+					}
+					else if (chunkType == GlbChunkBIN && binary == nullptr)
+					{
+						binary = data + offset + 8;
+						binarySize = chunkLength;
+					}
+					offset += 8 + ((chunkLength + 3) & ~3u);
+				}
+			}
+
+			std::string error;
+			if (!JsonValue::Parse(json, (size_t)jsonSize, m_Root, &error))
+			{
+				DEBUG_MESSAGE(RAY_ERROR, "%s: %s", m_Path.c_str(), error.c_str());
+				return false;
+			}
+
+			const JsonValue& buffers = m_Root["buffers"];
+			m_Buffers.resize(buffers.GetSize());
+			for (uint32 i = 0; i < buffers.GetSize(); ++i)
+			{
+				const JsonValue& buffer = buffers.GetElement(i);
+				GltfBuffer& target = m_Buffers[i];
+				if (!buffer.Has("uri"))
+				{
+					//the glb's own chunk
+					target.m_Data = binary;
+					target.m_Size = binarySize;
+				}
+				else if (!LoadUri(buffer["uri"].GetString(), target))
+				{
+					return false;
+				}
+
+				if (target.m_Data == nullptr || target.m_Size < buffer["byteLength"].GetUInt())
+				{
+					DEBUG_MESSAGE(RAY_ERROR, "%s: buffer %u is missing or short", m_Path.c_str(), i);
+					return false;
+				}
+			}
+			return true;
+		}
+
+		const JsonValue& GetRoot() const { return m_Root; }
+
+		/* fills count * components floats, integer formats are converted and normalized if flagged */
+		bool ReadFloats(uint32 accessorIndex, uint32 components, std::vector<float>& out, uint32& count) const
+		{
+			const JsonValue& accessor = m_Root["accessors"].GetElement(accessorIndex);
+			const uint8* data;
+			uint32 stride;
+			if (!Resolve(accessor, components, data, stride, count))
+				return false;
+
+			const uint32 type = accessor["componentType"].GetUInt();
+			const bool normalized = accessor["normalized"].GetBool();
+			out.resize(count * components);
+			for (uint32 i = 0; i < count; ++i)
+			{
+				const uint8* element = data + (uint64)i * stride;
+				for (uint32 c = 0; c < components; ++c)
+				{
+					float value;
+					switch (type)
+					{
+					case GCT_Float:			value = ((const float*)element)[c]; break;
+					case GCT_Byte:			value = ((const int8*)element)[c]; if (normalized) value = Math::Max(value / 127.0f, -1.0f); break;
+					case GCT_UnsignedByte:	value = ((const uint8*)element)[c]; if (normalized) value /= 255.0f; break;
+					case GCT_Short:			value = ((const int16*)element)[c]; if (normalized) value = Math::Max(value / 32767.0f, -1.0f); break;
+					case GCT_UnsignedShort:	value = ((const uint16*)element)[c]; if (normalized) value /= 65535.0f; break;
+					default:
+						DEBUG_MESSAGE(RAY_ERROR, "%s: accessor %u has an unsupported component type", m_Path.c_str(), accessorIndex);
+						return false;
+					}
+					out[i * components + c] = value;
+				}
+			}
+			return true;
+		}
+
+		bool ReadIndices(uint32 accessorIndex, std::vector<uint32>& out) const
+		{
+			const JsonValue& accessor = m_Root["accessors"].GetElement(accessorIndex);
+			const uint8* data;
+			uint32 stride, count;
+			if (!Resolve(accessor, 1, data, stride, count))
+				return false;
+
+			const uint32 type = accessor["componentType"].GetUInt();
+			out.resize(count);
+			for (uint32 i = 0; i < count; ++i)
+			{
+				const uint8* element = data + (uint64)i * stride;
+				switch (type)
+				{
+				case GCT_UnsignedByte:	out[i] = *element; break;
+				case GCT_UnsignedShort:	out[i] = *(const uint16*)element; break;
+				case GCT_UnsignedInt:	out[i] = *(const uint32*)element; break;
+				default:
+					DEBUG_MESSAGE(RAY_ERROR, "%s: accessor %u has an unsupported index type", m_Path.c_str(), accessorIndex);
+					return false;
+				}
+			}
+			return true;
+		}
+
+	private:
+		static uint32 GetComponentSize(uint32 type)
+		{
+			switch (type)
+			{
+			case GCT_Byte:
+			case GCT_UnsignedByte:
+				return 1;
+			case GCT_Short:
+			case GCT_UnsignedShort:
+				return 2;
+			case GCT_UnsignedInt:
+			case GCT_Float:
+				return 4;
+			}
+			return 0;
+		}
+
+		static uint32 GetComponentCount(const std::string& type)
+		{
+			if (type == "SCALAR") return 1;
+			if (type == "VEC2") return 2;
+			if (type == "VEC3") return 3;
+			if (type == "VEC4") return 4;
+			return 0;
+		}
+
+		/* where the accessor's elements are and how far apart, checked against the buffer */
+		bool Resolve(const JsonValue& accessor, uint32 components, const uint8*& data, uint32& stride, uint32& count) const
+		{
+			if (!accessor.IsObject() || accessor.Has("sparse") || !accessor.Has("bufferView"))
+			{
+				DEBUG_MESSAGE(RAY_ERROR, "%s: missing, sparse or empty accessors aren't supported", m_Path.c_str());
+				return false;
+			}
+
+			const uint32 componentSize = GetComponentSize(accessor["componentType"].GetUInt());
+			if (componentSize == 0 || GetComponentCount(accessor["type"].GetString()) != components)
+			{
+				DEBUG_MESSAGE(RAY_ERROR, "%s: accessor has an unexpected type", m_Path.c_str());
+				return false;
+			}
+
+			const JsonValue& view = m_Root["bufferViews"].GetElement(accessor["bufferView"].GetUInt());
+			const uint32 bufferIndex = view["buffer"].GetUInt(0xFFFFFFFF);
+			if (bufferIndex >= m_Buffers.size())
+			{
+				DEBUG_MESSAGE(RAY_ERROR, "%s: buffer view points at a missing buffer", m_Path.c_str());
+				return false;
+			}
+
+			const uint32 elementSize = componentSize * components;
+			count = accessor["count"].GetUInt();
+			stride = view["byteStride"].GetUInt(0);
+			if (stride == 0)
+			{
+				stride = elementSize;
+			}
+
+			const uint64 viewOffset = (uint64)view["byteOffset"].GetNumber();
+			const uint64 viewLength = (uint64)view["byteLength"].GetNumber();
+			const uint64 offset = (uint64)accessor["byteOffset"].GetNumber();
+			const GltfBuffer& buffer = m_Buffers[bufferIndex];
+			if (count > 0 && (offset + (uint64)(count - 1) * stride + elementSize > viewLength || viewOffset + viewLength > buffer.m_Size))
+			{
+				DEBUG_MESSAGE(RAY_ERROR, "%s: accessor runs past its buffer", m_Path.c_str());
+				return false;
+			}
+
+			data = buffer.m_Data + viewOffset + offset;
+			return true;
+		}
+
+		static int DecodeBase64Char(char c)
+		{
+			if (c >= 'A' && c <= 'Z') return c - 'A';
+			if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+			if (c >= '0' && c <= '9') return c - '0' + 52;
+			if (c == '+' || c == '-') return 62;
+			if (c == '/' || c == '_') return 63;
+			return -1;
+		}
+
+		bool LoadUri(const std::string& uri, GltfBuffer& buffer)
+		{
+			if (uri.compare(0, 5, "data:") == 0)
+			{
+				size_t comma = uri.find(',');
+				if (comma == std::string::npos || uri.rfind(";base64", comma) == std::string::npos)
+				{
+					DEBUG_MESSAGE(RAY_ERROR, "%s: only base64 data uris are supported", m_Path.c_str());
+					return false;
+				}
+
+				uint32 bits = 0;
+				int bitCount = 0;
+				for (size_t i = comma + 1; i < uri.size(); ++i)
+				{
+					int value = DecodeBase64Char(uri[i]);
+					if (value < 0)
+						continue; //padding
+
+					bits = (bits << 6) | (uint32)value;
+					bitCount += 6;
+					if (bitCount >= 8)
+					{
+						bitCount -= 8;
+						buffer.m_Decoded.push_back((uint8)(bits >> bitCount));
+					}
+				}
+				buffer.m_Data = buffer.m_Decoded.empty() ? nullptr : &buffer.m_Decoded[0];
+				buffer.m_Size = buffer.m_Decoded.size();
+				return true;
+			}
+
+			//relative to the .gltf, with %20 style escapes
+			std::string fileName;
+			for (size_t i = 0; i < uri.size(); ++i)
+			{
+				if (uri[i] == '%' && i + 2 < uri.size())
+				{
+					fileName += (char)strtol(uri.substr(i + 1, 2).c_str(), nullptr, 16);
+					i += 2;
+				}
+				else
+				{
+					fileName += uri[i];
+				}
+			}
+
+			MappedFile* file = new MappedFile();
+			m_Files.push_back(file);
+			if (!file->Open(GetDirectory(m_Path) + fileName))
+			{
+				DEBUG_MESSAGE(RAY_ERROR, "%s: can't open buffer %s", m_Path.c_str(), fileName.c_str());
+				return false;
+			}
+			buffer.m_Data = file->GetData();
+			buffer.m_Size = file->GetSize();
+			return true;
+		}
+
+	private:
+		std::string m_Path;
+		MappedFile m_Source;
+		std::vector<MappedFile*> m_Files;
+		JsonValue m_Root;
+		std::vector<GltfBuffer> m_Buffers;
+	};
+
+	/* glTF matrices are column major for column vectors, read in order they're our row vector matrix */
+	static Matrix GetNodeTransform(const JsonValue& node)
+	{
+		Matrix local = Matrix::Identity;
+		const JsonValue& matrix = node["matrix"];
+		if (matrix.GetSize() == 16)
+		{
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				local.M[i / 4][i % 4] = matrix.GetElement(i).GetFloat();
+			}
+			return local;
+		}
+
+		/* translation * rotation * scale for column vectors, scale first for rows */
+		const JsonValue& rotation = node["rotation"];
+		const float x = rotation.GetElement(0).GetFloat(0.0f);
+		const float y = rotation.GetElement(1).GetFloat(0.0f);
+		const float z = rotation.GetElement(2).GetFloat(0.0f);
+		const float w = rotation.GetElement(3).GetFloat(1.0f);
+
+		local.M[0][0] = 1.0f - 2.0f * (y * y + z * z);	local.M[0][1] = 2.0f * (x * y + z * w);			local.M[0][2] = 2.0f * (x * z - y * w);
+		local.M[1][0] = 2.0f * (x * y - z * w);			local.M[1][1] = 1.0f - 2.0f * (x * x + z * z);	local.M[1][2] = 2.0f * (y * z + x * w);
+		local.M[2][0] = 2.0f * (x * z + y * w);			local.M[2][1] = 2.0f * (y * z - x * w);			local.M[2][2] = 1.0f - 2.0f * (x * x + y * y);
+
+		const JsonValue& scale = node["scale"];
+		for (uint32 row = 0; row < 3; ++row)
+		{
+			const float s = scale.GetElement(row).GetFloat(1.0f);
+			local.M[row][0] *= s;
+			local.M[row][1] *= s;
+			local.M[row][2] *= s;
+		}
+
+		const JsonValue& translation = node["translation"];
+		local.M[3][0] = translation.GetElement(0).GetFloat(0.0f);
+		local.M[3][1] = translation.GetElement(1).GetFloat(0.0f);
+		local.M[3][2] = translation.GetElement(2).GetFloat(0.0f);
+		return local;
+	}
+
+	class GltfMeshBuilder
+	{
+	public:
+		GltfMeshBuilder(const GltfDocument& document, ImportedMesh& mesh)
+			: m_Document(document)
+			, m_Mesh(mesh)
+		{
+		}
+
+		bool AddNode(uint32 nodeIndex, const Matrix& parent, uint32 depth)
+		{
+			const JsonValue& node = m_Document.GetRoot()["nodes"].GetElement(nodeIndex);
+			if (!node.IsObject() || depth > 64)
+			{
+				DEBUG_MESSAGE(RAY_ERROR, "bad node %u", nodeIndex);
+				return false;
+			}
+
+			const Matrix world = GetNodeTransform(node) * parent;
+			if (node.Has("mesh") && !AddMesh(node["mesh"].GetUInt(), world))
+				return false;
+
+			const JsonValue& children = node["children"];
+			for (uint32 i = 0; i < children.GetSize(); ++i)
+			{
+				if (!AddNode(children.GetElement(i).GetUInt(), world, depth + 1))
+					return false;
+			}
+			return true;
+		}
+
+		bool AddMesh(uint32 meshIndex, const Matrix& world)
+		{
+			const JsonValue& mesh = m_Document.GetRoot()["meshes"].GetElement(meshIndex);
+			const JsonValue& primitives = mesh["primitives"];
+			for (uint32 i = 0; i < primitives.GetSize(); ++i)
+			{
+				const JsonValue& primitive = primitives.GetElement(i);
+				if (primitive["mode"].GetUInt(GltfTriangles) != GltfTriangles)
+				{
+					DEBUG_MESSAGE(RAY_MESSAGE, "skipping primitive %u of mesh %u, it isn't a triangle list", i, meshIndex);
+					continue;
+				}
+
+				std::string name = mesh["name"].GetString();
+				if (name.empty())
+				{
+					name = "mesh" + std::to_string((uint64)meshIndex);
+				}
+				if (primitives.GetSize() > 1)
+				{
+					name += "." + std::to_string((uint64)i);
+				}
+
+				if (!AddPrimitive(primitive, world, name))
+					return false;
+			}
+			return true;
+		}
+
+	private:
+		bool AddPrimitive(const JsonValue& primitive, const Matrix& world, const std::string& name)
+		{
+			const JsonValue& attributes = primitive["attributes"];
+			if (!attributes.Has("POSITION"))
+			{
+				DEBUG_MESSAGE(RAY_ERROR, "%s has no positions", name.c_str());
+				return false;
+			}
+
+			uint32 vertexCount, count;
+			if (!m_Document.ReadFloats(attributes["POSITION"].GetUInt(), 3, m_Positions, vertexCount))
+				return false;
+
+			const bool hasNormals = attributes.Has("NORMAL");
+			if (hasNormals && (!m_Document.ReadFloats(attributes["NORMAL"].GetUInt(), 3, m_Normals, count) || count != vertexCount))
+				return false;
+
+			const bool hasUVs = attributes.Has("TEXCOORD_0");
+			if (hasUVs && (!m_Document.ReadFloats(attributes["TEXCOORD_0"].GetUInt(), 2, m_UVs, count) || count != vertexCount))
+				return false;
+
+			m_Mesh.m_SubMeshes.push_back(ImportedSubMesh());
+			ImportedSubMesh& subMesh = m_Mesh.m_SubMeshes.back();
+			subMesh.m_Name = name;
+
+			if (primitive.Has("indices"))
+			{
+				if (!m_Document.ReadIndices(primitive["indices"].GetUInt(), subMesh.m_Indices))
+					return false;
+
+				for (auto index : subMesh.m_Indices)
+				{
+					if (index >= vertexCount)
+					{
+						DEBUG_MESSAGE(RAY_ERROR, "%s has an index out of range", name.c_str());
+						return false;
+					}
+				}
+			}
+			else
+			{
+				subMesh.m_Indices.resize(vertexCount);
+				for (uint32 i = 0; i < vertexCount; ++i)
+				{
+					subMesh.m_Indices[i] = i;
+				}
+			}
+			subMesh.m_Indices.resize(subMesh.m_Indices.size() / 3 * 3);
+
+			/* normals go through the cofactor matrix, the inverse transpose up to its scale */
+			float cofactor[3][3];
+			cofactor[0][0] = world.M[1][1] * world.M[2][2] - world.M[1][2] * world.M[2][1];
+			cofactor[0][1] = world.M[1][2] * world.M[2][0] - world.M[1][0] * world.M[2][2];
+			cofactor[0][2] = world.M[1][0] * world.M[2][1] - world.M[1][1] * world.M[2][0];
+			cofactor[1][0] = world.M[0][2] * world.M[2][1] - world.M[0][1] * world.M[2][2];
+			cofactor[1][1] = world.M[0][0] * world.M[2][2] - world.M[0][2] * world.M[2][0];
+			cofactor[1][2] = world.M[0][1] * world.M[2][0] - world.M[0][0] * world.M[2][1];
+			cofactor[2][0] = world.M[0][1] * world.M[1][2] - world.M[0][2] * world.M[1][1];
+			cofactor[2][1] = world.M[0][2] * world.M[1][0] - world.M[0][0] * world.M[1][2];
+			cofactor[2][2] = world.M[0][0] * world.M[1][1] - world.M[0][1] * world.M[1][0];
+			const float determinant = world.M[0][0] * cofactor[0][0] + world.M[0][1] * cofactor[0][1] + world.M[0][2] * cofactor[0][2];
+			const float normalSign = determinant < 0.0f ? -1.0f : 1.0f;
+
+			subMesh.m_Vertices.resize(vertexCount);
+			for (uint32 i = 0; i < vertexCount; ++i)
+			{
+				MeshVertex& vertex = subMesh.m_Vertices[i];
+				const float* p = &m_Positions[i * 3];
+				for (int column = 0; column < 3; ++column)
+				{
+					(&vertex.m_Position.X)[column] = p[0] * world.M[0][column] + p[1] * world.M[1][column] + p[2] * world.M[2][column] + world.M[3][column];
+				}
+
+				if (hasNormals)
+				{
+					const float* n = &m_Normals[i * 3];
+					for (int column = 0; column < 3; ++column)
+					{
+						(&vertex.m_Normal.X)[column] = (n[0] * cofactor[0][column] + n[1] * cofactor[1][column] + n[2] * cofactor[2][column]) * normalSign;
+					}
+					vertex.m_Normal = vertex.m_Normal.GetSafeNormal();
+				}
+
+				vertex.m_UV[0] = hasUVs ? m_UVs[i * 2] : 0.0f;
+				vertex.m_UV[1] = hasUVs ? 1.0f - m_UVs[i * 2 + 1] : 0.0f;
+			}
+
+			//a mirroring transform turns the triangles inside out
+			if (determinant < 0.0f)
+			{
+				for (size_t i = 0; i < subMesh.m_Indices.size(); i += 3)
+				{
+					std::swap(subMesh.m_Indices[i + 1], subMesh.m_Indices[i + 2]);
+				}
+			}
+
+			if (!hasNormals)
+			{
+				GenerateNormals(subMesh);
+			}
+			return true;
+		}
+
+	private:
+		const GltfDocument& m_Document;
+		ImportedMesh& m_Mesh;
+		std::vector<float> m_Positions;
+		std::vector<float> m_Normals;
+		std::vector<float> m_UVs;
+	};
+}
+
+bool MeshImporter::ImportGLTF(const std::string& path, ImportedMesh& mesh)
+{
+	GltfDocument document(path);
+	if (!document.Load())
+		return false;
+
+	mesh.m_SubMeshes.clear();
+	GltfMeshBuilder builder(document, mesh);
+	const JsonValue& root = document.GetRoot();
+	const JsonValue& scenes = root["scenes"];
+
+	if (scenes.GetSize() > 0)
+	{
+		const JsonValue& scene = scenes.GetElement(root["scene"].GetUInt(0));
+		const JsonValue& nodes = scene["nodes"];
+		for (uint32 i = 0; i < nodes.GetSize(); ++i)
+		{
+			if (!builder.AddNode(nodes.GetElement(i).GetUInt(), Matrix::Identity, 0))
+				return false;
+		}
+	}
+	else
+	{
+		//a library of meshes without a scene, take them as they are
+		for (uint32 i = 0; i < root["meshes"].GetSize(); ++i)
+		{
+			if (!builder.AddMesh(i, Matrix::Identity))
+				return false;
+		}
+	}
+
+	DEBUG_MESSAGE(RAY_MESSAGE, "imported %s: %u submeshes", path.c_str(), (uint32)mesh.m_SubMeshes.size());
+	return !mesh.m_SubMeshes.empty();
+}
+
+bool MeshImporter::Import(const std::string& path, ImportedMesh& mesh)
+{
+	const std::string extension = GetExtension(path);
+	if (extension == "obj")
+		return ImportOBJ(path, mesh);
+	if (extension == "gltf" || extension == "glb")
+		return ImportGLTF(path, mesh);
+
+	DEBUG_MESSAGE(RAY_ERROR, "no importer for %s", path.c_str());
+	return false;
+}
+
+/**
+	cooking
+**/
+static uint64 AlignOffset(uint64 offset)
+{
+	return (offset + MeshFileAlignment - 1) & ~(uint64)(MeshFileAlignment - 1);
+}
+
+static void WritePadding(std::ofstream& stream, uint64 from, uint64 to)
+{
+	static const char zeros[MeshFileAlignment] = {};
+	stream.write(zeros, (std::streamsize)(to - from));
+}
+
+bool MeshImporter::Cook(const ImportedMesh& mesh, const std::string& path, const VertexProfile& profile)
+{
+	MeshFileHeader header;
+	memset(&header, 0, sizeof(header));
+	header.m_Magic = MeshFileMagic;
+	header.m_Version = MeshFileVersion;
+	header.m_VertexFormat = profile.Pack();
+	header.m_VertexStride = profile.GetStride();
+	header.m_SubMeshCount = (uint32)mesh.m_SubMeshes.size();
+	header.m_IndexSize = sizeof(uint16);
+
+	/* the submesh table, with bounds and where each lands in the blobs */
+	std::vector<MeshFileSubMesh> subMeshes(mesh.m_SubMeshes.size());
+	Box bounds;
+	for (size_t i = 0; i < mesh.m_SubMeshes.size(); ++i)
+	{
+		const ImportedSubMesh& source = mesh.m_SubMeshes[i];
+		MeshFileSubMesh& subMesh = subMeshes[i];
+		memset(&subMesh, 0, sizeof(subMesh));
+
+		subMesh.m_BaseVertex = header.m_VertexCount;
+		subMesh.m_VertexCount = (uint32)source.m_Vertices.size();
+		subMesh.m_FirstIndex = header.m_IndexCount;
+		subMesh.m_IndexCount = (uint32)source.m_Indices.size();
+		memcpy(subMesh.m_Name, source.m_Name.c_str(), Math::Min(source.m_Name.size(), sizeof(subMesh.m_Name) - 1));
+
+		Box subMeshBounds;
+		for (const auto& vertex : source.m_Vertices)
+		{
+			subMeshBounds += vertex.m_Position;
+		}
+		if (subMeshBounds.IsValid)
+		{
+			memcpy(subMesh.m_BoundsMin, &subMeshBounds.Min.X, sizeof(subMesh.m_BoundsMin));
+			memcpy(subMesh.m_BoundsMax, &subMeshBounds.Max.X, sizeof(subMesh.m_BoundsMax));
+			bounds += subMeshBounds;
+		}
+
+		header.m_VertexCount += subMesh.m_VertexCount;
+		header.m_IndexCount += subMesh.m_IndexCount;
+		if (subMesh.m_VertexCount > 0x10000)
+		{
+			header.m_IndexSize = sizeof(uint32);
+		}
+	}
+
+	if (bounds.IsValid)
+	{
+		memcpy(header.m_BoundsMin, &bounds.Min.X, sizeof(header.m_BoundsMin));
+		memcpy(header.m_BoundsMax, &bounds.Max.X, sizeof(header.m_BoundsMax));
+	}
+
+	Vector positionScale, positionBias;
+	profile.GetDequantization(bounds, positionScale, positionBias);
+	memcpy(header.m_PositionScale, &positionScale.X, sizeof(header.m_PositionScale));
+	memcpy(header.m_PositionBias, &positionBias.X, sizeof(header.m_PositionBias));
+
+	header.m_SubMeshOffset = AlignOffset(sizeof(MeshFileHeader));
+	header.m_VertexOffset = AlignOffset(header.m_SubMeshOffset + subMeshes.size() * sizeof(MeshFileSubMesh));
+	header.m_IndexOffset = AlignOffset(header.m_VertexOffset + (uint64)header.m_VertexCount * header.m_VertexStride);
+	header.m_FileSize = header.m_IndexOffset + (uint64)header.m_IndexCount * header.m_IndexSize;
+
+	std::ofstream stream(path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!stream)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "can't write %s", path.c_str());
+		return false;
+	}
+
+	stream.write((const char*)&header, sizeof(header));
+	WritePadding(stream, sizeof(header), header.m_SubMeshOffset);
+	if (!subMeshes.empty())
+	{
+		stream.write((const char*)&subMeshes[0], subMeshes.size() * sizeof(MeshFileSubMesh));
+	}
+	WritePadding(stream, header.m_SubMeshOffset + subMeshes.size() * sizeof(MeshFileSubMesh), header.m_VertexOffset);
+
+	std::vector<uint8> encoded;
+	for (const auto& subMesh : mesh.m_SubMeshes)
+	{
+		if (subMesh.m_Vertices.empty())
+			continue;
+
+		encoded.resize(subMesh.m_Vertices.size() * header.m_VertexStride);
+		profile.Encode(&subMesh.m_Vertices[0], (uint32)subMesh.m_Vertices.size(), positionScale, positionBias, &encoded[0]);
+		stream.write((const char*)&encoded[0], encoded.size());
+	}
+	WritePadding(stream, header.m_VertexOffset + (uint64)header.m_VertexCount * header.m_VertexStride, header.m_IndexOffset);
+
+	std::vector<uint16> narrowed;
+	for (const auto& subMesh : mesh.m_SubMeshes)
+	{
+		if (subMesh.m_Indices.empty())
+			continue;
+
+		if (header.m_IndexSize == sizeof(uint16))
+		{
+			narrowed.assign(subMesh.m_Indices.begin(), subMesh.m_Indices.end());
+			stream.write((const char*)&narrowed[0], narrowed.size() * sizeof(uint16));
+		}
+		else
+		{
+			stream.write((const char*)&subMesh.m_Indices[0], subMesh.m_Indices.size() * sizeof(uint32));
+		}
+	}
+
+	if (!stream)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "writing %s failed", path.c_str());
+		return false;
+	}
+
+	DEBUG_MESSAGE(RAY_MESSAGE, "cooked %s: %u %s vertices (%u bytes), %u %u bit indices, %u submeshes", path.c_str(),
+		header.m_VertexCount, profile.GetName(), header.m_VertexStride, header.m_IndexCount, header.m_IndexSize * 8, header.m_SubMeshCount);
+	return true;
+}
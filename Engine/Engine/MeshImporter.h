@@ -0,0 +1,46 @@
+//=============================================================================================
+// MeshImporter: reads source meshes (Wavefront OBJ, glTF 2.0 as .gltf or .glb) into a list of
+// submeshes and cooks them into a MeshFile. This is the offline side, the runtime only ever
+// maps the cooked file.
+//=============================================================================================
+
+#pragma once
+#include "MeshFile.h"
+#include <string>
+#include <vector>
+
+/* indices are relative to the submesh's own vertices */
+struct ImportedSubMesh
+{
+	std::string m_Name;
+	std::vector<MeshVertex> m_Vertices;
+	std::vector<uint32> m_Indices;
+};
+
+struct ImportedMesh
+{
+	std::vector<ImportedSubMesh> m_SubMeshes;
+};
+
+class MeshImporter
+{
+public:
+	/* picks the importer from the extension */
+	static bool Import(const std::string& path, ImportedMesh& mesh);
+
+	/**
+	 * Polygons are triangulated as fans, every group, object or material
+	 * switch starts a submesh. Missing normals are generated.
+	 */
+	static bool ImportOBJ(const std::string& path, ImportedMesh& mesh);
+
+	/**
+	 * Triangle primitives of the default scene with their node transforms
+	 * applied, one submesh per primitive. Texture coordinates are flipped to
+	 * a bottom left origin like OBJ's.
+	 */
+	static bool ImportGLTF(const std::string& path, ImportedMesh& mesh);
+
+	/* vertices are encoded with profile, the bounds of the whole mesh set the quantization */
+	static bool Cook(const ImportedMesh& mesh, const std::string& path, const VertexProfile& profile = VertexProfile());
+};
@@ -0,0 +1,315 @@
+#include "MeshOptimizer.h"
+#include "../Tools/RayUtils.h"
+#include <algorithm>
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const std::vector<uint32>& indices, uint32 vertexCount, uint32 cacheSize)
+{
+	VertexCacheStats stats;
+	stats.m_ACMR = 0.0f;
+	stats.m_ATVR = 0.0f;
+	if (indices.size() < 3)
+		return stats;
+
+	/* a vertex is in the FIFO while fewer than cacheSize misses happened since it went in */
+	std::vector<uint32> insertedAt(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	uint32 misses = 0;
+	uint32 usedCount = 0;
+	for (auto index : indices)
+	{
+		if (!used[index])
+		{
+			used[index] = true;
+			++usedCount;
+		}
+		else if (misses - insertedAt[index] < cacheSize)
+		{
+			continue;
+		}
+
+		insertedAt[index] = misses;
+		++misses;
+	}
+
+	stats.m_ACMR = (float)misses / (indices.size() / 3);
+	stats.m_ATVR = (float)misses / usedCount;
+	return stats;
+}
+
+void MeshOptimizer::OptimizeVertexCache(std::vector<uint32>& indices, uint32 vertexCount, uint32 cacheSize, std::vector<uint32>* clusters)
+{
+	const uint32 triangleCount = (uint32)indices.size() / 3;
+	if (clusters != nullptr)
+	{
+		clusters->clear();
+	}
+	if (triangleCount == 0)
+		return;
+
+	/* vertex -> triangle adjacency, and how many unemitted triangles each vertex still has */
+	std::vector<uint32> liveTriangles(vertexCount, 0);
+	for (uint32 i = 0; i < triangleCount * 3; ++i)
+	{
+		++liveTriangles[indices[i]];
+	}
+
+	std::vector<uint32> adjacencyOffset(vertexCount + 1, 0);
+	for (uint32 v = 0; v < vertexCount; ++v)
+	{
+		adjacencyOffset[v + 1] = adjacencyOffset[v] + liveTriangles[v];
+	}
+
+	std::vector<uint32> adjacency(triangleCount * 3);
+	std::vector<uint32> adjacencyFill(adjacencyOffset.begin(), adjacencyOffset.end() - 1);
+	for (uint32 i = 0; i < triangleCount * 3; ++i)
+	{
+		adjacency[adjacencyFill[indices[i]]++] = i / 3;
+	}
+
+	std::vector<uint32> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32> deadEnd;
+	std::vector<uint32> candidates;
+	std::vector<uint32> output;
+	output.reserve(indices.size());
+
+	uint32 time = cacheSize + 1;
+	uint32 cursor = 0;
+	int64 fan = 0;
+	bool cold = true;
+
+	while (fan >= 0)
+	{
+		if (cold && clusters != nullptr && output.size() < indices.size())
+		{
+			clusters->push_back((uint32)output.size() / 3);
+		}
+		cold = false;
+
+		/* emit every remaining triangle around the fanning vertex */
+		candidates.clear();
+		for (uint32 a = adjacencyOffset[(uint32)fan]; a < adjacencyOffset[(uint32)fan + 1]; ++a)
+		{
+			const uint32 triangle = adjacency[a];
+			if (emitted[triangle])
+				continue;
+
+			for (uint32 corner = 0; corner < 3; ++corner)
+			{
+				const uint32 v = indices[triangle * 3 + corner];
+				output.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				--liveTriangles[v];
+				if (time - cacheTime[v] > cacheSize)
+				{
+					cacheTime[v] = time++;
+				}
+			}
+			emitted[triangle] = true;
+		}
+
+		/* next fan: the candidate staying in the cache the longest once its triangles are emitted */
+		int64 best = -1;
+		uint32 bestPriority = 0;
+		for (auto v : candidates)
+		{
+			if (liveTriangles[v] == 0)
+				continue;
+
+			uint32 priority = 0;
+			if (time - cacheTime[v] + 2 * liveTriangles[v] <= cacheSize)
+			{
+				priority = time - cacheTime[v];
+			}
+			if (best < 0 || priority > bestPriority)
+			{
+				best = v;
+				bestPriority = priority;
+			}
+		}
+
+		if (best < 0)
+		{
+			//dead end, back track through recent vertices, then scan for any vertex left
+			while (!deadEnd.empty() && best < 0)
+			{
+				const uint32 v = deadEnd.back();
+				deadEnd.pop_back();
+				if (liveTriangles[v] > 0)
+				{
+					best = v;
+				}
+			}
+			while (best < 0 && cursor < vertexCount)
+			{
+				if (liveTriangles[cursor] > 0)
+				{
+					best = cursor;
+				}
+				++cursor;
+			}
+			cold = true;
+		}
+		fan = best;
+	}
+
+	indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeOverdraw(std::vector<uint32>& indices, const std::vector<MeshVertex>& vertices, const std::vector<uint32>& clusters,
+	float threshold, uint32 cacheSize)
+{
+	const uint32 triangleCount = (uint32)indices.size() / 3;
+	if (triangleCount == 0 || clusters.empty())
+		return;
+
+	/* soft boundaries: cut a cluster again whenever the misses so far come down to its own rate */
+	std::vector<uint32> insertedAt(vertices.size(), 0);
+	std::vector<bool> cached(vertices.size(), false);
+	uint32 misses = 0;
+	auto countMisses = [&](uint32 triangle) -> uint32
+	{
+		uint32 triangleMisses = 0;
+		for (uint32 corner = 0; corner < 3; ++corner)
+		{
+			const uint32 v = indices[triangle * 3 + corner];
+			if (cached[v] && misses - insertedAt[v] < cacheSize)
+				continue;
+
+			cached[v] = true;
+			insertedAt[v] = misses++;
+			++triangleMisses;
+		}
+		return triangleMisses;
+	};
+	auto flushCache = [&]()
+	{
+		misses += cacheSize;
+	};
+
+	std::vector<uint32> splits;
+	for (size_t c = 0; c < clusters.size(); ++c)
+	{
+		const uint32 begin = clusters[c];
+		const uint32 end = c + 1 < clusters.size() ? clusters[c + 1] : triangleCount;
+
+		flushCache();
+		uint32 clusterMisses = 0;
+		for (uint32 t = begin; t < end; ++t)
+		{
+			clusterMisses += countMisses(t);
+		}
+		const float clusterThreshold = threshold * clusterMisses / (end - begin);
+
+		flushCache();
+		splits.push_back(begin);
+		uint32 runMisses = 0, runTriangles = 0;
+		for (uint32 t = begin; t < end; ++t)
+		{
+			runMisses += countMisses(t);
+			++runTriangles;
+			if (t + 1 < end && (float)runMisses / runTriangles <= clusterThreshold)
+			{
+				splits.push_back(t + 1);
+				runMisses = runTriangles = 0;
+				flushCache();
+			}
+		}
+	}
+
+	/* clusters whose faces point away from the center occlude the rest, so they go first */
+	struct ClusterOrder
+	{
+		uint32 m_Begin;
+		uint32 m_End;
+		Vector m_Centroid;
+		Vector m_Normal;
+		float m_Sort;
+	};
+
+	std::vector<ClusterOrder> order(splits.size());
+	Vector meshCentroid(0.0f, 0.0f, 0.0f);
+	float meshArea = 0.0f;
+	for (size_t c = 0; c < splits.size(); ++c)
+	{
+		ClusterOrder& cluster = order[c];
+		cluster.m_Begin = splits[c];
+		cluster.m_End = c + 1 < splits.size() ? splits[c + 1] : triangleCount;
+		cluster.m_Centroid = Vector(0.0f, 0.0f, 0.0f);
+		cluster.m_Normal = Vector(0.0f, 0.0f, 0.0f);
+
+		float clusterArea = 0.0f;
+		for (uint32 t = cluster.m_Begin; t < cluster.m_End; ++t)
+		{
+			const Vector& p0 = vertices[indices[t * 3]].m_Position;
+			const Vector& p1 = vertices[indices[t * 3 + 1]].m_Position;
+			const Vector& p2 = vertices[indices[t * 3 + 2]].m_Position;
+			const Vector normal = (p1 - p0) ^ (p2 - p0);
+			const float area = normal.Size();
+			cluster.m_Normal += normal;
+			cluster.m_Centroid += (p0 + p1 + p2) * (area / 3.0f);
+			clusterArea += area;
+		}
+
+		meshCentroid += cluster.m_Centroid;
+		meshArea += clusterArea;
+		cluster.m_Centroid = clusterArea > 0.0f ? cluster.m_Centroid * (1.0f / clusterArea) : vertices[indices[cluster.m_Begin * 3]].m_Position;
+		cluster.m_Normal = cluster.m_Normal.GetSafeNormal();
+	}
+	if (meshArea > 0.0f)
+	{
+		meshCentroid = meshCentroid * (1.0f / meshArea);
+	}
+
+	for (auto& cluster : order)
+	{
+		cluster.m_Sort = (cluster.m_Centroid - meshCentroid) | cluster.m_Normal;
+	}
+	std::stable_sort(order.begin(), order.end(), [](const ClusterOrder& a, const ClusterOrder& b) { return a.m_Sort > b.m_Sort; });
+
+	std::vector<uint32> output;
+	output.reserve(indices.size());
+	for (const auto& cluster : order)
+	{
+		output.insert(output.end(), indices.begin() + cluster.m_Begin * 3, indices.begin() + cluster.m_End * 3);
+	}
+	indices.swap(output);
+}
+
+void MeshOptimizer::OptimizeVertexFetch(std::vector<MeshVertex>& vertices, std::vector<uint32>& indices)
+{
+	const uint32 unassigned = 0xFFFFFFFF;
+	std::vector<uint32> remap(vertices.size(), unassigned);
+	std::vector<MeshVertex> output;
+	output.reserve(vertices.size());
+
+	for (auto& index : indices)
+	{
+		if (remap[index] == unassigned)
+		{
+			remap[index] = (uint32)output.size();
+			output.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices.swap(output);
+}
+
+void MeshOptimizer::Optimize(ImportedMesh& mesh)
+{
+	std::vector<uint32> clusters;
+	for (auto& subMesh : mesh.m_SubMeshes)
+	{
+		const uint32 vertexCount = (uint32)subMesh.m_Vertices.size();
+		const VertexCacheStats before = AnalyzeVertexCache(subMesh.m_Indices, vertexCount);
+
+		OptimizeVertexCache(subMesh.m_Indices, vertexCount, DefaultCacheSize, &clusters);
+		OptimizeOverdraw(subMesh.m_Indices, subMesh.m_Vertices, clusters);
+		OptimizeVertexFetch(subMesh.m_Vertices, subMesh.m_Indices);
+
+		const VertexCacheStats after = AnalyzeVertexCache(subMesh.m_Indices, (uint32)subMesh.m_Vertices.size());
+		DEBUG_MESSAGE(RAY_MESSAGE, "optimized '%s': %u triangles, ACMR %.3f -> %.3f, ATVR %.3f -> %.3f", subMesh.m_Name.c_str(),
+			(uint32)subMesh.m_Indices.size() / 3, before.m_ACMR, after.m_ACMR, before.m_ATVR, after.m_ATVR);
+	}
+}
@@ -0,0 +1,44 @@
+//=============================================================================================
+// MeshOptimizer: cook time reordering of imported meshes. Triangles are ordered for the post
+// transform vertex cache with Tipsify, the resulting clusters are ordered outside in to cut
+// overdraw, then vertices are renumbered in the order they're first used for fetch locality.
+//=============================================================================================
+
+#pragma once
+#include "MeshImporter.h"
+#include <vector>
+
+/* simulated on a FIFO cache, ACMR is misses per triangle, ATVR misses per vertex */
+struct VertexCacheStats
+{
+	float m_ACMR;
+	float m_ATVR;
+};
+
+class MeshOptimizer
+{
+public:
+	static const uint32 DefaultCacheSize = 16;
+
+	static VertexCacheStats AnalyzeVertexCache(const std::vector<uint32>& indices, uint32 vertexCount, uint32 cacheSize = DefaultCacheSize);
+
+	/**
+	 * Tipsify: fans around vertices that are still in the cache. clusters gets
+	 * the first triangle of every run that starts from a cold cache.
+	 */
+	static void OptimizeVertexCache(std::vector<uint32>& indices, uint32 vertexCount, uint32 cacheSize = DefaultCacheSize, std::vector<uint32>* clusters = nullptr);
+
+	/**
+	 * Splits the clusters from OptimizeVertexCache where their miss rate comes
+	 * within threshold of the cluster's, then draws the clusters facing away
+	 * from the mesh center first.
+	 */
+	static void OptimizeOverdraw(std::vector<uint32>& indices, const std::vector<MeshVertex>& vertices, const std::vector<uint32>& clusters,
+		float threshold = 1.05f, uint32 cacheSize = DefaultCacheSize);
+
+	/* renumbers vertices by first use and drops the unused ones */
+	static void OptimizeVertexFetch(std::vector<MeshVertex>& vertices, std::vector<uint32>& indices);
+
+	/* all three on every submesh, the cache stats before and after are logged */
+	static void Optimize(ImportedMesh& mesh);
+};
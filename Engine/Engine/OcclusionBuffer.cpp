@@ -0,0 +1,317 @@
+#include "OcclusionBuffer.h"
+#include "JobSystem.h"
+#include "../Tools/RayUtils.h"
+#include <chrono>
+#include <float.h>
+
+OcclusionBuffer::OcclusionBuffer()
+	: m_Width(0)
+	, m_Height(0)
+	, m_TilesX(0)
+	, m_TilesY(0)
+	, m_ViewProj(Matrix::Identity)
+	, m_NearClip(0.0f)
+{
+	m_Stats.m_Triangles = 0;
+	m_Stats.m_Skipped = 0;
+	m_Stats.m_Milliseconds = 0.0f;
+}
+
+void OcclusionBuffer::Init(uint32 width, uint32 height)
+{
+	m_TilesX = (width + TileWidth - 1) / TileWidth;
+	m_TilesY = (height + TileHeight - 1) / TileHeight;
+	m_Width = m_TilesX * TileWidth;
+	m_Height = m_TilesY * TileHeight;
+	m_Tiles.resize(m_TilesX * m_TilesY);
+
+	DEBUG_MESSAGE(RAY_MESSAGE, "Occlusion buffer: %u x %u, %u tiles", m_Width, m_Height, m_TilesX * m_TilesY);
+}
+
+void OcclusionBuffer::BeginFrame(const Matrix& viewProj, float nearClip)
+{
+	m_ViewProj = viewProj;
+	m_NearClip = nearClip;
+	m_Triangles.clear();
+
+	for (auto& tile : m_Tiles)
+	{
+		tile.m_ZMax0 = FLT_MAX;
+		tile.m_ZMax1 = 0.0f;
+		tile.m_Mask = 0;
+	}
+
+	m_Stats.m_Triangles = 0;
+	m_Stats.m_Skipped = 0;
+	m_Stats.m_Milliseconds = 0.0f;
+}
+
+void OcclusionBuffer::AddOccluder(const Vector* positions, uint32 vertexCount, const uint32* indices, uint32 indexCount, const Matrix& world)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const Matrix worldViewProj = world * m_ViewProj;
+	m_ClipPositions.resize(vertexCount);
+	for (uint32 i = 0; i < vertexCount; ++i)
+	{
+		const Vector& p = positions[i];
+		Vector4& clip = m_ClipPositions[i];
+		clip.X = p.X * worldViewProj.M[0][0] + p.Y * worldViewProj.M[1][0] + p.Z * worldViewProj.M[2][0] + worldViewProj.M[3][0];
+		clip.Y = p.X * worldViewProj.M[0][1] + p.Y * worldViewProj.M[1][1] + p.Z * worldViewProj.M[2][1] + worldViewProj.M[3][1];
+		clip.Z = p.X * worldViewProj.M[0][2] + p.Y * worldViewProj.M[1][2] + p.Z * worldViewProj.M[2][2] + worldViewProj.M[3][2];
+		clip.W = p.X * worldViewProj.M[0][3] + p.Y * worldViewProj.M[1][3] + p.Z * worldViewProj.M[2][3] + worldViewProj.M[3][3];
+	}
+
+	const float halfWidth = m_Width * 0.5f;
+	const float halfHeight = m_Height * 0.5f;
+	for (uint32 i = 0; i + 2 < indexCount; i += 3)
+	{
+		ScreenTriangle triangle;
+		bool clipped = false;
+		for (int v = 0; v < 3; ++v)
+		{
+			const Vector4& clip = m_ClipPositions[indices[i + v]];
+			//not clipped against the near plane, dropping the triangle keeps the buffer conservative
+			if (clip.W < m_NearClip)
+			{
+				clipped = true;
+				break;
+			}
+
+			const float invW = 1.0f / clip.W;
+			triangle.m_X[v] = (clip.X * invW + 1.0f) * halfWidth;
+			triangle.m_Y[v] = (clip.Y * invW + 1.0f) * halfHeight;
+			triangle.m_InvW[v] = invW;
+		}
+
+		if (clipped)
+		{
+			++m_Stats.m_Skipped;
+			continue;
+		}
+		m_Triangles.push_back(triangle);
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	m_Stats.m_Milliseconds += std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void OcclusionBuffer::Rasterize()
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	//every band owns its tile rows, so no two threads touch the same tile
+	const uint32 bandRows = 4;
+	const uint32 bandCount = (m_TilesY + bandRows - 1) / bandRows;
+	auto rasterizeBands = [this, bandRows](uint32 begin, uint32 end, uint32 thread)
+	{
+		for (uint32 band = begin; band < end; ++band)
+		{
+			const uint32 rowBegin = band * bandRows;
+			const uint32 rowEnd = rowBegin + bandRows < m_TilesY ? rowBegin + bandRows : m_TilesY;
+			for (const auto& triangle : m_Triangles)
+			{
+				RasterizeTriangle(triangle, rowBegin, rowEnd);
+			}
+		}
+	};
+
+	JobSystem* jobs = JobSystem::getInstancePtr();
+	if (jobs != nullptr)
+	{
+		jobs->ParallelFor(bandCount, 1, rasterizeBands);
+	}
+	else
+	{
+		rasterizeBands(0, bandCount, 0);
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	m_Stats.m_Triangles = (uint32)m_Triangles.size();
+	m_Stats.m_Milliseconds += std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void OcclusionBuffer::RasterizeTriangle(const ScreenTriangle& triangle, uint32 tileRowBegin, uint32 tileRowEnd)
+{
+	const float* x = triangle.m_X;
+	const float* y = triangle.m_Y;
+	const float* invW = triangle.m_InvW;
+
+	float area = (x[1] - x[0]) * (y[2] - y[0]) - (y[1] - y[0]) * (x[2] - x[0]);
+	if (Math::Abs(area) < SMALL_NUMBER)
+		return;
+
+	//edges as a x + b y + c, positive inside whatever the winding
+	const float sign = area > 0.0f ? 1.0f : -1.0f;
+	float edgeA[3], edgeB[3], edgeC[3];
+	for (int e = 0; e < 3; ++e)
+	{
+		const int v0 = e;
+		const int v1 = (e + 1) % 3;
+		edgeA[e] = -(y[v1] - y[v0]) * sign;
+		edgeB[e] = (x[v1] - x[v0]) * sign;
+		edgeC[e] = -(edgeA[e] * x[v0] + edgeB[e] * y[v0]);
+	}
+
+	//1/w is linear in screen space, its smallest value over a tile gives the tile's furthest depth
+	const float invArea = 1.0f / area;
+	const float depthA = ((invW[1] - invW[0]) * (y[2] - y[0]) - (invW[2] - invW[0]) * (y[1] - y[0])) * invArea;
+	const float depthB = ((invW[2] - invW[0]) * (x[1] - x[0]) - (invW[1] - invW[0]) * (x[2] - x[0])) * invArea;
+	const float depthC = invW[0] - depthA * x[0] - depthB * y[0];
+	const float minInvW = Math::Min(invW[0], Math::Min(invW[1], invW[2]));
+
+	const float minX = Math::Min(x[0], Math::Min(x[1], x[2]));
+	const float maxX = Math::Max(x[0], Math::Max(x[1], x[2]));
+	const float minY = Math::Min(y[0], Math::Min(y[1], y[2]));
+	const float maxY = Math::Max(y[0], Math::Max(y[1], y[2]));
+	if (maxX < 0.0f || maxY < 0.0f || minX >= m_Width || minY >= m_Height)
+		return;
+
+	const uint32 tileX0 = minX > 0.0f ? (uint32)minX / TileWidth : 0;
+	const uint32 tileX1 = Math::Min((uint32)maxX / TileWidth, m_TilesX - 1);
+	const uint32 tileY0 = Math::Max(minY > 0.0f ? (uint32)minY / TileHeight : 0, tileRowBegin);
+	const uint32 tileY1 = Math::Min(Math::Min((uint32)maxY / TileHeight, m_TilesY - 1), tileRowEnd - 1);
+	if (tileY0 > tileY1)
+		return;
+
+	VectorRegister a[3], b[3], laneOffset[3];
+	for (int e = 0; e < 3; ++e)
+	{
+		a[e] = VectorLoadFloat1(&edgeA[e]);
+		b[e] = VectorLoadFloat1(&edgeB[e]);
+		//pixel centers of lanes 0-3 of a tile row
+		laneOffset[e] = VectorMultiply(a[e], VectorSet(0.5f, 1.5f, 2.5f, 3.5f));
+	}
+	const VectorRegister halfTileStep = VectorSet(4.0f, 4.0f, 4.0f, 4.0f);
+
+	for (uint32 tileY = tileY0; tileY <= tileY1; ++tileY)
+	{
+		const float rowY = tileY * TileHeight + 0.5f;
+		for (uint32 tileX = tileX0; tileX <= tileX1; ++tileX)
+		{
+			const float tileLeft = (float)(tileX * TileWidth);
+
+			/* coverage of the 8x4 pixel centers, 4 pixels per register */
+			uint32 coverage = 0;
+			for (uint32 row = 0; row < TileHeight; ++row)
+			{
+				const float py = rowY + row;
+				VectorRegister insideLo = VectorCompareEQ(VectorZero(), VectorZero());
+				VectorRegister insideHi = insideLo;
+				for (int e = 0; e < 3; ++e)
+				{
+					const float base = edgeA[e] * tileLeft + edgeB[e] * py + edgeC[e];
+					const VectorRegister lo = VectorAdd(VectorLoadFloat1(&base), laneOffset[e]);
+					const VectorRegister hi = VectorMultiplyAdd(a[e], halfTileStep, lo);
+					insideLo = VectorBitwiseAnd(insideLo, VectorCompareGT(lo, VectorZero()));
+					insideHi = VectorBitwiseAnd(insideHi, VectorCompareGT(hi, VectorZero()));
+				}
+				coverage |= (uint32)(VectorMaskBits(insideLo) | (VectorMaskBits(insideHi) << 4)) << (row * TileWidth);
+			}
+
+			if (coverage == 0)
+				continue;
+
+			const float tileTop = (float)(tileY * TileHeight);
+			float tileMinInvW = depthC + depthA * tileLeft + depthB * tileTop;
+			tileMinInvW = Math::Min(tileMinInvW, depthC + depthA * (tileLeft + TileWidth) + depthB * tileTop);
+			tileMinInvW = Math::Min(tileMinInvW, depthC + depthA * tileLeft + depthB * (tileTop + TileHeight));
+			tileMinInvW = Math::Min(tileMinInvW, depthC + depthA * (tileLeft + TileWidth) + depthB * (tileTop + TileHeight));
+			tileMinInvW = Math::Max(tileMinInvW, minInvW);
+
+			UpdateTile(m_Tiles[tileY * m_TilesX + tileX], coverage, 1.0f / tileMinInvW);
+		}
+	}
+}
+
+void OcclusionBuffer::UpdateTile(Tile& tile, uint32 coverage, float depth)
+{
+	//entirely behind what the tile already holds
+	if (depth >= tile.m_ZMax0)
+		return;
+
+	//the working layer is much nearer than this triangle, drop it rather than pushing its depth back
+	const float distance1 = depth - tile.m_ZMax1;
+	const float distance0 = tile.m_ZMax0 - depth;
+	if (tile.m_Mask != 0 && distance1 > distance0)
+	{
+		tile.m_ZMax1 = 0.0f;
+		tile.m_Mask = 0;
+	}
+
+	tile.m_ZMax1 = Math::Max(tile.m_ZMax1, depth);
+	tile.m_Mask |= coverage;
+
+	if (tile.m_Mask == 0xFFFFFFFF)
+	{
+		tile.m_ZMax0 = tile.m_ZMax1;
+		tile.m_ZMax1 = 0.0f;
+		tile.m_Mask = 0;
+	}
+}
+
+bool OcclusionBuffer::IsVisible(const Vector& center, const Vector& extent) const
+{
+	float minX = FLT_MAX, minY = FLT_MAX, maxX = -FLT_MAX, maxY = -FLT_MAX;
+	float nearest = FLT_MAX;
+
+	for (int corner = 0; corner < 8; ++corner)
+	{
+		const Vector p(center.X + ((corner & 1) ? extent.X : -extent.X),
+			center.Y + ((corner & 2) ? extent.Y : -extent.Y),
+			center.Z + ((corner & 4) ? extent.Z : -extent.Z));
+
+		const float clipX = p.X * m_ViewProj.M[0][0] + p.Y * m_ViewProj.M[1][0] + p.Z * m_ViewProj.M[2][0] + m_ViewProj.M[3][0];
+		const float clipY = p.X * m_ViewProj.M[0][1] + p.Y * m_ViewProj.M[1][1] + p.Z * m_ViewProj.M[2][1] + m_ViewProj.M[3][1];
+		const float clipW = p.X * m_ViewProj.M[0][3] + p.Y * m_ViewProj.M[1][3] + p.Z * m_ViewProj.M[2][3] + m_ViewProj.M[3][3];
+
+		//reaching in front of the near plane, can't be hidden
+		if (clipW < m_NearClip)
+			return true;
+
+		const float invW = 1.0f / clipW;
+		const float screenX = (clipX * invW + 1.0f) * m_Width * 0.5f;
+		const float screenY = (clipY * invW + 1.0f) * m_Height * 0.5f;
+		minX = Math::Min(minX, screenX);
+		maxX = Math::Max(maxX, screenX);
+		minY = Math::Min(minY, screenY);
+		maxY = Math::Max(maxY, screenY);
+		nearest = Math::Min(nearest, clipW);
+	}
+
+	if (maxX < 0.0f || maxY < 0.0f || minX >= m_Width || minY >= m_Height)
+		return true;
+
+	const uint32 pixelX0 = minX > 0.0f ? (uint32)minX : 0;
+	const uint32 pixelY0 = minY > 0.0f ? (uint32)minY : 0;
+	const uint32 pixelX1 = Math::Min((uint32)maxX, m_Width - 1);
+	const uint32 pixelY1 = Math::Min((uint32)maxY, m_Height - 1);
+
+	for (uint32 tileY = pixelY0 / TileHeight; tileY <= pixelY1 / TileHeight; ++tileY)
+	{
+		for (uint32 tileX = pixelX0 / TileWidth; tileX <= pixelX1 / TileWidth; ++tileX)
+		{
+			const Tile& tile = m_Tiles[tileY * m_TilesX + tileX];
+			if (nearest >= tile.m_ZMax0)
+				continue;
+
+			//pixels of the box inside this tile
+			const uint32 x0 = Math::Max(pixelX0, tileX * TileWidth) - tileX * TileWidth;
+			const uint32 x1 = Math::Min(pixelX1, tileX * TileWidth + TileWidth - 1) - tileX * TileWidth;
+			const uint32 y0 = Math::Max(pixelY0, tileY * TileHeight) - tileY * TileHeight;
+			const uint32 y1 = Math::Min(pixelY1, tileY * TileHeight + TileHeight - 1) - tileY * TileHeight;
+			const uint32 rowBits = ((1u << (x1 + 1)) - 1) & ~((1u << x0) - 1);
+			uint32 boxMask = 0;
+			for (uint32 row = y0; row <= y1; ++row)
+			{
+				boxMask |= rowBits << (row * TileWidth);
+			}
+
+			//nearer than the reference layer, hidden only where the working layer covers it from the front
+			if ((boxMask & ~tile.m_Mask) != 0 || nearest < tile.m_ZMax1)
+				return true;
+		}
+	}
+
+	return false;
+}
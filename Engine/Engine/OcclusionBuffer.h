@@ -0,0 +1,88 @@
+//=============================================================================================
+// OcclusionBuffer: a low resolution masked depth buffer rasterized on the cpu. Occluder
+// triangles are drawn into 8x4 pixel tiles, each keeping a 32-bit coverage mask and two
+// depth layers instead of per-pixel depth. Occludee bounds are tested against it before
+// their draws are recorded.
+//=============================================================================================
+
+#pragma once
+#include "../Config/RayConifg.h"
+#include "../Math/RayMath.h"
+#include <vector>
+
+struct OcclusionStats
+{
+	uint32 m_Triangles;		//occluder triangles rasterized
+	uint32 m_Skipped;		//occluder triangles crossing the near plane, left out
+	float m_Milliseconds;	//transform and rasterization
+};
+
+class OcclusionBuffer
+{
+public:
+	static const uint32 TileWidth = 8;
+	static const uint32 TileHeight = 4;
+
+	OcclusionBuffer();
+
+	/* the size is rounded up to whole tiles */
+	void Init(uint32 width, uint32 height);
+
+	/* clears the buffer, nearClip is the view space depth of the camera's near plane */
+	void BeginFrame(const Matrix& viewProj, float nearClip);
+
+	/**
+	 * Queues an occluder mesh, positions are transformed by world then the
+	 * view projection. Occluders should be solid and close to their bounds,
+	 * both windings are drawn.
+	 */
+	void AddOccluder(const Vector* positions, uint32 vertexCount, const uint32* indices, uint32 indexCount, const Matrix& world);
+
+	/* draws the queued occluders, bands of tile rows go to the JobSystem */
+	void Rasterize();
+
+	/**
+	 * Conservative: false only if the box is hidden behind the occluders.
+	 * Thread safe once Rasterize returned.
+	 */
+	bool IsVisible(const Vector& center, const Vector& extent) const;
+
+	const OcclusionStats& GetStats() const { return m_Stats; }
+
+private:
+	/**
+	 * Depths are view space w, larger is further. m_ZMax0 bounds every pixel of
+	 * the tile, m_ZMax1 bounds the pixels set in m_Mask which are still being
+	 * filled. Once the mask is full the working layer becomes the reference.
+	 */
+	struct Tile
+	{
+		float m_ZMax0;
+		float m_ZMax1;
+		uint32 m_Mask;
+	};
+
+	struct ScreenTriangle
+	{
+		float m_X[3];
+		float m_Y[3];
+		float m_InvW[3];
+	};
+
+	void RasterizeTriangle(const ScreenTriangle& triangle, uint32 tileRowBegin, uint32 tileRowEnd);
+	static void UpdateTile(Tile& tile, uint32 coverage, float depth);
+
+private:
+	uint32 m_Width;
+	uint32 m_Height;
+	uint32 m_TilesX;
+	uint32 m_TilesY;
+	std::vector<Tile> m_Tiles;
+
+	Matrix m_ViewProj;
+	float m_NearClip;
+	std::vector<ScreenTriangle> m_Triangles;
+	std::vector<Vector4> m_ClipPositions;
+
+	OcclusionStats m_Stats;
+};
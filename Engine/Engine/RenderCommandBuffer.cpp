@@ -0,0 +1,39 @@
+#include "RenderCommandBuffer.h"
+#include "../Tools/RayUtils.h"
+#include <string.h>
+
+RenderCommandBuffer::RenderCommandBuffer(uint32 capacity)
+	: m_Storage(capacity)
+	, m_Size(0)
+{
+}
+
+void* RenderCommandBuffer::Push(uint16 type, uint32 size)
+{
+	const uint32 total = sizeof(RenderCommandHeader) + size;
+	if (m_Size + total > m_Storage.size())
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "render command buffer full, %u bytes", (uint32)m_Storage.size());
+		return nullptr;
+	}
+
+	RenderCommandHeader header;
+	header.m_Type = type;
+	header.m_Size = (uint16)size;
+	memcpy(&m_Storage[m_Size], &header, sizeof(header));
+
+	void* payload = &m_Storage[m_Size + sizeof(header)];
+	m_Size += total;
+	return payload;
+}
+
+bool RenderCommandBuffer::Next(uint32& cursor, RenderCommandHeader& outHeader, const uint8*& outPayload) const
+{
+	if (cursor + sizeof(RenderCommandHeader) > m_Size)
+		return false;
+
+	memcpy(&outHeader, &m_Storage[cursor], sizeof(outHeader));
+	outPayload = &m_Storage[cursor + sizeof(outHeader)];
+	cursor += sizeof(outHeader) + outHeader.m_Size;
+	return true;
+}
@@ -0,0 +1,101 @@
+//=============================================================================================
+// RenderCommandBuffer: a frame recorded as a flat stream of small POD commands. It is written
+// by the main thread and replayed by the render thread, its storage is allocated once and
+// reused every frame.
+//=============================================================================================
+
+#pragma once
+#include "../Config/RayConifg.h"
+#include "../Math/RayMath.h"
+#include <string.h>
+#include <vector>
+
+class RenderQueue;
+
+enum RenderCommandType
+{
+	RCT_Clear = 0,
+	RCT_SetView,
+	RCT_DrawQueue,
+};
+
+enum RenderClearFlags
+{
+	RCF_Color = 1 << 0,
+	RCF_Depth = 1 << 1,
+};
+
+struct RenderCommandHeader
+{
+	uint16 m_Type;
+	uint16 m_Size; //payload bytes following the header
+};
+
+struct ClearCommand
+{
+	static const uint16 Type = RCT_Clear;
+
+	uint32 m_Flags;
+	Vector4 m_Color;
+	float m_Depth;
+};
+
+struct SetViewCommand
+{
+	static const uint16 Type = RCT_SetView;
+
+	Matrix m_View;
+	Matrix m_Proj;
+	Matrix m_ViewProj;
+	Vector4 m_Time; //x: total time, y: delta time
+};
+
+/**
+ * The queue must stay untouched until the frame holding this command was executed.
+ */
+struct DrawQueueCommand
+{
+	static const uint16 Type = RCT_DrawQueue;
+
+	const RenderQueue* m_Queue;
+};
+
+class RenderCommandBuffer
+{
+public:
+	explicit RenderCommandBuffer(uint32 capacity = 64 * 1024);
+
+	void Reset() { m_Size = 0; }
+
+	/* returns false and drops the command if the buffer is full */
+	template<typename T>
+	bool Push(const T& command)
+	{
+		void* payload = Push(T::Type, sizeof(T));
+		if (payload == nullptr)
+			return false;
+		memcpy(payload, &command, sizeof(T));
+		return true;
+	}
+
+	/**
+	 * Walks the commands in recorded order, starting with cursor = 0. Payloads
+	 * are only byte aligned, read them with GetPayload.
+	 */
+	bool Next(uint32& cursor, RenderCommandHeader& outHeader, const uint8*& outPayload) const;
+
+	template<typename T>
+	static void GetPayload(const uint8* payload, T& outCommand)
+	{
+		memcpy(&outCommand, payload, sizeof(T));
+	}
+
+	uint32 GetSize() const { return m_Size; }
+
+private:
+	void* Push(uint16 type, uint32 size);
+
+private:
+	std::vector<uint8> m_Storage;
+	uint32 m_Size;
+};
@@ -0,0 +1,306 @@
+#include "RenderQueue.h"
+#include "JobSystem.h"
+#include "../Tools/RayUtils.h"
+#include <string.h>
+#include <algorithm>
+
+uint64 RenderSortKey::Make(RenderLayer layer, bool translucent, uint32 shader, uint32 material, float depth)
+{
+	const uint64 depthMax = (1 << 24) - 1;
+	float clamped = depth < 0.0f ? 0.0f : (depth > 1.0f ? 1.0f : depth);
+	uint64 quantized = (uint64)(clamped * depthMax);
+
+	uint64 key = (uint64)(layer & 0xF) << 60;
+	if (translucent)
+	{
+		key |= (uint64)1 << 59;
+		key |= (depthMax - quantized) << 35;
+		key |= (uint64)(shader & 0xFFFF) << 19;
+		key |= (uint64)(material & 0xFFFF) << 3;
+	}
+	else
+	{
+		key |= (uint64)(shader & 0xFFFF) << 43;
+		key |= (uint64)(material & 0xFFFF) << 27;
+		key |= quantized << 3;
+	}
+	return key;
+}
+
+RenderQueue::RenderQueue()
+{
+	m_Stats.m_Draws = 0;
+	m_Stats.m_Instances = 0;
+}
+
+RenderQueue::~RenderQueue()
+{
+	for (auto queue : m_ThreadQueues)
+	{
+		R_DELETE(queue);
+	}
+}
+
+void RenderQueue::Clear()
+{
+	for (auto queue : m_ThreadQueues)
+	{
+		queue->Clear();
+	}
+
+	m_Stats.m_Draws = 0;
+	m_Stats.m_Instances = 0;
+	m_Packets.clear();
+	m_DrawCalls.clear();
+
+	m_BatchLookup.clear();
+	m_Batches.clear();
+	m_PendingInstances.clear();
+	m_PendingBatch.clear();
+	m_Instances.clear();
+}
+
+void RenderQueue::Submit(const RenderDrawCall& draw, RenderLayer layer, bool translucent, float depth)
+{
+	RenderPacket packet;
+	packet.m_SortKey = RenderSortKey::Make(layer, translucent, draw.m_ShaderSort != 0 ? draw.m_ShaderSort : draw.m_Program, draw.m_Material, depth);
+	packet.m_DrawIndex = (uint32)m_DrawCalls.size();
+
+	m_DrawCalls.push_back(draw);
+	m_Packets.push_back(packet);
+	++m_Stats.m_Draws;
+}
+
+void RenderQueue::SubmitInstance(const RenderDrawCall& draw, const InstanceData& instance, RenderLayer layer, float depth)
+{
+	InstanceBatchKey key = InstanceBatchKey::Make(draw, layer);
+
+	uint32 batchIndex;
+	auto itr = m_BatchLookup.find(key);
+	if (itr == m_BatchLookup.end())
+	{
+		batchIndex = (uint32)m_Batches.size();
+		m_BatchLookup[key] = batchIndex;
+
+		InstanceBatch batch;
+		batch.m_Draw = draw;
+		batch.m_Draw.m_InstanceCount = 0;
+		batch.m_Layer = layer;
+		batch.m_Depth = depth;
+		m_Batches.push_back(batch);
+	}
+	else
+	{
+		batchIndex = itr->second;
+	}
+
+	InstanceBatch& batch = m_Batches[batchIndex];
+	++batch.m_Draw.m_InstanceCount;
+	if (depth < batch.m_Depth)
+	{
+		batch.m_Depth = depth;
+	}
+
+	m_PendingInstances.push_back(instance);
+	m_PendingBatch.push_back(batchIndex);
+	++m_Stats.m_Instances;
+}
+
+void RenderQueue::SetThreadCount(uint32 count)
+{
+	while (m_ThreadQueues.size() < count)
+	{
+		m_ThreadQueues.push_back(new RenderQueue());
+	}
+}
+
+void RenderQueue::MergeThreadQueues()
+{
+	const uint32 threadCount = (uint32)m_ThreadQueues.size();
+	if (threadCount == 0)
+		return;
+
+	/* reserve every thread a slice of the merged arrays, instance batches are
+	   matched up by key so each mesh still ends up in a single batch */
+	uint32 drawCount = (uint32)m_DrawCalls.size();
+	uint32 packetCount = (uint32)m_Packets.size();
+	uint32 instanceCount = (uint32)m_PendingInstances.size();
+
+	m_ThreadMerges.resize(threadCount);
+	for (uint32 t = 0; t < threadCount; ++t)
+	{
+		RenderQueue& queue = *m_ThreadQueues[t];
+		ThreadMerge& merge = m_ThreadMerges[t];
+		merge.m_FirstDraw = drawCount;
+		merge.m_FirstPacket = packetCount;
+		merge.m_FirstInstance = instanceCount;
+		drawCount += (uint32)queue.m_DrawCalls.size();
+		packetCount += (uint32)queue.m_Packets.size();
+		instanceCount += (uint32)queue.m_PendingInstances.size();
+
+		merge.m_BatchRemap.resize(queue.m_Batches.size());
+		for (size_t b = 0; b < queue.m_Batches.size(); ++b)
+		{
+			const InstanceBatch& batch = queue.m_Batches[b];
+			InstanceBatchKey key = InstanceBatchKey::Make(batch.m_Draw, batch.m_Layer);
+
+			auto itr = m_BatchLookup.find(key);
+			if (itr == m_BatchLookup.end())
+			{
+				merge.m_BatchRemap[b] = (uint32)m_Batches.size();
+				m_BatchLookup[key] = merge.m_BatchRemap[b];
+				m_Batches.push_back(batch);
+				continue;
+			}
+
+			InstanceBatch& merged = m_Batches[itr->second];
+			merged.m_Draw.m_InstanceCount += batch.m_Draw.m_InstanceCount;
+			if (batch.m_Depth < merged.m_Depth)
+			{
+				merged.m_Depth = batch.m_Depth;
+			}
+			merge.m_BatchRemap[b] = itr->second;
+		}
+	}
+
+	if (packetCount == m_Packets.size() && instanceCount == m_PendingInstances.size())
+		return;
+
+	m_DrawCalls.resize(drawCount);
+	m_Packets.resize(packetCount);
+	m_PendingInstances.resize(instanceCount);
+	m_PendingBatch.resize(instanceCount);
+
+	/* the slices don't overlap, so the copies run in parallel */
+	auto copySlices = [this](uint32 begin, uint32 end, uint32 thread)
+	{
+		for (uint32 t = begin; t < end; ++t)
+		{
+			RenderQueue& queue = *m_ThreadQueues[t];
+			const ThreadMerge& merge = m_ThreadMerges[t];
+
+			std::copy(queue.m_DrawCalls.begin(), queue.m_DrawCalls.end(), m_DrawCalls.begin() + merge.m_FirstDraw);
+			for (size_t i = 0; i < queue.m_Packets.size(); ++i)
+			{
+				RenderPacket& packet = m_Packets[merge.m_FirstPacket + i];
+				packet.m_SortKey = queue.m_Packets[i].m_SortKey;
+				packet.m_DrawIndex = queue.m_Packets[i].m_DrawIndex + merge.m_FirstDraw;
+			}
+
+			std::copy(queue.m_PendingInstances.begin(), queue.m_PendingInstances.end(), m_PendingInstances.begin() + merge.m_FirstInstance);
+			for (size_t i = 0; i < queue.m_PendingBatch.size(); ++i)
+			{
+				m_PendingBatch[merge.m_FirstInstance + i] = merge.m_BatchRemap[queue.m_PendingBatch[i]];
+			}
+
+			//the recorded stats stay until the next Clear
+			RenderRecordStats stats = queue.m_Stats;
+			queue.Clear();
+			queue.m_Stats = stats;
+		}
+	};
+
+	JobSystem* jobs = JobSystem::getInstancePtr();
+	if (jobs != nullptr)
+	{
+		jobs->ParallelFor(threadCount, 1, copySlices);
+	}
+	else
+	{
+		copySlices(0, threadCount, 0);
+	}
+}
+
+void RenderQueue::BuildInstanceBatches()
+{
+	if (m_Batches.empty())
+		return;
+
+	//counting sort the instances so every batch is a contiguous range
+	uint32 first = 0;
+	for (auto& batch : m_Batches)
+	{
+		batch.m_Draw.m_FirstInstance = first;
+		first += batch.m_Draw.m_InstanceCount;
+	}
+
+	m_Instances.resize(m_PendingInstances.size());
+	m_BatchCursor.resize(m_Batches.size());
+	for (size_t i = 0; i < m_Batches.size(); ++i)
+	{
+		m_BatchCursor[i] = m_Batches[i].m_Draw.m_FirstInstance;
+	}
+
+	for (size_t i = 0; i < m_PendingInstances.size(); ++i)
+	{
+		m_Instances[m_BatchCursor[m_PendingBatch[i]]++] = m_PendingInstances[i];
+	}
+
+	for (auto& batch : m_Batches)
+	{
+		Submit(batch.m_Draw, batch.m_Layer, false, batch.m_Depth);
+	}
+
+	m_Batches.clear();
+	m_BatchLookup.clear();
+	m_PendingInstances.clear();
+	m_PendingBatch.clear();
+}
+
+void RenderQueue::Sort()
+{
+	MergeThreadQueues();
+	BuildInstanceBatches();
+
+	const uint32 count = (uint32)m_Packets.size();
+	if (count < 2)
+		return;
+
+	//one read pass builds the histograms of all 8 digits
+	uint32 histograms[8][256];
+	memset(histograms, 0, sizeof(histograms));
+	for (uint32 i = 0; i < count; ++i)
+	{
+		uint64 key = m_Packets[i].m_SortKey;
+		for (int digit = 0; digit < 8; ++digit)
+		{
+			++histograms[digit][(key >> (digit * 8)) & 0xFF];
+		}
+	}
+
+	m_Scratch.resize(count);
+	RenderPacket* src = &m_Packets[0];
+	RenderPacket* dst = &m_Scratch[0];
+
+	for (int digit = 0; digit < 8; ++digit)
+	{
+		uint32* histogram = histograms[digit];
+		const int shift = digit * 8;
+
+		//all keys share this digit, the pass would not move anything
+		if (histogram[(src[0].m_SortKey >> shift) & 0xFF] == count)
+			continue;
+
+		uint32 offset = 0;
+		for (int bucket = 0; bucket < 256; ++bucket)
+		{
+			uint32 bucketSize = histogram[bucket];
+			histogram[bucket] = offset;
+			offset += bucketSize;
+		}
+
+		for (uint32 i = 0; i < count; ++i)
+		{
+			dst[histogram[(src[i].m_SortKey >> shift) & 0xFF]++] = src[i];
+		}
+
+		RenderPacket* tmp = src;
+		src = dst;
+		dst = tmp;
+	}
+
+	if (src != &m_Packets[0])
+	{
+		m_Packets.swap(m_Scratch);
+	}
+}
@@ -0,0 +1,228 @@
+//=============================================================================================
+// RenderQueue: draws are submitted as compact packets carrying a 64-bit sort key, radix
+// sorted once per frame and executed in key order by the concrete Render System.
+//=============================================================================================
+
+#pragma once
+#include "../Config/RayConifg.h"
+#include "../Math/RayMath.h"
+#include <vector>
+#include <unordered_map>
+
+enum RenderLayer
+{
+	RL_Background = 0,
+	RL_World,
+	RL_Effects,
+	RL_Overlay,
+	RL_Count = 16 //4 bits in the key
+};
+
+/**
+ * 64-bit sort key, most significant bits first:
+ *
+ *   opaque:      layer(4) | 0 | shader(16) | material(16) | depth(24) | unused(3)
+ *   translucent: layer(4) | 1 | depth(24)  | shader(16)   | material(16) | unused(3)
+ *
+ * Opaque draws are grouped by state and then go front to back to cut overdraw,
+ * translucent draws must go back to front so their depth is stored inverted
+ * and placed before the state bits. The shader field is the draw's sort id
+ * when it has one, an effect index above its variant's feature bits, so the
+ * variants of one effect end up next to each other.
+ */
+struct RenderSortKey
+{
+	static uint64 Make(RenderLayer layer, bool translucent, uint32 shader, uint32 material, float depth);
+
+	static bool IsTranslucent(uint64 key) { return ((key >> 59) & 1) != 0; }
+	static RenderLayer GetLayer(uint64 key) { return (RenderLayer)(key >> 60); }
+};
+
+/**
+ * Everything needed to issue one draw, handles are owned by the Render System.
+ * Instanced draws ignore m_World and read their transforms from the queue's
+ * instance array starting at m_FirstInstance.
+ */
+struct RenderDrawCall
+{
+	RenderDrawCall()
+		: m_Program(0)
+		, m_ShaderSort(0)
+		, m_Material(0)
+		, m_VertexArray(0)
+		, m_IndexCount(0)
+		, m_FirstIndex(0)
+		, m_BaseVertex(0)
+		, m_FirstInstance(0)
+		, m_InstanceCount(0)
+		, m_IndexSize(sizeof(uint32))
+	{}
+
+	uint32 m_Program;
+	uint32 m_ShaderSort;    //the program's sort id, 0 sorts by m_Program
+	uint32 m_Material;
+	uint32 m_VertexArray;
+	uint32 m_IndexCount;
+	uint32 m_FirstIndex;
+	int32 m_BaseVertex; //added to every index, meshes sharing a pooled buffer differ only here
+	uint32 m_FirstInstance;
+	uint32 m_InstanceCount; //0 for a regular draw
+	uint32 m_IndexSize;     //bytes per index, fixed by the vertex array's index buffer
+	Matrix m_World;
+};
+
+/**
+ * Per-instance vertex stream, read with a divisor of 1 by instanced programs.
+ */
+struct InstanceData
+{
+	Vector4 m_Transform[3]; //3x4 affine transform, one column of the world matrix each
+	Vector4 m_Color;
+	Vector4 m_Params;       //xy: lod fade, z: texture handle the material samples through, w: free
+
+	/* packs a row-vector world matrix, normalizing a homogeneous scale in M[3][3] */
+	void SetTransform(const Matrix& world)
+	{
+		const float invW = 1.0f / world.M[3][3];
+		for (int column = 0; column < 3; ++column)
+		{
+			m_Transform[column] = Vector4(world.M[0][column] * invW, world.M[1][column] * invW,
+				world.M[2][column] * invW, world.M[3][column] * invW);
+		}
+	}
+};
+
+/**
+ * What one recording thread submitted since the last Clear.
+ */
+struct RenderRecordStats
+{
+	uint32 m_Draws;
+	uint32 m_Instances;
+};
+
+struct RenderPacket
+{
+	uint64 m_SortKey;
+	uint32 m_DrawIndex; //index of the draw call in the queue
+};
+
+class RenderQueue
+{
+public:
+	RenderQueue();
+	~RenderQueue();
+
+	void Clear();
+
+	/**
+	 * @param depth distance to the camera normalized to [0, 1] by the far plane
+	 */
+	void Submit(const RenderDrawCall& draw, RenderLayer layer, bool translucent, float depth);
+
+	/**
+	 * Adds one instance of a mesh, instances sharing program, material, vertex
+	 * array and index range are collected into a single instanced draw. The
+	 * batch is sorted with the depth of its nearest instance.
+	 */
+	void SubmitInstance(const RenderDrawCall& draw, const InstanceData& instance, RenderLayer layer, float depth);
+
+	/**
+	 * Thread local arenas for parallel recording: thread i of a JobSystem range
+	 * submits into GetThreadQueue(i) only, Sort merges them back into this queue.
+	 * SetThreadCount is not thread safe, call it before recording starts.
+	 */
+	void SetThreadCount(uint32 count);
+	uint32 GetThreadCount() const { return (uint32)m_ThreadQueues.size(); }
+	RenderQueue& GetThreadQueue(uint32 thread) { return *m_ThreadQueues[thread]; }
+	const RenderRecordStats& GetThreadStats(uint32 thread) const { return m_ThreadQueues[thread]->m_Stats; }
+
+	/**
+	 * Merges the thread queues, turns the instance batches into packets, then LSD
+	 * radix sorts the keys, passes where every key has the same digit are skipped.
+	 */
+	void Sort();
+
+	uint32 GetPacketCount() const { return (uint32)m_Packets.size(); }
+	const RenderPacket& GetPacket(uint32 i) const { return m_Packets[i]; }
+	const RenderDrawCall& GetDrawCall(const RenderPacket& packet) const { return m_DrawCalls[packet.m_DrawIndex]; }
+
+	/* instances grouped by batch, valid after Sort */
+	uint32 GetInstanceCount() const { return (uint32)m_Instances.size(); }
+	const InstanceData* GetInstances() const { return m_Instances.empty() ? nullptr : &m_Instances[0]; }
+
+private:
+	void MergeThreadQueues();
+	void BuildInstanceBatches();
+
+private:
+	std::vector<RenderPacket> m_Packets;
+	std::vector<RenderPacket> m_Scratch;
+	std::vector<RenderDrawCall> m_DrawCalls;
+
+	struct InstanceBatch
+	{
+		RenderDrawCall m_Draw;
+		RenderLayer m_Layer;
+		float m_Depth;
+	};
+
+	struct InstanceBatchKey
+	{
+		static InstanceBatchKey Make(const RenderDrawCall& draw, RenderLayer layer)
+		{
+			InstanceBatchKey key = { draw.m_Program, draw.m_Material, draw.m_VertexArray, draw.m_FirstIndex, draw.m_IndexCount,
+				(uint32)draw.m_BaseVertex, (uint32)layer };
+			return key;
+		}
+
+		uint32 m_Program;
+		uint32 m_Material;
+		uint32 m_VertexArray;
+		uint32 m_FirstIndex;
+		uint32 m_IndexCount;
+		uint32 m_BaseVertex;
+		uint32 m_Layer;
+
+		bool operator==(const InstanceBatchKey& other) const
+		{
+			return m_Program == other.m_Program && m_Material == other.m_Material && m_VertexArray == other.m_VertexArray
+				&& m_FirstIndex == other.m_FirstIndex && m_IndexCount == other.m_IndexCount && m_BaseVertex == other.m_BaseVertex
+				&& m_Layer == other.m_Layer;
+		}
+	};
+
+	struct InstanceBatchKeyHash
+	{
+		size_t operator()(const InstanceBatchKey& key) const
+		{
+			const uint32* words = &key.m_Program;
+			size_t hash = 2166136261u;
+			for (int i = 0; i < 7; ++i)
+			{
+				hash = (hash ^ words[i]) * 16777619u;
+			}
+			return hash;
+		}
+	};
+
+	std::unordered_map<InstanceBatchKey, uint32, InstanceBatchKeyHash> m_BatchLookup;
+	std::vector<InstanceBatch> m_Batches;
+	std::vector<InstanceData> m_PendingInstances;
+	std::vector<uint32> m_PendingBatch;
+	std::vector<uint32> m_BatchCursor;
+	std::vector<InstanceData> m_Instances;
+
+	/* where each thread queue lands in the merged arrays */
+	struct ThreadMerge
+	{
+		uint32 m_FirstDraw;
+		uint32 m_FirstPacket;
+		uint32 m_FirstInstance;
+		std::vector<uint32> m_BatchRemap;
+	};
+
+	std::vector<RenderQueue*> m_ThreadQueues;
+	std::vector<ThreadMerge> m_ThreadMerges;
+	RenderRecordStats m_Stats;
+};
@@ -6,6 +6,8 @@
 #include "../Tools/Singleton.h"
 #include <string>
 
+class RenderQueue;
+
 enum RenderType 
 { 
 	OPENGL, 
@@ -16,11 +18,14 @@ enum RenderType
 class RenderSystem : public Singleton<RenderSystem>
 {
 public:
-	RenderSystem() {}
+	RenderSystem() 
+		: m_RenderQueue(nullptr)
+	{}
 
 	RenderSystem(RenderType type, std::string sysName)
 		: m_RenderType(type)
 		, m_SysName(sysName)
+		, m_RenderQueue(nullptr)
 	{}
 	
 	virtual ~RenderSystem()
@@ -30,7 +35,6 @@ protected:
 	virtual void RenderOneFrame() {}
 	//some render state settings
 	virtual void SetShader() {}
-	virtual void SetRenderQueue() {}
 	virtual void SetVertexBuffer() {}
 	virtual void SetIndexBuffer() {}
 	virtual void SetTexture() {}
@@ -41,6 +45,10 @@ public:
 	virtual void StopRendering() {}
 	virtual bool SetParam(int width, int height, std::string name, bool isFullSceen) { return true; }
 
+	/* the queue the current frame is recorded into, its sorted packets are executed */
+	virtual void SetRenderQueue(RenderQueue* queue) { m_RenderQueue = queue; }
+	RenderQueue* GetRenderQueue() const { return m_RenderQueue; }
+
 	const RenderType getRenderType() const
 	{
 		return m_RenderType;
@@ -60,6 +68,7 @@ protected:
 	RenderType m_RenderType;
 	std::string m_SysName;
 	void* m_WindowHandle;
+	RenderQueue* m_RenderQueue;
 };
 
 
@@ -0,0 +1,224 @@
+#include "SceneVisibility.h"
+#include "JobSystem.h"
+#include "OcclusionBuffer.h"
+#include "../Tools/RayUtils.h"
+#include <chrono>
+#include <string.h>
+
+SceneVisibility::SceneVisibility()
+	: m_Count(0)
+	, m_Occlusion(nullptr)
+{
+	m_Stats.m_Total = 0;
+	m_Stats.m_Visible = 0;
+	m_Stats.m_Culled = 0;
+	m_Stats.m_Occluded = 0;
+	m_Stats.m_Milliseconds = 0.0f;
+}
+
+void SceneVisibility::Resize(uint32 capacity)
+{
+	//a whole group of 4 is always readable, unused lanes are ignored
+	capacity = (capacity + 3) & ~3u;
+	m_CenterX.resize(capacity);
+	m_CenterY.resize(capacity);
+	m_CenterZ.resize(capacity);
+	m_ExtentX.resize(capacity);
+	m_ExtentY.resize(capacity);
+	m_ExtentZ.resize(capacity);
+	m_UserData.resize(capacity);
+	m_Handles.resize(capacity);
+}
+
+uint32 SceneVisibility::Add(const Box& worldBounds, uint32 userData)
+{
+	uint32 handle;
+	if (!m_FreeHandles.empty())
+	{
+		handle = m_FreeHandles.back();
+		m_FreeHandles.pop_back();
+	}
+	else
+	{
+		handle = (uint32)m_Indices.size();
+		m_Indices.push_back((uint32)InvalidHandle);
+	}
+
+	const uint32 index = m_Count++;
+	if (m_Count > m_CenterX.size())
+	{
+		Resize(m_Count * 2);
+	}
+
+	m_Indices[handle] = index;
+	m_Handles[index] = handle;
+	m_UserData[index] = userData;
+	Update(handle, worldBounds);
+	return handle;
+}
+
+void SceneVisibility::Update(uint32 handle, const Box& worldBounds)
+{
+	ASSERT(handle < m_Indices.size() && m_Indices[handle] != InvalidHandle);
+	const uint32 index = m_Indices[handle];
+
+	const Vector center = worldBounds.GetCenter();
+	const Vector extent = worldBounds.GetExtent();
+	m_CenterX[index] = center.X;
+	m_CenterY[index] = center.Y;
+	m_CenterZ[index] = center.Z;
+	m_ExtentX[index] = extent.X;
+	m_ExtentY[index] = extent.Y;
+	m_ExtentZ[index] = extent.Z;
+}
+
+void SceneVisibility::Remove(uint32 handle)
+{
+	ASSERT(handle < m_Indices.size() && m_Indices[handle] != InvalidHandle);
+	const uint32 index = m_Indices[handle];
+	const uint32 last = --m_Count;
+
+	//the last object fills the hole to keep the arrays dense
+	if (index != last)
+	{
+		m_CenterX[index] = m_CenterX[last];
+		m_CenterY[index] = m_CenterY[last];
+		m_CenterZ[index] = m_CenterZ[last];
+		m_ExtentX[index] = m_ExtentX[last];
+		m_ExtentY[index] = m_ExtentY[last];
+		m_ExtentZ[index] = m_ExtentZ[last];
+		m_UserData[index] = m_UserData[last];
+		m_Handles[index] = m_Handles[last];
+		m_Indices[m_Handles[index]] = index;
+	}
+
+	m_Indices[handle] = InvalidHandle;
+	m_FreeHandles.push_back(handle);
+}
+
+void SceneVisibility::Cull(const Plane planes[6])
+{
+	auto start = std::chrono::high_resolution_clock::now();
+
+	const uint32 chunkCount = (m_Count + ChunkSize - 1) / ChunkSize;
+	if (m_ChunkVisible.size() < chunkCount)
+	{
+		m_ChunkVisible.resize(chunkCount);
+		m_ChunkOccluded.resize(chunkCount);
+	}
+
+	auto cullChunks = [this, planes](uint32 begin, uint32 end, uint32 thread)
+	{
+		for (uint32 chunk = begin; chunk < end; ++chunk)
+		{
+			CullChunk(chunk, planes);
+		}
+	};
+
+	JobSystem* jobs = JobSystem::getInstancePtr();
+	if (jobs != nullptr && chunkCount > 1)
+	{
+		jobs->ParallelFor(chunkCount, 1, cullChunks);
+	}
+	else
+	{
+		cullChunks(0, chunkCount, 0);
+	}
+
+	//compact the chunk lists, they are already in object order
+	uint32 visibleCount = 0;
+	uint32 occludedCount = 0;
+	for (uint32 chunk = 0; chunk < chunkCount; ++chunk)
+	{
+		visibleCount += (uint32)m_ChunkVisible[chunk].size();
+		occludedCount += m_ChunkOccluded[chunk];
+	}
+
+	m_Visible.resize(visibleCount);
+	uint32 offset = 0;
+	for (uint32 chunk = 0; chunk < chunkCount; ++chunk)
+	{
+		const std::vector<uint32>& chunkVisible = m_ChunkVisible[chunk];
+		if (!chunkVisible.empty())
+		{
+			memcpy(&m_Visible[offset], &chunkVisible[0], chunkVisible.size() * sizeof(uint32));
+			offset += (uint32)chunkVisible.size();
+		}
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	m_Stats.m_Total = m_Count;
+	m_Stats.m_Visible = visibleCount;
+	m_Stats.m_Culled = m_Count - visibleCount;
+	m_Stats.m_Occluded = occludedCount;
+	m_Stats.m_Milliseconds = std::chrono::duration<float, std::milli>(end - start).count();
+}
+
+void SceneVisibility::CullChunk(uint32 chunk, const Plane planes[6])
+{
+	std::vector<uint32>& visible = m_ChunkVisible[chunk];
+	visible.clear();
+	uint32& occluded = m_ChunkOccluded[chunk];
+	occluded = 0;
+
+	/* planes splatted once per chunk, with the absolute normal for the box radius */
+	VectorRegister planeX[6], planeY[6], planeZ[6], planeW[6];
+	VectorRegister absX[6], absY[6], absZ[6];
+	for (int p = 0; p < 6; ++p)
+	{
+		planeX[p] = VectorLoadFloat1(&planes[p].X);
+		planeY[p] = VectorLoadFloat1(&planes[p].Y);
+		planeZ[p] = VectorLoadFloat1(&planes[p].Z);
+		planeW[p] = VectorLoadFloat1(&planes[p].W);
+		absX[p] = VectorAbs(planeX[p]);
+		absY[p] = VectorAbs(planeY[p]);
+		absZ[p] = VectorAbs(planeZ[p]);
+	}
+
+	const uint32 begin = chunk * ChunkSize;
+	const uint32 end = begin + ChunkSize < m_Count ? begin + ChunkSize : m_Count;
+
+	for (uint32 i = begin; i < end; i += 4)
+	{
+		const VectorRegister centerX = VectorLoad(&m_CenterX[i]);
+		const VectorRegister centerY = VectorLoad(&m_CenterY[i]);
+		const VectorRegister centerZ = VectorLoad(&m_CenterZ[i]);
+		const VectorRegister extentX = VectorLoad(&m_ExtentX[i]);
+		const VectorRegister extentY = VectorLoad(&m_ExtentY[i]);
+		const VectorRegister extentZ = VectorLoad(&m_ExtentZ[i]);
+
+		//a box is outside a plane when its center is further behind it than the box reaches
+		VectorRegister outside = VectorZero();
+		for (int p = 0; p < 6; ++p)
+		{
+			VectorRegister distance = VectorMultiply(centerX, planeX[p]);
+			distance = VectorMultiplyAdd(centerY, planeY[p], distance);
+			distance = VectorMultiplyAdd(centerZ, planeZ[p], distance);
+			distance = VectorSubtract(distance, planeW[p]);
+
+			VectorRegister radius = VectorMultiply(extentX, absX[p]);
+			radius = VectorMultiplyAdd(extentY, absY[p], radius);
+			radius = VectorMultiplyAdd(extentZ, absZ[p], radius);
+
+			outside = VectorBitwiseOr(outside, VectorCompareGT(VectorNegate(radius), distance));
+		}
+
+		uint32 lanes[4];
+		VectorStore(outside, lanes);
+
+		const uint32 groupEnd = i + 4 < end ? i + 4 : end;
+		for (uint32 j = i; j < groupEnd; ++j)
+		{
+			if (lanes[j - i] != 0)
+				continue;
+
+			if (m_Occlusion != nullptr && !m_Occlusion->IsVisible(Vector(m_CenterX[j], m_CenterY[j], m_CenterZ[j]), Vector(m_ExtentX[j], m_ExtentY[j], m_ExtentZ[j])))
+			{
+				++occluded;
+				continue;
+			}
+
+			visible.push_back(m_UserData[j]);
+		}
+	}
+}
@@ -0,0 +1,73 @@
+//=============================================================================================
+// SceneVisibility: world space bounds of every renderable kept as structure of arrays, culled
+// against the camera frustum four boxes at a time in parallel chunks. The result is a compact
+// list of the visible objects for the render queue. Boxes that pass the frustum can also be
+// tested against an OcclusionBuffer.
+//=============================================================================================
+
+#pragma once
+#include "../Config/RayConifg.h"
+#include "../Math/RayMath.h"
+#include <vector>
+
+class OcclusionBuffer;
+
+struct VisibilityStats
+{
+	uint32 m_Total;
+	uint32 m_Visible;
+	uint32 m_Culled;	//frustum and occlusion
+	uint32 m_Occluded;
+	float m_Milliseconds;
+};
+
+class SceneVisibility
+{
+public:
+	static const uint32 InvalidHandle = 0xFFFFFFFF;
+
+	SceneVisibility();
+
+	/* userData is what the visible list reports for this object */
+	uint32 Add(const Box& worldBounds, uint32 userData);
+	void Update(uint32 handle, const Box& worldBounds);
+	void Remove(uint32 handle);
+
+	/**
+	 * Tests every object against the planes (see Camera::GetFrustumPlanes), a box
+	 * is culled once it is fully behind any of them. Runs on the JobSystem when
+	 * there is one, the visible list keeps the order objects were added in.
+	 */
+	void Cull(const Plane planes[6]);
+
+	/* rasterized occluders to test against after the frustum, nullptr disables */
+	void SetOcclusionBuffer(const OcclusionBuffer* occlusion) { m_Occlusion = occlusion; }
+
+	uint32 GetObjectCount() const { return m_Count; }
+	const std::vector<uint32>& GetVisible() const { return m_Visible; }
+	const VisibilityStats& GetStats() const { return m_Stats; }
+
+private:
+	static const uint32 ChunkSize = 1024; //multiple of the 4 lanes
+
+	void CullChunk(uint32 chunk, const Plane planes[6]);
+	void Resize(uint32 capacity);
+
+private:
+	uint32 m_Count;
+
+	/* dense arrays, padded to a multiple of 4 */
+	std::vector<float> m_CenterX, m_CenterY, m_CenterZ;
+	std::vector<float> m_ExtentX, m_ExtentY, m_ExtentZ;
+	std::vector<uint32> m_UserData;
+	std::vector<uint32> m_Handles; //dense index -> handle
+
+	std::vector<uint32> m_Indices; //handle -> dense index
+	std::vector<uint32> m_FreeHandles;
+
+	std::vector<std::vector<uint32>> m_ChunkVisible;
+	std::vector<uint32> m_ChunkOccluded;
+	const OcclusionBuffer* m_Occlusion;
+	std::vector<uint32> m_Visible;
+	VisibilityStats m_Stats;
+};
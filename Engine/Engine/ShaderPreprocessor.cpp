@@ -0,0 +1,174 @@
+#include "ShaderPreprocessor.h"
+#include "../Tools/RayUtils.h"
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+const char* ShaderPreprocessor::GetFeatureDefine(uint32 feature)
+{
+	switch (feature)
+	{
+	case SF_Instancing:	return "RAY_INSTANCING";
+	case SF_Textured:	return "RAY_TEXTURED";
+	case SF_LodFade:	return "RAY_LOD_FADE";
+	default:			return nullptr;
+	}
+}
+
+bool ShaderPreprocessor::ReadFile(const std::string& path, std::string& text)
+{
+	std::ifstream file(path.c_str(), std::ios::binary);
+	if (!file)
+		return false;
+
+	std::ostringstream contents;
+	contents << file.rdbuf();
+	text = contents.str();
+	return true;
+}
+
+bool ShaderPreprocessor::Load(const std::string& path)
+{
+	return GetFile(path) != nullptr;
+}
+
+bool ShaderPreprocessor::Reload(const std::string& path)
+{
+	auto itr = m_Files.find(path);
+	if (itr == m_Files.end())
+		return false;
+
+	//editors often write a file more than once per save
+	std::string text;
+	if (!ReadFile(path, text) || text == itr->second)
+		return false;
+
+	itr->second = text;
+	return true;
+}
+
+const std::string* ShaderPreprocessor::GetFile(const std::string& path)
+{
+	auto itr = m_Files.find(path);
+	if (itr != m_Files.end())
+		return &itr->second;
+
+	std::string text;
+	if (!ReadFile(path, text))
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "shader file can not be found : %s!", path.c_str());
+		return nullptr;
+	}
+	return &(m_Files[path] = text);
+}
+
+bool ShaderPreprocessor::Process(const std::string& path, uint32 key, std::string& out, std::vector<std::string>& files)
+{
+	out.clear();
+	files.clear();
+
+	std::string defines;
+	for (uint32 feature = 1; feature <= SF_FeatureMask; feature <<= 1)
+	{
+		const char* name = GetFeatureDefine(feature);
+		if ((key & feature) != 0 && name != nullptr)
+		{
+			defines += "#define ";
+			defines += name;
+			defines += " 1\n";
+		}
+	}
+
+	std::string body;
+	if (!Expand(path, 0, body, files))
+		return false;
+
+	//#version has to come first, the defines go right after it
+	size_t insert = 0;
+	const size_t version = body.find("#version");
+	if (version != std::string::npos && body.find_first_not_of(" \t\r\n") == version)
+	{
+		insert = body.find('\n', version);
+		insert = insert == std::string::npos ? body.size() : insert + 1;
+	}
+	if (!defines.empty())
+	{
+		const uint32 nextLine = (uint32)std::count(body.begin(), body.begin() + insert, '\n') + 1;
+		std::ostringstream line;
+		line << "#line " << nextLine << " 0\n";
+		defines += line.str();
+	}
+
+	out.reserve(body.size() + defines.size());
+	out.append(body, 0, insert);
+	out += defines;
+	out.append(body, insert, std::string::npos);
+	return true;
+}
+
+bool ShaderPreprocessor::Expand(const std::string& path, uint32 depth, std::string& out, std::vector<std::string>& files)
+{
+	if (depth > MaxIncludeDepth)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "%s: includes nested deeper than %u", path.c_str(), MaxIncludeDepth);
+		return false;
+	}
+
+	const std::string* text = GetFile(path);
+	if (text == nullptr)
+		return false;
+
+	const uint32 index = (uint32)files.size();
+	files.push_back(path);
+
+	const size_t slash = path.find_last_of("/\\");
+	const std::string directory = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+
+	uint32 lineNumber = 0;
+	size_t start = 0;
+	while (start < text->size())
+	{
+		size_t end = text->find('\n', start);
+		end = end == std::string::npos ? text->size() : end + 1;
+		++lineNumber;
+
+		const size_t first = text->find_first_not_of(" \t", start);
+		if (first >= end || text->compare(first, 8, "#include") != 0)
+		{
+			out.append(*text, start, end - start);
+			if (end == text->size() && (*text)[end - 1] != '\n')
+			{
+				out += '\n';
+			}
+			start = end;
+			continue;
+		}
+
+		const size_t open = text->find_first_of("\"<", first + 8);
+		const size_t close = open < end ? text->find_first_of("\">", open + 1) : std::string::npos;
+		if (open >= end || close >= end)
+		{
+			DEBUG_MESSAGE(RAY_ERROR, "%s(%u): #include needs a \"file\"", path.c_str(), lineNumber);
+			return false;
+		}
+
+		const std::string included = directory + text->substr(open + 1, close - open - 1);
+		if (std::find(files.begin(), files.end(), included) == files.end())
+		{
+			std::ostringstream line;
+			line << "#line 1 " << files.size() << "\n";
+			out += line.str();
+			if (!Expand(included, depth + 1, out, files))
+			{
+				DEBUG_MESSAGE(RAY_ERROR, "included from %s(%u)", path.c_str(), lineNumber);
+				return false;
+			}
+		}
+
+		std::ostringstream line;
+		line << "#line " << lineNumber + 1 << " " << index << "\n";
+		out += line.str();
+		start = end;
+	}
+	return true;
+}
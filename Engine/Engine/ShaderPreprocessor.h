@@ -0,0 +1,60 @@
+//=============================================================================================
+// ShaderPreprocessor: expands #include in shader sources and puts the defines of a
+// permutation key right after #version, so one source builds every variant of an effect.
+// The files read are kept until they're reloaded, each variant only costs a text pass.
+//=============================================================================================
+
+#pragma once
+#include "../Config/WindowPlatform.h"
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Permutation switches, a variant's key is the bitwise or of its features.
+ * Every feature set in the key is defined in all stages as RAY_<NAME>.
+ */
+enum ShaderFeature
+{
+	SF_Instancing	= 1 << 0,	//transforms come from the instance stream instead of PerObject
+	SF_Textured		= 1 << 1,	//samples the material's texture, atlas regions and array layers included
+	SF_LodFade		= 1 << 2,	//dithers the lod cross-fade
+
+	//keys fit the low bits of a sort key's shader field, the effect index takes the rest
+	SF_FeatureBits	= 6,
+	SF_FeatureMask	= (1 << SF_FeatureBits) - 1,
+};
+
+class ShaderPreprocessor
+{
+public:
+	static const uint32 MaxIncludeDepth = 16;
+
+	/* "RAY_INSTANCING" for SF_Instancing, nullptr for bits without a feature */
+	static const char* GetFeatureDefine(uint32 feature);
+
+	/* reads path into the cache, false if it can't be read */
+	bool Load(const std::string& path);
+
+	/* reads a cached file again, true only if its text changed */
+	bool Reload(const std::string& path);
+
+	/**
+	 * The text of path with its includes expanded and the defines of key
+	 * added. Includes are relative to the including file and each file is
+	 * only expanded once per unit, so include guards aren't needed. #line
+	 * directives keep compiler errors pointing at the right line, the
+	 * source string number is the file's index in files, which also gets
+	 * every file the text was built from.
+	 */
+	bool Process(const std::string& path, uint32 key, std::string& out, std::vector<std::string>& files);
+
+private:
+	bool Expand(const std::string& path, uint32 depth, std::string& out, std::vector<std::string>& files);
+	const std::string* GetFile(const std::string& path);
+
+	static bool ReadFile(const std::string& path, std::string& text);
+
+private:
+	std::map<std::string, std::string> m_Files; //by path
+};
@@ -0,0 +1,358 @@
+#include "TextureAtlas.h"
+#include "../Math/RayMath.h"
+#include "../Tools/Json.h"
+#include "../Tools/MappedFile.h"
+#include "../Tools/RayUtils.h"
+#include <algorithm>
+#include <fstream>
+#include <string.h>
+
+SkylinePacker::SkylinePacker()
+	: m_Width(0)
+	, m_Height(0)
+{
+}
+
+void SkylinePacker::Init(uint32 width, uint32 height)
+{
+	m_Width = width;
+	m_Height = height;
+	m_Skyline.clear();
+
+	Segment floor;
+	floor.m_X = 0;
+	floor.m_Y = 0;
+	floor.m_Width = width;
+	m_Skyline.push_back(floor);
+}
+
+bool SkylinePacker::Fit(uint32 index, uint32 width, uint32 height, uint32& y, uint32& waste) const
+{
+	const uint32 x = m_Skyline[index].m_X;
+	if (x + width > m_Width)
+		return false;
+
+	/* rests on the highest segment under it, the gaps below are wasted */
+	y = 0;
+	uint32 covered = 0;
+	for (uint32 i = index; covered < width; ++i)
+	{
+		y = Math::Max(y, m_Skyline[i].m_Y);
+		covered += m_Skyline[i].m_Width;
+	}
+	if (y + height > m_Height)
+		return false;
+
+	waste = 0;
+	covered = 0;
+	for (uint32 i = index; covered < width; ++i)
+	{
+		const uint32 span = Math::Min(m_Skyline[i].m_Width, width - covered);
+		waste += (y - m_Skyline[i].m_Y) * span;
+		covered += span;
+	}
+	return true;
+}
+
+bool SkylinePacker::Insert(uint32 width, uint32 height, uint32& x, uint32& y)
+{
+	uint32 best = (uint32)m_Skyline.size();
+	uint32 bestTop = 0xFFFFFFFF;
+	uint32 bestWaste = 0xFFFFFFFF;
+	for (uint32 i = 0; i < m_Skyline.size(); ++i)
+	{
+		uint32 fitY, waste;
+		if (!Fit(i, width, height, fitY, waste))
+			continue;
+
+		if (fitY + height < bestTop || (fitY + height == bestTop && waste < bestWaste))
+		{
+			best = i;
+			bestTop = fitY + height;
+			bestWaste = waste;
+			y = fitY;
+		}
+	}
+	if (best == m_Skyline.size())
+		return false;
+
+	x = m_Skyline[best].m_X;
+
+	/* the new segment replaces whatever it covers, a partly covered one keeps its right part */
+	Segment placed;
+	placed.m_X = x;
+	placed.m_Y = y + height;
+	placed.m_Width = width;
+	m_Skyline.insert(m_Skyline.begin() + best, placed);
+
+	const uint32 right = x + width;
+	uint32 i = best + 1;
+	while (i < m_Skyline.size() && m_Skyline[i].m_X < right)
+	{
+		Segment& segment = m_Skyline[i];
+		const uint32 end = segment.m_X + segment.m_Width;
+		if (end <= right)
+		{
+			m_Skyline.erase(m_Skyline.begin() + i);
+			continue;
+		}
+		segment.m_Width = end - right;
+		segment.m_X = right;
+		break;
+	}
+
+	//neighbours at the same height become one
+	for (i = 0; i + 1 < m_Skyline.size();)
+	{
+		if (m_Skyline[i].m_Y == m_Skyline[i + 1].m_Y)
+		{
+			m_Skyline[i].m_Width += m_Skyline[i + 1].m_Width;
+			m_Skyline.erase(m_Skyline.begin() + i + 1);
+		}
+		else
+		{
+			++i;
+		}
+	}
+	return true;
+}
+
+static std::string GetBaseName(const std::string& path)
+{
+	const size_t slash = path.find_last_of("/\\");
+	std::string name = slash == std::string::npos ? path : path.substr(slash + 1);
+	const size_t dot = name.find_last_of('.');
+	return dot == std::string::npos ? name : name.substr(0, dot);
+}
+
+static uint32 AlignToBlock(uint32 value)
+{
+	return (value + 3) & ~3u;
+}
+
+bool TextureAtlas::Pack(const std::vector<std::string>& sources, uint32 maxSize, uint32 border, Image& atlas, AtlasTable& table)
+{
+	std::vector<Image> images(sources.size());
+	uint64 area = 0;
+	uint32 widest = 0, tallest = 0;
+	for (size_t i = 0; i < sources.size(); ++i)
+	{
+		if (!ImageLoader::Load(sources[i], images[i]))
+			return false;
+		if (images[i].IsCompressed())
+		{
+			DEBUG_MESSAGE(RAY_ERROR, "%s: atlas sources must be uncompressed images", sources[i].c_str());
+			return false;
+		}
+
+		const uint32 cellWidth = AlignToBlock(images[i].m_Width + 2 * border);
+		const uint32 cellHeight = AlignToBlock(images[i].m_Height + 2 * border);
+		area += (uint64)cellWidth * cellHeight;
+		widest = Math::Max(widest, cellWidth);
+		tallest = Math::Max(tallest, cellHeight);
+	}
+
+	/* tallest first, the skyline stays flatter that way */
+	std::vector<uint32> order(sources.size());
+	for (uint32 i = 0; i < order.size(); ++i)
+	{
+		order[i] = i;
+	}
+	std::sort(order.begin(), order.end(), [&images](uint32 a, uint32 b)
+	{
+		if (images[a].m_Height != images[b].m_Height)
+			return images[a].m_Height > images[b].m_Height;
+		return images[a].m_Width > images[b].m_Width;
+	});
+
+	/* the smallest power of two holding the total area, grown a side at a time until the packing works */
+	uint32 width = 4, height = 4;
+	while (width < widest)
+		width *= 2;
+	while (height < tallest)
+		height *= 2;
+	while ((uint64)width * height < area)
+	{
+		if (width <= height)
+			width *= 2;
+		else
+			height *= 2;
+	}
+
+	std::vector<uint32> cellX(sources.size()), cellY(sources.size());
+	SkylinePacker packer;
+	for (;;)
+	{
+		if (width > maxSize || height > maxSize)
+		{
+			DEBUG_MESSAGE(RAY_ERROR, "%u images don't fit a %ux%u atlas", (uint32)sources.size(), maxSize, maxSize);
+			return false;
+		}
+
+		packer.Init(width, height);
+		bool packed = true;
+		for (uint32 i : order)
+		{
+			const uint32 cellWidth = AlignToBlock(images[i].m_Width + 2 * border);
+			const uint32 cellHeight = AlignToBlock(images[i].m_Height + 2 * border);
+			if (!packer.Insert(cellWidth, cellHeight, cellX[i], cellY[i]))
+			{
+				packed = false;
+				break;
+			}
+		}
+		if (packed)
+			break;
+
+		if (width <= height)
+			width *= 2;
+		else
+			height *= 2;
+	}
+
+	atlas = Image();
+	atlas.m_Format = IF_RGBA8;
+	atlas.m_Width = width;
+	atlas.m_Height = height;
+	atlas.AllocateLevels(1);
+	memset(&atlas.m_Data[0], 0, atlas.m_Data.size());
+
+	table.m_Width = width;
+	table.m_Height = height;
+	table.m_Regions.resize(sources.size());
+	for (uint32 i = 0; i < sources.size(); ++i)
+	{
+		/* the whole cell is written, texels outside the image clamp to its nearest edge */
+		const Image& image = images[i];
+		const uint32 cellWidth = AlignToBlock(image.m_Width + 2 * border);
+		const uint32 cellHeight = AlignToBlock(image.m_Height + 2 * border);
+		const uint8* source = image.GetLevelData(0);
+		for (uint32 y = 0; y < cellHeight; ++y)
+		{
+			const uint32 sourceY = (uint32)Math::Clamp((int32)y - (int32)border, 0, (int32)image.m_Height - 1);
+			uint8* row = &atlas.m_Data[((size_t)(cellY[i] + y) * width + cellX[i]) * 4];
+			for (uint32 x = 0; x < cellWidth; ++x)
+			{
+				const uint32 sourceX = (uint32)Math::Clamp((int32)x - (int32)border, 0, (int32)image.m_Width - 1);
+				memcpy(row + x * 4, source + ((size_t)sourceY * image.m_Width + sourceX) * 4, 4);
+			}
+		}
+
+		AtlasRegion& region = table.m_Regions[i];
+		region.m_Name = GetBaseName(sources[i]);
+		region.m_X = cellX[i] + border;
+		region.m_Y = cellY[i] + border;
+		region.m_Width = image.m_Width;
+		region.m_Height = image.m_Height;
+	}
+
+	DEBUG_MESSAGE(RAY_MESSAGE, "packed %u images into %ux%u, %.1f%% used", (uint32)sources.size(), width, height,
+		100.0 * (double)area / ((double)width * height));
+	return true;
+}
+
+static void WriteJsonString(std::ofstream& file, const std::string& value)
+{
+	file << '"';
+	for (char c : value)
+	{
+		if (c == '"' || c == '\\')
+			file << '\\';
+		file << c;
+	}
+	file << '"';
+}
+
+bool TextureAtlas::WriteTable(const std::string& path, const AtlasTable& table)
+{
+	std::ofstream file(path.c_str());
+	if (!file)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "can't write %s", path.c_str());
+		return false;
+	}
+
+	file << "{\n\t\"texture\": ";
+	WriteJsonString(file, table.m_Texture);
+	file << ",\n\t\"width\": " << table.m_Width << ",\n\t\"height\": " << table.m_Height << ",\n\t\"regions\": [\n";
+	for (size_t i = 0; i < table.m_Regions.size(); ++i)
+	{
+		const AtlasRegion& region = table.m_Regions[i];
+		file << "\t\t{ \"name\": ";
+		WriteJsonString(file, region.m_Name);
+		file << ", \"x\": " << region.m_X << ", \"y\": " << region.m_Y << ", \"width\": " << region.m_Width
+			<< ", \"height\": " << region.m_Height << (i + 1 < table.m_Regions.size() ? " },\n" : " }\n");
+	}
+	file << "\t]\n}\n";
+	return file.good();
+}
+
+bool TextureAtlas::ReadTable(const std::string& path, AtlasTable& table)
+{
+	MappedFile file;
+	if (!file.Open(path))
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "can't open %s", path.c_str());
+		return false;
+	}
+
+	JsonValue root;
+	std::string error;
+	if (!JsonValue::Parse((const char*)file.GetData(), (size_t)file.GetSize(), root, &error))
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "%s: %s", path.c_str(), error.c_str());
+		return false;
+	}
+
+	table.m_Texture = root["texture"].GetString();
+	table.m_Width = root["width"].GetUInt();
+	table.m_Height = root["height"].GetUInt();
+	if (table.m_Texture.empty() || table.m_Width == 0 || table.m_Height == 0)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "%s is not an atlas table", path.c_str());
+		return false;
+	}
+
+	const JsonValue& regions = root["regions"];
+	table.m_Regions.resize(regions.GetSize());
+	for (uint32 i = 0; i < regions.GetSize(); ++i)
+	{
+		const JsonValue& entry = regions.GetElement(i);
+		AtlasRegion& region = table.m_Regions[i];
+		region.m_Name = entry["name"].GetString();
+		region.m_X = entry["x"].GetUInt();
+		region.m_Y = entry["y"].GetUInt();
+		region.m_Width = entry["width"].GetUInt();
+		region.m_Height = entry["height"].GetUInt();
+	}
+	return true;
+}
+
+std::string TextureAtlas::GetTablePath(const std::string& cookedPath)
+{
+	const size_t slash = cookedPath.find_last_of("/\\");
+	const size_t dot = cookedPath.find_last_of('.');
+	if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		return cookedPath + ".json";
+	return cookedPath.substr(0, dot) + ".json";
+}
+
+bool TextureAtlas::Cook(const std::vector<std::string>& sources, const std::string& cookedPath, const TextureCookSettings& settings)
+{
+	Image atlas;
+	AtlasTable table;
+	if (!Pack(sources, MaxSize, DefaultBorder, atlas, table))
+		return false;
+
+	ImageLoader::GenerateMips(atlas, settings.m_bSRGB);
+
+	Image compressed;
+	if (!TextureCompressor::Compress(atlas, settings.m_Format, settings.m_Quality, compressed) ||
+		!TextureCompressor::WriteDDS(cookedPath, compressed, settings.m_bSRGB))
+		return false;
+
+	//the table names the texture relative to itself, both are written to the same directory
+	const size_t slash = cookedPath.find_last_of("/\\");
+	table.m_Texture = slash == std::string::npos ? cookedPath : cookedPath.substr(slash + 1);
+	return WriteTable(GetTablePath(cookedPath), table);
+}
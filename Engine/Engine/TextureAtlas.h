@@ -0,0 +1,85 @@
+//=============================================================================================
+// TextureAtlas: the cook step packing many small images into one texture. Rectangles are
+// placed by a skyline packer, tallest first, and every image gets a border repeating its
+// edge texels so filtering and the first mips don't pull in the neighbours. The cooked
+// atlas is a DDS next to a JSON table naming the region of each source image.
+//=============================================================================================
+
+#pragma once
+#include "Image.h"
+#include "TextureCompressor.h"
+#include <string>
+#include <vector>
+
+/**
+ * Bottom-left skyline: the packed area is kept as the outline of its top
+ * edge, a rectangle goes where it ends lowest, then where it wastes the
+ * least space below it.
+ */
+class SkylinePacker
+{
+public:
+	SkylinePacker();
+
+	void Init(uint32 width, uint32 height);
+
+	/* false if the rectangle fits nowhere */
+	bool Insert(uint32 width, uint32 height, uint32& x, uint32& y);
+
+private:
+	struct Segment
+	{
+		uint32 m_X;
+		uint32 m_Y;
+		uint32 m_Width;
+	};
+
+	/* y the rectangle rests at on segment index, false if it leaves the area */
+	bool Fit(uint32 index, uint32 width, uint32 height, uint32& y, uint32& waste) const;
+
+	uint32 m_Width;
+	uint32 m_Height;
+	std::vector<Segment> m_Skyline;
+};
+
+/* texels of one source image inside the atlas, excluding the border */
+struct AtlasRegion
+{
+	std::string m_Name; //file name of the source without directory and extension
+	uint32 m_X;
+	uint32 m_Y;
+	uint32 m_Width;
+	uint32 m_Height;
+};
+
+struct AtlasTable
+{
+	std::string m_Texture; //relative to the table
+	uint32 m_Width;
+	uint32 m_Height;
+	std::vector<AtlasRegion> m_Regions;
+};
+
+class TextureAtlas
+{
+public:
+	/* texels repeated around every image, enough for the first log2(border) mips */
+	static const uint32 DefaultBorder = 8;
+	static const uint32 MaxSize = 4096;
+
+	/**
+	 * Packs the first level of each source into the smallest power of two
+	 * atlas they fit, up to maxSize a side. Cells are whole 4x4 blocks so
+	 * compressing the atlas never mixes two images in a block.
+	 */
+	static bool Pack(const std::vector<std::string>& sources, uint32 maxSize, uint32 border, Image& atlas, AtlasTable& table);
+
+	static bool WriteTable(const std::string& path, const AtlasTable& table);
+	static bool ReadTable(const std::string& path, AtlasTable& table);
+
+	/* packs, mipmaps and compresses the sources, the table goes next to cookedPath as .json */
+	static bool Cook(const std::vector<std::string>& sources, const std::string& cookedPath, const TextureCookSettings& settings);
+
+	/* cookedPath with its extension replaced by .json */
+	static std::string GetTablePath(const std::string& cookedPath);
+};
@@ -0,0 +1,880 @@
+#include "TextureCompressor.h"
+#include "JobSystem.h"
+#include "../Math/RayMath.h"
+#include "../Tools/ContentHash.h"
+#include "../Tools/MappedFile.h"
+#include "../Tools/RayUtils.h"
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <math.h>
+#include <string.h>
+
+/* part of the cache key, bump it whenever an encoder changes its output */
+static const uint32 CompressorVersion = 1;
+
+TextureCookSettings::TextureCookSettings()
+	: m_Format(IF_BC7)
+	, m_Quality(CQ_Normal)
+	, m_bSRGB(true)
+	, m_CacheDirectory("Cache")
+{
+}
+
+bool TextureCompressor::FormatFromName(const char* name, ImageFormat& format)
+{
+	static const struct { const char* m_Name; ImageFormat m_Format; } formats[] =
+	{
+		{ "bc1", IF_BC1 },
+		{ "bc3", IF_BC3 },
+		{ "bc4", IF_BC4 },
+		{ "bc5", IF_BC5 },
+		{ "bc7", IF_BC7 },
+	};
+
+	for (const auto& entry : formats)
+	{
+		if (strcmp(name, entry.m_Name) == 0)
+		{
+			format = entry.m_Format;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool TextureCompressor::QualityFromName(const char* name, CompressionQuality& quality)
+{
+	if (strcmp(name, "fast") == 0)
+		quality = CQ_Fast;
+	else if (strcmp(name, "normal") == 0)
+		quality = CQ_Normal;
+	else if (strcmp(name, "high") == 0)
+		quality = CQ_High;
+	else
+		return false;
+	return true;
+}
+
+//=============================================================================================
+// Endpoint fitting, shared by the color encoders
+//=============================================================================================
+
+static const VectorRegister ColorWeights = MakeVectorRegister(1.0f, 1.0f, 1.0f, 0.0f);
+static const VectorRegister AllWeights = MakeVectorRegister(1.0f, 1.0f, 1.0f, 1.0f);
+static const VectorRegister MaxTexel = MakeVectorRegister(255.0f, 255.0f, 255.0f, 255.0f);
+
+static void LoadBlock(const uint8* texels, VectorRegister* out)
+{
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		const uint8* texel = texels + i * 4;
+		out[i] = MakeVectorRegister((float)texel[0], (float)texel[1], (float)texel[2], (float)texel[3]);
+	}
+}
+
+static FORCEINLINE VectorRegister Splat(float value)
+{
+	return MakeVectorRegister(value, value, value, value);
+}
+
+static FORCEINLINE float GetFirst(const VectorRegister& vector)
+{
+	float value;
+	VectorStoreFloat1(vector, &value);
+	return value;
+}
+
+static FORCEINLINE float SquaredDistance(const VectorRegister& a, const VectorRegister& b, const VectorRegister& weights)
+{
+	const VectorRegister difference = VectorMultiply(VectorSubtract(a, b), weights);
+	return GetFirst(VectorDot4(difference, difference));
+}
+
+static FORCEINLINE VectorRegister ClampTexel(const VectorRegister& texel)
+{
+	return VectorMin(VectorMax(texel, VectorZero()), MaxTexel);
+}
+
+/**
+	a line through the texels, clipped to the extent of their projections. Its direction is
+	the bounding box diagonal with the signs of the widest channel's covariance row, refined
+	into the principal axis by power iteration unless quality is CQ_Fast.
+**/
+static void FindEndpoints(const VectorRegister* texels, uint32 count, const VectorRegister& weights, CompressionQuality quality,
+	VectorRegister& outStart, VectorRegister& outEnd)
+{
+	VectorRegister low = texels[0];
+	VectorRegister high = texels[0];
+	VectorRegister sum = VectorZero();
+	for (uint32 i = 0; i < count; ++i)
+	{
+		low = VectorMin(low, texels[i]);
+		high = VectorMax(high, texels[i]);
+		sum = VectorAdd(sum, texels[i]);
+	}
+	const VectorRegister mean = VectorMultiply(sum, Splat(1.0f / count));
+
+	VectorRegister covariance[4] = { VectorZero(), VectorZero(), VectorZero(), VectorZero() };
+	for (uint32 i = 0; i < count; ++i)
+	{
+		const VectorRegister offset = VectorMultiply(VectorSubtract(texels[i], mean), weights);
+		covariance[0] = VectorMultiplyAdd(offset, VectorReplicate(offset, 0), covariance[0]);
+		covariance[1] = VectorMultiplyAdd(offset, VectorReplicate(offset, 1), covariance[1]);
+		covariance[2] = VectorMultiplyAdd(offset, VectorReplicate(offset, 2), covariance[2]);
+		covariance[3] = VectorMultiplyAdd(offset, VectorReplicate(offset, 3), covariance[3]);
+	}
+
+	float extent[4];
+	VectorStore(VectorMultiply(VectorSubtract(high, low), weights), extent);
+	uint32 widest = 0;
+	for (uint32 c = 1; c < 4; ++c)
+	{
+		widest = extent[c] > extent[widest] ? c : widest;
+	}
+
+	float row[4];
+	VectorStore(covariance[widest], row);
+	for (uint32 c = 0; c < 4; ++c)
+	{
+		extent[c] = row[c] < 0.0f ? -extent[c] : extent[c];
+	}
+	VectorRegister axis = VectorLoad(extent);
+
+	if (quality != CQ_Fast)
+	{
+		for (uint32 iteration = 0; iteration < 8; ++iteration)
+		{
+			VectorRegister next = VectorMultiply(covariance[0], VectorReplicate(axis, 0));
+			next = VectorMultiplyAdd(covariance[1], VectorReplicate(axis, 1), next);
+			next = VectorMultiplyAdd(covariance[2], VectorReplicate(axis, 2), next);
+			next = VectorMultiplyAdd(covariance[3], VectorReplicate(axis, 3), next);
+
+			const float length = sqrtf(GetFirst(VectorDot4(next, next)));
+			if (length < SMALL_NUMBER)
+				break;
+			axis = VectorMultiply(next, Splat(1.0f / length));
+		}
+	}
+
+	const float lengthSquared = GetFirst(VectorDot4(axis, axis));
+	if (lengthSquared < SMALL_NUMBER)
+	{
+		//all texels alike
+		outStart = outEnd = mean;
+		return;
+	}
+	axis = VectorMultiply(axis, Splat(1.0f / sqrtf(lengthSquared)));
+
+	float minProjection = BIG_NUMBER, maxProjection = -BIG_NUMBER;
+	for (uint32 i = 0; i < count; ++i)
+	{
+		const float projection = GetFirst(VectorDot4(VectorSubtract(texels[i], mean), axis));
+		minProjection = Math::Min(minProjection, projection);
+		maxProjection = Math::Max(maxProjection, projection);
+	}
+	outStart = ClampTexel(VectorMultiplyAdd(axis, Splat(minProjection), mean));
+	outEnd = ClampTexel(VectorMultiplyAdd(axis, Splat(maxProjection), mean));
+}
+
+/* least squares endpoints for texels placed at positions along the line, 0 at start and 1 at end */
+static bool RefineEndpoints(const VectorRegister* texels, const float* positions, uint32 count, VectorRegister& start, VectorRegister& end)
+{
+	float startStart = 0.0f, endEnd = 0.0f, startEnd = 0.0f;
+	VectorRegister startTexel = VectorZero();
+	VectorRegister endTexel = VectorZero();
+	for (uint32 i = 0; i < count; ++i)
+	{
+		const float toEnd = positions[i];
+		const float toStart = 1.0f - toEnd;
+		startStart += toStart * toStart;
+		endEnd += toEnd * toEnd;
+		startEnd += toStart * toEnd;
+		startTexel = VectorMultiplyAdd(texels[i], Splat(toStart), startTexel);
+		endTexel = VectorMultiplyAdd(texels[i], Splat(toEnd), endTexel);
+	}
+
+	const float determinant = startStart * endEnd - startEnd * startEnd;
+	if (fabsf(determinant) < KINDA_SMALL_NUMBER)
+		return false;
+
+	const VectorRegister inverse = Splat(1.0f / determinant);
+	start = ClampTexel(VectorMultiply(VectorSubtract(VectorMultiply(startTexel, Splat(endEnd)), VectorMultiply(endTexel, Splat(startEnd))), inverse));
+	end = ClampTexel(VectorMultiply(VectorSubtract(VectorMultiply(endTexel, Splat(startStart)), VectorMultiply(startTexel, Splat(startEnd))), inverse));
+	return true;
+}
+
+/* the nearest palette entry of every texel, returns the summed squared error */
+static float FitIndices(const VectorRegister* texels, uint32 count, const VectorRegister* palette, uint32 paletteSize,
+	const VectorRegister& weights, uint8* indices)
+{
+	float error = 0.0f;
+	for (uint32 i = 0; i < count; ++i)
+	{
+		float best = BIG_NUMBER;
+		for (uint32 p = 0; p < paletteSize; ++p)
+		{
+			const float distance = SquaredDistance(texels[i], palette[p], weights);
+			if (distance < best)
+			{
+				best = distance;
+				indices[i] = (uint8)p;
+			}
+		}
+		error += best;
+	}
+	return error;
+}
+
+//=============================================================================================
+// BC1 and the color half of BC3
+//=============================================================================================
+
+static uint16 QuantizeColor(const VectorRegister& color)
+{
+	float channels[4];
+	VectorStore(color, channels);
+	const uint32 red = (uint32)(channels[0] * 31.0f / 255.0f + 0.5f);
+	const uint32 green = (uint32)(channels[1] * 63.0f / 255.0f + 0.5f);
+	const uint32 blue = (uint32)(channels[2] * 31.0f / 255.0f + 0.5f);
+	return (uint16)((red << 11) | (green << 5) | blue);
+}
+
+static VectorRegister ExpandColor(uint16 color)
+{
+	const uint32 red = color >> 11;
+	const uint32 green = (color >> 5) & 63;
+	const uint32 blue = color & 31;
+	return MakeVectorRegister((float)((red << 3) | (red >> 2)), (float)((green << 2) | (green >> 4)), (float)((blue << 3) | (blue >> 2)), 255.0f);
+}
+
+struct ColorBlock
+{
+	uint16 m_Color0;
+	uint16 m_Color1;
+	uint8 m_Indices[16];
+	float m_Error;
+};
+
+/**
+	quantizes the endpoints, orders them for the mode and keeps the result if it beats best.
+	Three color mode has the endpoints ascending and index 3 transparent, texels marked
+	transparent take it.
+**/
+static void TryColorEndpoints(const VectorRegister* texels, const bool* transparent, const VectorRegister& start, const VectorRegister& end,
+	bool threeColor, ColorBlock& best)
+{
+	uint16 color0 = QuantizeColor(start);
+	uint16 color1 = QuantizeColor(end);
+	//equal endpoints decode in three color mode, index 0 alone reproduces them
+	threeColor = threeColor || color0 == color1;
+	if (threeColor ? color0 > color1 : color0 < color1)
+	{
+		std::swap(color0, color1);
+	}
+
+	VectorRegister palette[4];
+	palette[0] = ExpandColor(color0);
+	palette[1] = ExpandColor(color1);
+	if (threeColor)
+	{
+		palette[2] = VectorMultiply(VectorAdd(palette[0], palette[1]), Splat(0.5f));
+	}
+	else
+	{
+		palette[2] = VectorMultiply(VectorAdd(VectorAdd(palette[0], palette[0]), palette[1]), Splat(1.0f / 3.0f));
+		palette[3] = VectorMultiply(VectorAdd(VectorAdd(palette[1], palette[1]), palette[0]), Splat(1.0f / 3.0f));
+	}
+
+	ColorBlock candidate;
+	candidate.m_Color0 = color0;
+	candidate.m_Color1 = color1;
+	candidate.m_Error = 0.0f;
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		if (transparent[i])
+		{
+			candidate.m_Indices[i] = 3;
+			continue;
+		}
+		candidate.m_Error += FitIndices(&texels[i], 1, palette, threeColor ? 3 : 4, ColorWeights, &candidate.m_Indices[i]);
+	}
+
+	if (candidate.m_Error < best.m_Error)
+	{
+		best = candidate;
+	}
+}
+
+static void EncodeColorBlock(const VectorRegister* texels, const bool* transparent, bool allowThreeColor, CompressionQuality quality, uint8* out)
+{
+	VectorRegister opaque[16];
+	uint32 opaqueCount = 0;
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		if (!transparent[i])
+		{
+			opaque[opaqueCount++] = texels[i];
+		}
+	}
+
+	ColorBlock best;
+	best.m_Color0 = best.m_Color1 = 0;
+	memset(best.m_Indices, 3, sizeof(best.m_Indices));
+	best.m_Error = BIG_NUMBER;
+
+	const bool hasTransparent = opaqueCount < 16;
+	if (opaqueCount > 0)
+	{
+		VectorRegister lineStart, lineEnd;
+		FindEndpoints(opaque, opaqueCount, ColorWeights, quality, lineStart, lineEnd);
+		TryColorEndpoints(texels, transparent, lineStart, lineEnd, hasTransparent, best);
+
+		if (quality == CQ_High)
+		{
+			//a few rounds of least squares on the chosen indices, then the other mode
+			VectorRegister start, end;
+			for (uint32 iteration = 0; iteration < 2; ++iteration)
+			{
+				const bool threeColor = best.m_Color0 <= best.m_Color1;
+				static const float fourColorPositions[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+				static const float threeColorPositions[4] = { 0.0f, 1.0f, 0.5f, 0.0f };
+
+				float positions[16];
+				uint32 count = 0;
+				for (uint32 i = 0; i < 16; ++i)
+				{
+					if (!transparent[i])
+					{
+						positions[count++] = (threeColor ? threeColorPositions : fourColorPositions)[best.m_Indices[i]];
+					}
+				}
+				if (!RefineEndpoints(opaque, positions, count, start, end))
+					break;
+				TryColorEndpoints(texels, transparent, start, end, hasTransparent, best);
+			}
+
+			if (allowThreeColor && !hasTransparent)
+			{
+				TryColorEndpoints(texels, transparent, lineStart, lineEnd, true, best);
+			}
+		}
+	}
+
+	uint32 indices = 0;
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		indices |= (uint32)best.m_Indices[i] << (i * 2);
+	}
+	out[0] = (uint8)best.m_Color0;
+	out[1] = (uint8)(best.m_Color0 >> 8);
+	out[2] = (uint8)best.m_Color1;
+	out[3] = (uint8)(best.m_Color1 >> 8);
+	memcpy(out + 4, &indices, sizeof(indices));
+}
+
+void TextureCompressor::EncodeBC1(const uint8* texels, CompressionQuality quality, uint8* out)
+{
+	VectorRegister block[16];
+	LoadBlock(texels, block);
+
+	bool transparent[16];
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		transparent[i] = texels[i * 4 + 3] < 128;
+	}
+	EncodeColorBlock(block, transparent, true, quality, out);
+}
+
+void TextureCompressor::EncodeBC3(const uint8* texels, CompressionQuality quality, uint8* out)
+{
+	EncodeBC4(texels, 3, quality, out);
+
+	//the color block of BC3 is always read in four color mode
+	VectorRegister block[16];
+	LoadBlock(texels, block);
+	static const bool opaque[16] = { false };
+	EncodeColorBlock(block, opaque, false, quality, out + 8);
+}
+
+//=============================================================================================
+// BC4 and BC5
+//=============================================================================================
+
+/* the 8 values of a BC4 block, interpolated like the decoder does */
+static void BuildAlphaPalette(uint32 value0, uint32 value1, uint32* palette)
+{
+	palette[0] = value0;
+	palette[1] = value1;
+	if (value0 > value1)
+	{
+		for (uint32 i = 2; i < 8; ++i)
+		{
+			palette[i] = ((8 - i) * value0 + (i - 1) * value1 + 3) / 7;
+		}
+	}
+	else
+	{
+		for (uint32 i = 2; i < 6; ++i)
+		{
+			palette[i] = ((6 - i) * value0 + (i - 1) * value1 + 2) / 5;
+		}
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+static uint32 FitAlphaIndices(const uint8* values, const uint32* palette, uint8* indices)
+{
+	uint32 error = 0;
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		uint32 best = 0xFFFFFFFF;
+		for (uint32 p = 0; p < 8; ++p)
+		{
+			const int32 difference = (int32)values[i] - (int32)palette[p];
+			const uint32 distance = (uint32)(difference * difference);
+			if (distance < best)
+			{
+				best = distance;
+				indices[i] = (uint8)p;
+			}
+		}
+		error += best;
+	}
+	return error;
+}
+
+void TextureCompressor::EncodeBC4(const uint8* texels, uint32 channel, CompressionQuality quality, uint8* out)
+{
+	uint8 values[16];
+	uint32 low = 255, high = 0;
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		values[i] = texels[i * 4 + channel];
+		low = Math::Min(low, (uint32)values[i]);
+		high = Math::Max(high, (uint32)values[i]);
+	}
+
+	//eight values from high down to low
+	uint32 value0 = high, value1 = low;
+	uint32 palette[8];
+	uint8 indices[16];
+	BuildAlphaPalette(value0, value1, palette);
+	uint32 error = FitAlphaIndices(values, palette, indices);
+
+	if (quality == CQ_High && error > 0)
+	{
+		//six values spanning the texels other than 0 and 255, which get codes of their own
+		uint32 innerLow = 255, innerHigh = 0;
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			if (values[i] != 0 && values[i] != 255)
+			{
+				innerLow = Math::Min(innerLow, (uint32)values[i]);
+				innerHigh = Math::Max(innerHigh, (uint32)values[i]);
+			}
+		}
+		if (innerLow > innerHigh)
+		{
+			innerLow = innerHigh = 0;
+		}
+
+		uint32 innerPalette[8];
+		uint8 innerIndices[16];
+		BuildAlphaPalette(innerLow, innerHigh, innerPalette);
+		const uint32 innerError = FitAlphaIndices(values, innerPalette, innerIndices);
+		if (innerError < error)
+		{
+			error = innerError;
+			value0 = innerLow;
+			value1 = innerHigh;
+			memcpy(indices, innerIndices, sizeof(indices));
+		}
+	}
+
+	out[0] = (uint8)value0;
+	out[1] = (uint8)value1;
+	uint64 bits = 0;
+	for (uint32 i = 0; i < 16; ++i)
+	{
+		bits |= (uint64)indices[i] << (i * 3);
+	}
+	memcpy(out + 2, &bits, 6);
+}
+
+void TextureCompressor::EncodeBC5(const uint8* texels, CompressionQuality quality, uint8* out)
+{
+	EncodeBC4(texels, 0, quality, out);
+	EncodeBC4(texels, 1, quality, out + 8);
+}
+
+//=============================================================================================
+// BC7, mode 6: one subset, 7 bit RGBA endpoints with a p-bit each and 4 bit indices
+//=============================================================================================
+
+static const uint32 BC7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct BC7Block
+{
+	uint32 m_Endpoints[2][4]; //7 bit values
+	uint32 m_PBits[2];
+	uint8 m_Indices[16];
+	float m_Error;
+};
+
+/* 7 bit value nearest to each channel of endpoint once pBit is appended, and its squared error */
+static float QuantizeBC7Endpoint(const VectorRegister& endpoint, uint32 pBit, uint32* quantized)
+{
+	float channels[4];
+	VectorStore(endpoint, channels);
+	float error = 0.0f;
+	for (uint32 c = 0; c < 4; ++c)
+	{
+		const int32 value = (int32)((channels[c] - pBit) * 0.5f + 0.5f);
+		quantized[c] = (uint32)Math::Clamp(value, 0, 127);
+		const float difference = (float)((quantized[c] << 1) | pBit) - channels[c];
+		error += difference * difference;
+	}
+	return error;
+}
+
+static void TryBC7Endpoints(const VectorRegister* texels, const VectorRegister& start, const VectorRegister& end, CompressionQuality quality,
+	BC7Block& best)
+{
+	//every p-bit pair at high quality, otherwise the one closest to each endpoint
+	uint32 pairs[4][2] = { { 0, 0 }, { 0, 1 }, { 1, 0 }, { 1, 1 } };
+	uint32 pairCount = 4;
+	if (quality != CQ_High)
+	{
+		uint32 scratch[4];
+		pairs[0][0] = QuantizeBC7Endpoint(start, 1, scratch) < QuantizeBC7Endpoint(start, 0, scratch) ? 1 : 0;
+		pairs[0][1] = QuantizeBC7Endpoint(end, 1, scratch) < QuantizeBC7Endpoint(end, 0, scratch) ? 1 : 0;
+		pairCount = 1;
+	}
+
+	for (uint32 pair = 0; pair < pairCount; ++pair)
+	{
+		BC7Block candidate;
+		candidate.m_PBits[0] = pairs[pair][0];
+		candidate.m_PBits[1] = pairs[pair][1];
+		QuantizeBC7Endpoint(start, candidate.m_PBits[0], candidate.m_Endpoints[0]);
+		QuantizeBC7Endpoint(end, candidate.m_PBits[1], candidate.m_Endpoints[1]);
+
+		uint32 expanded[2][4];
+		for (uint32 e = 0; e < 2; ++e)
+		{
+			for (uint32 c = 0; c < 4; ++c)
+			{
+				expanded[e][c] = (candidate.m_Endpoints[e][c] << 1) | candidate.m_PBits[e];
+			}
+		}
+
+		VectorRegister palette[16];
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			float entry[4];
+			for (uint32 c = 0; c < 4; ++c)
+			{
+				entry[c] = (float)(((64 - BC7Weights[i]) * expanded[0][c] + BC7Weights[i] * expanded[1][c] + 32) >> 6);
+			}
+			palette[i] = VectorLoad(entry);
+		}
+
+		if (quality == CQ_Fast)
+		{
+			//position along the line, the weights are close enough to even steps
+			const VectorRegister direction = VectorSubtract(palette[15], palette[0]);
+			const float lengthSquared = GetFirst(VectorDot4(direction, direction));
+			const float scale = lengthSquared > SMALL_NUMBER ? 15.0f / lengthSquared : 0.0f;
+			candidate.m_Error = 0.0f;
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				const float position = GetFirst(VectorDot4(VectorSubtract(texels[i], palette[0]), direction)) * scale;
+				candidate.m_Indices[i] = (uint8)Math::Clamp((int32)(position + 0.5f), 0, 15);
+				candidate.m_Error += SquaredDistance(texels[i], palette[candidate.m_Indices[i]], AllWeights);
+			}
+		}
+		else
+		{
+			candidate.m_Error = FitIndices(texels, 16, palette, 16, AllWeights, candidate.m_Indices);
+		}
+
+		if (candidate.m_Error < best.m_Error)
+		{
+			best = candidate;
+		}
+	}
+}
+
+struct BlockBitWriter
+{
+	explicit BlockBitWriter(uint8* data)
+		: m_Data(data)
+		, m_Bit(0)
+	{
+		memset(m_Data, 0, 16);
+	}
+
+	void Write(uint32 value, uint32 bits)
+	{
+		for (uint32 i = 0; i < bits; ++i, ++m_Bit)
+		{
+			m_Data[m_Bit >> 3] |= (uint8)(((value >> i) & 1) << (m_Bit & 7));
+		}
+	}
+
+	uint8* m_Data;
+	uint32 m_Bit;
+};
+
+void TextureCompressor::EncodeBC7(const uint8* texels, CompressionQuality quality, uint8* out)
+{
+	VectorRegister block[16];
+	LoadBlock(texels, block);
+
+	BC7Block best;
+	best.m_Error = BIG_NUMBER;
+	VectorRegister start, end;
+	FindEndpoints(block, 16, AllWeights, quality, start, end);
+	TryBC7Endpoints(block, start, end, quality, best);
+
+	if (quality == CQ_High)
+	{
+		for (uint32 iteration = 0; iteration < 2 && best.m_Error > 0.0f; ++iteration)
+		{
+			float positions[16];
+			for (uint32 i = 0; i < 16; ++i)
+			{
+				positions[i] = BC7Weights[best.m_Indices[i]] / 64.0f;
+			}
+			if (!RefineEndpoints(block, positions, 16, start, end))
+				break;
+			TryBC7Endpoints(block, start, end, quality, best);
+		}
+	}
+
+	//the first index is stored without its top bit, it must be clear
+	if (best.m_Indices[0] >= 8)
+	{
+		for (uint32 c = 0; c < 4; ++c)
+		{
+			std::swap(best.m_Endpoints[0][c], best.m_Endpoints[1][c]);
+		}
+		std::swap(best.m_PBits[0], best.m_PBits[1]);
+		for (uint32 i = 0; i < 16; ++i)
+		{
+			best.m_Indices[i] = (uint8)(15 - best.m_Indices[i]);
+		}
+	}
+
+	BlockBitWriter writer(out);
+	writer.Write(1 << 6, 7);
+	for (uint32 c = 0; c < 4; ++c)
+	{
+		writer.Write(best.m_Endpoints[0][c], 7);
+		writer.Write(best.m_Endpoints[1][c], 7);
+	}
+	writer.Write(best.m_PBits[0], 1);
+	writer.Write(best.m_PBits[1], 1);
+	writer.Write(best.m_Indices[0], 3);
+	for (uint32 i = 1; i < 16; ++i)
+	{
+		writer.Write(best.m_Indices[i], 4);
+	}
+}
+
+//=============================================================================================
+// Images and files
+//=============================================================================================
+
+static void EncodeBlock(ImageFormat format, const uint8* texels, CompressionQuality quality, uint8* out)
+{
+	switch (format)
+	{
+	case IF_BC1: TextureCompressor::EncodeBC1(texels, quality, out); break;
+	case IF_BC3: TextureCompressor::EncodeBC3(texels, quality, out); break;
+	case IF_BC4: TextureCompressor::EncodeBC4(texels, 0, quality, out); break;
+	case IF_BC5: TextureCompressor::EncodeBC5(texels, quality, out); break;
+	case IF_BC7: TextureCompressor::EncodeBC7(texels, quality, out); break;
+	default: break;
+	}
+}
+
+bool TextureCompressor::Compress(const Image& source, ImageFormat format, CompressionQuality quality, Image& out)
+{
+	if (source.IsCompressed() || !(format == IF_BC1 || format == IF_BC3 || format == IF_BC4 || format == IF_BC5 || format == IF_BC7))
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "can't compress image format %d into %d", (int)source.m_Format, (int)format);
+		return false;
+	}
+
+	auto start = std::chrono::high_resolution_clock::now();
+	out.m_Format = format;
+	out.m_Width = source.m_Width;
+	out.m_Height = source.m_Height;
+	out.AllocateLevels((uint32)source.m_Levels.size());
+
+	const uint32 blockBytes = Image::GetBlockBytes(format);
+	for (size_t level = 0; level < source.m_Levels.size(); ++level)
+	{
+		const ImageLevel& sourceLevel = source.m_Levels[level];
+		const uint8* pixels = &source.m_Data[sourceLevel.m_Offset];
+		uint8* blocks = &out.m_Data[out.m_Levels[level].m_Offset];
+		const uint32 width = sourceLevel.m_Width;
+		const uint32 height = sourceLevel.m_Height;
+		const uint32 blocksX = (width + 3) / 4;
+
+		//a block row per item, blocks past the edge repeat the last texels
+		auto encodeRows = [&](uint32 begin, uint32 end, uint32 thread)
+		{
+			uint8 texels[16 * 4];
+			for (uint32 blockY = begin; blockY < end; ++blockY)
+			{
+				for (uint32 blockX = 0; blockX < blocksX; ++blockX)
+				{
+					for (uint32 i = 0; i < 16; ++i)
+					{
+						const uint32 x = Math::Min(blockX * 4 + (i & 3), width - 1);
+						const uint32 y = Math::Min(blockY * 4 + (i >> 2), height - 1);
+						memcpy(texels + i * 4, pixels + ((size_t)y * width + x) * 4, 4);
+					}
+					EncodeBlock(format, texels, quality, blocks + ((size_t)blockY * blocksX + blockX) * blockBytes);
+				}
+			}
+		};
+
+		const uint32 blocksY = (height + 3) / 4;
+		JobSystem* jobSystem = JobSystem::getInstancePtr();
+		if (jobSystem != nullptr)
+		{
+			jobSystem->ParallelFor(blocksY, 0, encodeRows);
+		}
+		else
+		{
+			encodeRows(0, blocksY, 0);
+		}
+	}
+
+	auto end = std::chrono::high_resolution_clock::now();
+	DEBUG_MESSAGE(RAY_MESSAGE, "compressed %ux%u, %u levels: %u -> %u bytes in %.1fms", source.m_Width, source.m_Height,
+		(uint32)source.m_Levels.size(), (uint32)source.GetTotalSize(), (uint32)out.GetTotalSize(),
+		std::chrono::duration<double, std::milli>(end - start).count());
+	return true;
+}
+
+static uint32 GetDXGIFormat(ImageFormat format, bool sRGB)
+{
+	switch (format)
+	{
+	case IF_RGBA8: return sRGB ? 29 : 28;
+	case IF_BC1: return sRGB ? 72 : 71;
+	case IF_BC2: return sRGB ? 75 : 74;
+	case IF_BC3: return sRGB ? 78 : 77;
+	case IF_BC4: return 80;
+	case IF_BC5: return 83;
+	case IF_BC7: return sRGB ? 99 : 98;
+	default: return 0;
+	}
+}
+
+bool TextureCompressor::WriteDDS(const std::string& path, const Image& image, bool sRGB)
+{
+	//the 124 byte DDS_HEADER after the magic, then DDS_HEADER_DXT10
+	uint32 header[32 + 5];
+	memset(header, 0, sizeof(header));
+	header[0] = 0x20534444; //"DDS "
+	header[1] = 124;
+	header[2] = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000; //caps, height, width, pixel format, mip count, linear size
+	header[3] = image.m_Height;
+	header[4] = image.m_Width;
+	header[5] = image.m_Levels.empty() ? 0 : (uint32)image.m_Levels[0].m_Size;
+	header[7] = (uint32)image.m_Levels.size();
+	header[8] = ImageBottomUpTag;
+	header[19] = 32;
+	header[20] = 0x4; //fourcc
+	header[21] = 0x30315844; //"DX10"
+	header[27] = 0x1000 | (image.m_Levels.size() > 1 ? 0x8 | 0x400000 : 0); //texture, complex mipmap
+	header[32] = GetDXGIFormat(image.m_Format, sRGB);
+	header[33] = 3; //2d texture
+	header[35] = 1; //array size
+
+	std::ofstream stream(path.c_str(), std::ios::binary | std::ios::trunc);
+	if (!stream)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "can't write %s", path.c_str());
+		return false;
+	}
+
+	stream.write((const char*)header, sizeof(header));
+	if (!image.m_Data.empty())
+	{
+		stream.write((const char*)&image.m_Data[0], image.m_Data.size());
+	}
+
+	if (!stream)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "failed writing %s", path.c_str());
+		return false;
+	}
+	return true;
+}
+
+static bool CopyToFile(const std::string& path, const uint8* data, size_t size)
+{
+	std::ofstream stream(path.c_str(), std::ios::binary | std::ios::trunc);
+	stream.write((const char*)data, size);
+	if (!stream)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "can't write %s", path.c_str());
+		return false;
+	}
+	return true;
+}
+
+bool TextureCompressor::Cook(const std::string& sourcePath, const std::string& cookedPath, const TextureCookSettings& settings)
+{
+	std::string cachePath;
+	if (!settings.m_CacheDirectory.empty())
+	{
+		MappedFile source;
+		if (!source.Open(sourcePath))
+		{
+			DEBUG_MESSAGE(RAY_ERROR, "can't open %s", sourcePath.c_str());
+			return false;
+		}
+
+		const uint32 key[4] = { CompressorVersion, (uint32)settings.m_Format, (uint32)settings.m_Quality, settings.m_bSRGB ? 1u : 0u };
+		uint64 hash = HashBytes(HashSeed, key, sizeof(key));
+		hash = HashBytes(hash, source.GetData(), (size_t)source.GetSize());
+		cachePath = GetCachePath(settings.m_CacheDirectory, hash, ".dds");
+
+		MappedFile cached;
+		if (cached.Open(cachePath))
+		{
+			DEBUG_MESSAGE(RAY_MESSAGE, "%s unchanged, using %s", sourcePath.c_str(), cachePath.c_str());
+			return CopyToFile(cookedPath, cached.GetData(), (size_t)cached.GetSize());
+		}
+	}
+
+	Image image;
+	if (!ImageLoader::Load(sourcePath, image))
+		return false;
+
+	if (image.m_Levels.size() == 1)
+	{
+		ImageLoader::GenerateMips(image, settings.m_bSRGB);
+	}
+
+	Image compressed;
+	if (!Compress(image, settings.m_Format, settings.m_Quality, compressed) || !WriteDDS(cookedPath, compressed, settings.m_bSRGB))
+		return false;
+
+	if (!cachePath.empty())
+	{
+		CreateCacheDirectory(settings.m_CacheDirectory);
+		//a missing cache entry only costs the next cook some time
+		WriteDDS(cachePath, compressed, settings.m_bSRGB);
+	}
+	return true;
+}
@@ -0,0 +1,56 @@
+//=============================================================================================
+// TextureCompressor: the cook step turning RGBA8 images into BC1, BC3, BC4, BC5 or BC7
+// blocks. Block rows are spread over the job system and every block is fitted with vector
+// math on its 16 texels. Results are kept in an on-disk cache keyed by a hash of the source
+// file and the settings, so textures that did not change are never encoded twice.
+//=============================================================================================
+
+#pragma once
+#include "Image.h"
+#include <string>
+
+enum CompressionQuality
+{
+	CQ_Fast,	//bounding box endpoints, indices by projection
+	CQ_Normal,	//principal axis endpoints, best palette entry per texel
+	CQ_High,	//refined endpoints, every block mode tried
+};
+
+struct TextureCookSettings
+{
+	TextureCookSettings();
+
+	ImageFormat m_Format;
+	CompressionQuality m_Quality;
+	bool m_bSRGB; //mips are filtered as linear light, the DDS is marked sRGB
+	std::string m_CacheDirectory; //empty disables the cache
+};
+
+class TextureCompressor
+{
+public:
+	/* "bc1", "bc3", "bc4", "bc5" or "bc7" */
+	static bool FormatFromName(const char* name, ImageFormat& format);
+	/* "fast", "normal" or "high" */
+	static bool QualityFromName(const char* name, CompressionQuality& quality);
+
+	/* every level of an RGBA8 image, edge blocks repeat the last row and column */
+	static bool Compress(const Image& source, ImageFormat format, CompressionQuality quality, Image& out);
+
+	/* a DX10 DDS carrying ImageBottomUpTag, the loader takes the rows as they are */
+	static bool WriteDDS(const std::string& path, const Image& image, bool sRGB);
+
+	/* loads, mipmaps, compresses and writes sourcePath, or copies the cached result of an earlier cook */
+	static bool Cook(const std::string& sourcePath, const std::string& cookedPath, const TextureCookSettings& settings);
+
+	/**
+	 * Single blocks, texels are 16 RGBA8 values in rows of 4. BC1 uses its
+	 * transparent mode for texels with alpha under 128, BC4 compresses one
+	 * channel of the texels, BC5 the red and green ones.
+	 */
+	static void EncodeBC1(const uint8* texels, CompressionQuality quality, uint8* out);
+	static void EncodeBC3(const uint8* texels, CompressionQuality quality, uint8* out);
+	static void EncodeBC4(const uint8* texels, uint32 channel, CompressionQuality quality, uint8* out);
+	static void EncodeBC5(const uint8* texels, CompressionQuality quality, uint8* out);
+	static void EncodeBC7(const uint8* texels, CompressionQuality quality, uint8* out);
+};
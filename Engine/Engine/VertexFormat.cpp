@@ -0,0 +1,221 @@
+#include "VertexFormat.h"
+#include <string.h>
+
+VertexProfile::VertexProfile()
+	: m_Position(VPF_Float3)
+	, m_Normal(VNF_Float3)
+	, m_UV(VUF_Float2)
+{
+}
+
+VertexProfile::VertexProfile(VertexPositionFormat position, VertexNormalFormat normal, VertexUVFormat uv)
+	: m_Position((uint8)position)
+	, m_Normal((uint8)normal)
+	, m_UV((uint8)uv)
+{
+}
+
+bool VertexProfile::FromName(const std::string& name, VertexProfile& profile)
+{
+	if (name == "float")
+	{
+		profile = VertexProfile();
+	}
+	else if (name == "half")
+	{
+		profile = VertexProfile(VPF_Half4, VNF_Snorm10x3, VUF_Half2);
+	}
+	else if (name == "compact")
+	{
+		profile = VertexProfile(VPF_Unorm16x4, VNF_Snorm10x3, VUF_Half2);
+	}
+	else
+	{
+		return false;
+	}
+	return true;
+}
+
+VertexProfile VertexProfile::Unpack(uint32 packed)
+{
+	VertexProfile profile;
+	profile.m_Position = (uint8)(packed & 0xFF);
+	profile.m_Normal = (uint8)((packed >> 8) & 0xFF);
+	profile.m_UV = (uint8)((packed >> 16) & 0xFF);
+	return profile;
+}
+
+uint32 VertexProfile::Pack() const
+{
+	return m_Position | (m_Normal << 8) | (m_UV << 16);
+}
+
+bool VertexProfile::IsValid() const
+{
+	return m_Position <= VPF_Unorm16x4 && m_Normal <= VNF_Snorm10x3 && m_UV <= VUF_Half2;
+}
+
+const char* VertexProfile::GetName() const
+{
+	if (m_Position == VPF_Float3 && m_Normal == VNF_Float3 && m_UV == VUF_Float2)
+		return "float";
+	if (m_Position == VPF_Half4 && m_Normal == VNF_Snorm10x3 && m_UV == VUF_Half2)
+		return "half";
+	if (m_Position == VPF_Unorm16x4 && m_Normal == VNF_Snorm10x3 && m_UV == VUF_Half2)
+		return "compact";
+	return "custom";
+}
+
+uint32 VertexProfile::GetNormalOffset() const
+{
+	return m_Position == VPF_Float3 ? 12 : 8;
+}
+
+uint32 VertexProfile::GetUVOffset() const
+{
+	return GetNormalOffset() + (m_Normal == VNF_Float3 ? 12 : 4);
+}
+
+uint32 VertexProfile::GetStride() const
+{
+	return GetUVOffset() + (m_UV == VUF_Float2 ? 8 : 4);
+}
+
+void VertexProfile::GetDequantization(const Box& bounds, Vector& scale, Vector& bias) const
+{
+	if (m_Position == VPF_Float3 || !bounds.IsValid)
+	{
+		scale = Vector(1.0f, 1.0f, 1.0f);
+		bias = Vector(0.0f, 0.0f, 0.0f);
+	}
+	else if (m_Position == VPF_Half4)
+	{
+		scale = bounds.GetExtent();
+		bias = bounds.GetCenter();
+	}
+	else
+	{
+		scale = bounds.Max - bounds.Min;
+		bias = bounds.Min;
+	}
+}
+
+/* a flat axis has no scale, everything on it sits at the bias */
+static float InverseScale(float scale)
+{
+	return scale > 0.0f ? 1.0f / scale : 0.0f;
+}
+
+static uint16 QuantizeUnorm16(float value)
+{
+	return (uint16)(Math::Clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+}
+
+void VertexProfile::Encode(const MeshVertex* vertices, uint32 count, const Vector& scale, const Vector& bias, uint8* out) const
+{
+	const Vector invScale(InverseScale(scale.X), InverseScale(scale.Y), InverseScale(scale.Z));
+	const uint32 stride = GetStride();
+	const uint32 normalOffset = GetNormalOffset();
+	const uint32 uvOffset = GetUVOffset();
+
+	for (uint32 i = 0; i < count; ++i, out += stride)
+	{
+		const MeshVertex& vertex = vertices[i];
+		const Vector local = (vertex.m_Position - bias) * invScale;
+
+		if (m_Position == VPF_Float3)
+		{
+			memcpy(out, &vertex.m_Position, 12);
+		}
+		else if (m_Position == VPF_Half4)
+		{
+			const uint16 position[4] = { FloatToHalf(local.X), FloatToHalf(local.Y), FloatToHalf(local.Z), FloatToHalf(1.0f) };
+			memcpy(out, position, sizeof(position));
+		}
+		else
+		{
+			const uint16 position[4] = { QuantizeUnorm16(local.X), QuantizeUnorm16(local.Y), QuantizeUnorm16(local.Z), 65535 };
+			memcpy(out, position, sizeof(position));
+		}
+
+		if (m_Normal == VNF_Float3)
+		{
+			memcpy(out + normalOffset, &vertex.m_Normal, 12);
+		}
+		else
+		{
+			const uint32 normal = PackSnorm10x3(vertex.m_Normal);
+			memcpy(out + normalOffset, &normal, sizeof(normal));
+		}
+
+		if (m_UV == VUF_Float2)
+		{
+			memcpy(out + uvOffset, vertex.m_UV, 8);
+		}
+		else
+		{
+			const uint16 uv[2] = { FloatToHalf(vertex.m_UV[0]), FloatToHalf(vertex.m_UV[1]) };
+			memcpy(out + uvOffset, uv, sizeof(uv));
+		}
+	}
+}
+
+/**
+	round to nearest even, out of range values become infinity, tiny ones denormals or zero
+**/
+uint16 FloatToHalf(float value)
+{
+	uint32 bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	const uint32 sign = (bits >> 16) & 0x8000;
+	const uint32 floatExponent = (bits >> 23) & 0xFF;
+	uint32 mantissa = bits & 0x7FFFFF;
+	const int32 exponent = (int32)floatExponent - 127 + 15;
+
+	if (floatExponent == 0xFF)
+		return (uint16)(sign | 0x7C00 | (mantissa != 0 ? 0x200 : 0));
+	if (exponent >= 31)
+		return (uint16)(sign | 0x7C00);
+
+	uint32 shift = 13;
+	uint32 half = ((uint32)Math::Max(exponent, 0) << 10);
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return (uint16)sign;
+
+		mantissa |= 0x800000;
+		shift = 14 - exponent;
+	}
+
+	half |= mantissa >> shift;
+	const uint32 remainder = mantissa & ((1u << shift) - 1);
+	const uint32 halfway = 1u << (shift - 1);
+	if (remainder > halfway || (remainder == halfway && (half & 1) != 0))
+	{
+		//a carry out of the mantissa steps the exponent, up to infinity
+		++half;
+	}
+	return (uint16)(sign | half);
+}
+
+uint32 PackUnorm8x4(const Vector4& value)
+{
+	const uint32 r = (uint32)(Math::Clamp(value.X, 0.0f, 1.0f) * 255.0f + 0.5f);
+	const uint32 g = (uint32)(Math::Clamp(value.Y, 0.0f, 1.0f) * 255.0f + 0.5f);
+	const uint32 b = (uint32)(Math::Clamp(value.Z, 0.0f, 1.0f) * 255.0f + 0.5f);
+	const uint32 a = (uint32)(Math::Clamp(value.W, 0.0f, 1.0f) * 255.0f + 0.5f);
+	return r | (g << 8) | (b << 16) | (a << 24);
+}
+
+static uint32 QuantizeSnorm10(float value)
+{
+	const float scaled = Math::Clamp(value, -1.0f, 1.0f) * 511.0f;
+	return (uint32)(int32)(scaled < 0.0f ? scaled - 0.5f : scaled + 0.5f) & 0x3FF;
+}
+
+uint32 PackSnorm10x3(const Vector& value)
+{
+	return QuantizeSnorm10(value.X) | (QuantizeSnorm10(value.Y) << 10) | (QuantizeSnorm10(value.Z) << 20) | (1u << 30);
+}
@@ -0,0 +1,74 @@
+//=============================================================================================
+// VertexFormat: the vertex encodings a mesh can be cooked with. Positions are quantized inside
+// the mesh bounds and expanded again by a per-mesh transform that is folded into the world
+// matrix, the other attributes are decoded by the vertex fetch as normalized integers or half
+// floats. Shaders read the same inputs whatever profile the mesh was cooked with.
+//=============================================================================================
+
+#pragma once
+#include "../Config/WindowPlatform.h"
+#include "../Math/RayMath.h"
+#include <string>
+
+/* the uncompressed vertex, what importers produce and the float profile stores */
+struct MeshVertex
+{
+	Vector m_Position;
+	Vector m_Normal;
+	float m_UV[2];
+};
+
+enum VertexPositionFormat
+{
+	VPF_Float3,
+	VPF_Half4,      //inside the bounds mapped to [-1, 1]
+	VPF_Unorm16x4,  //inside the bounds mapped to [0, 1]
+};
+
+enum VertexNormalFormat
+{
+	VNF_Float3,
+	VNF_Snorm10x3,  //GL_INT_2_10_10_10_REV, w is always 1
+};
+
+enum VertexUVFormat
+{
+	VUF_Float2,
+	VUF_Half2,
+};
+
+/**
+ * One format per attribute, attributes are laid out position, normal, uv.
+ * Packs into the 32 bit vertex format word of MeshFileHeader, the all float
+ * profile packs to 0.
+ */
+struct VertexProfile
+{
+	VertexProfile();
+	VertexProfile(VertexPositionFormat position, VertexNormalFormat normal, VertexUVFormat uv);
+
+	/* "float" (32 bytes), "half" or "compact" (16 bytes) */
+	static bool FromName(const std::string& name, VertexProfile& profile);
+	static VertexProfile Unpack(uint32 packed);
+	uint32 Pack() const;
+	bool IsValid() const;
+	const char* GetName() const;
+
+	uint32 GetStride() const;
+	uint32 GetNormalOffset() const;
+	uint32 GetUVOffset() const;
+
+	/* mesh position = stored position * scale + bias */
+	void GetDequantization(const Box& bounds, Vector& scale, Vector& bias) const;
+
+	/* writes count vertices GetStride apart, scale and bias from GetDequantization */
+	void Encode(const MeshVertex* vertices, uint32 count, const Vector& scale, const Vector& bias, uint8* out) const;
+
+	uint8 m_Position;
+	uint8 m_Normal;
+	uint8 m_UV;
+};
+
+uint16 FloatToHalf(float value);
+uint32 PackUnorm8x4(const Vector4& value);
+uint32 PackSnorm10x3(const Vector& value);
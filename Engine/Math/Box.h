@@ -0,0 +1,148 @@
+//===========================================================================
+// Box: Axis aligned bounding box.
+//===========================================================================
+
+#pragma once
+#include "Vector.h"
+#include "Matrix.h"
+
+/**
+ * An axis aligned box given by its min and max corners, empty until IsValid.
+ */
+struct Box
+{
+public:
+	/** Holds the box's minimum point. */
+	Vector Min;
+
+	/** Holds the box's maximum point. */
+	Vector Max;
+
+	/** Holds a flag indicating whether this box is valid. */
+	bool IsValid;
+
+public:
+	/** Creates an empty box. */
+	FORCEINLINE Box();
+
+	/**
+	 * Creates and initializes a new box from the specified corners.
+	 *
+	 * @param InMin The box's minimum point.
+	 * @param InMax The box's maximum point.
+	 */
+	FORCEINLINE Box(const Vector& InMin, const Vector& InMax);
+
+	/**
+	 * Creates a box from its center and half size.
+	 */
+	static FORCEINLINE Box BuildAABB(const Vector& Origin, const Vector& Extent);
+
+public:
+	/** Grows the box to contain the point. */
+	FORCEINLINE Box& operator+=(const Vector& Other);
+
+	/** Grows the box to contain the other box. */
+	FORCEINLINE Box& operator+=(const Box& Other);
+
+	FORCEINLINE Vector GetCenter() const;
+
+	/** Gets the half size of the box. */
+	FORCEINLINE Vector GetExtent() const;
+
+	FORCEINLINE bool IsInside(const Vector& In) const;
+
+	/**
+	 * Gets the box bounding this box after an affine transform, for row vectors
+	 * (v * M). A homogeneous scale in M[3][3] is divided out.
+	 */
+	FORCEINLINE Box TransformBy(const Matrix& M) const;
+};
+
+
+FORCEINLINE Box::Box()
+	: Min(0.0f, 0.0f, 0.0f)
+	, Max(0.0f, 0.0f, 0.0f)
+	, IsValid(false)
+{
+}
+
+FORCEINLINE Box::Box(const Vector& InMin, const Vector& InMax)
+	: Min(InMin)
+	, Max(InMax)
+	, IsValid(true)
+{
+}
+
+FORCEINLINE Box Box::BuildAABB(const Vector& Origin, const Vector& Extent)
+{
+	return Box(Origin - Extent, Origin + Extent);
+}
+
+FORCEINLINE Box& Box::operator+=(const Vector& Other)
+{
+	if (IsValid)
+	{
+		Min = Min.ComponentMin(Other);
+		Max = Max.ComponentMax(Other);
+	}
+	else
+	{
+		Min = Max = Other;
+		IsValid = true;
+	}
+	return *this;
+}
+
+FORCEINLINE Box& Box::operator+=(const Box& Other)
+{
+	if (!Other.IsValid)
+		return *this;
+
+	if (IsValid)
+	{
+		Min = Min.ComponentMin(Other.Min);
+		Max = Max.ComponentMax(Other.Max);
+	}
+	else
+	{
+		*this = Other;
+	}
+	return *this;
+}
+
+FORCEINLINE Vector Box::GetCenter() const
+{
+	return Vector((Min.X + Max.X) * 0.5f, (Min.Y + Max.Y) * 0.5f, (Min.Z + Max.Z) * 0.5f);
+}
+
+FORCEINLINE Vector Box::GetExtent() const
+{
+	return Vector((Max.X - Min.X) * 0.5f, (Max.Y - Min.Y) * 0.5f, (Max.Z - Min.Z) * 0.5f);
+}
+
+FORCEINLINE bool Box::IsInside(const Vector& In) const
+{
+	return In.X > Min.X && In.X < Max.X && In.Y > Min.Y && In.Y < Max.Y && In.Z > Min.Z && In.Z < Max.Z;
+}
+
+FORCEINLINE Box Box::TransformBy(const Matrix& M) const
+{
+	if (!IsValid)
+		return Box();
+
+	//the center moves with the matrix, the extent is spread over the absolute axes
+	const Vector Center = GetCenter();
+	const Vector Extent = GetExtent();
+	const float InvW = 1.0f / M.M[3][3];
+
+	float NewCenter[3], NewExtent[3];
+	for (int Column = 0; Column < 3; ++Column)
+	{
+		NewCenter[Column] = (Center.X * M.M[0][Column] + Center.Y * M.M[1][Column] + Center.Z * M.M[2][Column] + M.M[3][Column]) * InvW;
+		NewExtent[Column] = (Extent.X * Math::Abs(M.M[0][Column]) + Extent.Y * Math::Abs(M.M[1][Column])
+			+ Extent.Z * Math::Abs(M.M[2][Column])) * Math::Abs(InvW);
+	}
+
+	return BuildAABB(Vector(NewCenter[0], NewCenter[1], NewCenter[2]), Vector(NewExtent[0], NewExtent[1], NewExtent[2]));
+}
@@ -787,6 +787,15 @@ inline Vector Matrix::GetOrigin() const
 	return Vector(M[3][0], M[3][1], M[3][2]);
 }
 
+// SetOrigin
+
+inline void Matrix::SetOrigin(const Vector& NewOrigin)
+{
+	M[3][0] = NewOrigin.X;
+	M[3][1] = NewOrigin.Y;
+	M[3][2] = NewOrigin.Z;
+}
+
 /**
 * Apply Scale to this matrix
 */
@@ -0,0 +1,69 @@
+//===========================================================================
+// Plane: Plane in 3D space, Normal | P = W.
+//===========================================================================
+
+#pragma once
+#include "Vector.h"
+#include "Vector4.h"
+
+/**
+ * A plane stored as its normal (X, Y, Z) and distance W, points P with
+ * PlaneDot(P) > 0 are in front of it.
+ */
+struct Plane : public Vector
+{
+public:
+	/** The w-component. */
+	float W;
+
+public:
+	FORCEINLINE Plane();
+
+	/**
+	 * @param V Normal in X, Y, Z and -W in the fourth component, the layout
+	 *			of a clip space row (a x + b y + c z + d >= 0).
+	 */
+	FORCEINLINE explicit Plane(const Vector4& V);
+
+	FORCEINLINE Plane(const Vector& InNormal, float InW);
+
+	/** Signed distance of the point to the plane, scaled by the normal's length. */
+	FORCEINLINE float PlaneDot(const Vector& P) const;
+
+	/** Scales the plane so its normal has unit length. */
+	FORCEINLINE Plane GetNormalized() const;
+};
+
+
+FORCEINLINE Plane::Plane()
+	: Vector(0.0f, 0.0f, 0.0f)
+	, W(0.0f)
+{
+}
+
+FORCEINLINE Plane::Plane(const Vector4& V)
+	: Vector(V.X, V.Y, V.Z)
+	, W(-V.W)
+{
+}
+
+FORCEINLINE Plane::Plane(const Vector& InNormal, float InW)
+	: Vector(InNormal)
+	, W(InW)
+{
+}
+
+FORCEINLINE float Plane::PlaneDot(const Vector& P) const
+{
+	return X * P.X + Y * P.Y + Z * P.Z - W;
+}
+
+FORCEINLINE Plane Plane::GetNormalized() const
+{
+	const float Length = Math::Sqrt(X * X + Y * Y + Z * Z);
+	if (Length <= SMALL_NUMBER)
+		return *this;
+
+	const float InvLength = 1.0f / Length;
+	return Plane(Vector(X * InvLength, Y * InvLength, Z * InvLength), W * InvLength);
+}
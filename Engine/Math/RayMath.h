@@ -7,6 +7,8 @@
 #include "Vector.h"
 #include "Vector4.h"
 #include "Matrix.h"
+#include "Box.h"
+#include "Plane.h"
 #include "Quaternion.h"
 #include "Rotator.h"
 
@@ -642,6 +642,14 @@ FORCEINLINE uint32 VectorAnyGreaterThan(const VectorRegister& Vec1, const Vector
 	return (uint32)XMComparisonAnyTrue(comparisonValue);
 }
 
+/**
+* Returns an integer bit-mask (0x00 - 0x0f) based on the sign-bit for each component in a vector.
+*
+* @param VecMask		Vector, usually the result of one of the VectorCompare functions
+* @return				Bit 0 = sign(VecMask.x), Bit 1 = sign(VecMask.y), Bit 2 = sign(VecMask.z), Bit 3 = sign(VecMask.w)
+*/
+#define VectorMaskBits( VecMask )		_mm_movemask_ps( VecMask )
+
 /**
 * Resets the floating point registers so that they can be used again.
 * Some intrinsics use these for MMX purposes (e.g. VectorLoadByte4 and VectorStoreByte4).
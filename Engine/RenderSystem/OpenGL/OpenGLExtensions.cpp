@@ -0,0 +1,31 @@
+#include "OpenGLExtensions.h"
+#include "../../Tools/RayUtils.h"
+#include <GLFW/glfw3.h>
+
+bool OpenGLExtensions::m_bBufferStorage = false;
+PFNRAYBUFFERSTORAGEPROC OpenGLExtensions::BufferStorage = nullptr;
+bool OpenGLExtensions::m_bParallelShaderCompile = false;
+PFNRAYMAXSHADERCOMPILERTHREADSPROC OpenGLExtensions::MaxShaderCompilerThreads = nullptr;
+
+bool OpenGLExtensions::Load()
+{
+	if (glfwExtensionSupported("GL_ARB_buffer_storage"))
+	{
+		BufferStorage = (PFNRAYBUFFERSTORAGEPROC)glfwGetProcAddress("glBufferStorage");
+		m_bBufferStorage = (BufferStorage != nullptr);
+	}
+
+	if (glfwExtensionSupported("GL_KHR_parallel_shader_compile"))
+	{
+		MaxShaderCompilerThreads = (PFNRAYMAXSHADERCOMPILERTHREADSPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsKHR");
+	}
+	else if (glfwExtensionSupported("GL_ARB_parallel_shader_compile"))
+	{
+		MaxShaderCompilerThreads = (PFNRAYMAXSHADERCOMPILERTHREADSPROC)glfwGetProcAddress("glMaxShaderCompilerThreadsARB");
+	}
+	m_bParallelShaderCompile = (MaxShaderCompilerThreads != nullptr);
+
+	DEBUG_MESSAGE(RAY_MESSAGE, "OpenGL %s, buffer storage: %s, parallel shader compile: %s", (const char*)glGetString(GL_VERSION),
+		m_bBufferStorage ? "yes" : "no", m_bParallelShaderCompile ? "yes" : "no");
+	return true;
+}
@@ -0,0 +1,39 @@
+//===========================================================================
+// OpenGLExtensions: entry points and enums newer than the bundled glew.
+//===========================================================================
+
+#pragma once
+#include <GL/glew.h>
+
+/* ARB_buffer_storage (core in 4.4) */
+#ifndef GL_MAP_PERSISTENT_BIT
+#define GL_MAP_PERSISTENT_BIT	0x0040
+#define GL_MAP_COHERENT_BIT		0x0080
+#define GL_DYNAMIC_STORAGE_BIT	0x0100
+#define GL_CLIENT_STORAGE_BIT	0x0200
+#endif
+
+/* KHR_parallel_shader_compile, ARB_parallel_shader_compile uses the same values */
+#ifndef GL_COMPLETION_STATUS_KHR
+#define GL_MAX_SHADER_COMPILER_THREADS_KHR	0x91B0
+#define GL_COMPLETION_STATUS_KHR			0x91B1
+#endif
+
+typedef void (GLAPIENTRY * PFNRAYBUFFERSTORAGEPROC) (GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+typedef void (GLAPIENTRY * PFNRAYMAXSHADERCOMPILERTHREADSPROC) (GLuint count);
+
+/**
+ * Loaded once after glewInit, everything here is optional and callers
+ * must check the matching flag before using an entry point.
+ */
+struct OpenGLExtensions
+{
+	static bool Load();
+
+	static bool m_bBufferStorage;
+	static PFNRAYBUFFERSTORAGEPROC BufferStorage;
+
+	/* compiles and links return at once, GL_COMPLETION_STATUS_KHR tells when they're done */
+	static bool m_bParallelShaderCompile;
+	static PFNRAYMAXSHADERCOMPILERTHREADSPROC MaxShaderCompilerThreads;
+};
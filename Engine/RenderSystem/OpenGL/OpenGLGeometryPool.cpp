@@ -0,0 +1,107 @@
+#include "OpenGLGeometryPool.h"
+#include "OpenGLStateCache.h"
+#include "../../Tools/RayUtils.h"
+
+GeometryPool::GeometryPool()
+	: m_VertexBuffer(0)
+	, m_IndexBuffer(0)
+	, m_IndexSize(sizeof(uint32))
+{
+}
+
+GeometryPool::~GeometryPool()
+{
+	Release();
+}
+
+bool GeometryPool::Init(const VertexLayout& layout, uint32 maxVertices, uint32 maxIndices, uint32 indexSize)
+{
+	ASSERT(indexSize == sizeof(uint16) || indexSize == sizeof(uint32));
+	OpenGLStateCache* stateCache = OpenGLStateCache::getInstancePtr();
+	m_Layout = layout;
+	m_IndexSize = indexSize;
+
+	//go through the copy target, the element binding is vertex array state
+	glGenBuffers(1, &m_VertexBuffer);
+	stateCache->BindBuffer(GL_COPY_WRITE_BUFFER, m_VertexBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)maxVertices * layout.GetStride(), NULL, GL_STATIC_DRAW);
+
+	glGenBuffers(1, &m_IndexBuffer);
+	stateCache->BindBuffer(GL_COPY_WRITE_BUFFER, m_IndexBuffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, (GLsizeiptr)maxIndices * indexSize, NULL, GL_STATIC_DRAW);
+
+	m_Vertices.Reset(maxVertices);
+	m_Indices.Reset(maxIndices);
+
+	DEBUG_MESSAGE(RAY_MESSAGE, "Geometry pool: %u vertices (stride %d), %u %u bit indices", maxVertices, layout.GetStride(), maxIndices, indexSize * 8);
+	return m_VertexBuffer != 0 && m_IndexBuffer != 0;
+}
+
+void GeometryPool::Release()
+{
+	OpenGLStateCache* stateCache = OpenGLStateCache::getInstancePtr();
+	if (m_VertexBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_VertexBuffer);
+		stateCache->OnBufferDeleted(m_VertexBuffer);
+		m_VertexBuffer = 0;
+	}
+	if (m_IndexBuffer != 0)
+	{
+		glDeleteBuffers(1, &m_IndexBuffer);
+		stateCache->OnBufferDeleted(m_IndexBuffer);
+		m_IndexBuffer = 0;
+	}
+}
+
+MeshAllocation GeometryPool::Allocate(uint32 vertexCount, uint32 indexCount)
+{
+	MeshAllocation mesh;
+
+	uint32 baseVertex = m_Vertices.Allocate(vertexCount);
+	if (baseVertex == RangeAllocator::InvalidOffset)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "geometry pool out of vertex space, %u requested", vertexCount);
+		return mesh;
+	}
+
+	uint32 firstIndex = m_Indices.Allocate(indexCount);
+	if (firstIndex == RangeAllocator::InvalidOffset)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "geometry pool out of index space, %u requested", indexCount);
+		m_Vertices.Free(baseVertex, vertexCount);
+		return mesh;
+	}
+
+	mesh.m_BaseVertex = (int32)baseVertex;
+	mesh.m_VertexCount = vertexCount;
+	mesh.m_FirstIndex = firstIndex;
+	mesh.m_IndexCount = indexCount;
+	return mesh;
+}
+
+void GeometryPool::Free(MeshAllocation& mesh)
+{
+	if (!mesh.IsValid())
+		return;
+
+	m_Vertices.Free((uint32)mesh.m_BaseVertex, mesh.m_VertexCount);
+	m_Indices.Free(mesh.m_FirstIndex, mesh.m_IndexCount);
+	mesh = MeshAllocation();
+}
+
+bool GeometryPool::Upload(const MeshAllocation& mesh, const void* vertices, const void* indices)
+{
+	if (!mesh.IsValid())
+		return false;
+
+	OpenGLStateCache* stateCache = OpenGLStateCache::getInstancePtr();
+	const GLsizei stride = m_Layout.GetStride();
+
+	stateCache->BindBuffer(GL_COPY_WRITE_BUFFER, m_VertexBuffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)mesh.m_BaseVertex * stride, (GLsizeiptr)mesh.m_VertexCount * stride, vertices);
+
+	stateCache->BindBuffer(GL_COPY_WRITE_BUFFER, m_IndexBuffer);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, (GLintptr)mesh.m_FirstIndex * m_IndexSize, (GLsizeiptr)mesh.m_IndexCount * m_IndexSize, indices);
+	return true;
+}
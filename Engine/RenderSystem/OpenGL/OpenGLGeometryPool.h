@@ -0,0 +1,74 @@
+//===========================================================================
+// GeometryPool: many meshes sub allocated in one large vertex buffer and
+// one large index buffer, so they can share a vertex array and be drawn
+// together with glMultiDrawElementsIndirect.
+//===========================================================================
+
+#pragma once
+#include "OpenGLVertexLayout.h"
+#include "../../Tools/RangeAllocator.h"
+#include <GL/glew.h>
+
+/**
+ * Where a mesh lives inside its pool, indices are relative to m_BaseVertex.
+ */
+struct MeshAllocation
+{
+	MeshAllocation()
+		: m_BaseVertex(0)
+		, m_VertexCount(0)
+		, m_FirstIndex(RangeAllocator::InvalidOffset)
+		, m_IndexCount(0)
+	{}
+
+	bool IsValid() const { return m_FirstIndex != RangeAllocator::InvalidOffset; }
+
+	int32 m_BaseVertex;
+	uint32 m_VertexCount;
+	uint32 m_FirstIndex;
+	uint32 m_IndexCount;
+};
+
+/**
+ * Layout of one record in GL_DRAW_INDIRECT_BUFFER.
+ */
+struct DrawElementsIndirectCommand
+{
+	GLuint m_Count;
+	GLuint m_InstanceCount;
+	GLuint m_FirstIndex;
+	GLint m_BaseVertex;
+	GLuint m_BaseInstance;
+};
+
+class GeometryPool
+{
+public:
+	GeometryPool();
+	~GeometryPool();
+
+	/* indexSize is 2 or 4 bytes, every mesh in the pool uses the same */
+	bool Init(const VertexLayout& layout, uint32 maxVertices, uint32 maxIndices, uint32 indexSize = sizeof(uint32));
+	void Release();
+
+	MeshAllocation Allocate(uint32 vertexCount, uint32 indexCount);
+	void Free(MeshAllocation& mesh);
+
+	/* vertices must match the pool's layout, indices its index size */
+	bool Upload(const MeshAllocation& mesh, const void* vertices, const void* indices);
+
+	const VertexLayout& GetLayout() const { return m_Layout; }
+	GLuint GetVertexBuffer() const { return m_VertexBuffer; }
+	GLuint GetIndexBuffer() const { return m_IndexBuffer; }
+	uint32 GetIndexSize() const { return m_IndexSize; }
+
+private:
+	VertexLayout m_Layout;
+
+	GLuint m_VertexBuffer;
+	GLuint m_IndexBuffer;
+	uint32 m_IndexSize;
+
+	RangeAllocator m_Vertices;
+	RangeAllocator m_Indices;
+};
@@ -1,18 +1,78 @@
 #include "OpenGLRender.h"
 #include "OpenGLShader.h"
+#include "OpenGLExtensions.h"
+#include "OpenGLStateCache.h"
 #include "../../Tools/RayUtils.h"
 #include "../../Math/RayMath.h"
 #include "../../Camera/Camera.h"
 #include "../../Camera/FreeCameraController.h"
+#include "../../Engine/JobSystem.h"
 
+#include <fstream>
 #include <stdio.h>
+#include <stddef.h>
+#include <string.h>
 using namespace std;
 
 struct Vertex
 {
 	Vector positon;
-	Vector4 Color;
+	uint32 Color; //RGBA8, see PackUnorm8x4
+	float UV[2]; //location 7 like the cooked meshes, so textured variants draw both
+
+	static const VertexLayout& GetLayout()
+	{
+		static const VertexLayout layout = VertexLayout(sizeof(Vertex))
+			.Add(0, &Vertex::positon)
+			.Add(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, (GLuint)offsetof(Vertex, Color))
+			.Add(7, 2, GL_FLOAT, GL_FALSE, (GLuint)offsetof(Vertex, UV));
+		return layout;
+	}
 };
+
+/**
+	cooked meshes, built from the profile they were cooked with. The demo shows
+	the normal through the color input, texture coordinates go to location 7
+**/
+static VertexLayout GetMeshVertexLayout(const VertexProfile& profile)
+{
+	VertexLayout layout(profile.GetStride());
+	switch (profile.m_Position)
+	{
+	case VPF_Float3:	layout.Add(0, 3, GL_FLOAT, GL_FALSE, 0); break;
+	case VPF_Half4:		layout.Add(0, 4, GL_HALF_FLOAT, GL_FALSE, 0); break;
+	default:			layout.Add(0, 4, GL_UNSIGNED_SHORT, GL_TRUE, 0); break;
+	}
+
+	if (profile.m_Normal == VNF_Float3)
+	{
+		layout.Add(1, 3, GL_FLOAT, GL_FALSE, profile.GetNormalOffset());
+	}
+	else
+	{
+		layout.Add(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, profile.GetNormalOffset());
+	}
+
+	layout.Add(7, 2, profile.m_UV == VUF_Float2 ? GL_FLOAT : GL_HALF_FLOAT, GL_FALSE, profile.GetUVOffset());
+	return layout;
+}
+
+/**
+	per-instance stream of the instanced programs, one InstanceData per instance
+**/
+static const VertexLayout& GetInstanceLayout()
+{
+	static const GLuint transformOffset = (GLuint)offsetof(InstanceData, m_Transform);
+	static const VertexLayout layout = VertexLayout(sizeof(InstanceData))
+		.Add(2, 4, GL_FLOAT, GL_FALSE, transformOffset)
+		.Add(3, 4, GL_FLOAT, GL_FALSE, transformOffset + sizeof(Vector4))
+		.Add(4, 4, GL_FLOAT, GL_FALSE, transformOffset + 2 * sizeof(Vector4))
+		.Add(5, &InstanceData::m_Color)
+		.Add(6, &InstanceData::m_Params)
+		.SetDivisor(1);
+	return layout;
+}
+
 /**
 	default constructor
 **/
@@ -24,11 +84,31 @@ OpenGLRenderSystem::OpenGLRenderSystem()
 	, m_Height(600)
 	, m_Window(nullptr)
 	, m_Monitor(nullptr)
+	, m_CompileWindow(nullptr)
 	, m_SysPaused(false)
+	, m_MeshInstancedVAO(0)
+	, m_ImportedTexture(TextureManager::WhiteTexture)
+	, m_PoolVAO(0)
+	, m_PoolInstancedVAO(0)
+	, m_MeshProgram(0)
+	, m_MeshSort(0)
+	, m_InstancedProgram(0)
+	, m_InstancedSort(0)
+	, m_InstanceOffset(0)
+	, m_IndirectOffset(0)
+	, m_DrawCalls(0)
+	, m_CubeHandle(SceneVisibility::InvalidHandle)
+	, m_RecordIndex(0)
+	, m_LastDrawCalls(0)
+	, m_bRenderThreadQuit(false)
 {
 	DEBUG_MESSAGE(RAY_MESSAGE, "OpenGL RenderSystem Start...");
+	m_LastStateStats.m_Issued = m_LastStateStats.m_Filtered = 0;
+	memset(&m_LastTextureStats, 0, sizeof(m_LastTextureStats));
 	InitWindow();
+	m_StateCache = new OpenGLStateCache();
 	m_ShaderManager = new ShaderManager();
+	m_ShaderManager->InitAsyncCompile(m_CompileWindow);
 }
 
 /**
@@ -42,11 +122,31 @@ OpenGLRenderSystem::OpenGLRenderSystem(int width, int height, string name, bool
 	, m_Height(height)
 	, m_Window(nullptr)
 	, m_Monitor(nullptr)
+	, m_CompileWindow(nullptr)
 	, m_SysPaused(false)
+	, m_MeshInstancedVAO(0)
+	, m_ImportedTexture(TextureManager::WhiteTexture)
+	, m_PoolVAO(0)
+	, m_PoolInstancedVAO(0)
+	, m_MeshProgram(0)
+	, m_MeshSort(0)
+	, m_InstancedProgram(0)
+	, m_InstancedSort(0)
+	, m_InstanceOffset(0)
+	, m_IndirectOffset(0)
+	, m_DrawCalls(0)
+	, m_CubeHandle(SceneVisibility::InvalidHandle)
+	, m_RecordIndex(0)
+	, m_LastDrawCalls(0)
+	, m_bRenderThreadQuit(false)
 {
 	DEBUG_MESSAGE(RAY_MESSAGE, "OpenGL RenderSystem Start Resolution %d x %d...", width, height);
+	m_LastStateStats.m_Issued = m_LastStateStats.m_Filtered = 0;
+	memset(&m_LastTextureStats, 0, sizeof(m_LastTextureStats));
 	InitWindow();
+	m_StateCache = new OpenGLStateCache();
 	m_ShaderManager = new ShaderManager();
+	m_ShaderManager->InitAsyncCompile(m_CompileWindow);
 }
 
 /*
@@ -54,7 +154,20 @@ OpenGLRenderSystem::OpenGLRenderSystem(int width, int height, string name, bool
 */
 OpenGLRenderSystem::~OpenGLRenderSystem()
 {
+	StopRendering();
+	m_Textures.Release();
+	m_UniformRing.Release();
+	m_VertexArrays.Release();
+	m_GeometryPool.Release();
+	m_MeshPool.Release();
+	m_InstanceStream.Release();
+	m_IndirectStream.Release();
 	R_DELETE(m_ShaderManager);
+	if (m_CompileWindow != nullptr)
+	{
+		glfwDestroyWindow(m_CompileWindow);
+	}
+	R_DELETE(m_StateCache);
 	R_DELETE(m_Camera);
 	DEBUG_MESSAGE(RAY_MESSAGE, "Unload OpenGL RenderSystem...");
 }
@@ -100,6 +213,19 @@ bool OpenGLRenderSystem::InitWindow()
 		glfwTerminate();
 		return false;
 	}
+	OpenGLExtensions::Load();
+
+	/* without compiler threads in the driver, queued shader links run on a hidden window's context sharing this one */
+	if (!OpenGLExtensions::m_bParallelShaderCompile)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+		m_CompileWindow = glfwCreateWindow(1, 1, "Ray Engine Compile", NULL, m_Window);
+		glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+		if (m_CompileWindow == nullptr)
+		{
+			DEBUG_MESSAGE(RAY_MESSAGE, "no shared context, shader links won't be queued");
+		}
+	}
 
 	return true;
 }
@@ -115,68 +241,517 @@ bool OpenGLRenderSystem::SetParam(int width, int height, std::string name, bool
 
 void OpenGLRenderSystem::RenderOneFrame()
 {
-	glClear(GL_COLOR_BUFFER_BIT);
+	RenderFrame& frame = m_Frames[m_RecordIndex];
+	{
+		std::unique_lock<std::mutex> lock(m_FrameMutex);
+		m_FrameCondition.wait(lock, [&frame]() { return !frame.m_bRecorded; });
+		m_LastDrawCalls = frame.m_DrawCalls;
+		m_LastStateStats = frame.m_StateStats;
+		m_LastTextureStats = frame.m_TextureStats;
+	}
 
 	static float scale = 0.0f;
 
 	scale += 0.003f;
 
-	Matrix World, World2, World3;
-	
-//	World.M[0][0] = 1.0f;		  World.M[0][1] = 0.0f;		    World.M[0][2] = 0.0f;		 World.M[0][3] = 0.0f;
-//	World.M[1][0] = 0.0f;		  World.M[1][1] =cosf(scale);   World.M[1][2] =sinf(scale) ; World.M[1][3] = 0.0f;
-//	World.M[2][0] = 0.0f;		  World.M[2][1] = -sinf(scale); World.M[2][2] = cosf(scale); World.M[2][3] = 0.0f;
-//	World.M[3][0] = 0.0f;		  World.M[3][1] = 0.0f;		    World.M[3][2] = 0.0f;		 World.M[3][3] = 2.0f;
-
+	/* the rotating cube in the middle */
+	Matrix World2;
 	World2.M[0][0] = cosf(scale);  World2.M[0][1] = 0.0f; World2.M[0][2] = -sinf(scale); World2.M[0][3] = 0.0f;
 	World2.M[1][0] = 0.0f;	       World2.M[1][1] = 1.0f; World2.M[1][2] = 0.0f;		 World2.M[1][3] = 0.0f;
 	World2.M[2][0] = sinf(scale);  World2.M[2][1] = 0.0f; World2.M[2][2] = cosf(scale);  World2.M[2][3] = 0.0f;
 	World2.M[3][0] = 0.0f;		   World2.M[3][1] = 0.0f; World2.M[3][2] = 0.0f;		 World2.M[3][3] = 2.0f;
 
-//	World3.M[0][0] = cosf(scale);  World3.M[0][1] = sinf(scale);  World3.M[0][2] = 0.0f;  World3.M[0][3] = 0.0f;
-//	World3.M[1][0] = -sinf(scale);  World3.M[1][1] = cosf(scale); World3.M[1][2] = 0.0f;  World3.M[1][3] = 0.0f;
-//	World3.M[2][0] = 0.0f;		   World3.M[2][1] = 0.0f;		  World3.M[2][2] = 1.0f;  World3.M[2][3] = 0.0f;
-//	World3.M[3][0] = 0.0f;		   World3.M[3][1] = 0.0f;		  World3.M[3][2] = 0.0f;  World3.M[3][3] = 2.0f;
+	m_Camera->Update(m_Timer.DeltaTime());
 
-	World.M[0][0] = 1.0f;		  World.M[0][1] = 0.0f;		    World.M[0][2] = 0.0f;		 World.M[0][3] = 0.0f;
-	World.M[1][0] = 0.0f;		  World.M[1][1] = 1.0f;         World.M[1][2] = 0.0f;        World.M[1][3] = 0.0f;
-	World.M[2][0] = 0.0f;		  World.M[2][1] = 0.0f;		    World.M[2][2] = 1.0f;	     World.M[2][3] = 0.0f;
-	World.M[3][0] = 1.0f;		  World.M[3][1] = 0.0f;		    World.M[3][2] = 2.0f*sinf(scale);		 World.M[3][3] = 4.0f;
+	/* gather the draws of this frame, they're executed sorted by state and depth */
+	SetRenderQueue(&frame.m_Queue);
+	RenderQueue* queue = GetRenderQueue();
+	queue->Clear();
 
-	m_Camera->Update(m_Timer.DeltaTime());
-	World2*= m_Camera->GetViewProj();
+	/* only what the camera can see is recorded */
+	m_Visibility.Update(m_CubeHandle, Box(Vector(-1.0f, -1.0f, -1.0f), Vector(1.0f, 1.0f, 1.0f)).TransformBy(World2));
 
-	GLuint gWorldLocaltion = glGetUniformLocation(ShaderManager::getInstancePtr()->GetCurrentProg(), "gWorld");
-	glUniformMatrix4fv(gWorldLocaltion, 1, GL_TRUE, &World2.M[0][0]);
-	
-	/*Render here*/
-	glEnableVertexAttribArray(0);
-	glEnableVertexAttribArray(1);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), 0);
-	glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Vertex), (const GLvoid*)12);
+	/* objects hidden behind the occluders are dropped after the frustum test */
+	m_Occlusion.BeginFrame(m_Camera->GetViewProj(), m_Camera->GetNear());
+	for (const auto& occluderWorld : m_OccluderWorlds)
+	{
+		m_Occlusion.AddOccluder(&m_OccluderPositions[0], (uint32)m_OccluderPositions.size(),
+			&m_OccluderIndices[0], (uint32)m_OccluderIndices.size(), occluderWorld);
+	}
+	m_Occlusion.Rasterize();
 
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
+	Plane frustum[6];
+	m_Camera->GetFrustumPlanes(frustum);
+	m_Visibility.Cull(frustum);
 
-	glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
-	
-	glDisableVertexAttribArray(0);
-	glDisableVertexAttribArray(1);
+	RenderDrawCall cube;
+	cube.m_Program = m_MeshProgram;
+	cube.m_ShaderSort = m_MeshSort;
+	cube.m_Material = 0;
+	cube.m_VertexArray = m_PoolVAO;
+	cube.m_IndexCount = m_CubeMesh.m_IndexCount;
+	cube.m_FirstIndex = m_CubeMesh.m_FirstIndex;
+	cube.m_BaseVertex = m_CubeMesh.m_BaseVertex;
+	cube.m_World = World2;
+
+	/* a field of small cubes and pyramids below, one instanced batch per mesh, both
+	   batches share the pooled buffers and go out in a single multi draw */
+	RenderDrawCall smallCube;
+	smallCube.m_Program = m_InstancedProgram;
+	smallCube.m_ShaderSort = m_InstancedSort;
+	smallCube.m_VertexArray = m_PoolInstancedVAO;
+	smallCube.m_IndexCount = m_CubeMesh.m_IndexCount;
+	smallCube.m_FirstIndex = m_CubeMesh.m_FirstIndex;
+	smallCube.m_BaseVertex = m_CubeMesh.m_BaseVertex;
+
+	RenderDrawCall smallPyramid = smallCube;
+	smallPyramid.m_IndexCount = m_PyramidMesh.m_IndexCount;
+	smallPyramid.m_FirstIndex = m_PyramidMesh.m_FirstIndex;
+	smallPyramid.m_BaseVertex = m_PyramidMesh.m_BaseVertex;
+
+	/* spheres pick a level of detail from their size on screen, each level is its own batch */
+	RenderDrawCall sphereLods[LodChain::MaxLevels];
+	for (uint32 level = 0; level < m_SphereChain.m_LevelCount; ++level)
+	{
+		sphereLods[level] = smallCube;
+		sphereLods[level].m_IndexCount = m_SphereLods[level].m_IndexCount;
+		sphereLods[level].m_FirstIndex = m_SphereLods[level].m_FirstIndex;
+		sphereLods[level].m_BaseVertex = m_SphereLods[level].m_BaseVertex;
+	}
+	m_LodSelector.BeginFrame(*m_Camera, m_Timer.DeltaTime(), m_Timer.DeltaTime() * 1000.0f);
+
+	/* the cooked mesh, one draw per submesh */
+	std::vector<RenderDrawCall> importedDraws(m_ImportedMesh.m_SubMeshes.size(), smallCube);
+	for (size_t i = 0; i < importedDraws.size(); ++i)
+	{
+		const MeshFileSubMesh& subMesh = m_ImportedMesh.m_SubMeshes[i];
+		importedDraws[i].m_VertexArray = m_MeshInstancedVAO;
+		importedDraws[i].m_Material = m_ImportedTexture;
+		importedDraws[i].m_IndexSize = m_MeshPool.GetIndexSize();
+		importedDraws[i].m_IndexCount = subMesh.m_IndexCount;
+		importedDraws[i].m_FirstIndex = m_ImportedMesh.m_Allocation.m_FirstIndex + subMesh.m_FirstIndex;
+		importedDraws[i].m_BaseVertex = m_ImportedMesh.m_Allocation.m_BaseVertex + subMesh.m_BaseVertex;
+	}
+
+	/* recorded in parallel, every job thread fills its own arena which Sort merges */
+	const std::vector<uint32>& visible = m_Visibility.GetVisible();
+	const Vector cameraPosition = m_Camera->GetPosition();
+	const float invFar = 1.0f / m_Camera->GetFar();
+
+	auto recordVisible = [&](uint32 begin, uint32 end, uint32 thread)
+	{
+		RenderQueue& threadQueue = queue->GetThreadQueue(thread);
+		for (uint32 i = begin; i < end; ++i)
+		{
+			if (visible[i] == MainCubeObject)
+			{
+				float depth = (World2.GetOrigin() - cameraPosition).Size() * invFar;
+				threadQueue.Submit(cube, RL_World, false, depth);
+				continue;
+			}
+
+			SceneObject& object = m_SceneObjects[visible[i]];
+			float instanceDepth = (object.m_Origin - cameraPosition).Size() * invFar;
+			if (object.m_Mesh == DM_Imported)
+			{
+				InstanceData instance = object.m_Instance;
+				for (const auto& draw : importedDraws)
+				{
+					instance.m_Params.Z = (float)draw.m_Material;
+					threadQueue.SubmitInstance(draw, instance, RL_World, instanceDepth);
+				}
+				continue;
+			}
+
+			if (object.m_Mesh != DM_Sphere)
+			{
+				//textures sharing an atlas or pool resolve to the same bindings, the draws still batch
+				RenderDrawCall draw = object.m_Mesh == DM_Pyramid ? smallPyramid : smallCube;
+				draw.m_Material = object.m_Material;
+				threadQueue.SubmitInstance(draw, object.m_Instance, RL_World, instanceDepth);
+				continue;
+			}
+
+			const uint32 level = m_LodSelector.Select(m_SphereChain, object.m_Origin, object.m_Radius, object.m_Lod);
+			RenderDrawCall sphere = sphereLods[level];
+			sphere.m_Material = object.m_Material;
+			if (!object.m_Lod.IsFading())
+			{
+				threadQueue.SubmitInstance(sphere, object.m_Instance, RL_World, instanceDepth);
+				continue;
+			}
+
+			//both levels during a cross-fade, dithered so each pixel comes from one of them; z keeps the texture handle
+			InstanceData fading = object.m_Instance;
+			fading.m_Params.X = object.m_Lod.m_Fade;
+			fading.m_Params.Y = 1.0f;
+			threadQueue.SubmitInstance(sphere, fading, RL_World, instanceDepth);
+			RenderDrawCall fadingFrom = sphereLods[object.m_Lod.m_FadeFrom];
+			fadingFrom.m_Material = object.m_Material;
+			fading.m_Params.Y = -1.0f;
+			threadQueue.SubmitInstance(fadingFrom, fading, RL_World, instanceDepth);
+		}
+	};
+	JobSystem::getInstancePtr()->ParallelFor((uint32)visible.size(), 0, recordVisible);
+
+	/* every material streams in as much detail as its largest visible instance shows, the uvs of
+	   every demo mesh span their texture once; atlas regions are scaled up to the atlas by Update */
+	std::map<TextureHandle, float> texturePixels;
+	for (uint32 index : visible)
+	{
+		if (index == MainCubeObject)
+			continue;
+
+		const SceneObject& object = m_SceneObjects[index];
+		const float screenSize = Math::Min(m_LodSelector.GetScreenSize(object.m_Origin, object.m_Radius), 1.0f);
+		float& pixels = texturePixels[object.m_Material];
+		pixels = Math::Max(pixels, screenSize * (float)m_Height);
+	}
+	for (const auto& request : texturePixels)
+	{
+		m_Textures.Request(request.first, request.second);
+	}
+
+	queue->Sort();
+
+	/* record the frame, nothing in it touches gl until the render thread replays it */
+	RenderCommandBuffer& commands = frame.m_Commands;
+	commands.Reset();
+
+	ClearCommand clear;
+	clear.m_Flags = RCF_Color | RCF_Depth;
+	clear.m_Color = Vector4(0.0f, 0.0f, 0.0f, 0.0f);
+	clear.m_Depth = 0.0f;
+	commands.Push(clear);
+
+	SetViewCommand view;
+	view.m_View = m_Camera->GetView();
+	view.m_Proj = m_Camera->GetProj();
+	view.m_ViewProj = m_Camera->GetViewProj();
+	view.m_Time = Vector4(m_Timer.TotalTime(), m_Timer.DeltaTime(), 0.0f, 0.0f);
+	commands.Push(view);
+
+	DrawQueueCommand draw;
+	draw.m_Queue = queue;
+	commands.Push(draw);
+
+	{
+		std::lock_guard<std::mutex> lock(m_FrameMutex);
+		frame.m_bRecorded = true;
+	}
+	m_FrameCondition.notify_all();
+	m_RecordIndex = (m_RecordIndex + 1) % FrameSlots;
+}
+
+void OpenGLRenderSystem::RenderThreadMain()
+{
+	glfwMakeContextCurrent(m_Window);
+
+	int index = 0;
+	for (;;)
+	{
+		RenderFrame& frame = m_Frames[index];
+		{
+			std::unique_lock<std::mutex> lock(m_FrameMutex);
+			m_FrameCondition.wait(lock, [this, &frame]() { return frame.m_bRecorded || m_bRenderThreadQuit; });
+			//frames already recorded are still executed before quitting
+			if (!frame.m_bRecorded)
+				break;
+		}
+
+		ExecuteFrame(frame);
+
+		{
+			std::lock_guard<std::mutex> lock(m_FrameMutex);
+			frame.m_bRecorded = false;
+		}
+		m_FrameCondition.notify_all();
+		index = (index + 1) % FrameSlots;
+	}
+
+	glfwMakeContextCurrent(NULL);
+}
+
+void OpenGLRenderSystem::ExecuteFrame(RenderFrame& frame)
+{
+	m_DrawCalls = 0;
+	//finished decodes become textures before anything samples them
+	m_Textures.Update();
+	//and finished links replace their fallbacks
+	m_ShaderManager->Update();
+	frame.m_TextureStats = m_Textures.GetStats();
+	m_UniformRing.BeginFrame();
+	m_InstanceStream.BeginFrame();
+	m_IndirectStream.BeginFrame();
+
+	uint32 cursor = 0;
+	RenderCommandHeader header;
+	const uint8* payload = nullptr;
+	while (frame.m_Commands.Next(cursor, header, payload))
+	{
+		switch (header.m_Type)
+		{
+		case RCT_Clear:
+		{
+			ClearCommand clear;
+			RenderCommandBuffer::GetPayload(payload, clear);
+			GLbitfield mask = 0;
+			if (clear.m_Flags & RCF_Color)
+			{
+				glClearColor(clear.m_Color.X, clear.m_Color.Y, clear.m_Color.Z, clear.m_Color.W);
+				mask |= GL_COLOR_BUFFER_BIT;
+			}
+			if (clear.m_Flags & RCF_Depth)
+			{
+				m_StateCache->SetDepthMask(true);
+				glClearDepth(clear.m_Depth);
+				mask |= GL_DEPTH_BUFFER_BIT;
+			}
+			glClear(mask);
+			break;
+		}
+		case RCT_SetView:
+		{
+			SetViewCommand view;
+			RenderCommandBuffer::GetPayload(payload, view);
+			m_FrameConstants.m_View = view.m_View;
+			m_FrameConstants.m_Proj = view.m_Proj;
+			m_FrameConstants.m_ViewProj = view.m_ViewProj;
+			m_FrameConstants.m_Time = view.m_Time;
+			break;
+		}
+		case RCT_DrawQueue:
+		{
+			DrawQueueCommand draw;
+			RenderCommandBuffer::GetPayload(payload, draw);
+			ExecuteRenderQueue(*draw.m_Queue);
+			break;
+		}
+		default:
+			DEBUG_MESSAGE(RAY_ERROR, "unknown render command %d", header.m_Type);
+			break;
+		}
+	}
+
+	m_UniformRing.EndFrame();
+	m_InstanceStream.EndFrame();
+	m_IndirectStream.EndFrame();
+
+	frame.m_DrawCalls = m_DrawCalls;
+	m_StateCache->EndFrame();
+	frame.m_StateStats = m_StateCache->GetLastFrameStats();
 
 	/* Swap front and back buffers*/
 	glfwSwapBuffers(m_Window);
+}
+
+void OpenGLRenderSystem::ExecuteRenderQueue(const RenderQueue& queue)
+{
+	uint32 count = queue.GetPacketCount();
+
+	/* per-frame and per-object constants go through the uniform ring */
+	GLintptr frameOffset = 0;
+	PerFrameConstants* frameConstants = m_UniformRing.Allocate<PerFrameConstants>(frameOffset);
+	if (frameConstants == nullptr)
+		return;
+	*frameConstants = m_FrameConstants;
+
+	/* where each texture handle samples, read by the instanced programs through the handle in the instance */
+	GLintptr slotOffset = 0;
+	TextureSlotConstants* slots = m_UniformRing.Allocate<TextureSlotConstants>(slotOffset);
+	if (slots == nullptr)
+		return;
+	const uint32 slotCount = Math::Min(m_Textures.GetHandleCount(), MaxTextureSlots);
+	for (uint32 handle = 0; handle < MaxTextureSlots; ++handle)
+	{
+		float layer = -1.0f;
+		Vector4 uvRect(1.0f, 1.0f, 0.0f, 0.0f);
+		if (handle < slotCount)
+		{
+			m_Textures.GetSlot(handle, uvRect, layer);
+		}
+		slots->m_Slots[handle * 2] = uvRect;
+		slots->m_Slots[handle * 2 + 1] = Vector4(layer, 0.0f, 0.0f, 0.0f);
+	}
+
+	const bool instancesReady = UploadInstances(queue);
+	const GLuint instanceBase = (GLuint)(m_InstanceOffset / sizeof(InstanceData));
+
+	/* instanced packets become indirect commands in packet order, regular ones get their constants */
+	m_IndirectCommands.clear();
+	m_ObjectOffsets.resize(count);
+	for (uint32 i = 0; i < count; ++i)
+	{
+		const RenderDrawCall& draw = queue.GetDrawCall(queue.GetPacket(i));
+		if (draw.m_InstanceCount > 0)
+		{
+			DrawElementsIndirectCommand command;
+			command.m_Count = draw.m_IndexCount;
+			command.m_InstanceCount = draw.m_InstanceCount;
+			command.m_FirstIndex = draw.m_FirstIndex;
+			command.m_BaseVertex = draw.m_BaseVertex;
+			command.m_BaseInstance = instanceBase + draw.m_FirstInstance;
+			m_IndirectCommands.push_back(command);
+			continue;
+		}
+
+		PerObjectConstants* objectConstants = m_UniformRing.Allocate<PerObjectConstants>(m_ObjectOffsets[i]);
+		if (objectConstants == nullptr)
+		{
+			//ring exhausted, the remaining packets are dropped this frame
+			count = i;
+			break;
+		}
+		objectConstants->m_World = draw.m_World;
+	}
+
+	const bool indirectReady = UploadIndirectCommands();
+	m_UniformRing.Flush();
+	m_UniformRing.Bind(UBB_PerFrame, frameOffset, sizeof(PerFrameConstants));
+	m_UniformRing.Bind(UBB_TextureSlots, slotOffset, sizeof(TextureSlotConstants));
+
+	uint32 command = 0;
+
+	for (uint32 i = 0; i < count; ++i)
+	{
+		const RenderPacket& packet = queue.GetPacket(i);
+		const RenderDrawCall& draw = queue.GetDrawCall(packet);
+
+		bool translucent = RenderSortKey::IsTranslucent(packet.m_SortKey);
+		m_StateCache->SetBlend(translucent);
+		m_StateCache->SetDepthMask(!translucent);
+
+		//programs still compiling draw with their fallback, or not at all
+		const GLuint program = m_ShaderManager->GetDrawProgram(draw.m_Program);
+		if (program == 0 && draw.m_InstanceCount == 0)
+			continue;
+
+		m_StateCache->UseProgram(program);
+		m_StateCache->BindVertexArray(draw.m_VertexArray);
+		const GLuint texture = m_Textures.GetTexture(draw.m_Material);
+		const GLuint textureArray = m_Textures.GetArray(draw.m_Material);
+		m_StateCache->BindTexture(0, GL_TEXTURE_2D, texture);
+		if (textureArray != 0)
+		{
+			m_StateCache->BindTexture(1, GL_TEXTURE_2D_ARRAY, textureArray);
+		}
+		++m_DrawCalls;
+
+		const GLenum indexType = draw.m_IndexSize == sizeof(uint16) ? GL_UNSIGNED_SHORT : GL_UNSIGNED_INT;
+		if (draw.m_InstanceCount == 0)
+		{
+			const GLvoid* indexOffset = (const GLvoid*)((uintptr_t)draw.m_FirstIndex * draw.m_IndexSize);
+			m_UniformRing.Bind(UBB_PerObject, m_ObjectOffsets[i], sizeof(PerObjectConstants));
+			glDrawElementsBaseVertex(GL_TRIANGLES, draw.m_IndexCount, indexType, indexOffset, draw.m_BaseVertex);
+			continue;
+		}
+
+		//following instanced packets with the same program, vertex array, textures and blending join this draw,
+		//materials differing only in their atlas region or array layer included
+		uint32 last = i;
+		while (last + 1 < count)
+		{
+			const RenderPacket& next = queue.GetPacket(last + 1);
+			const RenderDrawCall& nextDraw = queue.GetDrawCall(next);
+			if (nextDraw.m_InstanceCount == 0 || nextDraw.m_Program != draw.m_Program || nextDraw.m_VertexArray != draw.m_VertexArray
+				|| RenderSortKey::IsTranslucent(next.m_SortKey) != translucent)
+				break;
+			if (nextDraw.m_Material != draw.m_Material && (m_Textures.GetTexture(nextDraw.m_Material) != texture ||
+				m_Textures.GetArray(nextDraw.m_Material) != textureArray))
+				break;
+			++last;
+		}
+		const uint32 commandCount = last - i + 1;
 
-	/* Poll for and process events */
-	glfwPollEvents();
+		if (!instancesReady || program == 0)
+		{
+			//instance stream exhausted or no program yet, nothing to draw these with
+			--m_DrawCalls;
+		}
+		else if (indirectReady)
+		{
+			GLintptr indirectOffset = m_IndirectOffset + command * sizeof(DrawElementsIndirectCommand);
+			m_StateCache->BindBuffer(GL_DRAW_INDIRECT_BUFFER, m_IndirectStream.GetBuffer());
+			glMultiDrawElementsIndirect(GL_TRIANGLES, indexType, (const GLvoid*)indirectOffset,
+				commandCount, sizeof(DrawElementsIndirectCommand));
+		}
+		else
+		{
+			for (uint32 c = command; c < command + commandCount; ++c)
+			{
+				const DrawElementsIndirectCommand& cmd = m_IndirectCommands[c];
+				const GLvoid* indexOffset = (const GLvoid*)((uintptr_t)cmd.m_FirstIndex * draw.m_IndexSize);
+				if (GLEW_ARB_base_instance)
+				{
+					glDrawElementsInstancedBaseVertexBaseInstance(GL_TRIANGLES, cmd.m_Count, indexType, indexOffset,
+						cmd.m_InstanceCount, cmd.m_BaseVertex, cmd.m_BaseInstance);
+				}
+				else
+				{
+					//no base instance, point the instance stream at the batch instead
+					m_StateCache->BindBuffer(GL_ARRAY_BUFFER, m_InstanceStream.GetBuffer());
+					GetInstanceLayout().Apply(cmd.m_BaseInstance * sizeof(InstanceData));
+					glDrawElementsInstancedBaseVertex(GL_TRIANGLES, cmd.m_Count, indexType, indexOffset,
+						cmd.m_InstanceCount, cmd.m_BaseVertex);
+				}
+			}
+			m_DrawCalls += commandCount - 1;
+		}
+
+		command += commandCount;
+		i = last;
+	}
+}
+
+bool OpenGLRenderSystem::UploadInstances(const RenderQueue& queue)
+{
+	const uint32 count = queue.GetInstanceCount();
+	if (count == 0)
+		return true;
+
+	//offsets are multiples of the instance size, so they map to a base instance
+	InstanceData* instances = m_InstanceStream.Allocate<InstanceData>(m_InstanceOffset, count);
+	if (instances == nullptr)
+		return false;
+
+	memcpy(instances, queue.GetInstances(), count * sizeof(InstanceData));
+	m_InstanceStream.Flush();
+	return true;
+}
+
+bool OpenGLRenderSystem::UploadIndirectCommands()
+{
+	const uint32 count = (uint32)m_IndirectCommands.size();
+	if (count == 0 || !GLEW_ARB_multi_draw_indirect)
+		return false;
+
+	DrawElementsIndirectCommand* commands = m_IndirectStream.Allocate<DrawElementsIndirectCommand>(m_IndirectOffset, count);
+	if (commands == nullptr)
+		return false;
+
+	memcpy(commands, &m_IndirectCommands[0], count * sizeof(DrawElementsIndirectCommand));
+	m_IndirectStream.Flush();
+	return true;
 }
 
 void OpenGLRenderSystem::StartRendering()
 {
-	SetupVertexBuffer();
-	SetupIndexBuffer();
+	SetupGeometry();
+	SetupStreamBuffers();
 	SetupShaders();
 	SetupTexure();
 	SetupLights();
+	SetupScene();
+
+	GLuint poolVBO = m_GeometryPool.GetVertexBuffer();
+	GLuint poolIBO = m_GeometryPool.GetIndexBuffer();
+	m_PoolVAO = m_VertexArrays.GetVertexArray(m_GeometryPool.GetLayout(), poolVBO, poolIBO);
+	m_PoolInstancedVAO = m_VertexArrays.GetVertexArray(m_GeometryPool.GetLayout(), poolVBO, poolIBO, &GetInstanceLayout(), m_InstanceStream.GetBuffer());
+	if (m_ImportedMesh.m_Allocation.IsValid())
+	{
+		m_MeshInstancedVAO = m_VertexArrays.GetVertexArray(m_MeshPool.GetLayout(), m_MeshPool.GetVertexBuffer(), m_MeshPool.GetIndexBuffer(),
+			&GetInstanceLayout(), m_InstanceStream.GetBuffer());
+	}
 
 	m_Camera = new Camera();
 	m_Camera->SetProjParameters(m_Width*1.0f / m_Height, 45, 1, 1000);
@@ -187,14 +762,31 @@ void OpenGLRenderSystem::StartRendering()
 	m_Camera->SetController(controller);
 
 	m_Timer.Reset();
-	glCullFace(GL_BACK);
-	glEnable(GL_CULL_FACE);
+	m_StateCache->SetCullFace(GL_BACK);
+	m_StateCache->SetCull(true);
+	m_StateCache->SetDepthTest(true);
+	//PerspectiveProjectMatrix puts the near plane at depth 1 and the far plane at 0
+	m_StateCache->SetDepthFunc(GL_GREATER);
+	m_StateCache->SetBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	for (int i = 0; i < FrameSlots; ++i)
+	{
+		m_Frames[i].m_Queue.SetThreadCount(JobSystem::getInstancePtr()->GetThreadCount());
+	}
+
+	/* from here on the context belongs to the render thread, this one only records frames */
+	glfwMakeContextCurrent(NULL);
+	m_bRenderThreadQuit = false;
+	m_RenderThread = std::thread(&OpenGLRenderSystem::RenderThreadMain, this);
 
 	/*Loop until the user closes the window*/
 	while (!glfwWindowShouldClose(m_Window))
 	{
 		m_Timer.Tick();
 
+		/* Poll for and process events, glfw wants this on the main thread */
+		glfwPollEvents();
+
 		if (!m_SysPaused)
 		{
 			CalculateFrameStats();
@@ -205,11 +797,24 @@ void OpenGLRenderSystem::StartRendering()
 			;
 		}
 	}
+
+	StopRendering();
 }
 
 void OpenGLRenderSystem::StopRendering()
 {
+	if (!m_RenderThread.joinable())
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_FrameMutex);
+		m_bRenderThreadQuit = true;
+	}
+	m_FrameCondition.notify_all();
+	m_RenderThread.join();
 
+	//take the context back for the cleanup
+	glfwMakeContextCurrent(m_Window);
 }
 
 void OpenGLRenderSystem::CalculateFrameStats()
@@ -229,7 +834,36 @@ void OpenGLRenderSystem::CalculateFrameStats()
 		float fps = (float)frameCnt; // fps = frameCnt / 1
 		float mspf = 1000.0f / fps;
 
-		printf("FPS %.2f\n", fps);
+		const StateCacheStats& stats = m_LastStateStats;
+		printf("FPS %.2f, draw calls %u, GL state calls issued %u, filtered %u\n", fps, m_LastDrawCalls, stats.m_Issued, stats.m_Filtered);
+
+		/* recording of the last frame and job thread load over the last second */
+		JobSystem* jobs = JobSystem::getInstancePtr();
+		const RenderQueue& recorded = m_Frames[(m_RecordIndex + FrameSlots - 1) % FrameSlots].m_Queue;
+		for (uint32 i = 0; i < recorded.GetThreadCount() && i < jobs->GetThreadCount(); ++i)
+		{
+			const RenderRecordStats& record = recorded.GetThreadStats(i);
+			const JobThreadStats& load = jobs->GetThreadStats(i);
+			printf("  thread %u: recorded %u draws, %u instances, %u ranges, %.2f ms busy\n", i, record.m_Draws,
+				record.m_Instances, load.m_Ranges, load.m_BusyMilliseconds);
+		}
+		printf("  background jobs: %.2f ms\n", jobs->GetBackgroundMilliseconds());
+		jobs->ResetStats();
+
+		const VisibilityStats& visibility = m_Visibility.GetStats();
+		printf("  visibility: %u of %u visible, %u culled, %.3f ms\n", visibility.m_Visible, visibility.m_Total,
+			visibility.m_Culled, visibility.m_Milliseconds);
+
+		printf("  lod bias %.2f\n", m_LodSelector.GetBias());
+
+		const TextureStreamingStats& textures = m_LastTextureStats;
+		printf("  textures: %u resident, %u KB of %u KB budget, %u KB wanted, %u levels over budget, %u uploading, %u evictions\n",
+			textures.m_Textures, (uint32)(textures.m_ResidentBytes / 1024), (uint32)(textures.m_BudgetBytes / 1024),
+			(uint32)(textures.m_WantedBytes / 1024), textures.m_LevelsOverBudget, textures.m_Uploading, textures.m_Evictions);
+
+		const OcclusionStats& occlusion = m_Occlusion.GetStats();
+		printf("  occlusion: %u occluded, %u occluder triangles, %u skipped, %.3f ms\n", visibility.m_Occluded,
+			occlusion.m_Triangles, occlusion.m_Skipped, occlusion.m_Milliseconds);
 	
 		// Reset for next average.
 		frameCnt = 0;
@@ -237,27 +871,23 @@ void OpenGLRenderSystem::CalculateFrameStats()
 	}
 }
 
-void OpenGLRenderSystem::SetupVertexBuffer()
+void OpenGLRenderSystem::SetupGeometry()
 {
-	/*Vertex Buffer*/
-	Vertex Vertices[8];
-	Vertices[0] = { Vector(-1.0f, -1.0f, -1.0f), Vector4(1.0f, 1.0f, 1.0f, 1.0f) };
-	Vertices[1] = { Vector(-1.0f, 1.0f, -1.0f), Vector4(0.0f, 0.0f, 0.0f, 1.0f) };
-	Vertices[2] = { Vector(1.0f, 1.0f, -1.0f), Vector4(1.0f, 0.0f, 0.0f, 1.0f) };
-	Vertices[3] = { Vector(1.0f, -1.0f, -1.0f), Vector4(0.0f, 1.0f, 0.0f, 1.0f) };
-	Vertices[4] = { Vector(-1.0f, -1.0f, 1.0f), Vector4(0.0f, 0.0f, 1.0f, 1.0f) };
-	Vertices[5] = { Vector(-1.0f, 1.0f, 1.0f), Vector4(1.0f, 1.0f, 0.0f, 1.0f) };
-	Vertices[6] = { Vector(1.0f, 1.0f, 1.0f), Vector4(0.0f, 1.0f, 1.0f, 1.0f) };
-	Vertices[7] = { Vector(1.0f, -1.0f, 1.0f), Vector4(1.0f, 0.0f, 1.0f, 1.0f) };
-
-	glGenBuffers(1, &VBO);
-	glBindBuffer(GL_ARRAY_BUFFER, VBO);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(Vertices), Vertices, GL_STATIC_DRAW);
-}
+	/* every mesh is sub allocated from the one pool, so they all share a vertex array */
+	m_GeometryPool.Init(Vertex::GetLayout(), 64 * 1024, 256 * 1024);
 
+	/*Cube*/
+	const Vector Corners[8] = {
+		Vector(-1.0f, -1.0f, -1.0f), Vector(-1.0f, 1.0f, -1.0f), Vector(1.0f, 1.0f, -1.0f), Vector(1.0f, -1.0f, -1.0f),
+		Vector(-1.0f, -1.0f, 1.0f), Vector(-1.0f, 1.0f, 1.0f), Vector(1.0f, 1.0f, 1.0f), Vector(1.0f, -1.0f, 1.0f)
+	};
+	const uint32 CornerColors[8] = {
+		PackUnorm8x4(Vector4(1.0f, 1.0f, 1.0f, 1.0f)), PackUnorm8x4(Vector4(0.0f, 0.0f, 0.0f, 1.0f)),
+		PackUnorm8x4(Vector4(1.0f, 0.0f, 0.0f, 1.0f)), PackUnorm8x4(Vector4(0.0f, 1.0f, 0.0f, 1.0f)),
+		PackUnorm8x4(Vector4(0.0f, 0.0f, 1.0f, 1.0f)), PackUnorm8x4(Vector4(1.0f, 1.0f, 0.0f, 1.0f)),
+		PackUnorm8x4(Vector4(0.0f, 1.0f, 1.0f, 1.0f)), PackUnorm8x4(Vector4(1.0f, 0.0f, 1.0f, 1.0f))
+	};
 
-void OpenGLRenderSystem::SetupIndexBuffer()
-{
 	uint32 Indices[] = {
 		//back face
 		0, 1, 2,
@@ -279,15 +909,285 @@ void OpenGLRenderSystem::SetupIndexBuffer()
 		4, 3, 7
 	};
 
-	glGenBuffers(1, &IBO);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, IBO);
-	glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Indices), Indices, GL_STATIC_DRAW);
+	/* every face gets its own 4 vertices so the texture spans each one, the occluder keeps the 8 corners */
+	Vertex Vertices[24];
+	uint32 VertexCorners[24];
+	uint32 FaceIndices[36];
+	uint32 vertexCount = 0;
+	for (uint32 face = 0; face < 6; ++face)
+	{
+		//the axis a face is perpendicular to is the one all its corners agree on, uvs come from the other two
+		const Vector& a = Corners[Indices[face * 6]];
+		const Vector& b = Corners[Indices[face * 6 + 1]];
+		const Vector& c = Corners[Indices[face * 6 + 2]];
+		const int axis = (a.X == b.X && a.X == c.X) ? 0 : (a.Y == b.Y && a.Y == c.Y) ? 1 : 2;
+
+		const uint32 firstVertex = vertexCount;
+		for (uint32 i = face * 6; i < face * 6 + 6; ++i)
+		{
+			uint32 vertex = firstVertex;
+			while (vertex < vertexCount && VertexCorners[vertex] != Indices[i])
+			{
+				++vertex;
+			}
+			if (vertex == vertexCount)
+			{
+				const Vector& p = Corners[Indices[i]];
+				const float u = axis == 0 ? p.Z : p.X;
+				const float v = axis == 1 ? p.Z : p.Y;
+				Vertex corner = { p, CornerColors[Indices[i]], { u * 0.5f + 0.5f, v * 0.5f + 0.5f } };
+				Vertices[vertexCount] = corner;
+				VertexCorners[vertexCount++] = Indices[i];
+			}
+			FaceIndices[i] = vertex;
+		}
+	}
+
+	m_CubeMesh = m_GeometryPool.Allocate(24, 36);
+	m_GeometryPool.Upload(m_CubeMesh, Vertices, FaceIndices);
+
+	m_OccluderPositions.assign(Corners, Corners + 8);
+	m_OccluderIndices.assign(Indices, Indices + 36);
+
+	/*Pyramid*/
+	Vertex PyramidVertices[5];
+	//uvs projected from above, the apex sits in the middle of the texture
+	PyramidVertices[0] = { Vector(-1.0f, -1.0f, -1.0f), PackUnorm8x4(Vector4(1.0f, 0.0f, 0.0f, 1.0f)), { 0.0f, 0.0f } };
+	PyramidVertices[1] = { Vector(1.0f, -1.0f, -1.0f), PackUnorm8x4(Vector4(0.0f, 1.0f, 0.0f, 1.0f)), { 1.0f, 0.0f } };
+	PyramidVertices[2] = { Vector(1.0f, -1.0f, 1.0f), PackUnorm8x4(Vector4(0.0f, 0.0f, 1.0f, 1.0f)), { 1.0f, 1.0f } };
+	PyramidVertices[3] = { Vector(-1.0f, -1.0f, 1.0f), PackUnorm8x4(Vector4(1.0f, 1.0f, 0.0f, 1.0f)), { 0.0f, 1.0f } };
+	PyramidVertices[4] = { Vector(0.0f, 1.0f, 0.0f), PackUnorm8x4(Vector4(1.0f, 1.0f, 1.0f, 1.0f)), { 0.5f, 0.5f } };
+
+	uint32 PyramidIndices[] = {
+		//sides
+		3, 2, 4,
+		2, 1, 4,
+		1, 0, 4,
+		0, 3, 4,
+		//bottom face
+		0, 1, 2,
+		0, 2, 3
+	};
+
+	m_PyramidMesh = m_GeometryPool.Allocate(5, 18);
+	m_GeometryPool.Upload(m_PyramidMesh, PyramidVertices, PyramidIndices);
+
+	/*Sphere, each level has half the rings and segments of the one before*/
+	const uint32 sphereRings[] = { 16, 8, 4 };
+	const float sphereScreenSize[] = { 0.08f, 0.03f, 0.0f };
+	m_SphereChain.m_LevelCount = 3;
+	for (uint32 level = 0; level < m_SphereChain.m_LevelCount; ++level)
+	{
+		const uint32 rings = sphereRings[level];
+		const uint32 segments = rings * 2;
+
+		std::vector<Vertex> sphereVertices;
+		for (uint32 ring = 0; ring <= rings; ++ring)
+		{
+			const float theta = PI * ring / rings;
+			for (uint32 segment = 0; segment <= segments; ++segment)
+			{
+				const float phi = 2.0f * PI * segment / segments;
+				Vector position(Math::Sin(theta) * Math::Cos(phi), Math::Cos(theta), Math::Sin(theta) * Math::Sin(phi));
+				Vertex vertex = { position, PackUnorm8x4(Vector4(position.X * 0.5f + 0.5f, position.Y * 0.5f + 0.5f, position.Z * 0.5f + 0.5f, 1.0f)),
+					{ (float)segment / segments, (float)ring / rings } };
+				sphereVertices.push_back(vertex);
+			}
+		}
+
+		std::vector<uint32> sphereIndices;
+		for (uint32 ring = 0; ring < rings; ++ring)
+		{
+			for (uint32 segment = 0; segment < segments; ++segment)
+			{
+				const uint32 i0 = ring * (segments + 1) + segment;
+				const uint32 i1 = i0 + segments + 1;
+				sphereIndices.push_back(i0);
+				sphereIndices.push_back(i0 + 1);
+				sphereIndices.push_back(i1);
+				sphereIndices.push_back(i0 + 1);
+				sphereIndices.push_back(i1 + 1);
+				sphereIndices.push_back(i1);
+			}
+		}
+
+		m_SphereChain.m_ScreenSize[level] = sphereScreenSize[level];
+		m_SphereLods[level] = m_GeometryPool.Allocate((uint32)sphereVertices.size(), (uint32)sphereIndices.size());
+		m_GeometryPool.Upload(m_SphereLods[level], &sphereVertices[0], &sphereIndices[0]);
+	}
+
+	/*Cooked mesh, optional: made with -cook from an OBJ or glTF file*/
+	const std::string cookedMesh("Media/demo.rmesh");
+	if (!LoadMesh(cookedMesh, m_ImportedMesh))
+	{
+		DEBUG_MESSAGE(RAY_MESSAGE, "no cooked mesh at %s, create one with -cook <mesh.obj|.gltf|.glb> %s", cookedMesh.c_str(), cookedMesh.c_str());
+	}
+}
+
+
+void OpenGLRenderSystem::SetupStreamBuffers()
+{
+	/* dynamic per-frame data, each stream keeps three frames in flight */
+	m_UniformRing.Init(1024 * 1024);
+	m_InstanceStream.Init("instances", 16384 * sizeof(InstanceData), sizeof(InstanceData));
+	m_IndirectStream.Init("indirect", 4096 * sizeof(DrawElementsIndirectCommand), sizeof(DrawElementsIndirectCommand));
+}
+
+
+void OpenGLRenderSystem::SetupScene()
+{
+	/* spheres step down to coarser levels while frames take longer than 60 fps allows */
+	m_LodSelector.SetFrameBudget(1000.0f / 60.0f);
+
+	/* the rotating cube, its bounds are refreshed every frame */
+	m_CubeHandle = m_Visibility.Add(Box(), MainCubeObject);
+
+	m_Occlusion.Init(320, 240);
+	m_Visibility.SetOcclusionBuffer(&m_Occlusion);
+
+	/* a wall across the field, drawn and used as an occluder */
+	Matrix wallWorld = Matrix::Identity;
+	wallWorld.M[0][0] = 6.0f;
+	wallWorld.M[1][1] = 1.2f;
+	wallWorld.M[2][2] = 0.1f;
+	wallWorld.M[3][1] = -1.0f;
+	wallWorld.M[3][2] = -4.0f;
+
+	SceneObject wall;
+	wall.m_Instance.SetTransform(wallWorld);
+	wall.m_Instance.m_Color = Vector4(0.6f, 0.6f, 0.6f, 1.0f);
+	wall.m_Instance.m_Params = Vector4(0.0f, 0.0f, 0.0f, 0.0f);
+	wall.m_Origin = wallWorld.GetOrigin();
+	wall.m_Radius = wallWorld.M[0][0];
+	wall.m_Mesh = DM_Cube;
+	wall.m_Material = TextureManager::WhiteTexture;
+	m_Visibility.Add(Box(Vector(-1.0f, -1.0f, -1.0f), Vector(1.0f, 1.0f, 1.0f)).TransformBy(wallWorld), (uint32)m_SceneObjects.size());
+	m_SceneObjects.push_back(wall);
+	m_OccluderWorlds.push_back(wallWorld);
+
+	/* the cooked mesh, scaled to about the size of the rotating cube and put beside it */
+	if (m_ImportedMesh.m_Allocation.IsValid())
+	{
+		const Vector extent = m_ImportedMesh.m_Bounds.GetExtent();
+		const float scale = 1.0f / Math::Max(Math::Max(extent.X, extent.Y), Math::Max(extent.Z, SMALL_NUMBER));
+
+		Matrix meshWorld = Matrix::Identity;
+		meshWorld.M[0][0] = meshWorld.M[1][1] = meshWorld.M[2][2] = scale;
+		meshWorld.SetOrigin(Vector(-3.0f, 0.0f, 0.0f) - m_ImportedMesh.m_Bounds.GetCenter() * scale);
+
+		SceneObject imported;
+		imported.m_Instance.SetTransform(m_ImportedMesh.m_Dequantization * meshWorld);
+		imported.m_Instance.m_Color = Vector4(1.0f, 1.0f, 1.0f, 1.0f);
+		imported.m_Instance.m_Params = Vector4(0.0f, 0.0f, 0.0f, 0.0f);
+		imported.m_Origin = meshWorld.GetOrigin();
+		imported.m_Radius = 1.0f;
+		imported.m_Mesh = DM_Imported;
+		imported.m_Material = m_ImportedTexture;
+		m_Visibility.Add(m_ImportedMesh.m_Bounds.TransformBy(meshWorld), (uint32)m_SceneObjects.size());
+		m_SceneObjects.push_back(imported);
+	}
+
+	/* a static field of small cubes, pyramids and spheres */
+	const int fieldSize = 32;
+	for (int x = 0; x < fieldSize; ++x)
+	{
+		for (int z = 0; z < fieldSize; ++z)
+		{
+			Matrix instanceWorld = Matrix::Identity;
+			instanceWorld.M[0][0] = instanceWorld.M[1][1] = instanceWorld.M[2][2] = 0.2f;
+			instanceWorld.M[3][0] = (x - fieldSize / 2) * 0.75f;
+			instanceWorld.M[3][1] = -2.0f;
+			instanceWorld.M[3][2] = (z - fieldSize / 2) * 0.75f;
+
+			SceneObject object;
+			object.m_Instance.SetTransform(instanceWorld);
+			object.m_Instance.m_Color = Vector4(x * 1.0f / fieldSize, 0.5f, z * 1.0f / fieldSize, 1.0f);
+			object.m_Instance.m_Params = Vector4(0.0f, 0.0f, 0.0f, 0.0f);
+			object.m_Origin = instanceWorld.GetOrigin();
+			object.m_Radius = 0.2f;
+			object.m_Mesh = (DemoMesh)((x + z) % 3);
+			object.m_Material = m_AtlasRegions.empty() ? TextureManager::WhiteTexture : m_AtlasRegions[(x * fieldSize + z) % m_AtlasRegions.size()];
+			object.m_Instance.m_Params.Z = (float)object.m_Material;
+
+			Box bounds = Box(Vector(-1.0f, -1.0f, -1.0f), Vector(1.0f, 1.0f, 1.0f)).TransformBy(instanceWorld);
+			m_Visibility.Add(bounds, (uint32)m_SceneObjects.size());
+			m_SceneObjects.push_back(object);
+		}
+	}
+}
+
+
+bool OpenGLRenderSystem::LoadMesh(const std::string& path, LoadedMesh& mesh)
+{
+	MeshFile file;
+	if (!file.Open(path))
+		return false;
+
+	const MeshFileHeader& header = file.GetHeader();
+	const VertexLayout layout = GetMeshVertexLayout(file.GetVertexProfile());
+	if (m_MeshPool.GetVertexBuffer() == 0)
+	{
+		m_MeshPool.Init(layout, Math::Max(header.m_VertexCount, 256u * 1024u), Math::Max(header.m_IndexCount, 1024u * 1024u),
+			header.m_IndexSize);
+	}
+	if (header.m_IndexSize != m_MeshPool.GetIndexSize() || !(layout == m_MeshPool.GetLayout()))
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "%s was cooked with %s vertices and %u bit indices, unlike the meshes in the pool", path.c_str(),
+			file.GetVertexProfile().GetName(), header.m_IndexSize * 8);
+		return false;
+	}
+
+	mesh.m_Allocation = m_MeshPool.Allocate(header.m_VertexCount, header.m_IndexCount);
+	if (!mesh.m_Allocation.IsValid())
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "no room for %s in the mesh pool", path.c_str());
+		return false;
+	}
+
+	//straight from the mapping, the pages are read in as the driver copies them
+	m_MeshPool.Upload(mesh.m_Allocation, file.GetVertices(), file.GetIndices());
+	mesh.m_SubMeshes.assign(file.GetSubMeshes(), file.GetSubMeshes() + header.m_SubMeshCount);
+	mesh.m_Bounds = file.GetBounds();
+	mesh.m_Dequantization = file.GetDequantization();
+
+	DEBUG_MESSAGE(RAY_MESSAGE, "loaded %s: %u %s vertices, %u indices, %u submeshes", path.c_str(),
+		header.m_VertexCount, file.GetVertexProfile().GetName(), header.m_IndexCount, header.m_SubMeshCount);
+	return true;
 }
 
 
 void OpenGLRenderSystem::SetupTexure()
 {
+	/* decoded on the job threads, uploaded by the render thread a few megabytes a frame, streamed within a fixed budget */
+	m_Textures.Init(8 * 1024 * 1024, 256 * 1024 * 1024);
+
+	/* a cooked texture goes to the gpu as its blocks, the source image is the fallback */
+	const std::string cookedTexture("Media/demo.dds");
+	const std::string sourceTexture("Media/demo.png");
+	if (std::ifstream(cookedTexture.c_str()).good())
+	{
+		m_ImportedTexture = m_Textures.Load(cookedTexture);
+	}
+	else if (std::ifstream(sourceTexture.c_str()).good())
+	{
+		DEBUG_MESSAGE(RAY_MESSAGE, "uncompressed %s, cook it with -cooktex %s %s", sourceTexture.c_str(), sourceTexture.c_str(), cookedTexture.c_str());
+		m_ImportedTexture = m_Textures.Load(sourceTexture);
+	}
+	else
+	{
+		DEBUG_MESSAGE(RAY_MESSAGE, "no texture at %s, the cooked mesh is drawn untextured", sourceTexture.c_str());
+	}
 
+	/* small textures packed with -cookatlas, shared by the field of cubes and pyramids */
+	std::map<std::string, TextureHandle> regions;
+	const std::string atlasTable("Media/demo_atlas.json");
+	if (std::ifstream(atlasTable.c_str()).good() && m_Textures.LoadAtlas(atlasTable, regions))
+	{
+		for (const auto& region : regions)
+		{
+			m_AtlasRegions.push_back(region.second);
+		}
+	}
 }
 
 
@@ -299,14 +1199,38 @@ void OpenGLRenderSystem::SetupLights()
 void OpenGLRenderSystem::SetupShaders()
 {
 	ShaderManager* shaderManager = ShaderManager::getInstancePtr();
-	string shaderName("basic");
+	/* one uber shader, every mesh draw is a variant of it; the bindings are shared by the variants,
+	   blocks and samplers a variant compiles out are skipped */
+	string shaderName("mesh");
 	shaderManager->CreateEffect(shaderName);
 	shaderManager->AddVertexShader(shaderName);
 	shaderManager->AddPixelShader(shaderName);
 	shaderManager->SetVS(shaderName, shaderName);
 	shaderManager->SetPS(shaderName, shaderName);
+	shaderManager->BindUniformBlock(shaderName, "PerFrame", UBB_PerFrame);
+	shaderManager->BindUniformBlock(shaderName, "PerObject", UBB_PerObject);
+	shaderManager->BindUniformBlock(shaderName, "TextureSlots", UBB_TextureSlots);
+	shaderManager->BindSampler(shaderName, "gDiffuse", 0);
+	shaderManager->BindSampler(shaderName, "gDiffuseArray", 1);
 	shaderManager->LinkShaders(shaderName);
 	shaderManager->EnableShader(shaderName);
+	m_MeshProgram = shaderManager->GetProgramHandle(shaderName);
+	m_MeshSort = shaderManager->GetProgram(m_MeshProgram)->m_SortId;
+
+	/* untextured stand-in for the instanced variant, small enough to link before the first frame */
+	shaderManager->GetVariant(shaderName, SF_Instancing);
+	string fallbackName = ShaderManager::GetVariantName(shaderName, SF_Instancing);
+	shaderManager->LinkShaders(fallbackName);
+
+	/* the instanced variant reads the world transform from the instance stream, samples pooled
+	   textures and dithers lod fades, it links on its first draw */
+	m_InstancedProgram = shaderManager->GetVariant(shaderName, SF_Instancing | SF_Textured | SF_LodFade, fallbackName);
+	m_InstancedSort = shaderManager->GetProgram(m_InstancedProgram)->m_SortId;
+
+#ifdef DEBUG_MODE
+	/* edited shaders relink while the scene keeps running */
+	shaderManager->EnableHotReload();
+#endif
 }
 
 GLFWwindow* OpenGLRenderSystem::GetWindowHandler()
@@ -5,11 +5,26 @@
 #pragma once
 #include "../../Engine/RenderSystem.h"
 #include "../../Engine/RayTimer.h"
+#include "../../Engine/RenderQueue.h"
+#include "../../Engine/RenderCommandBuffer.h"
+#include "../../Engine/SceneVisibility.h"
+#include "../../Engine/OcclusionBuffer.h"
+#include "../../Engine/LodSelector.h"
+#include "../../Engine/MeshFile.h"
+#include "OpenGLUniformBuffer.h"
+#include "OpenGLStreamBuffer.h"
+#include "OpenGLVertexLayout.h"
+#include "OpenGLGeometryPool.h"
+#include "OpenGLShader.h"
+#include "OpenGLStateCache.h"
+#include "OpenGLTextureManager.h"
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 class Camera;
-class ShaderManager;
 
 class OpenGLRenderSystem : public RenderSystem
 {
@@ -26,13 +41,56 @@ public:
 	GLFWwindow* GetWindowHandler();
 
 protected:
+	/**
+	 * One frame in flight: recorded on the main thread, then executed by the
+	 * render thread while the main thread records the other one.
+	 */
+	struct RenderFrame
+	{
+		RenderFrame()
+			: m_bRecorded(false)
+			, m_DrawCalls(0)
+		{
+			m_StateStats.m_Issued = m_StateStats.m_Filtered = 0;
+			memset(&m_TextureStats, 0, sizeof(m_TextureStats));
+		}
+
+		RenderQueue m_Queue;
+		RenderCommandBuffer m_Commands;
+		bool m_bRecorded; //guarded by m_FrameMutex
+
+		/* filled in by the render thread */
+		uint32 m_DrawCalls;
+		StateCacheStats m_StateStats;
+		TextureStreamingStats m_TextureStats;
+	};
+
+	/* records the next frame on the main thread, blocks while its slot is still being executed */
 	virtual void RenderOneFrame();
+	virtual void RenderThreadMain();
+	virtual void ExecuteFrame(RenderFrame& frame);
+	virtual void ExecuteRenderQueue(const RenderQueue& queue);
+	virtual bool UploadInstances(const RenderQueue& queue);
+	virtual bool UploadIndirectCommands();
 	virtual void CalculateFrameStats();
 	virtual void SetupShaders();
-	virtual void SetupVertexBuffer();
-	virtual void SetupIndexBuffer();
+	virtual void SetupGeometry();
+	virtual void SetupStreamBuffers();
 	virtual void SetupTexure();
 	virtual void SetupLights();
+	virtual void SetupScene();
+
+	/* a cooked mesh uploaded into m_MeshPool, submesh ranges are relative to m_Allocation */
+	struct LoadedMesh
+	{
+		MeshAllocation m_Allocation;
+		std::vector<MeshFileSubMesh> m_SubMeshes;
+		Box m_Bounds;
+		Matrix m_Dequantization; //in front of the world matrix of every instance
+	};
+
+	/* maps the cooked file and uploads its blobs as they are */
+	virtual bool LoadMesh(const std::string& path, LoadedMesh& mesh);
 
 
 private:
@@ -43,14 +101,88 @@ private:
 
 	GLFWwindow* m_Window;
 	GLFWmonitor* m_Monitor;
+	GLFWwindow* m_CompileWindow; //hidden, its context links queued programs
 
 	bool m_SysPaused;
 	RayTimer m_Timer;
 
-	GLuint VBO, IBO;
+	GeometryPool m_GeometryPool;
+	MeshAllocation m_CubeMesh;
+	MeshAllocation m_PyramidMesh;
+	MeshAllocation m_SphereLods[LodChain::MaxLevels];
+	LodChain m_SphereChain;
+
+	GeometryPool m_MeshPool; //cooked meshes, layout of the first one loaded
+	GLuint m_MeshInstancedVAO;
+	LoadedMesh m_ImportedMesh;
+	TextureHandle m_ImportedTexture;
+	std::vector<TextureHandle> m_AtlasRegions;
+	GLuint m_PoolVAO;
+	GLuint m_PoolInstancedVAO;
+	ProgramHandle m_MeshProgram;
+	uint32 m_MeshSort; //sort ids, variants of one effect sort next to each other
+	ProgramHandle m_InstancedProgram;
+	uint32 m_InstancedSort;
+
+	TextureManager m_Textures;
+	StreamBuffer m_InstanceStream;
+	StreamBuffer m_IndirectStream;
+	GLintptr m_InstanceOffset;
+	GLintptr m_IndirectOffset;
+	std::vector<DrawElementsIndirectCommand> m_IndirectCommands;
+	uint32 m_DrawCalls;
+	PerFrameConstants m_FrameConstants;
+
+	/* demo scene, visible objects report their index in m_SceneObjects */
+	enum DemoMesh
+	{
+		DM_Cube,
+		DM_Pyramid,
+		DM_Sphere,
+		DM_Imported,
+	};
+
+	struct SceneObject
+	{
+		InstanceData m_Instance;
+		Vector m_Origin;
+		float m_Radius;
+		DemoMesh m_Mesh;
+		TextureHandle m_Material; //cubes and pyramids, regions of the demo atlas if there is one
+		LodState m_Lod; //written while recording, only by the thread recording the object
+	};
+
+	static const uint32 MainCubeObject = 0x80000000;
+	SceneVisibility m_Visibility;
+	std::vector<SceneObject> m_SceneObjects;
+	uint32 m_CubeHandle;
+
+	/* occluders are drawn from a cpu copy of the cube mesh */
+	OcclusionBuffer m_Occlusion;
+	std::vector<Vector> m_OccluderPositions;
+	std::vector<uint32> m_OccluderIndices;
+	std::vector<Matrix> m_OccluderWorlds;
+
+	LodSelector m_LodSelector;
+	VertexArrayCache m_VertexArrays;
+	UniformBufferRing m_UniformRing;
+	std::vector<GLintptr> m_ObjectOffsets;
+
+	static const int FrameSlots = 2;
+	RenderFrame m_Frames[FrameSlots];
+	int m_RecordIndex;
+	uint32 m_LastDrawCalls;
+	StateCacheStats m_LastStateStats;
+	TextureStreamingStats m_LastTextureStats;
+
+	std::thread m_RenderThread;
+	std::mutex m_FrameMutex;
+	std::condition_variable m_FrameCondition;
+	bool m_bRenderThreadQuit;
 
 	Camera *m_Camera;
 
 	ShaderManager* m_ShaderManager;
+	OpenGLStateCache* m_StateCache;
 };
 
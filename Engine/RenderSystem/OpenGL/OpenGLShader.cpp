@@ -1,326 +1,1196 @@
 #include "OpenGLShader.h"
+#include "OpenGLStateCache.h"
+#include "OpenGLExtensions.h"
+#include "../../Tools/ContentHash.h"
+#include "../../Tools/MappedFile.h"
 #include "../../Tools/RayUtils.h"
 
+#include <GLFW/glfw3.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <fstream>
+#include <string.h>
 using namespace std;
 
+/**
+	one link in flight, everything the context running it needs is copied in
+**/
+struct CompileJob
+{
+	ProgramHandle m_Handle;
+	GLuint m_Program;
+	GLenum m_Types[SS_Count];
+	ShaderHandle m_StageShaders[SS_Count]; //the table entries compiled stages go into
+	string m_Sources[SS_Count]; //empty for stages compiled before
+	GLuint m_Shaders[SS_Count];
+	uint32 m_Generations[SS_Count]; //of the table entries when the job was prepared
+	bool m_bAttach[SS_Count];
+	uint64 m_Key;
+	string m_CachePath; //empty when the binary isn't kept
+	bool m_bReload; //links a scratch program, the one in use keeps drawing until it's replaced
+	chrono::high_resolution_clock::time_point m_Start;
+	atomic<bool> m_bDone; //set by the compile thread
+};
+
+static const GLenum StageTypes[SS_Count] = { GL_VERTEX_SHADER, GL_FRAGMENT_SHADER, GL_GEOMETRY_SHADER };
+
+/**
+	issues every call of the link without waiting on one, so compiles run
+	in parallel with KHR_parallel_shader_compile. Errors are read at finish.
+**/
+static void IssueJob(CompileJob& job)
+{
+	for (int i = 0; i < SS_Count; ++i)
+	{
+		if (!job.m_Sources[i].empty())
+		{
+			job.m_Shaders[i] = glCreateShader(job.m_Types[i]);
+			const GLchar* p[1] = { job.m_Sources[i].c_str() };
+			GLint lengths[1] = { (GLint)job.m_Sources[i].size() };
+			glShaderSource(job.m_Shaders[i], 1, p, lengths);
+			glCompileShader(job.m_Shaders[i]);
+		}
+		if (job.m_bAttach[i])
+		{
+			glAttachShader(job.m_Program, job.m_Shaders[i]);
+		}
+	}
+
+	if (!job.m_CachePath.empty())
+	{
+		glProgramParameteri(job.m_Program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+	glLinkProgram(job.m_Program);
+}
+
+/**
+	layout of a cached program binary, the driver's blob follows
+**/
+struct ProgramBinaryHeader
+{
+	static const uint32 Magic = 0x42505952; //"RYPB"
+
+	uint32 m_Magic;
+	uint32 m_Format; //binary format the driver reported
+	uint64 m_Key;
+	uint32 m_Length;
+	uint32 m_Padding;
+};
+
 template<> ShaderManager* Singleton<ShaderManager>::m_pSingleton = nullptr;
 
+static const char* const ShaderDirectory = "Shaders";
+
 ShaderManager::ShaderManager()
 	: m_CurrentProgram(0)
-	, m_CurrentVS(0)
-	, m_CurrentPS(0)
-	, m_CurrentGS(0)
+	, m_BinaryCache("Cache")
+	, m_EffectCount(0)
+	, m_CompileContext(nullptr)
+	, m_bCompileQuit(false)
 {
+	//entry 0 of every table stands for none, so handles index them without a check
+	m_Programs.push_back(Program());
+	DrawSlot noDraw = { 0, false };
+	m_DrawSlots.push_back(noDraw);
+	CompiledShader noShader = { NameTable::NoName, SS_Vertex, 0, 0 };
+	m_Shaders.push_back(noShader);
+	m_ProgramsByName.push_back(0);
+
 	DEBUG_MESSAGE(RAY_MESSAGE, "ShaderManager Start...");
 }
 
 ShaderManager::~ShaderManager()
 {
+	if (m_CompileThread.joinable())
+	{
+		{
+			lock_guard<mutex> lock(m_CompileMutex);
+			m_bCompileQuit = true;
+		}
+		m_CompileCondition.notify_all();
+		m_CompileThread.join();
+	}
+	for (CompileJob* job : m_PendingJobs)
+	{
+		R_DELETE(job);
+	}
+
 	//Detach all shaders are using
-	for (auto itr : m_Programs)
+	for (size_t i = 1; i < m_Programs.size(); ++i)
 	{
 		const GLsizei maxCount = 5;
 		GLsizei count=0;
 		GLuint shaders[maxCount];
-		GLuint program = itr.second.m_Program;
+		GLuint program = m_Programs[i].m_Program;
 		glGetAttachedShaders(program, maxCount, &count, shaders);
 		
-		for (int i = 0; i < count; ++i)
+		for (int j = 0; j < count; ++j)
 		{
-			glDetachShader(program, shaders[i]);
-			glDeleteProgram(program);
+			glDetachShader(program, shaders[j]);
 		}
+		//programs loaded as binaries have nothing attached
+		glDeleteProgram(program);
 	}
 
 	//Delete all shader objects
-	for (auto itr : m_Vs)
+	for (size_t i = 1; i < m_Shaders.size(); ++i)
 	{
-		glDeleteShader(itr.second);
+		if (m_Shaders[i].m_Shader != 0)
+		{
+			glDeleteShader(m_Shaders[i].m_Shader);
+		}
 	}
-	for (auto itr : m_Ps)
+
+	DEBUG_MESSAGE(RAY_MESSAGE, "Unload ShaderManager...");
+}
+
+ProgramHandle ShaderManager::CreateEffect(std::string& progName)
+{
+	ProgramHandle handle = GetProgramHandle(progName);
+	if (handle != 0)
 	{
-		glDeleteShader(itr.second);
+		DEBUG_MESSAGE(RAY_ERROR, "effect %s already exists", progName.c_str());
+		return handle;
 	}
-	for (auto itr : m_Gs)
+
+	GLuint program = glCreateProgram();
+	ASSERT(program != 0);
+	const NameId name = m_Names.Intern(progName);
+	handle = (ProgramHandle)m_Programs.size();
+	m_Programs.push_back(Program());
+
+	Program& prog = m_Programs.back();
+	prog.m_Program = program;
+	prog.m_Name = name;
+	prog.m_Status = PS_Unlinked;
+	prog.m_Features = 0;
+	//0 is left for draws that don't set a sort id
+	prog.m_SortId = ++m_EffectCount << SF_FeatureBits;
+	prog.m_Fallback = 0;
+
+	DrawSlot slot = { program, false };
+	m_DrawSlots.push_back(slot);
+	if (m_ProgramsByName.size() <= name)
 	{
-		glDeleteShader(itr.second);
+		m_ProgramsByName.resize(name + 1, 0);
 	}
+	m_ProgramsByName[name] = handle;
+	return handle;
+}
 
-	DEBUG_MESSAGE(RAY_MESSAGE, "Unload ShaderManager...");
+ProgramHandle ShaderManager::GetProgramHandle(const std::string& progName) const
+{
+	const NameId name = m_Names.Find(progName);
+	return name < m_ProgramsByName.size() ? m_ProgramsByName[name] : 0;
 }
 
-void ShaderManager::CreateEffect(std::string& progName)
+string ShaderManager::GetVariantName(const string& progName, uint32 features)
 {
-	GLuint program = glCreateProgram();
-	ASSERT(program != 0);
-	m_Programs[progName].m_Program = program;
-	m_Programs[progName].m_VS= 0;
-	m_Programs[progName].m_PS= 0;
-	m_Programs[progName].m_GS= 0;
+	if (features == 0)
+		return progName;
+
+	static const char digits[] = "0123456789abcdef";
+	string name = progName + "#";
+	for (int shift = 28; shift >= 0; shift -= 4)
+	{
+		if ((features >> shift) != 0 || shift == 0)
+		{
+			name += digits[(features >> shift) & 15];
+		}
+	}
+	return name;
+}
+
+ProgramHandle ShaderManager::GetVariant(const string& progName, uint32 features, const string& fallbackName)
+{
+	string name = GetVariantName(progName, features);
+	ProgramHandle handle = GetProgramHandle(name);
+	if (handle != 0)
+		return handle;
+
+	const ProgramHandle base = GetProgramHandle(progName);
+	if (base == 0 || (features & ~SF_FeatureMask) != 0)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "no variant %s of effect %s", name.c_str(), progName.c_str());
+		return 0;
+	}
+
+	handle = CreateEffect(name);
+	Program& variant = m_Programs[handle];
+	const Program& effect = m_Programs[base];
+	for (int i = 0; i < SS_Count; ++i)
+	{
+		variant.m_StageNames[i] = effect.m_StageNames[i];
+	}
+	variant.m_Features = features;
+	variant.m_SortId = (effect.m_SortId & ~(uint32)SF_FeatureMask) | features;
+	variant.m_Fallback = fallbackName.empty() ? effect.m_Fallback : GetProgramHandle(fallbackName);
+	variant.m_BlockBindings = effect.m_BlockBindings;
+	variant.m_SamplerBindings = effect.m_SamplerBindings;
+	--m_EffectCount;
+
+	//the first draw goes through ResolveDrawProgram, which starts the link
+	SetDrawProgram(handle, variant.m_Fallback);
+	m_DrawSlots[handle].m_bLinkOnDraw = true;
+	return handle;
+}
+
+GLuint ShaderManager::ResolveDrawProgram(ProgramHandle program)
+{
+	m_DrawSlots[program].m_bLinkOnDraw = false;
+	if (m_Programs[program].m_Status == PS_Unlinked)
+	{
+		LinkShadersAsync(program, m_Programs[program].m_Fallback);
+	}
+	return m_DrawSlots[program].m_Program;
+}
+
+void ShaderManager::SetDrawProgram(ProgramHandle program, ProgramHandle fallback)
+{
+	const Program& prog = m_Programs[fallback];
+	m_DrawSlots[program].m_Program = prog.m_Status == PS_Ready ? prog.m_Program : 0;
 }
 
 void ShaderManager::AddVertexShader(std::string& vsName)
 {
-	bool ret = CompileShader(vsName, GL_VERTEX_SHADER);
+	bool ret = AddSource(vsName, SS_Vertex);
 	ASSERT(ret != 0);
 }
 
 void ShaderManager::AddPixelShader(std::string& psName)
 {
-	bool ret = CompileShader(psName, GL_FRAGMENT_SHADER);
+	bool ret = AddSource(psName, SS_Pixel);
 	ASSERT(ret != 0);
 }
 
 void ShaderManager::AddGeometrySahder(std::string& gsName)
 {
-	bool ret = CompileShader(gsName, GL_GEOMETRY_SHADER);
+	bool ret = AddSource(gsName, SS_Geometry);
 	ASSERT(ret != 0);
 }
 
-void ShaderManager::SetVS(std::string& vsName, std::string& programName)
+/**
+	stages are only named here, LinkShaders compiles and attaches them unless the binary is cached
+**/
+static void DetachStage(GLuint program, GLuint& shader)
 {
-	GLuint program = m_Programs[programName].m_Program;
-	GLuint oldVS = m_Programs[programName].m_VS;
-	GLuint newVS = m_Vs[vsName];
+	if (shader != 0)
+	{
+		glDetachShader(program, shader);
+		shader = 0;
+	}
+}
 
-	glDetachShader(program, oldVS);
-	glAttachShader(program, newVS);
-	m_Programs[programName].m_VS = newVS;
+static void DetachStages(Program& prog)
+{
+	for (int i = 0; i < SS_Count; ++i)
+	{
+		DetachStage(prog.m_Program, prog.m_Stages[i]);
+	}
+}
+
+void ShaderManager::SetStage(const string& stageName, const string& programName, ShaderStage stage)
+{
+	const ProgramHandle handle = GetProgramHandle(programName);
+	if (handle == 0)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "program %s does not exist", programName.c_str());
+		return;
+	}
+
+	Program& prog = m_Programs[handle];
+	DetachStage(prog.m_Program, prog.m_Stages[stage]);
+	prog.m_StageNames[stage] = m_Names.Intern(stageName);
+}
+
+void ShaderManager::SetVS(std::string& vsName, std::string& programName)
+{
+	SetStage(vsName, programName, SS_Vertex);
 }
 
 void ShaderManager::UnSetVS(std::string& vsName, std::string& programName)
 {
-	glDetachShader(m_Programs[programName].m_Program, m_Vs[vsName]);
-	m_Programs[programName].m_VS = 0;
+	SetStage(string(), programName, SS_Vertex);
 }
 
 void ShaderManager::SetPS(std::string& psName, std::string& programName)
 {
-	GLuint program = m_Programs[programName].m_Program;
-	GLuint oldPS = m_Programs[programName].m_PS;
-	GLuint newPS = m_Ps[psName];
-
-	glDetachShader(program, oldPS);
-	glAttachShader(program, newPS);
-	m_Programs[programName].m_PS = newPS;
+	SetStage(psName, programName, SS_Pixel);
 }
 
 void ShaderManager::UnSetPS(std::string& psName, std::string& programName)
 {
-	glDetachShader(m_Programs[programName].m_Program, m_Ps[psName]);
-	m_Programs[programName].m_PS = 0;
+	SetStage(string(), programName, SS_Pixel);
 }
 
 void ShaderManager::SetGS(std::string& gsName, std::string& programName)
 {
-	GLuint program = m_Programs[programName].m_Program;
-	GLuint oldGS = m_Programs[programName].m_GS;
-	GLuint newGS = m_Ps[gsName];
-
-	glDetachShader(program, oldGS);
-	glAttachShader(program, newGS);
-	m_Programs[programName].m_GS = newGS;
+	SetStage(gsName, programName, SS_Geometry);
 }
 
 void ShaderManager::UnSetGS(std::string& gsName, std::string& programName)
 {
-	glDetachShader(m_Programs[programName].m_Program, m_Gs[gsName]);
-	m_Programs[programName].m_GS = 0;
+	SetStage(string(), programName, SS_Geometry);
 }
 
 const string ShaderManager::GetCurrentProgName() const
 {
-	string ret;
-	if (m_CurrentProgram == 0)
-		return ret;
+	return m_Names.GetName(m_Programs[m_CurrentProgram].m_Name);
+}
+
+const string ShaderManager::GetCurrentVSName() const
+{
+	return m_Names.GetName(m_Programs[m_CurrentProgram].m_StageNames[SS_Vertex]);
+}
+
+const string ShaderManager::GetCurrentPSName() const
+{
+	return m_Names.GetName(m_Programs[m_CurrentProgram].m_StageNames[SS_Pixel]);
+}
 
-	for (auto itr : m_Programs)
+const string ShaderManager::GetCurrentGSName() const
+{
+	return m_Names.GetName(m_Programs[m_CurrentProgram].m_StageNames[SS_Geometry]);
+}
+
+const GLuint ShaderManager::GetCurrentProg() const
+{
+	return m_Programs[m_CurrentProgram].m_Program;
+}
+
+const ProgramHandle ShaderManager::GetCurrentHandle() const
+{
+	return m_CurrentProgram;
+}
+
+const GLuint ShaderManager::GetCurrentVS() const
+{
+	return m_Programs[m_CurrentProgram].m_Stages[SS_Vertex];
+}
+
+const GLuint ShaderManager::GetCurrentPS() const
+{
+	return m_Programs[m_CurrentProgram].m_Stages[SS_Pixel];
+}
+
+const GLuint ShaderManager::GetCurrentGS() const
+{
+	return m_Programs[m_CurrentProgram].m_Stages[SS_Geometry];
+}
+
+string ShaderManager::GetShaderFile(const string& shaderName, ShaderStage stage)
+{
+	static const char* const extensions[SS_Count] = { ".vs", ".fs", ".gs" };
+	return string(ShaderDirectory) + "/" + shaderName + extensions[stage];
+}
+
+bool ShaderManager::AddSource(const string& shaderName, ShaderStage stage)
+{
+	return m_Preprocessor.Load(GetShaderFile(shaderName, stage));
+}
+
+uint64 ShaderManager::GetShaderKey(NameId name, ShaderStage stage, uint32 features)
+{
+	return ((uint64)name << 32) | ((uint64)stage << SF_FeatureBits) | features;
+}
+
+ShaderHandle ShaderManager::FindShader(NameId name, ShaderStage stage, uint32 features) const
+{
+	auto itr = m_ShadersByKey.find(GetShaderKey(name, stage, features));
+	return itr != m_ShadersByKey.end() ? itr->second : 0;
+}
+
+ShaderHandle ShaderManager::AddShader(NameId name, ShaderStage stage, uint32 features)
+{
+	const ShaderHandle handle = (ShaderHandle)m_Shaders.size();
+	CompiledShader shader = { name, stage, features, 0, 0 };
+	m_Shaders.push_back(shader);
+	m_ShadersByKey[GetShaderKey(name, stage, features)] = handle;
+	return handle;
+}
+
+uint64 ShaderManager::GetBinaryKey(const string* sources)
+{
+	if (m_Driver.empty())
 	{
-		if (itr.second.m_Program == m_CurrentProgram)
-			ret = itr.first;
+		const GLubyte* strings[3] = { glGetString(GL_VENDOR), glGetString(GL_RENDERER), glGetString(GL_VERSION) };
+		for (const GLubyte* text : strings)
+		{
+			m_Driver += text != nullptr ? (const char*)text : "";
+			m_Driver += "\n";
+		}
 	}
-	return ret;
+
+	uint64 key = HashString(HashSeed, m_Driver);
+	for (int i = 0; i < SS_Count; ++i)
+	{
+		if (sources[i].empty())
+			continue;
+
+		//defines and includes are part of the source text by the time it's hashed
+		key = HashBytes(key, &StageTypes[i], sizeof(StageTypes[i]));
+		key = HashString(key, sources[i]);
+	}
+	return key;
 }
 
-const string ShaderManager::GetCurrentVSName() const
+bool ShaderManager::LoadBinary(Program& prog, const string& path, uint64 key)
 {
-	string ret;
+	MappedFile file;
+	if (!file.Open(path))
+		return false;
 
-	if (m_CurrentVS == 0)
-		return ret;
+	ProgramBinaryHeader header;
+	if (file.GetSize() < sizeof(header))
+		return false;
 
-	for (auto itr : m_Vs)
+	memcpy(&header, file.GetData(), sizeof(header));
+	if (header.m_Magic != ProgramBinaryHeader::Magic || header.m_Key != key || file.GetSize() < sizeof(header) + header.m_Length)
+		return false;
+
+	//a driver update can still refuse the binary, the program then links from source as usual
+	GLint success = 0;
+	glProgramBinary(prog.m_Program, header.m_Format, file.GetData() + sizeof(header), header.m_Length);
+	glGetProgramiv(prog.m_Program, GL_LINK_STATUS, &success);
+	if (success == 0)
 	{
-		if (itr.second == m_CurrentVS)
-			ret = itr.first;
+		DEBUG_MESSAGE(RAY_MESSAGE, "the driver rejected %s, compiling from source", path.c_str());
+		return false;
 	}
-	return ret;
+	return true;
 }
 
-const string ShaderManager::GetCurrentPSName() const
+void ShaderManager::SaveBinary(GLuint program, const string& path, uint64 key)
 {
-	string ret;
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+	if (length <= 0)
+		return;
+
+	vector<uint8> binary((size_t)length);
+	GLenum format = 0;
+	glGetProgramBinary(program, length, &length, &format, &binary[0]);
+
+	ProgramBinaryHeader header;
+	header.m_Magic = ProgramBinaryHeader::Magic;
+	header.m_Format = format;
+	header.m_Key = key;
+	header.m_Length = (uint32)length;
+	header.m_Padding = 0;
 
-	if (m_CurrentPS == 0)
-		return ret;
-	
-	for (auto itr : m_Ps)
+	//a missing entry only costs the next run a compile
+	CreateCacheDirectory(m_BinaryCache);
+	ofstream file(path.c_str(), ios::binary | ios::trunc);
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)&binary[0], length);
+}
+
+bool ShaderManager::LinkShaders(std::string& progName)
+{
+	const ProgramHandle handle = GetProgramHandle(progName);
+	if (handle == 0)
 	{
-		if (itr.second == m_CurrentPS)
-			ret = itr.first;
+		DEBUG_MESSAGE(RAY_ERROR, "program %s does not exist", progName.c_str());
+		return false;
 	}
-	return ret;
+	return LinkShaders(handle);
 }
 
-const string ShaderManager::GetCurrentGSName() const
+bool ShaderManager::LinkShaders(ProgramHandle program)
 {
-	string ret;
+	CompileJob* job = PrepareJob(program, false);
+	if (job == nullptr)
+		return m_Programs[program].m_Status == PS_Ready;
 
-	if (m_CurrentGS == 0)
-		return ret;
+	//the status queries in FinishJob wait for the driver
+	IssueJob(*job);
+	const bool linked = FinishJob(job);
+	R_DELETE(job);
+	return linked;
+}
 
-	for (auto itr : m_Gs)
+void ShaderManager::LinkShadersAsync(std::string& progName, const std::string& fallbackName)
+{
+	const ProgramHandle handle = GetProgramHandle(progName);
+	if (handle == 0)
 	{
-		if (itr.second == m_CurrentGS)
-			ret = itr.first;
+		DEBUG_MESSAGE(RAY_ERROR, "program %s does not exist", progName.c_str());
+		return;
 	}
-	return ret;
+	LinkShadersAsync(handle, GetProgramHandle(fallbackName));
 }
 
-const GLuint ShaderManager::GetCurrentProg() const
+void ShaderManager::LinkShadersAsync(ProgramHandle program, ProgramHandle fallback)
 {
-	return m_CurrentProgram;
+	const bool parallel = OpenGLExtensions::m_bParallelShaderCompile;
+	if (!parallel && !m_CompileThread.joinable())
+	{
+		LinkShaders(program);
+		return;
+	}
+
+	CompileJob* job = PrepareJob(program, false);
+	if (job == nullptr)
+		return;
+
+	m_Programs[program].m_Fallback = fallback;
+	SetDrawProgram(program, fallback);
+	StartJob(job);
 }
 
-const GLuint ShaderManager::GetCurrentVS() const
+void ShaderManager::StartJob(CompileJob* job)
 {
-	return m_CurrentVS;
+	m_Programs[job->m_Handle].m_Status = PS_Compiling;
+	if (OpenGLExtensions::m_bParallelShaderCompile)
+	{
+		m_PendingJobs.push_back(job);
+		IssueJob(*job);
+		return;
+	}
+	if (!m_CompileThread.joinable())
+	{
+		IssueJob(*job);
+		FinishJob(job);
+		R_DELETE(job);
+		return;
+	}
+
+	m_PendingJobs.push_back(job);
+	{
+		lock_guard<mutex> lock(m_CompileMutex);
+		m_CompileQueue.push_back(job);
+	}
+	m_CompileCondition.notify_one();
 }
 
-const GLuint ShaderManager::GetCurrentPS() const
+void ShaderManager::InitAsyncCompile(GLFWwindow* compileContext)
 {
-	return m_CurrentPS;
+	if (OpenGLExtensions::m_bParallelShaderCompile)
+	{
+		//let the driver pick the thread count
+		OpenGLExtensions::MaxShaderCompilerThreads(0xFFFFFFFF);
+		return;
+	}
+	if (compileContext == nullptr || m_CompileThread.joinable())
+		return;
+
+	m_CompileContext = compileContext;
+	m_bCompileQuit = false;
+	m_CompileThread = thread(&ShaderManager::CompileThreadMain, this);
 }
 
-const GLuint ShaderManager::GetCurrentGS() const
+void ShaderManager::CompileThreadMain()
 {
-	return m_CurrentGS;
+	glfwMakeContextCurrent(m_CompileContext);
+	for (;;)
+	{
+		CompileJob* job = nullptr;
+		{
+			unique_lock<mutex> lock(m_CompileMutex);
+			m_CompileCondition.wait(lock, [this]() { return m_bCompileQuit || !m_CompileQueue.empty(); });
+			if (m_bCompileQuit)
+				break;
+
+			job = m_CompileQueue.front();
+			m_CompileQueue.erase(m_CompileQueue.begin());
+		}
+
+		IssueJob(*job);
+		//the results have to be complete before the other context looks at them
+		glFinish();
+		job->m_bDone = true;
+	}
+	glfwMakeContextCurrent(NULL);
 }
 
-bool ShaderManager::ReadFile(string fileName, std::string& outFile)
+void ShaderManager::Update()
 {
-	ifstream f(fileName.c_str());
-	bool ret = false;
-	
-	if (f.is_open())
+	if (m_Watcher.IsWatching())
 	{
-		string line;
-		while (getline(f, line))
+		vector<string> changed;
+		m_Watcher.Poll(changed);
+		if (!changed.empty())
 		{
-			outFile.append(line);
-			outFile.append("\n");
+			ReloadSources(changed);
 		}
-		f.close();
-		return true;
 	}
-	else
+
+	//programs that were busy when their sources changed are picked up once their link is done
+	for (size_t i = 0; i < m_StalePrograms.size();)
 	{
-		DEBUG_MESSAGE(RAY_ERROR, "shader file can not be found : %s!", fileName.c_str());
+		Program& prog = m_Programs[m_StalePrograms[i]];
+		if (prog.m_Status == PS_Compiling)
+		{
+			++i;
+			continue;
+		}
+
+		//a program that failed gets a normal link from fresh stages, its fallback is still in place
+		const bool reload = prog.m_Status == PS_Ready;
+		if (!reload)
+		{
+			DetachStages(prog);
+		}
+		CompileJob* job = PrepareJob(m_StalePrograms[i], reload);
+		if (job != nullptr)
+		{
+			StartJob(job);
+		}
+		m_StalePrograms.erase(m_StalePrograms.begin() + i);
+	}
+
+	const bool parallel = OpenGLExtensions::m_bParallelShaderCompile;
+	for (size_t i = 0; i < m_PendingJobs.size();)
+	{
+		CompileJob* job = m_PendingJobs[i];
+		bool done = job->m_bDone;
+		if (parallel)
+		{
+			GLint complete = 0;
+			glGetProgramiv(job->m_Program, GL_COMPLETION_STATUS_KHR, &complete);
+			done = complete != 0;
+		}
+		if (!done)
+		{
+			++i;
+			continue;
+		}
+
+		m_PendingJobs.erase(m_PendingJobs.begin() + i);
+		FinishJob(job);
+		R_DELETE(job);
 	}
-	return false;
 }
 
-bool ShaderManager::CompileShader(string& shaderName, GLenum shaderType)
+bool ShaderManager::EnableHotReload()
 {
-	GLuint shaderObj = glCreateShader(shaderType);
-	ASSERT(shaderObj != 0);
+	if (!m_Watcher.Watch(ShaderDirectory))
+		return false;
+
+	DEBUG_MESSAGE(RAY_MESSAGE, "watching %s for shader edits", ShaderDirectory);
+	return true;
+}
 
-	string fileName="Shaders/";
-	if (shaderType == GL_VERTEX_SHADER)
+void ShaderManager::ReloadSources(const vector<string>& changed)
+{
+	for (const string& name : changed)
 	{
-		fileName += shaderName + ".vs";
+		const string fileName = string(ShaderDirectory) + "/" + name;
+		if (!m_Preprocessor.Reload(fileName))
+			continue;
+		DEBUG_MESSAGE(RAY_MESSAGE, "%s changed, relinking", fileName.c_str());
+
+		//includes count too, every program built from the file goes
+		const NameId file = m_Names.Find(fileName);
+		for (ProgramHandle handle = 1; handle < (ProgramHandle)m_Programs.size(); ++handle)
+		{
+			const Program& prog = m_Programs[handle];
+			if (prog.m_Status == PS_Unlinked || find(prog.m_Files.begin(), prog.m_Files.end(), file) == prog.m_Files.end())
+				continue;
+
+			//its compiled stages are only flagged, the running program keeps them until it's swapped
+			for (int i = 0; i < SS_Count; ++i)
+			{
+				const ShaderHandle stage = FindShader(prog.m_StageNames[i], (ShaderStage)i, prog.m_Features);
+				if (stage == 0)
+					continue;
+
+				//a link still compiling the old text must not put its stage back in the table
+				CompiledShader& shader = m_Shaders[stage];
+				++shader.m_Generation;
+				if (shader.m_Shader != 0)
+				{
+					glDeleteShader(shader.m_Shader);
+					shader.m_Shader = 0;
+				}
+			}
+			if (find(m_StalePrograms.begin(), m_StalePrograms.end(), handle) == m_StalePrograms.end())
+			{
+				m_StalePrograms.push_back(handle);
+			}
+		}
 	}
-	else if (shaderType == GL_FRAGMENT_SHADER)
+}
+
+ProgramStatus ShaderManager::GetStatus(const std::string& progName) const
+{
+	const Program* prog = GetProgram(progName);
+	return prog != nullptr ? prog->m_Status : PS_Unlinked;
+}
+
+CompileJob* ShaderManager::PrepareJob(ProgramHandle handle, bool reload)
+{
+	Program& prog = m_Programs[handle];
+	const string& progName = m_Names.GetName(prog.m_Name);
+	if (prog.m_Status == PS_Compiling)
 	{
-		fileName += shaderName + ".fs";
+		DEBUG_MESSAGE(RAY_ERROR, "program %s is already being linked", progName.c_str());
+		return nullptr;
 	}
-	else
+
+	const auto start = chrono::high_resolution_clock::now();
+
+	//every stage is preprocessed, the binary key needs the final text
+	string sources[SS_Count];
+	vector<string> files;
+	prog.m_Files.clear();
+	for (int i = 0; i < SS_Count; ++i)
 	{
-		fileName += shaderName + ".gs";
+		if (prog.m_StageNames[i] == NameTable::NoName)
+			continue;
+
+		const string& stageName = m_Names.GetName(prog.m_StageNames[i]);
+		if (!m_Preprocessor.Process(GetShaderFile(stageName, (ShaderStage)i), prog.m_Features, sources[i], files))
+		{
+			DEBUG_MESSAGE(RAY_ERROR, "can't preprocess %s of program %s", stageName.c_str(), progName.c_str());
+			if (!reload)
+			{
+				prog.m_Status = PS_Failed;
+			}
+			return nullptr;
+		}
+		for (const string& file : files)
+		{
+			const NameId fileName = m_Names.Intern(file);
+			if (find(prog.m_Files.begin(), prog.m_Files.end(), fileName) == prog.m_Files.end())
+			{
+				prog.m_Files.push_back(fileName);
+			}
+		}
 	}
-	string content;
-	ReadFile(fileName, content);
 
-	const GLchar* p[1];
-	GLint Lengths[1];
-	p[0] = content.c_str();
-	Lengths[0] = content.size();
+	string cachePath;
+	uint64 key = 0;
+	if (!m_BinaryCache.empty() && GLEW_ARB_get_program_binary)
+	{
+		key = GetBinaryKey(sources);
+		cachePath = GetCachePath(m_BinaryCache, key, ".glbin");
+		//on a reload the live program takes the binary, only ever written for sources that linked
+		if (LoadBinary(prog, cachePath, key))
+		{
+			DetachStages(prog);
+			prog.m_Status = PS_Ready;
+			ReflectProgram(prog);
+			ApplyBindings(prog);
+			m_DrawSlots[handle].m_Program = prog.m_Program;
+			DEBUG_MESSAGE(RAY_MESSAGE, "Program %s loaded from %s in %.2f ms", progName.c_str(), cachePath.c_str(),
+				chrono::duration<double, milli>(chrono::high_resolution_clock::now() - start).count());
+			return nullptr;
+		}
+	}
 
-	glShaderSource(shaderObj, 1, p, Lengths);
-	glCompileShader(shaderObj);
+	CompileJob* job = new CompileJob();
+	job->m_Handle = handle;
+	job->m_Program = reload ? glCreateProgram() : prog.m_Program;
+	job->m_Key = key;
+	job->m_CachePath = cachePath;
+	job->m_bReload = reload;
+	job->m_Start = start;
+	job->m_bDone = false;
 
-	GLint success;
-	glGetShaderiv(shaderObj, GL_COMPILE_STATUS, &success);
-	if (!success) 
+	for (int i = 0; i < SS_Count; ++i)
 	{
-		GLchar InfoLog[1024];
-		glGetShaderInfoLog(shaderObj, 1024, NULL, InfoLog);
-		fprintf(stderr, "Error compiling shader type %d: '%s'\n", shaderType, InfoLog);
-		return false;
+		const GLuint attached = reload ? 0 : prog.m_Stages[i];
+		job->m_Types[i] = StageTypes[i];
+		job->m_StageShaders[i] = 0;
+		job->m_Generations[i] = 0;
+		job->m_Shaders[i] = attached;
+		job->m_bAttach[i] = false;
+		if (prog.m_StageNames[i] == NameTable::NoName || attached != 0)
+			continue;
+
+		//stages other programs compiled with the same features are shared, only the missing ones are compiled here
+		ShaderHandle shader = FindShader(prog.m_StageNames[i], (ShaderStage)i, prog.m_Features);
+		if (shader == 0)
+		{
+			shader = AddShader(prog.m_StageNames[i], (ShaderStage)i, prog.m_Features);
+		}
+		job->m_StageShaders[i] = shader;
+		job->m_Generations[i] = m_Shaders[shader].m_Generation;
+		if (m_Shaders[shader].m_Shader != 0)
+		{
+			job->m_Shaders[i] = m_Shaders[shader].m_Shader;
+		}
+		else
+		{
+			job->m_Sources[i] = sources[i];
+		}
+		job->m_bAttach[i] = true;
 	}
-	
-	if (shaderType == GL_VERTEX_SHADER)
+	return job;
+}
+
+bool ShaderManager::FinishJob(CompileJob* job)
+{
+	Program& prog = m_Programs[job->m_Handle];
+	const string& progName = m_Names.GetName(prog.m_Name);
+	GLuint linkedStages[SS_Count] = { prog.m_Stages[SS_Vertex], prog.m_Stages[SS_Pixel], prog.m_Stages[SS_Geometry] };
+	GLchar ErrorLog[1024] = {0};
+	GLint success = 0;
+
+	//sources edited while the job ran, the result is still good to draw until the relink Update starts
+	bool stale = false;
+	for (int i = 0; i < SS_Count; ++i)
+	{
+		if (job->m_StageShaders[i] != 0 && m_Shaders[job->m_StageShaders[i]].m_Generation != job->m_Generations[i])
+		{
+			stale = true;
+		}
+	}
+
+	bool linked = true;
+	for (int i = 0; i < SS_Count; ++i)
+	{
+		if (job->m_Sources[i].empty())
+		{
+			if (job->m_bAttach[i])
+			{
+				linkedStages[i] = job->m_Shaders[i];
+			}
+			continue;
+		}
+
+		GLuint shaderObj = job->m_Shaders[i];
+		glGetShaderiv(shaderObj, GL_COMPILE_STATUS, &success);
+		if (!success)
+		{
+			glGetShaderInfoLog(shaderObj, sizeof(ErrorLog), NULL, ErrorLog);
+			fprintf(stderr, "Error compiling shader type %d: '%s'\n", job->m_Types[i], ErrorLog);
+			glDetachShader(job->m_Program, shaderObj);
+			glDeleteShader(shaderObj);
+			linked = false;
+			continue;
+		}
+
+		//another link may have compiled the same stage meanwhile, the later copy goes with the program, so does an outdated one
+		CompiledShader& compiled = m_Shaders[job->m_StageShaders[i]];
+		if (compiled.m_Shader == 0 && compiled.m_Generation == job->m_Generations[i])
+		{
+			compiled.m_Shader = shaderObj;
+		}
+		else
+		{
+			glDeleteShader(shaderObj);
+		}
+		linkedStages[i] = shaderObj;
+	}
+	if (!job->m_bReload)
+	{
+		for (int i = 0; i < SS_Count; ++i)
+		{
+			prog.m_Stages[i] = linkedStages[i];
+		}
+	}
+
+	GLuint program = job->m_Program;
+	if (linked)
+	{
+		glGetProgramiv(program, GL_LINK_STATUS, &success);
+		if (success == 0)
+		{
+			glGetProgramInfoLog(program, sizeof(ErrorLog), NULL, ErrorLog);
+			fprintf(stderr, "Error linking shader program: '%s'\n", ErrorLog);
+			linked = false;
+		}
+	}
+
+#ifdef DEBUG_MODE
+	if (linked)
+	{
+		glValidateProgram(program);
+		glGetProgramiv(program, GL_VALIDATE_STATUS, &success);
+		if (!success) {
+			glGetProgramInfoLog(program, sizeof(ErrorLog), NULL, ErrorLog);
+			fprintf(stderr, "Invalid shader program: '%s'\n", ErrorLog);
+			linked = false;
+		}
+	}
+#endif
+
+	if (!linked)
 	{
-		m_Vs[shaderName] = shaderObj;
+		if (job->m_bReload)
+		{
+			//the program in use stays as it was, the next edit tries again
+			glDeleteProgram(program);
+			prog.m_Status = PS_Ready;
+			DEBUG_MESSAGE(RAY_ERROR, "Program %s failed to relink, keeping the running version", progName.c_str());
+		}
+		else
+		{
+			prog.m_Status = PS_Failed;
+		}
+		return false;
 	}
-	else if (shaderType == GL_FRAGMENT_SHADER)
+
+	if (!job->m_CachePath.empty() && !stale)
 	{
-		m_Ps[shaderName] = shaderObj;
+		SaveBinary(program, job->m_CachePath, job->m_Key);
 	}
-	else
+	if (job->m_bReload)
 	{
-		m_Gs[shaderName] = shaderObj;
+		SwapReloaded(prog, job, linkedStages);
 	}
 
+	prog.m_Status = PS_Ready;
+	ReflectProgram(prog);
+	ApplyBindings(prog);
+	m_DrawSlots[job->m_Handle].m_Program = prog.m_Program;
+	DEBUG_MESSAGE(RAY_MESSAGE, "Program %s linked: %d uniforms, %d uniform blocks, %d attributes, %.2f ms", progName.c_str(),
+		(int)prog.m_Uniforms.size(), (int)prog.m_UniformBlocks.size(), (int)prog.m_Attributes.size(),
+		chrono::duration<double, milli>(chrono::high_resolution_clock::now() - job->m_Start).count());
 	return true;
 }
 
-bool ShaderManager::LinkShaders(std::string& progName)
+void ShaderManager::SwapReloaded(Program& prog, CompileJob* job, const GLuint* stages)
 {
-	GLint success = 0;
-	GLchar ErrorLog[1024] = {0};
-	GLuint program = m_Programs[progName].m_Program;
+	//the live program keeps its GL name, so draws holding it pick up the new code on their next use
+	DetachStages(prog);
+	if (job->m_CachePath.empty() || !LoadBinary(prog, job->m_CachePath, job->m_Key))
+	{
+		//no binary to move over, link the stages that just linked again
+		for (int i = 0; i < SS_Count; ++i)
+		{
+			if (stages[i] != 0)
+			{
+				glAttachShader(prog.m_Program, stages[i]);
+				prog.m_Stages[i] = stages[i];
+			}
+		}
+		glLinkProgram(prog.m_Program);
+	}
+	glDeleteProgram(job->m_Program);
+}
 
-	glLinkProgram(program);
-	glGetProgramiv(program, GL_LINK_STATUS, &success);
-	if (success == 0)
+/**
+	strip the "[0]" suffix GL reports for array uniforms and attributes
+**/
+static string TrimArrayName(const GLchar* name)
+{
+	string ret(name);
+	size_t pos = ret.find('[');
+	if (pos != string::npos)
 	{
-		glGetProgramInfoLog(program, sizeof(ErrorLog), NULL, ErrorLog);
-		fprintf(stderr, "Error linking shader program: '%s'\n", ErrorLog);
-		return false;
+		ret.erase(pos);
 	}
+	return ret;
+}
 
-#ifdef DEBUG_MODE
-	glValidateProgram(program);
-	glGetProgramiv(program, GL_VALIDATE_STATUS, &success);
-	if (!success) {
-		glGetProgramInfoLog(program, sizeof(ErrorLog), NULL, ErrorLog);
-		fprintf(stderr, "Invalid shader program: '%s'\n", ErrorLog);
+void ShaderManager::ReflectProgram(Program& prog)
+{
+	GLuint program = prog.m_Program;
+	GLchar name[256];
+	GLint count = 0;
+
+	prog.m_Uniforms.clear();
+	prog.m_UniformBlocks.clear();
+	prog.m_Attributes.clear();
+
+	//Uniforms living in the default block, block members have no location
+	glGetProgramiv(program, GL_ACTIVE_UNIFORMS, &count);
+	for (GLint i = 0; i < count; ++i)
+	{
+		ShaderUniform uniform;
+		glGetActiveUniform(program, i, sizeof(name), NULL, &uniform.m_Size, &uniform.m_Type, name);
+		uniform.m_Location = glGetUniformLocation(program, name);
+		if (uniform.m_Location < 0)
+			continue;
+
+		uniform.m_Name = TrimArrayName(name);
+		prog.m_Uniforms.push_back(uniform);
+	}
+
+	//Uniform blocks
+	glGetProgramiv(program, GL_ACTIVE_UNIFORM_BLOCKS, &count);
+	for (GLint i = 0; i < count; ++i)
+	{
+		ShaderUniformBlock block;
+		glGetActiveUniformBlockName(program, i, sizeof(name), NULL, name);
+		glGetActiveUniformBlockiv(program, i, GL_UNIFORM_BLOCK_DATA_SIZE, &block.m_DataSize);
+		block.m_Name = name;
+		block.m_Index = i;
+		prog.m_UniformBlocks.push_back(block);
+	}
+
+	//Vertex attributes, built-ins like gl_VertexID have no location
+	glGetProgramiv(program, GL_ACTIVE_ATTRIBUTES, &count);
+	for (GLint i = 0; i < count; ++i)
+	{
+		ShaderAttribute attrib;
+		glGetActiveAttrib(program, i, sizeof(name), NULL, &attrib.m_Size, &attrib.m_Type, name);
+		attrib.m_Location = glGetAttribLocation(program, name);
+		if (attrib.m_Location < 0)
+			continue;
+
+		attrib.m_Name = TrimArrayName(name);
+		prog.m_Attributes.push_back(attrib);
+	}
+}
+
+const Program* ShaderManager::GetProgram(const std::string& progName) const
+{
+	return GetProgram(GetProgramHandle(progName));
+}
+
+const Program* ShaderManager::GetProgram(ProgramHandle program) const
+{
+	if (program == 0 || program >= m_Programs.size())
+		return nullptr;
+
+	return &m_Programs[program];
+}
+
+GLint ShaderManager::GetUniformLocation(const std::string& progName, const std::string& uniformName) const
+{
+	const Program* prog = GetProgram(progName);
+	if (prog == nullptr)
+		return -1;
+
+	for (auto& uniform : prog->m_Uniforms)
+	{
+		if (uniform.m_Name == uniformName)
+			return uniform.m_Location;
+	}
+
+	DEBUG_MESSAGE(RAY_EXCEPTION, "uniform %s is not active in program %s", uniformName.c_str(), progName.c_str());
+	return -1;
+}
+
+GLint ShaderManager::GetUniformBlockIndex(const std::string& progName, const std::string& blockName) const
+{
+	const Program* prog = GetProgram(progName);
+	if (prog == nullptr)
+		return -1;
+
+	for (auto& block : prog->m_UniformBlocks)
+	{
+		if (block.m_Name == blockName)
+			return block.m_Index;
+	}
+	return -1;
+}
+
+GLint ShaderManager::GetAttributeLocation(const std::string& progName, const std::string& attribName) const
+{
+	const Program* prog = GetProgram(progName);
+	if (prog == nullptr)
+		return -1;
+
+	for (auto& attrib : prog->m_Attributes)
+	{
+		if (attrib.m_Name == attribName)
+			return attrib.m_Location;
+	}
+	return -1;
+}
+
+void ShaderManager::EnableShader(std::string& progName)
+{
+	const ProgramHandle handle = GetProgramHandle(progName);
+	if (handle == 0)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "program %s does not exist", progName.c_str());
+		return;
+	}
+	EnableShader(handle);
+}
+
+void ShaderManager::EnableShader(ProgramHandle program)
+{
+	OpenGLStateCache::getInstancePtr()->UseProgram(m_Programs[program].m_Program);
+	m_CurrentProgram = program;
+}
+
+bool ShaderManager::BindUniformBlock(const std::string& progName, const std::string& blockName, GLuint bindingPoint)
+{
+	const ProgramHandle handle = GetProgramHandle(progName);
+	if (handle == 0)
 		return false;
+
+	Program& prog = m_Programs[handle];
+	const NameId block = m_Names.Intern(blockName);
+	bool found = false;
+	for (auto& binding : prog.m_BlockBindings)
+	{
+		if (binding.first == block)
+		{
+			binding.second = bindingPoint;
+			found = true;
+		}
 	}
-#endif
-	
+	if (!found)
+	{
+		prog.m_BlockBindings.push_back(make_pair(block, bindingPoint));
+	}
+	if (prog.m_Status != PS_Ready)
+		return true;
+
+	GLint blockIndex = GetUniformBlockIndex(progName, blockName);
+	if (blockIndex < 0)
+		return false;
+
+	glUniformBlockBinding(prog.m_Program, blockIndex, bindingPoint);
 	return true;
 }
 
-void ShaderManager::EnableShader(std::string& progName)
+bool ShaderManager::BindSampler(const std::string& progName, const std::string& samplerName, GLint unit)
 {
-	Program program = m_Programs[progName];
-	glUseProgram(program.m_Program);
-	m_CurrentProgram = program.m_Program;
-	m_CurrentVS = program.m_VS;
-	m_CurrentPS = program.m_PS;
-	m_CurrentGS = program.m_GS;
+	const ProgramHandle handle = GetProgramHandle(progName);
+	if (handle == 0)
+		return false;
+
+	Program& prog = m_Programs[handle];
+	const NameId sampler = m_Names.Intern(samplerName);
+	bool found = false;
+	for (auto& binding : prog.m_SamplerBindings)
+	{
+		if (binding.first == sampler)
+		{
+			binding.second = unit;
+			found = true;
+		}
+	}
+	if (!found)
+	{
+		prog.m_SamplerBindings.push_back(make_pair(sampler, unit));
+	}
+	if (prog.m_Status != PS_Ready)
+		return true;
+
+	GLint location = GetUniformLocation(progName, samplerName);
+	if (location < 0)
+		return false;
+
+	OpenGLStateCache::getInstancePtr()->UseProgram(prog.m_Program);
+	glUniform1i(location, unit);
+	return true;
 }
 
+void ShaderManager::ApplyBindings(Program& prog)
+{
+	for (auto& binding : prog.m_BlockBindings)
+	{
+		const string& blockName = m_Names.GetName(binding.first);
+		for (auto& block : prog.m_UniformBlocks)
+		{
+			if (block.m_Name == blockName)
+			{
+				glUniformBlockBinding(prog.m_Program, block.m_Index, binding.second);
+			}
+		}
+	}
+	//variants share their effect's bindings, samplers a variant compiled out are skipped quietly
+	for (auto& binding : prog.m_SamplerBindings)
+	{
+		const string& samplerName = m_Names.GetName(binding.first);
+		for (auto& uniform : prog.m_Uniforms)
+		{
+			if (uniform.m_Name == samplerName)
+			{
+				OpenGLStateCache::getInstancePtr()->UseProgram(prog.m_Program);
+				glUniform1i(uniform.m_Location, binding.second);
+			}
+		}
+	}
+}
@@ -1,21 +1,100 @@
 //===========================================================================
 // Shader: abstrcat base class for creating shaders and config shaders.
+// Programs are looked up by name while loading and drawn by handle.
 //===========================================================================
 
 #pragma once
 #include <string>
-#include <map>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include "../../Config/WindowPlatform.h"
+#include "../../Engine/ShaderPreprocessor.h"
+#include "../../Tools/FileWatcher.h"
+#include "../../Tools/NameTable.h"
 #include "../../Tools/Singleton.h"
 
 //opengl
 #include <GL/glew.h>
 
+struct GLFWwindow;
+struct CompileJob;
+
+/* index into the program table, 0 is no program and draws as GL program 0 */
+typedef uint32 ProgramHandle;
+/* index into the compiled stage table, 0 is none */
+typedef uint32 ShaderHandle;
+
+enum ShaderStage
+{
+	SS_Vertex,
+	SS_Pixel,
+	SS_Geometry,
+	SS_Count,
+};
+
+/**
+ * Reflected information of an active uniform, filled after linking.
+ */
+struct ShaderUniform
+{
+	std::string m_Name;
+	GLint m_Location;
+	GLenum m_Type;
+	GLint m_Size;
+};
+
+/**
+ * Reflected information of an active uniform block.
+ */
+struct ShaderUniformBlock
+{
+	std::string m_Name;
+	GLuint m_Index;
+	GLint m_DataSize;
+};
+
+/**
+ * Reflected information of an active vertex attribute.
+ */
+struct ShaderAttribute
+{
+	std::string m_Name;
+	GLint m_Location;
+	GLenum m_Type;
+	GLint m_Size;
+};
+
+enum ProgramStatus
+{
+	PS_Unlinked,
+	PS_Compiling,	//queued, draws use the fallback
+	PS_Ready,
+	PS_Failed,		//draws keep the fallback
+};
+
 struct Program
 {
 	GLuint m_Program;
-	GLuint m_VS; //the vs bounded to this program
-	GLuint m_PS; //the ps bounded to this program
-	GLuint m_GS; //the gs bounded to this program
+	GLuint m_Stages[SS_Count]; //the shaders bounded to this program, 0 when it was loaded as a binary
+	NameId m_Name;
+	NameId m_StageNames[SS_Count]; //the stages linked at LinkShaders, NoName if unset
+	ProgramStatus m_Status;
+	uint32 m_Features; //ShaderFeature bits defined in every stage
+	uint32 m_SortId; //effect index above the feature bits, the shader field of a sort key
+	ProgramHandle m_Fallback; //drawn while this program compiles
+	std::vector<NameId> m_Files; //everything its stages were built from, includes too
+
+	//bindings asked for before the link finished are applied once it does, and after every relink
+	std::vector<std::pair<NameId, GLuint>> m_BlockBindings;
+	std::vector<std::pair<NameId, GLint>> m_SamplerBindings;
+
+	//reflection tables, rebuilt every time the program is linked
+	std::vector<ShaderUniform> m_Uniforms;
+	std::vector<ShaderUniformBlock> m_UniformBlocks;
+	std::vector<ShaderAttribute> m_Attributes;
 };
 
 class ShaderManager : public Singleton<ShaderManager>
@@ -24,7 +103,11 @@ public:
 	ShaderManager();
 	~ShaderManager();
 
-	void CreateEffect(std::string& progName);
+	/**
+	 * The string api is for loading: resolve a program's handle once and keep
+	 * it, the render path only passes handles around.
+	 */
+	ProgramHandle CreateEffect(std::string& progName);
 	void AddVertexShader(std::string& vsName);
 	void AddPixelShader(std::string& psName);
 	void AddGeometrySahder(std::string& gsName);
@@ -42,23 +125,175 @@ public:
 	const std::string GetCurrentGSName() const;
 
 	const GLuint GetCurrentProg() const;
+	const ProgramHandle GetCurrentHandle() const;
 	const GLuint GetCurrentVS() const;
 	const GLuint GetCurrentPS() const;
 	const GLuint GetCurrentGS() const;
 
+	/**
+	 * Loads the program's binary from the cache, or compiles its stages and
+	 * links them, then stores the binary for the next run.
+	 */
 	bool LinkShaders(std::string& progName);
 	void EnableShader(std::string& shaderName);
+	void EnableShader(ProgramHandle program);
+
+	/**
+	 * Queues the link and returns at once, a cached binary still loads right
+	 * away. Until Update sees the program finished, draws using it get the
+	 * fallback program instead, which should be linked already. Without
+	 * parallel compile support or a compile context it links on the spot.
+	 */
+	void LinkShadersAsync(std::string& progName, const std::string& fallbackName);
+
+	/**
+	 * Queued links use KHR_parallel_shader_compile when the driver has it,
+	 * otherwise a thread making compileContext current, a hidden window
+	 * sharing objects with the main one. Null leaves only the driver path.
+	 */
+	void InitAsyncCompile(GLFWwindow* compileContext);
+
+	/* finishes the queued links that are done and relinks edited programs, once a frame on the thread owning the context */
+	void Update();
+
+	/**
+	 * Watches the shader directory. An edited source is read again and its
+	 * programs are linked into scratch programs; one that links replaces
+	 * the running code under the same GL name, one that fails is dropped
+	 * and the running version stays.
+	 */
+	bool EnableHotReload();
+
+	/* the GL program to draw program with, its fallback while it compiles, 0 without one */
+	GLuint GetDrawProgram(ProgramHandle program)
+	{
+		const DrawSlot& slot = m_DrawSlots[program];
+		if (slot.m_bLinkOnDraw)
+			return ResolveDrawProgram(program);
+		return slot.m_Program;
+	}
+
+	/**
+	 * The variant of an effect built with the given ShaderFeature bits, its
+	 * name is GetVariantName(progName, features). It shares the stage names
+	 * and bindings the effect has at that point and links the first time
+	 * GetDrawProgram sees it, drawing with fallbackName (the effect's own
+	 * fallback if empty) until then. Features 0 is the effect itself.
+	 */
+	ProgramHandle GetVariant(const std::string& progName, uint32 features, const std::string& fallbackName = std::string());
+	static std::string GetVariantName(const std::string& progName, uint32 features);
+
+	ProgramStatus GetStatus(const std::string& progName) const;
+	uint32 GetPendingCount() const { return (uint32)m_PendingJobs.size(); }
+
+	/* where linked program binaries are kept, empty compiles every program from source */
+	void SetBinaryCache(const std::string& directory) { m_BinaryCache = directory; }
+
+	/**
+	 * Reflection queries, they only look into the tables built at link time and
+	 * never call into the driver. Resolve the handles once after linking and
+	 * keep them, -1 (GL's "no location") is returned for unknown names.
+	 */
+	const Program* GetProgram(const std::string& progName) const;
+	const Program* GetProgram(ProgramHandle program) const;
+	/* 0 for unknown names */
+	ProgramHandle GetProgramHandle(const std::string& progName) const;
+	GLint GetUniformLocation(const std::string& progName, const std::string& uniformName) const;
+	GLint GetUniformBlockIndex(const std::string& progName, const std::string& blockName) const;
+	GLint GetAttributeLocation(const std::string& progName, const std::string& attribName) const;
+
+	/* connects a uniform block to a global binding point, applied when the program is linked */
+	bool BindUniformBlock(const std::string& progName, const std::string& blockName, GLuint bindingPoint);
+
+	/* points a sampler at a texture unit, leaves the program in use if it's linked */
+	bool BindSampler(const std::string& progName, const std::string& samplerName, GLint unit);
 
 private:
-	bool ReadFile(std::string fileName, std::string& outFile);
-	bool CompileShader(std::string& shaderName, GLenum shaderType);
+	/**
+	 * What draws of a program use, kept apart from Program so the render
+	 * path reads one small array.
+	 */
+	struct DrawSlot
+	{
+		GLuint m_Program; //the program itself once it's ready, else its fallback or 0
+		bool m_bLinkOnDraw; //a variant nobody linked yet
+	};
+
+	/**
+	 * A stage compiled with one set of features, shared by every program
+	 * linking it. Its shader is 0 after an edit until a link compiles it again.
+	 */
+	struct CompiledShader
+	{
+		NameId m_Name;
+		ShaderStage m_Stage;
+		uint32 m_Features;
+		GLuint m_Shader;
+		uint32 m_Generation; //bumped by every edit, links started before it don't hand their copy back
+	};
+
+	/* reads the source of a stage, it's only compiled when a link needs it */
+	bool AddSource(const std::string& shaderName, ShaderStage stage);
+	/* starts the link of a variant drawn for the first time */
+	GLuint ResolveDrawProgram(ProgramHandle program);
+	/* draws use the program once it's ready, fallback until then */
+	void SetDrawProgram(ProgramHandle program, ProgramHandle fallback);
+	void ReflectProgram(Program& program);
+	void ApplyBindings(Program& program);
+	bool LinkShaders(ProgramHandle program);
+	void LinkShadersAsync(ProgramHandle program, ProgramHandle fallback);
+	void SetStage(const std::string& stageName, const std::string& programName, ShaderStage stage);
+
+	/* what a link needs, copied out so another context can run it */
+	CompileJob* PrepareJob(ProgramHandle program, bool reload);
+	/* issues the job, queues it for Update, or finishes it on the spot without async support */
+	void StartJob(CompileJob* job);
+	/* takes in the stages the job compiled and checks the results, true if the program linked */
+	bool FinishJob(CompileJob* job);
+	/* moves a reloaded program's code into the live program */
+	void SwapReloaded(Program& program, CompileJob* job, const GLuint* stages);
+	void ReloadSources(const std::vector<std::string>& changed);
+	void CompileThreadMain();
+
+	/* the key covers the driver and the preprocessed source of every stage */
+	uint64 GetBinaryKey(const std::string* sources);
+	bool LoadBinary(Program& program, const std::string& path, uint64 key);
+	void SaveBinary(GLuint program, const std::string& path, uint64 key);
+
+	/* the stage compiled from name with features, 0 if it never was */
+	ShaderHandle FindShader(NameId name, ShaderStage stage, uint32 features) const;
+	ShaderHandle AddShader(NameId name, ShaderStage stage, uint32 features);
+	static uint64 GetShaderKey(NameId name, ShaderStage stage, uint32 features);
+	static std::string GetShaderFile(const std::string& shaderName, ShaderStage stage);
 
 private:
-	GLuint m_CurrentProgram;
-	GLuint m_CurrentVS, m_CurrentPS, m_CurrentGS;
+	ProgramHandle m_CurrentProgram;
+
+	//dense tables indexed by handle, entry 0 stands for none
+	std::vector<Program> m_Programs;
+	std::vector<DrawSlot> m_DrawSlots;
+	std::vector<CompiledShader> m_Shaders;
+
+	//reverse indices, only used while loading
+	NameTable m_Names;
+	std::vector<ProgramHandle> m_ProgramsByName; //by NameId
+	std::unordered_map<uint64, ShaderHandle> m_ShadersByKey; //by GetShaderKey
+	uint32 m_EffectCount;
+
+	ShaderPreprocessor m_Preprocessor;
+	std::string m_BinaryCache;
+	std::string m_Driver; //vendor, renderer and version
+
+	std::vector<CompileJob*> m_PendingJobs; //queued links, owned by the context thread
+
+	FileWatcher m_Watcher;
+	std::vector<ProgramHandle> m_StalePrograms; //sources changed, relinked once they aren't busy
 
-	std::map<std::string, Program> m_Programs;
-	std::map<std::string, GLuint> m_Vs;
-	std::map<std::string, GLuint> m_Ps;
-	std::map<std::string, GLuint> m_Gs;
+	//shared context path, jobs are handed over and flagged done by the compile thread
+	GLFWwindow* m_CompileContext;
+	std::thread m_CompileThread;
+	std::mutex m_CompileMutex;
+	std::condition_variable m_CompileCondition;
+	std::vector<CompileJob*> m_CompileQueue;
+	bool m_bCompileQuit;
 };
\ No newline at end of file
@@ -0,0 +1,104 @@
+#include "OpenGLStateCache.h"
+#include "../../Tools/RayUtils.h"
+
+template<> OpenGLStateCache* Singleton<OpenGLStateCache>::m_pSingleton = nullptr;
+
+OpenGLStateCache::OpenGLStateCache()
+{
+	DEBUG_MESSAGE(RAY_MESSAGE, "OpenGL StateCache Start...");
+	Invalidate();
+
+	m_Frame.m_Issued = m_Frame.m_Filtered = 0;
+	m_LastFrame = m_Frame;
+}
+
+OpenGLStateCache::~OpenGLStateCache()
+{
+}
+
+void OpenGLStateCache::Invalidate()
+{
+	m_Program = Unknown;
+	m_VertexArray = Unknown;
+	for (int i = 0; i < BS_Count; ++i)
+	{
+		m_Buffers[i] = Unknown;
+	}
+
+	for (int i = 0; i < MaxUniformBindings; ++i)
+	{
+		m_UniformRanges[i].m_Buffer = Unknown;
+		m_UniformRanges[i].m_Offset = 0;
+		m_UniformRanges[i].m_Size = 0;
+	}
+
+	m_ActiveUnit = Unknown;
+	for (int i = 0; i < MaxTextureUnits; ++i)
+	{
+		m_Textures[i] = Unknown;
+		m_TextureTargets[i] = GL_NONE;
+	}
+
+	m_EnabledAttribs = 0;
+	m_KnownAttribs = 0;
+
+	m_Blend = m_DepthTest = m_DepthWrite = m_Cull = -1;
+	m_BlendSrc = m_BlendDst = m_DepthFunc = m_CullFace = GL_NONE;
+}
+
+void OpenGLStateCache::OnBufferDeleted(GLuint buffer)
+{
+	for (int i = 0; i < BS_Count; ++i)
+	{
+		if (m_Buffers[i] == buffer)
+			m_Buffers[i] = 0;
+	}
+
+	for (int i = 0; i < MaxUniformBindings; ++i)
+	{
+		if (m_UniformRanges[i].m_Buffer == buffer)
+			m_UniformRanges[i].m_Buffer = 0;
+	}
+}
+
+void OpenGLStateCache::OnTextureDeleted(GLuint texture)
+{
+	for (int i = 0; i < MaxTextureUnits; ++i)
+	{
+		if (m_Textures[i] == texture)
+			m_Textures[i] = 0;
+	}
+}
+
+void OpenGLStateCache::OnVertexArrayDeleted(GLuint vao)
+{
+	if (m_VertexArray == vao)
+	{
+		m_VertexArray = 0;
+		m_Buffers[BS_ElementArray] = Unknown;
+		m_EnabledAttribs = 0;
+		m_KnownAttribs = 0;
+	}
+}
+
+void OpenGLStateCache::EndFrame()
+{
+	m_LastFrame = m_Frame;
+	m_Frame.m_Issued = 0;
+	m_Frame.m_Filtered = 0;
+}
+
+int OpenGLStateCache::GetBufferSlot(GLenum target)
+{
+	switch (target)
+	{
+	case GL_ARRAY_BUFFER:			return BS_Array;
+	case GL_ELEMENT_ARRAY_BUFFER:	return BS_ElementArray;
+	case GL_UNIFORM_BUFFER:			return BS_Uniform;
+	case GL_PIXEL_UNPACK_BUFFER:	return BS_PixelUnpack;
+	case GL_DRAW_INDIRECT_BUFFER:	return BS_DrawIndirect;
+	case GL_COPY_READ_BUFFER:		return BS_CopyRead;
+	case GL_COPY_WRITE_BUFFER:		return BS_CopyWrite;
+	default:						return -1;
+	}
+}
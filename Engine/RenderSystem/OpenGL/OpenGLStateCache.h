@@ -0,0 +1,275 @@
+//===========================================================================
+// OpenGLStateCache: shadows the GL binding/render states and drops calls
+// that would not change anything.
+//===========================================================================
+
+#pragma once
+#include "../../Tools/Singleton.h"
+#include "../../Config/RayConifg.h"
+#include "../../Config/WindowPlatform.h"
+#include <GL/glew.h>
+
+struct StateCacheStats
+{
+	uint32 m_Issued;   //calls forwarded to the driver
+	uint32 m_Filtered; //redundant calls dropped by the cache
+};
+
+class OpenGLStateCache : public Singleton<OpenGLStateCache>
+{
+public:
+	OpenGLStateCache();
+	~OpenGLStateCache();
+
+	/* forget everything, next call of every kind goes to the driver */
+	void Invalidate();
+
+	/* deleting a bound object resets its bindings to 0 in GL, mirror that */
+	void OnBufferDeleted(GLuint buffer);
+	void OnTextureDeleted(GLuint texture);
+	void OnVertexArrayDeleted(GLuint vao);
+
+	FORCEINLINE void UseProgram(GLuint program);
+	FORCEINLINE void BindVertexArray(GLuint vao);
+	FORCEINLINE void BindBuffer(GLenum target, GLuint buffer);
+	FORCEINLINE void BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size);
+	FORCEINLINE void BindTexture(GLuint unit, GLenum target, GLuint texture);
+
+	FORCEINLINE void EnableVertexAttribArray(GLuint index);
+	FORCEINLINE void DisableVertexAttribArray(GLuint index);
+
+	FORCEINLINE void SetBlend(bool enable);
+	FORCEINLINE void SetBlendFunc(GLenum src, GLenum dst);
+	FORCEINLINE void SetDepthTest(bool enable);
+	FORCEINLINE void SetDepthFunc(GLenum func);
+	FORCEINLINE void SetDepthMask(bool write);
+	FORCEINLINE void SetCull(bool enable);
+	FORCEINLINE void SetCullFace(GLenum face);
+
+	/* latches the counters of the finished frame and starts a new one */
+	void EndFrame();
+	const StateCacheStats& GetLastFrameStats() const { return m_LastFrame; }
+
+private:
+	enum BufferSlot
+	{
+		BS_Array,
+		BS_ElementArray,
+		BS_Uniform,
+		BS_PixelUnpack,
+		BS_DrawIndirect,
+		BS_CopyRead,
+		BS_CopyWrite,
+		BS_Count
+	};
+
+	static const GLuint Unknown = 0xFFFFFFFF;
+	static const int MaxTextureUnits = 16;
+	static const int MaxUniformBindings = 16;
+
+	static int GetBufferSlot(GLenum target);
+	FORCEINLINE void SetCapability(GLenum cap, bool enable, int& cached);
+
+	FORCEINLINE bool Filter(bool redundant)
+	{
+		redundant ? ++m_Frame.m_Filtered : ++m_Frame.m_Issued;
+		return redundant;
+	}
+
+private:
+	GLuint m_Program;
+	GLuint m_VertexArray;
+	GLuint m_Buffers[BS_Count];
+
+	struct BufferRange
+	{
+		GLuint m_Buffer;
+		GLintptr m_Offset;
+		GLsizeiptr m_Size;
+	};
+	BufferRange m_UniformRanges[MaxUniformBindings];
+
+	GLuint m_ActiveUnit;
+	GLuint m_Textures[MaxTextureUnits];
+	GLenum m_TextureTargets[MaxTextureUnits];
+
+	//attribute arrays belong to the vertex array, the mask is reset with it
+	uint32 m_EnabledAttribs;
+	uint32 m_KnownAttribs;
+
+	//-1 unknown, 0 disabled, 1 enabled
+	int m_Blend, m_DepthTest, m_DepthWrite, m_Cull;
+	GLenum m_BlendSrc, m_BlendDst, m_DepthFunc, m_CullFace;
+
+	StateCacheStats m_Frame;
+	StateCacheStats m_LastFrame;
+};
+
+FORCEINLINE void OpenGLStateCache::UseProgram(GLuint program)
+{
+	if (Filter(m_Program == program))
+		return;
+
+	glUseProgram(program);
+	m_Program = program;
+}
+
+FORCEINLINE void OpenGLStateCache::BindVertexArray(GLuint vao)
+{
+	if (Filter(m_VertexArray == vao))
+		return;
+
+	glBindVertexArray(vao);
+	m_VertexArray = vao;
+
+	//element buffer and attribute enables are vertex array state
+	m_Buffers[BS_ElementArray] = Unknown;
+	m_EnabledAttribs = 0;
+	m_KnownAttribs = 0;
+}
+
+FORCEINLINE void OpenGLStateCache::BindBuffer(GLenum target, GLuint buffer)
+{
+	int slot = GetBufferSlot(target);
+	if (slot >= 0 && Filter(m_Buffers[slot] == buffer))
+		return;
+
+	glBindBuffer(target, buffer);
+	if (slot >= 0)
+	{
+		m_Buffers[slot] = buffer;
+	}
+	else
+	{
+		++m_Frame.m_Issued;
+	}
+}
+
+FORCEINLINE void OpenGLStateCache::BindBufferRange(GLenum target, GLuint index, GLuint buffer, GLintptr offset, GLsizeiptr size)
+{
+	if (target == GL_UNIFORM_BUFFER && index < MaxUniformBindings)
+	{
+		BufferRange& range = m_UniformRanges[index];
+		if (Filter(range.m_Buffer == buffer && range.m_Offset == offset && range.m_Size == size))
+			return;
+
+		range.m_Buffer = buffer;
+		range.m_Offset = offset;
+		range.m_Size = size;
+		//the indexed bind also replaces the generic binding
+		m_Buffers[BS_Uniform] = buffer;
+	}
+	else
+	{
+		++m_Frame.m_Issued;
+	}
+
+	glBindBufferRange(target, index, buffer, offset, size);
+}
+
+FORCEINLINE void OpenGLStateCache::BindTexture(GLuint unit, GLenum target, GLuint texture)
+{
+	if (unit >= MaxTextureUnits)
+	{
+		++m_Frame.m_Issued;
+		glActiveTexture(GL_TEXTURE0 + unit);
+		glBindTexture(target, texture);
+		m_ActiveUnit = unit;
+		return;
+	}
+
+	if (Filter(m_Textures[unit] == texture && m_TextureTargets[unit] == target))
+		return;
+
+	if (m_ActiveUnit != unit)
+	{
+		glActiveTexture(GL_TEXTURE0 + unit);
+		m_ActiveUnit = unit;
+	}
+	glBindTexture(target, texture);
+	m_Textures[unit] = texture;
+	m_TextureTargets[unit] = target;
+}
+
+FORCEINLINE void OpenGLStateCache::EnableVertexAttribArray(GLuint index)
+{
+	uint32 bit = 1u << index;
+	if (Filter((m_KnownAttribs & bit) && (m_EnabledAttribs & bit)))
+		return;
+
+	glEnableVertexAttribArray(index);
+	m_KnownAttribs |= bit;
+	m_EnabledAttribs |= bit;
+}
+
+FORCEINLINE void OpenGLStateCache::DisableVertexAttribArray(GLuint index)
+{
+	uint32 bit = 1u << index;
+	if (Filter((m_KnownAttribs & bit) && !(m_EnabledAttribs & bit)))
+		return;
+
+	glDisableVertexAttribArray(index);
+	m_KnownAttribs |= bit;
+	m_EnabledAttribs &= ~bit;
+}
+
+FORCEINLINE void OpenGLStateCache::SetCapability(GLenum cap, bool enable, int& cached)
+{
+	if (Filter(cached == (enable ? 1 : 0)))
+		return;
+
+	enable ? glEnable(cap) : glDisable(cap);
+	cached = enable ? 1 : 0;
+}
+
+FORCEINLINE void OpenGLStateCache::SetBlend(bool enable)
+{
+	SetCapability(GL_BLEND, enable, m_Blend);
+}
+
+FORCEINLINE void OpenGLStateCache::SetBlendFunc(GLenum src, GLenum dst)
+{
+	if (Filter(m_BlendSrc == src && m_BlendDst == dst))
+		return;
+
+	glBlendFunc(src, dst);
+	m_BlendSrc = src;
+	m_BlendDst = dst;
+}
+
+FORCEINLINE void OpenGLStateCache::SetDepthTest(bool enable)
+{
+	SetCapability(GL_DEPTH_TEST, enable, m_DepthTest);
+}
+
+FORCEINLINE void OpenGLStateCache::SetDepthFunc(GLenum func)
+{
+	if (Filter(m_DepthFunc == func))
+		return;
+
+	glDepthFunc(func);
+	m_DepthFunc = func;
+}
+
+FORCEINLINE void OpenGLStateCache::SetDepthMask(bool write)
+{
+	if (Filter(m_DepthWrite == (write ? 1 : 0)))
+		return;
+
+	glDepthMask(write ? GL_TRUE : GL_FALSE);
+	m_DepthWrite = write ? 1 : 0;
+}
+
+FORCEINLINE void OpenGLStateCache::SetCull(bool enable)
+{
+	SetCapability(GL_CULL_FACE, enable, m_Cull);
+}
+
+FORCEINLINE void OpenGLStateCache::SetCullFace(GLenum face)
+{
+	if (Filter(m_CullFace == face))
+		return;
+
+	glCullFace(face);
+	m_CullFace = face;
+}
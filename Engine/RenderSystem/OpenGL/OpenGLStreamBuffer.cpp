@@ -0,0 +1,139 @@
+#include "OpenGLStreamBuffer.h"
+#include "OpenGLExtensions.h"
+#include "OpenGLStateCache.h"
+#include "../../Tools/RayUtils.h"
+
+StreamBuffer::StreamBuffer()
+	: m_Name("")
+	, m_Buffer(0)
+	, m_FrameSize(0)
+	, m_Alignment(1)
+	, m_bPersistent(false)
+	, m_Mapped(nullptr)
+	, m_Frame(0)
+	, m_Cursor(0)
+{
+	for (int i = 0; i < FrameCount; ++i)
+	{
+		m_Fences[i] = 0;
+	}
+}
+
+StreamBuffer::~StreamBuffer()
+{
+	Release();
+}
+
+bool StreamBuffer::Init(const char* name, GLsizeiptr frameSize, GLsizeiptr alignment)
+{
+	m_Name = name;
+	m_Alignment = alignment > 0 ? alignment : 1;
+	m_FrameSize = (frameSize + m_Alignment - 1) / m_Alignment * m_Alignment;
+	GLsizeiptr totalSize = m_FrameSize * FrameCount;
+
+	//created through the copy target, the data is bound wherever the caller needs it
+	glGenBuffers(1, &m_Buffer);
+	OpenGLStateCache::getInstancePtr()->BindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+
+	if (OpenGLExtensions::m_bBufferStorage)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		OpenGLExtensions::BufferStorage(GL_COPY_WRITE_BUFFER, totalSize, NULL, flags);
+		m_Mapped = (uint8*)glMapBufferRange(GL_COPY_WRITE_BUFFER, 0, totalSize, flags);
+		m_bPersistent = (m_Mapped != nullptr);
+	}
+
+	if (!m_bPersistent)
+	{
+		glBufferData(GL_COPY_WRITE_BUFFER, totalSize, NULL, GL_STREAM_DRAW);
+		m_Shadow.resize(totalSize);
+		m_Mapped = &m_Shadow[0];
+	}
+
+	DEBUG_MESSAGE(RAY_MESSAGE, "Stream buffer %s: %d bytes x %d frames, alignment %d, %s", m_Name, (int)m_FrameSize, FrameCount,
+		(int)m_Alignment, m_bPersistent ? "persistent mapped" : "orphaned glBufferSubData");
+	return m_Buffer != 0;
+}
+
+void StreamBuffer::Release()
+{
+	for (int i = 0; i < FrameCount; ++i)
+	{
+		if (m_Fences[i] != 0)
+		{
+			glDeleteSync(m_Fences[i]);
+			m_Fences[i] = 0;
+		}
+	}
+
+	if (m_Buffer != 0)
+	{
+		if (m_bPersistent)
+		{
+			OpenGLStateCache::getInstancePtr()->BindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+			glUnmapBuffer(GL_COPY_WRITE_BUFFER);
+		}
+		glDeleteBuffers(1, &m_Buffer);
+		OpenGLStateCache::getInstancePtr()->OnBufferDeleted(m_Buffer);
+		m_Buffer = 0;
+	}
+
+	m_bPersistent = false;
+	m_Mapped = nullptr;
+	m_Shadow.clear();
+}
+
+void StreamBuffer::BeginFrame()
+{
+	m_Frame = (m_Frame + 1) % FrameCount;
+	m_Cursor = 0;
+
+	GLsync fence = m_Fences[m_Frame];
+	if (fence != 0)
+	{
+		GLenum ret = glClientWaitSync(fence, 0, 0);
+		while (ret == GL_TIMEOUT_EXPIRED)
+		{
+			ret = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+		}
+		glDeleteSync(fence);
+		m_Fences[m_Frame] = 0;
+	}
+}
+
+void StreamBuffer::Flush()
+{
+	GLsizeiptr used = m_Cursor < m_FrameSize ? (GLsizeiptr)m_Cursor : m_FrameSize;
+	if (m_bPersistent || used == 0)
+		return;
+
+	/* orphan first, the driver hands out fresh storage instead of syncing with
+	   draws still reading the previous frames */
+	GLintptr regionOffset = m_Frame * m_FrameSize;
+	OpenGLStateCache::getInstancePtr()->BindBuffer(GL_COPY_WRITE_BUFFER, m_Buffer);
+	glBufferData(GL_COPY_WRITE_BUFFER, m_FrameSize * FrameCount, NULL, GL_STREAM_DRAW);
+	glBufferSubData(GL_COPY_WRITE_BUFFER, regionOffset, used, m_Mapped + regionOffset);
+}
+
+void StreamBuffer::EndFrame()
+{
+	//orphaned storage is never rewritten in place, only the mapping needs fencing
+	if (m_bPersistent)
+	{
+		m_Fences[m_Frame] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+void* StreamBuffer::Allocate(GLsizeiptr size, GLintptr& outOffset)
+{
+	GLsizeiptr alignedSize = (size + m_Alignment - 1) / m_Alignment * m_Alignment;
+	GLsizeiptr offset = m_Cursor.fetch_add(alignedSize);
+	if (offset + alignedSize > m_FrameSize)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "stream buffer %s exhausted, %d bytes per frame", m_Name, (int)m_FrameSize);
+		return nullptr;
+	}
+
+	outOffset = m_Frame * m_FrameSize + offset;
+	return m_Mapped + outOffset;
+}
@@ -0,0 +1,66 @@
+//===========================================================================
+// StreamBuffer: per-frame dynamic data (constants, instances, indirect
+// commands) written straight into a persistently mapped buffer. The
+// buffer is split into FrameCount regions, each fenced after use so the
+// cpu never overwrites what the gpu is still reading.
+//===========================================================================
+
+#pragma once
+#include "../../Config/WindowPlatform.h"
+#include <GL/glew.h>
+#include <atomic>
+#include <vector>
+
+class StreamBuffer
+{
+public:
+	static const int FrameCount = 3;
+
+	StreamBuffer();
+	~StreamBuffer();
+
+	/**
+	 * frameSize is rounded up to alignment, every allocation starts on a
+	 * multiple of alignment measured from the start of the buffer.
+	 */
+	bool Init(const char* name, GLsizeiptr frameSize, GLsizeiptr alignment);
+	void Release();
+
+	/* waits for the gpu to release the region of this frame */
+	void BeginFrame();
+	/* uploads the written data if the buffer is not persistently mapped */
+	void Flush();
+	/* fences the region so it's not reused while still being read */
+	void EndFrame();
+
+	/**
+	 * Bump allocates from the current frame region. Lock free and safe to
+	 * call from several threads at once, returns the memory to write into
+	 * and its offset in the buffer, or nullptr if the region is exhausted.
+	 */
+	void* Allocate(GLsizeiptr size, GLintptr& outOffset);
+
+	template<typename T>
+	T* Allocate(GLintptr& outOffset, uint32 count = 1)
+	{
+		return static_cast<T*>(Allocate(sizeof(T) * count, outOffset));
+	}
+
+	GLuint GetBuffer() const { return m_Buffer; }
+	GLsizeiptr GetFrameSize() const { return m_FrameSize; }
+	bool IsPersistent() const { return m_bPersistent; }
+
+private:
+	const char* m_Name;
+	GLuint m_Buffer;
+	GLsizeiptr m_FrameSize;
+	GLsizeiptr m_Alignment;
+	bool m_bPersistent;
+
+	uint8* m_Mapped; //persistent mapping or cpu shadow copy
+	std::vector<uint8> m_Shadow;
+
+	int m_Frame;
+	std::atomic<GLsizeiptr> m_Cursor;
+	GLsync m_Fences[FrameCount];
+};
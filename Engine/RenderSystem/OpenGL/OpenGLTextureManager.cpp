@@ -0,0 +1,835 @@
+#include "OpenGLTextureManager.h"
+#include "OpenGLStateCache.h"
+#include "../../Engine/JobSystem.h"
+#include "../../Engine/TextureAtlas.h"
+#include "../../Math/RayMath.h"
+#include "../../Tools/RayUtils.h"
+#include <algorithm>
+
+TextureManager::TextureRecord::TextureRecord()
+	: m_Flags(0)
+	, m_Image(nullptr)
+	, m_Texture(0)
+	, m_State(TS_Loading)
+	, m_bUploading(false)
+	, m_FirstLevel(0)
+	, m_TailLevel(0)
+	, m_WantedLevel(0)
+	, m_TargetLevel(0)
+	, m_LastRequested(0)
+	, m_Priority(0.0f)
+	, m_Pool(InvalidPool)
+	, m_Layer(0)
+	, m_bRegion(false)
+	, m_Atlas(WhiteTexture)
+	, m_UVRect(1.0f, 1.0f, 0.0f, 0.0f)
+{
+}
+
+TextureManager::TextureManager()
+	: m_NextHandle(WhiteTexture + 1)
+	, m_InFlight(0)
+	, m_White(0)
+	, m_Loading(0)
+	, m_Error(0)
+	, m_Anisotropy(1.0f)
+	, m_bTextureStorage(false)
+	, m_Frame(0)
+{
+	memset(&m_Stats, 0, sizeof(m_Stats));
+}
+
+TextureManager::~TextureManager()
+{
+	Release();
+}
+
+bool TextureManager::Init(GLsizeiptr uploadBudget, uint64 residencyBudget)
+{
+	memset(&m_Stats, 0, sizeof(m_Stats));
+	m_Stats.m_BudgetBytes = residencyBudget;
+
+	m_bTextureStorage = GLEW_ARB_texture_storage != 0;
+	if (GLEW_EXT_texture_filter_anisotropic)
+	{
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &m_Anisotropy);
+		m_Anisotropy = Math::Min(m_Anisotropy, 8.0f);
+	}
+
+	static const uint8 white[4] = { 255, 255, 255, 255 };
+	m_White = CreatePlaceholder(white, 1);
+
+	/* grey checks while loading, magenta ones when the file is broken */
+	uint8 loading[8 * 8 * 4];
+	uint8 error[8 * 8 * 4];
+	for (uint32 i = 0; i < 8 * 8; ++i)
+	{
+		const bool odd = ((i % 8) + (i / 8)) % 2 != 0;
+		loading[i * 4] = loading[i * 4 + 1] = loading[i * 4 + 2] = odd ? 96 : 160;
+		loading[i * 4 + 3] = 255;
+		error[i * 4] = error[i * 4 + 2] = odd ? 0 : 255;
+		error[i * 4 + 1] = 0;
+		error[i * 4 + 3] = 255;
+	}
+	m_Loading = CreatePlaceholder(loading, 8);
+	m_Error = CreatePlaceholder(error, 8);
+
+	DEBUG_MESSAGE(RAY_MESSAGE, "Texture manager: %d bytes uploaded per frame, %u KB resident, %s, anisotropy %.0f", (int)uploadBudget,
+		(uint32)(residencyBudget / 1024), m_bTextureStorage ? "immutable storage" : "mutable storage", m_Anisotropy);
+	return m_Staging.Init("texture staging", uploadBudget, 16);
+}
+
+void TextureManager::Release()
+{
+	{
+		//the decode jobs reference this, none may be left running
+		std::unique_lock<std::mutex> lock(m_Mutex);
+		m_Condition.wait(lock, [this]() { return m_InFlight == 0; });
+		for (auto& decoded : m_Decoded)
+		{
+			R_DELETE(decoded.m_Image);
+		}
+		m_Decoded.clear();
+		m_Requests.clear();
+		m_NewRegions.clear();
+		m_Paths.clear();
+	}
+
+	std::vector<GLuint> textures;
+	for (auto& upload : m_Uploads)
+	{
+		textures.push_back(upload.m_Texture);
+	}
+	m_Uploads.clear();
+
+	for (auto& record : m_Records)
+	{
+		textures.push_back(record.m_Texture);
+		R_DELETE(record.m_Image);
+	}
+	m_Records.clear();
+	m_FrameRequests.clear();
+
+	for (const auto& pool : m_Pools)
+	{
+		textures.push_back(pool.m_Texture);
+	}
+	m_Pools.clear();
+
+	textures.push_back(m_White);
+	textures.push_back(m_Loading);
+	textures.push_back(m_Error);
+	OpenGLStateCache* stateCache = OpenGLStateCache::getInstancePtr();
+	for (GLuint texture : textures)
+	{
+		if (texture != 0)
+		{
+			glDeleteTextures(1, &texture);
+			stateCache->OnTextureDeleted(texture);
+		}
+	}
+	m_White = m_Loading = m_Error = 0;
+
+	m_Staging.Release();
+}
+
+TextureHandle TextureManager::Load(const std::string& path, uint32 flags)
+{
+	TextureHandle handle = WhiteTexture;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		auto found = m_Paths.find(path);
+		if (found != m_Paths.end())
+			return found->second;
+
+		handle = m_NextHandle++;
+		m_Paths[path] = handle;
+		++m_InFlight;
+	}
+
+	JobSystem::getInstancePtr()->Submit([this, handle, flags, path]()
+	{
+		DecodedImage decoded;
+		decoded.m_Handle = handle;
+		decoded.m_Flags = flags;
+		decoded.m_Path = path;
+		decoded.m_Image = new Image();
+		if (!ImageLoader::Load(path, *decoded.m_Image))
+		{
+			R_DELETE(decoded.m_Image);
+		}
+		else if ((flags & TF_GenerateMips) != 0 && decoded.m_Image->m_Levels.size() == 1)
+		{
+			ImageLoader::GenerateMips(*decoded.m_Image, (flags & TF_SRGB) != 0);
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_Decoded.push_back(decoded);
+			--m_InFlight;
+		}
+		m_Condition.notify_all();
+	});
+	return handle;
+}
+
+bool TextureManager::LoadAtlas(const std::string& tablePath, std::map<std::string, TextureHandle>& regions, uint32 flags)
+{
+	AtlasTable table;
+	if (!TextureAtlas::ReadTable(tablePath, table))
+		return false;
+
+	const size_t slash = tablePath.find_last_of("/\\");
+	const std::string directory = slash == std::string::npos ? std::string() : tablePath.substr(0, slash + 1);
+	const TextureHandle atlas = Load(directory + table.m_Texture, flags);
+
+	const float invWidth = 1.0f / (float)table.m_Width;
+	const float invHeight = 1.0f / (float)table.m_Height;
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	for (const auto& entry : table.m_Regions)
+	{
+		NewRegion region;
+		region.m_Handle = m_NextHandle++;
+		region.m_Atlas = atlas;
+		region.m_UVRect = Vector4(entry.m_Width * invWidth, entry.m_Height * invHeight, entry.m_X * invWidth, entry.m_Y * invHeight);
+		m_NewRegions.push_back(region);
+		regions[entry.m_Name] = region.m_Handle;
+	}
+	return true;
+}
+
+void TextureManager::Request(TextureHandle handle, float screenPixels)
+{
+	if (handle == WhiteTexture)
+		return;
+
+	TextureRequest request;
+	request.m_Handle = handle;
+	request.m_ScreenPixels = screenPixels;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	m_Requests.push_back(request);
+}
+
+void TextureManager::Update()
+{
+	std::vector<DecodedImage> decodedImages;
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Records.resize(m_NextHandle);
+		decodedImages.swap(m_Decoded);
+		m_FrameRequests.swap(m_Requests);
+		m_Requests.clear();
+
+		for (const auto& region : m_NewRegions)
+		{
+			TextureRecord& record = m_Records[region.m_Handle];
+			record.m_bRegion = true;
+			record.m_Atlas = region.m_Atlas;
+			record.m_UVRect = region.m_UVRect;
+		}
+		m_NewRegions.clear();
+	}
+
+	++m_Frame;
+	for (auto& decoded : decodedImages)
+	{
+		AddDecoded(decoded);
+	}
+
+	for (const auto& request : m_FrameRequests)
+	{
+		//a region covers part of its atlas, which needs as many more texels to give it the size asked for
+		float screenPixels = request.m_ScreenPixels;
+		TextureHandle handle = request.m_Handle;
+		if (handle >= m_Records.size())
+			continue;
+		if (m_Records[handle].m_bRegion)
+		{
+			const Vector4& rect = m_Records[handle].m_UVRect;
+			screenPixels /= Math::Max(Math::Min(rect.X, rect.Y), KINDA_SMALL_NUMBER);
+			handle = m_Records[handle].m_Atlas;
+			if (handle == WhiteTexture)
+				continue;
+		}
+
+		TextureRecord& record = m_Records[handle];
+		if (record.m_LastRequested != m_Frame)
+		{
+			record.m_LastRequested = m_Frame;
+			record.m_Priority = 0.0f;
+		}
+		record.m_Priority = Math::Max(record.m_Priority, screenPixels);
+	}
+
+	UpdateResidency();
+
+	if (m_Uploads.empty())
+		return;
+
+	OpenGLStateCache* stateCache = OpenGLStateCache::getInstancePtr();
+	stateCache->BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	m_Staging.BeginFrame();
+	m_Staged.clear();
+
+	/* copy levels in order until the budget runs out, the rest waits for the next frames */
+	const GLsizeiptr budget = m_Staging.GetFrameSize();
+	GLsizeiptr staged = 0;
+	for (uint32 u = 0; u < m_Uploads.size() && staged < budget; ++u)
+	{
+		PendingUpload& upload = m_Uploads[u];
+		const Image& image = *m_Records[upload.m_Handle].m_Image;
+		while (upload.m_NextLevel < image.m_Levels.size())
+		{
+			const uint32 level = upload.m_NextLevel;
+			const GLsizeiptr size = (GLsizeiptr)image.m_Levels[level].m_Size;
+			if (size > budget)
+			{
+				//larger than the whole staging region, it goes straight from memory in a frame of its own
+				if (staged > 0)
+					break;
+
+				UploadLevel(upload, level, image.GetLevelData(level));
+				++upload.m_NextLevel;
+				staged = budget;
+				break;
+			}
+
+			const GLsizeiptr alignedSize = (size + 15) & ~(GLsizeiptr)15;
+			if (staged + alignedSize > budget)
+			{
+				staged = budget;
+				break;
+			}
+
+			StagedLevel copy;
+			copy.m_Upload = u;
+			copy.m_Level = level;
+			void* target = m_Staging.Allocate(size, copy.m_Offset);
+			if (target == nullptr)
+			{
+				//the region filled up before the budget did, the level stays queued for the next frame
+				staged = budget;
+				break;
+			}
+			memcpy(target, image.GetLevelData(level), (size_t)size);
+			m_Staged.push_back(copy);
+			staged += alignedSize;
+			++upload.m_NextLevel;
+		}
+	}
+
+	if (!m_Staged.empty())
+	{
+		m_Staging.Flush();
+		stateCache->BindBuffer(GL_PIXEL_UNPACK_BUFFER, m_Staging.GetBuffer());
+		for (const auto& copy : m_Staged)
+		{
+			UploadLevel(m_Uploads[copy.m_Upload], copy.m_Level, (const GLvoid*)copy.m_Offset);
+		}
+		stateCache->BindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	m_Staging.EndFrame();
+
+	//uploads finish in the order they started
+	while (!m_Uploads.empty() && m_Uploads.front().m_NextLevel == m_Records[m_Uploads.front().m_Handle].m_Image->m_Levels.size())
+	{
+		FinishUpload(m_Uploads.front(), true);
+		m_Uploads.pop_front();
+	}
+}
+
+void TextureManager::AddDecoded(const DecodedImage& decoded)
+{
+	TextureRecord& record = m_Records[decoded.m_Handle];
+	record.m_Path = decoded.m_Path;
+	record.m_Flags = decoded.m_Flags;
+	record.m_Image = decoded.m_Image;
+	if (record.m_Image == nullptr)
+	{
+		record.m_State = TS_Failed;
+		return;
+	}
+
+	/* the tail is the first level small enough to keep for good, a chain without one and pool layers are kept whole */
+	const Image& image = *record.m_Image;
+	const uint32 lastLevel = (uint32)image.m_Levels.size() - 1;
+	uint32 tail = 0;
+	while ((record.m_Flags & TF_Pooled) == 0 && tail < lastLevel &&
+		Math::Max(image.m_Levels[tail].m_Width, image.m_Levels[tail].m_Height) > MinResidentSize)
+	{
+		++tail;
+	}
+	record.m_TailLevel = tail;
+	record.m_WantedLevel = tail;
+	record.m_TargetLevel = tail;
+	record.m_FirstLevel = tail;
+}
+
+void TextureManager::UpdateResidency()
+{
+	/**
+	 * The wanted level of a requested texture is the coarsest one still covering
+	 * its size on screen. A visible texture only drops a level once it's wanted
+	 * two levels coarser, so sizes around a level boundary don't rebuild it every
+	 * frame, and one no longer requested falls back to its tail after a while.
+	 */
+	uint64 wantedBytes = 0;
+	uint64 residentBytes = 0;
+	std::vector<uint32> candidates;
+	for (uint32 handle = WhiteTexture + 1; handle < m_Records.size(); ++handle)
+	{
+		TextureRecord& record = m_Records[handle];
+		if (record.m_Image == nullptr)
+			continue;
+
+		const Image& image = *record.m_Image;
+		if (record.m_LastRequested == m_Frame)
+		{
+			uint32 level = 0;
+			while (level < record.m_TailLevel &&
+				(float)Math::Max(image.m_Levels[level + 1].m_Width, image.m_Levels[level + 1].m_Height) >= record.m_Priority)
+			{
+				++level;
+			}
+
+			if (record.m_State == TS_Ready && level == record.m_FirstLevel + 1)
+			{
+				level = record.m_FirstLevel;
+			}
+			record.m_WantedLevel = level;
+		}
+		else if (m_Frame - record.m_LastRequested > UnusedFrames)
+		{
+			record.m_WantedLevel = record.m_TailLevel;
+		}
+
+		record.m_TargetLevel = record.m_WantedLevel;
+		wantedBytes += GetResidentSize(image, record.m_WantedLevel);
+		if (record.m_State == TS_Ready && record.m_Pool == InvalidPool)
+		{
+			residentBytes += GetResidentSize(image, record.m_FirstLevel);
+		}
+		if (record.m_WantedLevel < record.m_TailLevel)
+		{
+			candidates.push_back(handle);
+		}
+	}
+
+	//pools hold their layers whether used or not
+	for (const auto& pool : m_Pools)
+	{
+		residentBytes += pool.m_Size;
+	}
+
+	/* over budget, the least recently requested textures give up their finest levels first, the smallest on screen among equals */
+	uint64 targetBytes = wantedBytes;
+	uint32 levelsOverBudget = 0;
+	if (targetBytes > m_Stats.m_BudgetBytes)
+	{
+		std::sort(candidates.begin(), candidates.end(), [this](uint32 a, uint32 b)
+		{
+			const TextureRecord& first = m_Records[a];
+			const TextureRecord& second = m_Records[b];
+			if (first.m_LastRequested != second.m_LastRequested)
+				return first.m_LastRequested < second.m_LastRequested;
+			return first.m_Priority < second.m_Priority;
+		});
+
+		for (uint32 i = 0; i < candidates.size() && targetBytes > m_Stats.m_BudgetBytes; ++i)
+		{
+			TextureRecord& record = m_Records[candidates[i]];
+			while (record.m_TargetLevel < record.m_TailLevel && targetBytes > m_Stats.m_BudgetBytes)
+			{
+				targetBytes -= record.m_Image->m_Levels[record.m_TargetLevel].m_Size;
+				++record.m_TargetLevel;
+				++levelsOverBudget;
+			}
+		}
+	}
+
+	/**
+	 * Rebuilds of textures whose target differs from what they hold. The ones
+	 * dropping levels go first as they free memory, then the largest on screen.
+	 * Until a rebuild finishes the old texture stays bound, so both are briefly
+	 * resident.
+	 */
+	std::vector<PendingUpload> rebuilds;
+	uint32 uploading = 0;
+	uint32 textures = 0;
+	for (uint32 handle = WhiteTexture + 1; handle < m_Records.size(); ++handle)
+	{
+		TextureRecord& record = m_Records[handle];
+		if (record.m_State == TS_Ready)
+		{
+			++textures;
+		}
+		if (record.m_bUploading)
+		{
+			++uploading;
+			continue;
+		}
+		if (record.m_Image == nullptr || record.m_State == TS_Failed)
+			continue;
+		if (record.m_State == TS_Ready && record.m_TargetLevel == record.m_FirstLevel)
+			continue;
+
+		PendingUpload upload;
+		upload.m_Handle = handle;
+		upload.m_Texture = 0;
+		upload.m_InternalFormat = 0;
+		upload.m_Pool = InvalidPool;
+		upload.m_Layer = 0;
+		upload.m_FirstLevel = record.m_TargetLevel;
+		upload.m_NextLevel = record.m_TargetLevel;
+		upload.m_Priority = record.m_State == TS_Ready && record.m_TargetLevel > record.m_FirstLevel ? BIG_NUMBER : record.m_Priority;
+		rebuilds.push_back(upload);
+	}
+
+	std::sort(rebuilds.begin(), rebuilds.end(), [](const PendingUpload& a, const PendingUpload& b)
+	{
+		return a.m_Priority > b.m_Priority;
+	});
+
+	for (auto& upload : rebuilds)
+	{
+		TextureRecord& record = m_Records[upload.m_Handle];
+		if (BeginUpload(upload))
+		{
+			record.m_bUploading = true;
+			m_Uploads.push_back(upload);
+			++uploading;
+		}
+		else
+		{
+			FinishUpload(upload, false);
+		}
+	}
+
+	m_Stats.m_Textures = textures;
+	m_Stats.m_Uploading = uploading;
+	m_Stats.m_LevelsOverBudget = levelsOverBudget;
+	m_Stats.m_ResidentBytes = residentBytes;
+	m_Stats.m_WantedBytes = wantedBytes;
+}
+
+GLuint TextureManager::GetTexture(TextureHandle handle) const
+{
+	//handed out but not seen by Update yet
+	if (handle < m_Records.size() && m_Records[handle].m_bRegion)
+	{
+		handle = m_Records[handle].m_Atlas;
+	}
+	if (handle == WhiteTexture)
+		return m_White;
+	if (handle >= m_Records.size())
+		return m_Loading;
+
+	const TextureRecord& record = m_Records[handle];
+	switch (record.m_State)
+	{
+	case TS_Ready:
+		//a pooled texture is sampled from its array, this unit is left unused
+		return record.m_Pool == InvalidPool ? record.m_Texture : m_White;
+	case TS_Failed:
+		return m_Error;
+	default:
+		return m_Loading;
+	}
+}
+
+GLuint TextureManager::GetArray(TextureHandle handle) const
+{
+	if (handle < m_Records.size() && m_Records[handle].m_bRegion)
+	{
+		handle = m_Records[handle].m_Atlas;
+	}
+	if (handle >= m_Records.size())
+		return 0;
+
+	const TextureRecord& record = m_Records[handle];
+	return record.m_State == TS_Ready && record.m_Pool != InvalidPool ? m_Pools[record.m_Pool].m_Texture : 0;
+}
+
+void TextureManager::GetSlot(TextureHandle handle, Vector4& uvRect, float& layer) const
+{
+	uvRect = Vector4(1.0f, 1.0f, 0.0f, 0.0f);
+	layer = -1.0f;
+	if (handle >= m_Records.size())
+		return;
+
+	if (m_Records[handle].m_bRegion)
+	{
+		uvRect = m_Records[handle].m_UVRect;
+		handle = m_Records[handle].m_Atlas;
+	}
+
+	const TextureRecord& record = m_Records[handle];
+	if (record.m_State == TS_Ready && record.m_Pool != InvalidPool)
+	{
+		layer = (float)record.m_Layer;
+	}
+}
+
+GLuint TextureManager::CreatePlaceholder(const uint8* pixels, GLsizei size)
+{
+	GLuint texture = 0;
+	glGenTextures(1, &texture);
+	OpenGLStateCache::getInstancePtr()->BindTexture(0, GL_TEXTURE_2D, texture);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, size, size, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	return texture;
+}
+
+GLenum TextureManager::GetInternalFormat(ImageFormat format, bool sRGB)
+{
+	const bool s3tc = GLEW_EXT_texture_compression_s3tc != 0;
+	sRGB = sRGB && (format == IF_RGBA8 || GLEW_EXT_texture_sRGB != 0);
+
+	switch (format)
+	{
+	case IF_RGBA8:
+		return sRGB ? GL_SRGB8_ALPHA8 : GL_RGBA8;
+	case IF_BC1:
+		return !s3tc ? 0 : sRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_S3TC_DXT1_EXT;
+	case IF_BC2:
+		return !s3tc ? 0 : sRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT3_EXT : GL_COMPRESSED_RGBA_S3TC_DXT3_EXT;
+	case IF_BC3:
+		return !s3tc ? 0 : sRGB ? GL_COMPRESSED_SRGB_ALPHA_S3TC_DXT5_EXT : GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+	//single and two channel data is never color
+	case IF_BC4:
+		return GL_COMPRESSED_RED_RGTC1;
+	case IF_BC5:
+		return GL_COMPRESSED_RG_RGTC2;
+	case IF_BC7:
+		return !GLEW_ARB_texture_compression_bptc ? 0 : sRGB ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM_ARB : GL_COMPRESSED_RGBA_BPTC_UNORM_ARB;
+	default:
+		return 0;
+	}
+}
+
+uint64 TextureManager::GetResidentSize(const Image& image, uint32 first)
+{
+	uint64 size = 0;
+	for (uint32 level = first; level < image.m_Levels.size(); ++level)
+	{
+		size += image.m_Levels[level].m_Size;
+	}
+	return size;
+}
+
+bool TextureManager::AllocateLayer(PendingUpload& upload, const Image& image)
+{
+	const uint32 levels = (uint32)image.m_Levels.size();
+	uint32 layers = MinPoolLayers;
+	for (uint32 p = 0; p < m_Pools.size(); ++p)
+	{
+		ArrayPool& pool = m_Pools[p];
+		if (pool.m_InternalFormat != upload.m_InternalFormat || pool.m_Width != image.m_Width || pool.m_Height != image.m_Height ||
+			pool.m_Levels != levels)
+			continue;
+
+		if (pool.m_Used < pool.m_Layers)
+		{
+			upload.m_Pool = p;
+			upload.m_Layer = pool.m_Used++;
+			upload.m_Texture = pool.m_Texture;
+			return true;
+		}
+		layers = Math::Min(Math::Max(layers, pool.m_Layers * 2), MaxPoolLayers);
+	}
+
+	/* a new array, every level of every layer allocated up front */
+	ArrayPool pool;
+	pool.m_InternalFormat = upload.m_InternalFormat;
+	pool.m_Width = image.m_Width;
+	pool.m_Height = image.m_Height;
+	pool.m_Levels = levels;
+	pool.m_Layers = layers;
+	pool.m_Used = 1;
+	pool.m_Size = image.GetTotalSize() * layers;
+	glGenTextures(1, &pool.m_Texture);
+	OpenGLStateCache::getInstancePtr()->BindTexture(0, GL_TEXTURE_2D_ARRAY, pool.m_Texture);
+	if (m_bTextureStorage)
+	{
+		glTexStorage3D(GL_TEXTURE_2D_ARRAY, levels, pool.m_InternalFormat, image.m_Width, image.m_Height, layers);
+	}
+	else
+	{
+		for (uint32 level = 0; level < levels; ++level)
+		{
+			const ImageLevel& data = image.m_Levels[level];
+			if (image.IsCompressed())
+			{
+				glCompressedTexImage3D(GL_TEXTURE_2D_ARRAY, level, pool.m_InternalFormat, data.m_Width, data.m_Height, layers, 0,
+					(GLsizei)(data.m_Size * layers), nullptr);
+			}
+			else
+			{
+				glTexImage3D(GL_TEXTURE_2D_ARRAY, level, pool.m_InternalFormat, data.m_Width, data.m_Height, layers, 0,
+					GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			}
+		}
+		glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	}
+
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	if (m_Anisotropy > 1.0f)
+	{
+		glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, m_Anisotropy);
+	}
+
+	DEBUG_MESSAGE(RAY_MESSAGE, "texture pool %u: %ux%u, %u levels, %u layers", (uint32)m_Pools.size(), image.m_Width, image.m_Height,
+		levels, layers);
+	upload.m_Pool = (uint32)m_Pools.size();
+	upload.m_Layer = 0;
+	upload.m_Texture = pool.m_Texture;
+	m_Pools.push_back(pool);
+	return true;
+}
+
+bool TextureManager::BeginUpload(PendingUpload& upload)
+{
+	const TextureRecord& record = m_Records[upload.m_Handle];
+	const Image& image = *record.m_Image;
+	upload.m_InternalFormat = GetInternalFormat(image.m_Format, (record.m_Flags & TF_SRGB) != 0);
+	if (upload.m_InternalFormat == 0)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "%s: the driver can't sample image format %d", record.m_Path.c_str(), (int)image.m_Format);
+		return false;
+	}
+
+	if ((record.m_Flags & TF_Pooled) != 0)
+		return AllocateLayer(upload, image);
+
+	//gl level 0 is the first streamed level
+	const ImageLevel& first = image.m_Levels[upload.m_FirstLevel];
+	const GLsizei levels = (GLsizei)(image.m_Levels.size() - upload.m_FirstLevel);
+	glGenTextures(1, &upload.m_Texture);
+	OpenGLStateCache::getInstancePtr()->BindTexture(0, GL_TEXTURE_2D, upload.m_Texture);
+	if (m_bTextureStorage)
+	{
+		glTexStorage2D(GL_TEXTURE_2D, levels, upload.m_InternalFormat, first.m_Width, first.m_Height);
+	}
+	else
+	{
+		//levels are specified one at a time, the texture must not expect more than the file has
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, levels - 1);
+	}
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, levels > 1 ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+	if (m_Anisotropy > 1.0f)
+	{
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, m_Anisotropy);
+	}
+	return true;
+}
+
+void TextureManager::UploadLevel(const PendingUpload& upload, uint32 level, const GLvoid* pixels)
+{
+	const Image& image = *m_Records[upload.m_Handle].m_Image;
+	const ImageLevel& data = image.m_Levels[level];
+	const GLint target = (GLint)(level - upload.m_FirstLevel);
+	if (upload.m_Pool != InvalidPool)
+	{
+		//the array's storage exists already, only this layer is written
+		OpenGLStateCache::getInstancePtr()->BindTexture(0, GL_TEXTURE_2D_ARRAY, upload.m_Texture);
+		if (image.IsCompressed())
+		{
+			glCompressedTexSubImage3D(GL_TEXTURE_2D_ARRAY, target, 0, 0, upload.m_Layer, data.m_Width, data.m_Height, 1,
+				upload.m_InternalFormat, (GLsizei)data.m_Size, pixels);
+		}
+		else
+		{
+			glTexSubImage3D(GL_TEXTURE_2D_ARRAY, target, 0, 0, upload.m_Layer, data.m_Width, data.m_Height, 1, GL_RGBA,
+				GL_UNSIGNED_BYTE, pixels);
+		}
+		return;
+	}
+
+	OpenGLStateCache::getInstancePtr()->BindTexture(0, GL_TEXTURE_2D, upload.m_Texture);
+
+	if (image.IsCompressed())
+	{
+		if (m_bTextureStorage)
+		{
+			glCompressedTexSubImage2D(GL_TEXTURE_2D, target, 0, 0, data.m_Width, data.m_Height, upload.m_InternalFormat,
+				(GLsizei)data.m_Size, pixels);
+		}
+		else
+		{
+			glCompressedTexImage2D(GL_TEXTURE_2D, target, upload.m_InternalFormat, data.m_Width, data.m_Height, 0,
+				(GLsizei)data.m_Size, pixels);
+		}
+	}
+	else if (m_bTextureStorage)
+	{
+		glTexSubImage2D(GL_TEXTURE_2D, target, 0, 0, data.m_Width, data.m_Height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	}
+	else
+	{
+		glTexImage2D(GL_TEXTURE_2D, target, upload.m_InternalFormat, data.m_Width, data.m_Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+	}
+}
+
+void TextureManager::FinishUpload(PendingUpload& upload, bool succeeded)
+{
+	OpenGLStateCache* stateCache = OpenGLStateCache::getInstancePtr();
+	TextureRecord& record = m_Records[upload.m_Handle];
+	record.m_bUploading = false;
+	if (succeeded)
+	{
+		const Image& image = *record.m_Image;
+		if (record.m_State != TS_Ready)
+		{
+			DEBUG_MESSAGE(RAY_MESSAGE, "texture %s: %ux%u, %u levels, %u bytes, %u resident", record.m_Path.c_str(), image.m_Width,
+				image.m_Height, (uint32)image.m_Levels.size(), (uint32)image.GetTotalSize(), (uint32)GetResidentSize(image, upload.m_FirstLevel));
+		}
+		else if (upload.m_FirstLevel > record.m_FirstLevel)
+		{
+			++m_Stats.m_Evictions;
+		}
+
+		if (upload.m_Pool != InvalidPool)
+		{
+			record.m_Pool = upload.m_Pool;
+			record.m_Layer = upload.m_Layer;
+			record.m_FirstLevel = upload.m_FirstLevel;
+			record.m_State = TS_Ready;
+			return;
+		}
+
+		if (record.m_Texture != 0)
+		{
+			glDeleteTextures(1, &record.m_Texture);
+			stateCache->OnTextureDeleted(record.m_Texture);
+		}
+		record.m_Texture = upload.m_Texture;
+		record.m_FirstLevel = upload.m_FirstLevel;
+		record.m_State = TS_Ready;
+		return;
+	}
+
+	//pools outlive their layers
+	if (upload.m_Texture != 0 && upload.m_Pool == InvalidPool)
+	{
+		glDeleteTextures(1, &upload.m_Texture);
+		stateCache->OnTextureDeleted(upload.m_Texture);
+	}
+	if (record.m_Texture != 0)
+	{
+		glDeleteTextures(1, &record.m_Texture);
+		stateCache->OnTextureDeleted(record.m_Texture);
+		record.m_Texture = 0;
+	}
+	record.m_State = TS_Failed;
+	R_DELETE(record.m_Image);
+}
@@ -0,0 +1,240 @@
+//===========================================================================
+// TextureManager: textures loaded without stalling a frame. Files are
+// decoded and mipmapped by background jobs, the render thread then copies
+// a budgeted number of bytes per frame through a staging pixel buffer.
+// Until a texture is complete its handle samples a placeholder.
+// Only the levels the renderer asks for are kept on the gpu, the decoded
+// chain stays in memory and textures are rebuilt with more or fewer levels
+// as their size on screen changes or the residency budget runs out.
+// Small textures can share texture arrays and atlases instead, so draws
+// using different ones still batch without a bind in between.
+//===========================================================================
+
+#pragma once
+#include "OpenGLStreamBuffer.h"
+#include "../../Engine/Image.h"
+#include "../../Math/RayMath.h"
+#include <GL/glew.h>
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+typedef uint32 TextureHandle;
+
+enum TextureFlags
+{
+	TF_SRGB = 1 << 0,		//color data, filtered and sampled as linear light
+	TF_GenerateMips = 1 << 1,	//box filtered chain for images stored without one
+	TF_Pooled = 1 << 2,		//a layer of an array shared with textures of its format and size, always fully resident
+};
+
+struct TextureStreamingStats
+{
+	uint32 m_Textures;		//with at least their tail resident
+	uint32 m_Uploading;		//rebuilds in flight
+	uint32 m_LevelsOverBudget;	//levels asked for but left out to stay in the budget
+	uint32 m_Evictions;		//rebuilds dropping levels, since Init
+	uint64 m_ResidentBytes;
+	uint64 m_WantedBytes;	//what the requested levels would take without a budget
+	uint64 m_BudgetBytes;
+};
+
+class TextureManager
+{
+public:
+	/* always valid, a 1x1 white texture for draws without one */
+	static const TextureHandle WhiteTexture = 0;
+
+	TextureManager();
+	~TextureManager();
+
+	/* levels of this many texels and less are always resident */
+	static const uint32 MinResidentSize = 64;
+	/* frames without a request before a texture falls back to its tail */
+	static const uint32 UnusedFrames = 120;
+
+	/**
+	 * On the thread owning the context, uploadBudget bytes are staged per frame and
+	 * the resident levels of all textures are kept under residencyBudget bytes.
+	 */
+	bool Init(GLsizeiptr uploadBudget, uint64 residencyBudget);
+	/* waits for the decodes in flight, then deletes every texture */
+	void Release();
+
+	/**
+	 * Starts loading path and returns its handle at once, from any thread.
+	 * Loading the same path again returns the first handle, whatever the flags.
+	 */
+	TextureHandle Load(const std::string& path, uint32 flags = TF_SRGB | TF_GenerateMips);
+
+	/**
+	 * From any thread, once a frame per texture drawn: screenPixels is the size the
+	 * texture covers on screen, which already falls with the distance to the camera.
+	 * The finest level needed is picked from it, larger requests stream first and
+	 * are evicted last.
+	 */
+	void Request(TextureHandle handle, float screenPixels);
+
+	/* render thread, once a frame: creates the decoded textures, streams levels in and out */
+	void Update();
+
+	/**
+	 * Loads an atlas cooked by TextureAtlas and adds a handle per region, by
+	 * name, to regions. A region samples the atlas through its rectangle and
+	 * can't repeat. False if the table can't be read.
+	 */
+	bool LoadAtlas(const std::string& tablePath, std::map<std::string, TextureHandle>& regions, uint32 flags = TF_SRGB);
+
+	/* render thread: the texture to bind, a placeholder while loading or after a failure */
+	GLuint GetTexture(TextureHandle handle) const;
+
+	/* render thread: the array holding a pooled texture once it's ready, 0 otherwise */
+	GLuint GetArray(TextureHandle handle) const;
+
+	/**
+	 * Render thread: where a handle samples, uvRect scales the texture
+	 * coordinates in xy and offsets them in zw, layer is the array layer or -1.
+	 */
+	void GetSlot(TextureHandle handle, Vector4& uvRect, float& layer) const;
+
+	/* render thread: handles are below this */
+	uint32 GetHandleCount() const { return (uint32)m_Records.size(); }
+
+	/* render thread, as of the last Update */
+	const TextureStreamingStats& GetStats() const { return m_Stats; }
+
+private:
+	struct DecodedImage
+	{
+		TextureHandle m_Handle;
+		uint32 m_Flags;
+		std::string m_Path;
+		Image* m_Image; //nullptr if the file could not be decoded
+	};
+
+	struct NewRegion
+	{
+		TextureHandle m_Handle;
+		TextureHandle m_Atlas;
+		Vector4 m_UVRect;
+	};
+
+	struct TextureRequest
+	{
+		TextureHandle m_Handle;
+		float m_ScreenPixels;
+	};
+
+	/* a texture with levels m_FirstLevel and coarser, built from the kept image */
+	struct PendingUpload
+	{
+		TextureHandle m_Handle;
+		GLuint m_Texture;		//the pool's array for a pooled texture
+		GLenum m_InternalFormat;
+		uint32 m_Pool;
+		uint32 m_Layer;
+		uint32 m_FirstLevel;
+		uint32 m_NextLevel;
+		float m_Priority;
+	};
+
+	struct StagedLevel
+	{
+		uint32 m_Upload;
+		uint32 m_Level;
+		GLintptr m_Offset;
+	};
+
+	enum TextureState
+	{
+		TS_Loading,
+		TS_Ready,
+		TS_Failed,
+	};
+
+	struct TextureRecord
+	{
+		TextureRecord();
+
+		std::string m_Path;
+		uint32 m_Flags;
+		Image* m_Image;			//every level, the source of each rebuild
+		GLuint m_Texture;		//levels m_FirstLevel and coarser
+		uint8 m_State;
+		bool m_bUploading;		//at most one rebuild per texture in m_Uploads
+		uint32 m_FirstLevel;
+		uint32 m_TailLevel;		//finest level of MinResidentSize texels or less
+		uint32 m_WantedLevel;	//from the requests
+		uint32 m_TargetLevel;	//m_WantedLevel after the budget
+		uint32 m_LastRequested;	//frame number
+		float m_Priority;		//largest size requested in that frame
+		uint32 m_Pool;			//InvalidPool unless pooled
+		uint32 m_Layer;
+		bool m_bRegion;			//samples m_Atlas through m_UVRect, holds nothing itself
+		TextureHandle m_Atlas;
+		Vector4 m_UVRect;
+	};
+
+	/**
+	 * Textures of one format, size and chain length, layers are handed out in
+	 * order and never returned. A full pool is followed by one twice its size.
+	 */
+	struct ArrayPool
+	{
+		GLuint m_Texture;
+		GLenum m_InternalFormat;
+		uint32 m_Width;
+		uint32 m_Height;
+		uint32 m_Levels;
+		uint32 m_Layers;
+		uint32 m_Used;
+		uint64 m_Size; //bytes of every layer
+	};
+
+	static const uint32 InvalidPool = 0xFFFFFFFF;
+	static const uint32 MinPoolLayers = 4;
+	static const uint32 MaxPoolLayers = 64;
+
+	static GLuint CreatePlaceholder(const uint8* pixels, GLsizei size);
+	static GLenum GetInternalFormat(ImageFormat format, bool sRGB);
+
+	/* bytes of levels first and coarser */
+	static uint64 GetResidentSize(const Image& image, uint32 first);
+
+	void AddDecoded(const DecodedImage& decoded);
+	bool AllocateLayer(PendingUpload& upload, const Image& image);
+	void UpdateResidency();
+	bool BeginUpload(PendingUpload& upload);
+	void UploadLevel(const PendingUpload& upload, uint32 level, const GLvoid* pixels);
+	void FinishUpload(PendingUpload& upload, bool succeeded);
+
+private:
+	//shared with the decode jobs, guarded by m_Mutex
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	std::map<std::string, TextureHandle> m_Paths;
+	std::vector<DecodedImage> m_Decoded;
+	std::vector<TextureRequest> m_Requests;
+	std::vector<NewRegion> m_NewRegions;
+	TextureHandle m_NextHandle;
+	uint32 m_InFlight;
+
+	//render thread only
+	std::vector<TextureRecord> m_Records;
+	std::vector<ArrayPool> m_Pools;
+	std::vector<TextureRequest> m_FrameRequests;
+	std::deque<PendingUpload> m_Uploads;
+	std::vector<StagedLevel> m_Staged;
+	StreamBuffer m_Staging;
+
+	GLuint m_White;
+	GLuint m_Loading;
+	GLuint m_Error;
+	float m_Anisotropy;
+	bool m_bTextureStorage;
+	uint32 m_Frame;
+	TextureStreamingStats m_Stats;
+};
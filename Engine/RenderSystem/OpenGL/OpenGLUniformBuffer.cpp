@@ -0,0 +1,14 @@
+#include "OpenGLUniformBuffer.h"
+#include "OpenGLStateCache.h"
+
+bool UniformBufferRing::Init(GLsizeiptr frameSize)
+{
+	GLint alignment = 256;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+	return m_Stream.Init("uniforms", frameSize, alignment);
+}
+
+void UniformBufferRing::Bind(GLuint bindingPoint, GLintptr offset, GLsizeiptr size)
+{
+	OpenGLStateCache::getInstancePtr()->BindBufferRange(GL_UNIFORM_BUFFER, bindingPoint, m_Stream.GetBuffer(), offset, size);
+}
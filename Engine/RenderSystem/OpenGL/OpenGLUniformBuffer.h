@@ -0,0 +1,83 @@
+//===========================================================================
+// UniformBufferRing: per-frame and per-object shader constants, sub
+// allocated from one large uniform buffer and bound with glBindBufferRange.
+//===========================================================================
+
+#pragma once
+#include "OpenGLStreamBuffer.h"
+#include "../../Math/RayMath.h"
+#include <GL/glew.h>
+
+/**
+ * Binding points shared by every program, see ShaderManager::BindUniformBlock.
+ */
+enum UniformBlockBinding
+{
+	UBB_PerFrame = 0,
+	UBB_PerObject = 1,
+	UBB_TextureSlots = 2,
+};
+
+/**
+ * Mirrors the std140 row_major "PerFrame" block in the shaders.
+ */
+struct PerFrameConstants
+{
+	Matrix m_View;
+	Matrix m_Proj;
+	Matrix m_ViewProj;
+	Vector4 m_Time; //x: total time, y: delta time
+};
+
+/**
+ * Mirrors the std140 row_major "PerObject" block in the shaders.
+ */
+struct PerObjectConstants
+{
+	Matrix m_World;
+};
+
+/**
+ * Mirrors the std140 "TextureSlots" block, two vectors per texture handle:
+ * the atlas rectangle (scale in xy, offset in zw) and the array layer in x,
+ * -1 outside a pool. Handles past the table sample their whole texture.
+ */
+static const uint32 MaxTextureSlots = 512;
+
+struct TextureSlotConstants
+{
+	Vector4 m_Slots[MaxTextureSlots * 2];
+};
+
+class UniformBufferRing
+{
+public:
+	bool Init(GLsizeiptr frameSize);
+	void Release() { m_Stream.Release(); }
+
+	/* see StreamBuffer, the ring only adds the uniform offset alignment and binding */
+	void BeginFrame() { m_Stream.BeginFrame(); }
+	void Flush() { m_Stream.Flush(); }
+	void EndFrame() { m_Stream.EndFrame(); }
+
+	/**
+	 * Sub allocates constants in the current frame region. Safe to call from
+	 * several threads at once, returns the memory to write into and the offset
+	 * to bind, or nullptr if the region is exhausted.
+	 */
+	void* Allocate(GLsizeiptr size, GLintptr& outOffset) { return m_Stream.Allocate(size, outOffset); }
+
+	template<typename T>
+	T* Allocate(GLintptr& outOffset)
+	{
+		return static_cast<T*>(Allocate(sizeof(T), outOffset));
+	}
+
+	void Bind(GLuint bindingPoint, GLintptr offset, GLsizeiptr size);
+
+	GLuint GetBuffer() const { return m_Stream.GetBuffer(); }
+	bool IsPersistent() const { return m_Stream.IsPersistent(); }
+
+private:
+	StreamBuffer m_Stream;
+};
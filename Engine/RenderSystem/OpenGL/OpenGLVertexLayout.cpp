@@ -0,0 +1,161 @@
+#include "OpenGLVertexLayout.h"
+#include "OpenGLStateCache.h"
+#include "../../Tools/RayUtils.h"
+
+/**
+	FNV-1a, folded over every field so equal layouts share a hash
+**/
+static uint32 HashCombine(uint32 hash, uint32 value)
+{
+	for (int i = 0; i < 4; ++i)
+	{
+		hash ^= (value >> (i * 8)) & 0xFF;
+		hash *= 16777619u;
+	}
+	return hash;
+}
+
+VertexLayout::VertexLayout()
+	: m_Stride(0)
+	, m_Divisor(0)
+	, m_Count(0)
+	, m_Hash(2166136261u)
+{
+}
+
+VertexLayout::VertexLayout(GLsizei stride)
+	: m_Stride(stride)
+	, m_Divisor(0)
+	, m_Count(0)
+	, m_Hash(HashCombine(2166136261u, stride))
+{
+}
+
+VertexLayout& VertexLayout::Add(GLuint index, GLint components, GLenum type, GLboolean normalized, GLuint offset)
+{
+	ASSERT(m_Count < MaxAttributes);
+
+	VertexAttribute& attrib = m_Attributes[m_Count++];
+	attrib.m_Index = index;
+	attrib.m_Components = components;
+	attrib.m_Type = type;
+	attrib.m_Normalized = normalized;
+	attrib.m_Offset = offset;
+
+	m_Hash = HashCombine(m_Hash, index);
+	m_Hash = HashCombine(m_Hash, components);
+	m_Hash = HashCombine(m_Hash, type);
+	m_Hash = HashCombine(m_Hash, normalized);
+	m_Hash = HashCombine(m_Hash, offset);
+	return *this;
+}
+
+VertexLayout& VertexLayout::SetDivisor(GLuint divisor)
+{
+	m_Divisor = divisor;
+	m_Hash = HashCombine(m_Hash, 0xD1u ^ divisor);
+	return *this;
+}
+
+bool VertexLayout::operator==(const VertexLayout& other) const
+{
+	if (m_Stride != other.m_Stride || m_Divisor != other.m_Divisor || m_Count != other.m_Count)
+		return false;
+
+	for (int i = 0; i < m_Count; ++i)
+	{
+		const VertexAttribute& a = m_Attributes[i];
+		const VertexAttribute& b = other.m_Attributes[i];
+		if (a.m_Index != b.m_Index || a.m_Components != b.m_Components || a.m_Type != b.m_Type
+			|| a.m_Normalized != b.m_Normalized || a.m_Offset != b.m_Offset)
+			return false;
+	}
+	return true;
+}
+
+void VertexLayout::Apply(GLintptr baseOffset) const
+{
+	for (int i = 0; i < m_Count; ++i)
+	{
+		const VertexAttribute& attrib = m_Attributes[i];
+		glEnableVertexAttribArray(attrib.m_Index);
+		glVertexAttribPointer(attrib.m_Index, attrib.m_Components, attrib.m_Type, attrib.m_Normalized,
+			m_Stride, (const GLvoid*)(baseOffset + attrib.m_Offset));
+		glVertexAttribDivisor(attrib.m_Index, m_Divisor);
+	}
+}
+
+VertexArrayCache::VertexArrayCache()
+{
+}
+
+VertexArrayCache::~VertexArrayCache()
+{
+	Release();
+}
+
+GLuint VertexArrayCache::GetVertexArray(const VertexLayout& layout, GLuint vertexBuffer, GLuint indexBuffer,
+	const VertexLayout* instanceLayout, GLuint instanceBuffer)
+{
+	Key key = { layout.GetHash(), vertexBuffer, indexBuffer, instanceLayout ? instanceLayout->GetHash() : 0, instanceBuffer };
+	const VertexLayout noInstances;
+	const VertexLayout& instances = instanceLayout ? *instanceLayout : noInstances;
+
+	//a hash match alone could hand back attribute pointers of another layout
+	auto range = m_VertexArrays.equal_range(key);
+	for (auto itr = range.first; itr != range.second; ++itr)
+	{
+		if (itr->second.m_Layout == layout && itr->second.m_InstanceLayout == instances)
+			return itr->second.m_VertexArray;
+	}
+
+	OpenGLStateCache* stateCache = OpenGLStateCache::getInstancePtr();
+
+	GLuint vao = 0;
+	glGenVertexArrays(1, &vao);
+	stateCache->BindVertexArray(vao);
+	stateCache->BindBuffer(GL_ARRAY_BUFFER, vertexBuffer);
+	stateCache->BindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer);
+	layout.Apply();
+
+	if (instanceLayout != nullptr)
+	{
+		stateCache->BindBuffer(GL_ARRAY_BUFFER, instanceBuffer);
+		instanceLayout->Apply();
+	}
+
+	Entry entry;
+	entry.m_Layout = layout;
+	entry.m_InstanceLayout = instances;
+	entry.m_VertexArray = vao;
+	m_VertexArrays.insert(std::make_pair(key, entry));
+	return vao;
+}
+
+void VertexArrayCache::OnBufferDeleted(GLuint buffer)
+{
+	for (auto itr = m_VertexArrays.begin(); itr != m_VertexArrays.end();)
+	{
+		const Key& key = itr->first;
+		if (key.m_VertexBuffer == buffer || key.m_IndexBuffer == buffer || key.m_InstanceBuffer == buffer)
+		{
+			glDeleteVertexArrays(1, &itr->second.m_VertexArray);
+			OpenGLStateCache::getInstancePtr()->OnVertexArrayDeleted(itr->second.m_VertexArray);
+			itr = m_VertexArrays.erase(itr);
+		}
+		else
+		{
+			++itr;
+		}
+	}
+}
+
+void VertexArrayCache::Release()
+{
+	for (auto& itr : m_VertexArrays)
+	{
+		glDeleteVertexArrays(1, &itr.second.m_VertexArray);
+		OpenGLStateCache::getInstancePtr()->OnVertexArrayDeleted(itr.second.m_VertexArray);
+	}
+	m_VertexArrays.clear();
+}
@@ -0,0 +1,120 @@
+//===========================================================================
+// VertexLayout: declarative description of a vertex format, and the cache
+// of vertex array objects built from layout/buffer combinations.
+//===========================================================================
+
+#pragma once
+#include "../../Math/RayMath.h"
+#include <GL/glew.h>
+#include <map>
+
+/**
+ * Maps a vertex member type to its GL attribute format, specialize it to
+ * support new member types in VertexLayout::Add.
+ */
+template<typename T> struct VertexAttributeTraits;
+
+template<> struct VertexAttributeTraits<float>		{ enum { Components = 1, Type = GL_FLOAT }; };
+template<> struct VertexAttributeTraits<Vector>		{ enum { Components = 3, Type = GL_FLOAT }; };
+template<> struct VertexAttributeTraits<Vector4>	{ enum { Components = 4, Type = GL_FLOAT }; };
+
+struct VertexAttribute
+{
+	GLuint m_Index;
+	GLint m_Components;
+	GLenum m_Type;
+	GLboolean m_Normalized;
+	GLuint m_Offset;
+};
+
+class VertexLayout
+{
+public:
+	static const int MaxAttributes = 8;
+
+	VertexLayout();
+	explicit VertexLayout(GLsizei stride);
+
+	VertexLayout& Add(GLuint index, GLint components, GLenum type, GLboolean normalized, GLuint offset);
+
+	/* attributes advance once every 'divisor' instances instead of per vertex */
+	VertexLayout& SetDivisor(GLuint divisor);
+
+	/**
+	 * Deduces format and offset from a member of the vertex struct:
+	 *   VertexLayout(sizeof(Vertex)).Add(0, &Vertex::positon).Add(1, &Vertex::Color);
+	 */
+	template<typename TVertex, typename TMember>
+	VertexLayout& Add(GLuint index, TMember TVertex::* member, GLboolean normalized = GL_FALSE)
+	{
+		GLuint offset = (GLuint)(size_t)&(((TVertex*)0)->*member);
+		return Add(index, VertexAttributeTraits<TMember>::Components, VertexAttributeTraits<TMember>::Type, normalized, offset);
+	}
+
+	/* enables and points the attributes at the currently bound array buffer */
+	void Apply(GLintptr baseOffset = 0) const;
+
+	GLsizei GetStride() const { return m_Stride; }
+	GLuint GetDivisor() const { return m_Divisor; }
+	int GetAttributeCount() const { return m_Count; }
+	const VertexAttribute& GetAttribute(int i) const { return m_Attributes[i]; }
+	uint32 GetHash() const { return m_Hash; }
+
+	/* compares every field, the hash only narrows the search */
+	bool operator==(const VertexLayout& other) const;
+
+private:
+	GLsizei m_Stride;
+	GLuint m_Divisor;
+	int m_Count;
+	uint32 m_Hash;
+	VertexAttribute m_Attributes[MaxAttributes];
+};
+
+/**
+ * One vertex array object per layout/vertex buffer/index buffer combination,
+ * plus the optional per-instance stream, created the first time it's
+ * requested and kept for the buffers' lifetime.
+ */
+class VertexArrayCache
+{
+public:
+	VertexArrayCache();
+	~VertexArrayCache();
+
+	GLuint GetVertexArray(const VertexLayout& layout, GLuint vertexBuffer, GLuint indexBuffer,
+		const VertexLayout* instanceLayout = nullptr, GLuint instanceBuffer = 0);
+
+	/* drops every vertex array referencing the buffer, call before deleting it */
+	void OnBufferDeleted(GLuint buffer);
+	void Release();
+
+private:
+	/* buffers and layout hashes, layouts whose hashes collide share a key */
+	struct Key
+	{
+		uint32 m_Layout;
+		GLuint m_VertexBuffer;
+		GLuint m_IndexBuffer;
+		uint32 m_InstanceLayout;
+		GLuint m_InstanceBuffer;
+
+		bool operator<(const Key& other) const
+		{
+			if (m_Layout != other.m_Layout) return m_Layout < other.m_Layout;
+			if (m_VertexBuffer != other.m_VertexBuffer) return m_VertexBuffer < other.m_VertexBuffer;
+			if (m_IndexBuffer != other.m_IndexBuffer) return m_IndexBuffer < other.m_IndexBuffer;
+			if (m_InstanceLayout != other.m_InstanceLayout) return m_InstanceLayout < other.m_InstanceLayout;
+			return m_InstanceBuffer < other.m_InstanceBuffer;
+		}
+	};
+
+	struct Entry
+	{
+		VertexLayout m_Layout;
+		VertexLayout m_InstanceLayout; //empty without an instance stream
+		GLuint m_VertexArray;
+	};
+
+	std::multimap<Key, Entry> m_VertexArrays;
+};
@@ -0,0 +1,27 @@
+#include "ContentHash.h"
+
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+std::string GetCachePath(const std::string& directory, uint64 key, const char* extension)
+{
+	static const char digits[] = "0123456789abcdef";
+	std::string name(16, '0');
+	for (int i = 15; i >= 0; --i, key >>= 4)
+	{
+		name[i] = digits[key & 15];
+	}
+	return directory + "/" + name + extension;
+}
+
+void CreateCacheDirectory(const std::string& directory)
+{
+#ifdef _WIN32
+	_mkdir(directory.c_str());
+#else
+	mkdir(directory.c_str(), 0755);
+#endif
+}
@@ -0,0 +1,33 @@
+//===========================================================================
+// ContentHash: FNV-1a hashing of file contents and settings, and the file
+// names of the on-disk caches keyed by such a hash.
+//===========================================================================
+
+#pragma once
+#include "../Config/WindowPlatform.h"
+#include <stddef.h>
+#include <string>
+
+static const uint64 HashSeed = 14695981039346656037ull;
+
+/* FNV-1a, 64 bit so distinct sources practically never share a cache entry */
+inline uint64 HashBytes(uint64 hash, const void* data, size_t size)
+{
+	const uint8* bytes = (const uint8*)data;
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * 1099511628211ull;
+	}
+	return hash;
+}
+
+inline uint64 HashString(uint64 hash, const std::string& text)
+{
+	return HashBytes(hash, text.data(), text.size());
+}
+
+/* directory/<16 hex digits of key><extension> */
+std::string GetCachePath(const std::string& directory, uint64 key, const char* extension);
+
+/* creates the directory if it's missing, its parent must exist */
+void CreateCacheDirectory(const std::string& directory);
@@ -0,0 +1,200 @@
+#include "FileWatcher.h"
+#include "RayUtils.h"
+#include <algorithm>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <errno.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+#endif
+
+FileWatcher::FileWatcher()
+#ifdef _WIN32
+	: m_Directory(INVALID_HANDLE_VALUE)
+	, m_Overlapped(nullptr)
+#else
+	: m_Notify(-1)
+	, m_Watch(-1)
+#endif
+{
+}
+
+FileWatcher::~FileWatcher()
+{
+	Close();
+}
+
+#ifdef _WIN32
+
+bool FileWatcher::Watch(const std::string& directory)
+{
+	Close();
+
+	m_Directory = CreateFileA(directory.c_str(), FILE_LIST_DIRECTORY, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+		nullptr, OPEN_EXISTING, FILE_FLAG_BACKUP_SEMANTICS | FILE_FLAG_OVERLAPPED, nullptr);
+	if (m_Directory == INVALID_HANDLE_VALUE)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "can't watch %s", directory.c_str());
+		return false;
+	}
+
+	OVERLAPPED* overlapped = new OVERLAPPED();
+	overlapped->hEvent = CreateEventA(nullptr, TRUE, FALSE, nullptr);
+	m_Overlapped = overlapped;
+	m_Buffer.resize(16 * 1024);
+	if (!Read())
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "can't watch %s", directory.c_str());
+		Close();
+		return false;
+	}
+	return true;
+}
+
+bool FileWatcher::Read()
+{
+	OVERLAPPED* overlapped = (OVERLAPPED*)m_Overlapped;
+	ResetEvent(overlapped->hEvent);
+	return ReadDirectoryChangesW(m_Directory, &m_Buffer[0], (DWORD)(m_Buffer.size() * sizeof(uint32)), FALSE,
+		FILE_NOTIFY_CHANGE_LAST_WRITE | FILE_NOTIFY_CHANGE_FILE_NAME, nullptr, overlapped, nullptr) != FALSE;
+}
+
+void FileWatcher::Close()
+{
+	if (m_Directory != INVALID_HANDLE_VALUE)
+	{
+		CancelIo(m_Directory);
+		CloseHandle(m_Directory);
+		m_Directory = INVALID_HANDLE_VALUE;
+	}
+	if (m_Overlapped != nullptr)
+	{
+		OVERLAPPED* overlapped = (OVERLAPPED*)m_Overlapped;
+		CloseHandle(overlapped->hEvent);
+		R_DELETE(overlapped);
+		m_Overlapped = nullptr;
+	}
+}
+
+bool FileWatcher::IsWatching() const
+{
+	return m_Directory != INVALID_HANDLE_VALUE;
+}
+
+void FileWatcher::Poll(std::vector<std::string>& changed)
+{
+	if (!IsWatching())
+		return;
+
+	const size_t first = changed.size();
+	DWORD bytes = 0;
+	while (GetOverlappedResult(m_Directory, (OVERLAPPED*)m_Overlapped, &bytes, FALSE))
+	{
+		//0 bytes means the buffer overflowed, the changes in it are lost
+		const uint8* record = (const uint8*)&m_Buffer[0];
+		while (bytes > 0)
+		{
+			const FILE_NOTIFY_INFORMATION* info = (const FILE_NOTIFY_INFORMATION*)record;
+			if (info->Action == FILE_ACTION_MODIFIED || info->Action == FILE_ACTION_ADDED || info->Action == FILE_ACTION_RENAMED_NEW_NAME)
+			{
+				const int wideLength = (int)(info->FileNameLength / sizeof(WCHAR));
+				const int length = WideCharToMultiByte(CP_UTF8, 0, info->FileName, wideLength, nullptr, 0, nullptr, nullptr);
+				std::string name((size_t)length, '\0');
+				WideCharToMultiByte(CP_UTF8, 0, info->FileName, wideLength, &name[0], length, nullptr, nullptr);
+				changed.push_back(name);
+			}
+			if (info->NextEntryOffset == 0)
+				break;
+			record += info->NextEntryOffset;
+		}
+
+		if (!Read())
+		{
+			DEBUG_MESSAGE(RAY_ERROR, "file watch stopped");
+			Close();
+			break;
+		}
+	}
+
+	std::sort(changed.begin() + first, changed.end());
+	changed.erase(std::unique(changed.begin() + first, changed.end()), changed.end());
+}
+
+#else
+
+bool FileWatcher::Watch(const std::string& directory)
+{
+	Close();
+
+	m_Notify = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (m_Notify >= 0)
+	{
+		//written in place, or saved to a temporary and renamed over the original
+		m_Watch = inotify_add_watch(m_Notify, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+	}
+	if (m_Watch < 0)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "can't watch %s", directory.c_str());
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void FileWatcher::Close()
+{
+	if (m_Notify >= 0)
+	{
+		close(m_Notify);
+		m_Notify = -1;
+	}
+	m_Watch = -1;
+}
+
+bool FileWatcher::IsWatching() const
+{
+	return m_Watch >= 0;
+}
+
+void FileWatcher::Poll(std::vector<std::string>& changed)
+{
+	if (!IsWatching())
+		return;
+
+	const size_t first = changed.size();
+	uint32 buffer[4096 / sizeof(uint32)];
+	for (;;)
+	{
+		const ssize_t bytes = read(m_Notify, buffer, sizeof(buffer));
+		if (bytes <= 0)
+		{
+			if (bytes < 0 && errno != EAGAIN && errno != EINTR)
+			{
+				DEBUG_MESSAGE(RAY_ERROR, "file watch stopped");
+				Close();
+			}
+			if (bytes == 0 || errno != EINTR)
+				break;
+			continue;
+		}
+
+		const uint8* record = (const uint8*)buffer;
+		const uint8* end = record + bytes;
+		while (record < end)
+		{
+			const inotify_event* event = (const inotify_event*)record;
+			if (event->len > 0 && (event->mask & IN_ISDIR) == 0)
+			{
+				changed.push_back(event->name);
+			}
+			record += sizeof(inotify_event) + event->len;
+		}
+	}
+
+	std::sort(changed.begin() + first, changed.end());
+	changed.erase(std::unique(changed.begin() + first, changed.end()), changed.end());
+}
+
+#endif
@@ -0,0 +1,46 @@
+//===========================================================================
+// FileWatcher: reports files written inside one directory. The os queues
+// the notifications (ReadDirectoryChangesW, inotify elsewhere) and Poll
+// only collects them, so it is cheap enough to call every frame.
+//===========================================================================
+
+#pragma once
+#include "../Config/WindowPlatform.h"
+#include <string>
+#include <vector>
+
+class FileWatcher
+{
+public:
+	FileWatcher();
+	~FileWatcher();
+
+	/* files directly inside directory, subdirectories aren't watched */
+	bool Watch(const std::string& directory);
+	void Close();
+
+	bool IsWatching() const;
+
+	/**
+	 * Appends the names, relative to the directory, of the files written or
+	 * moved in since the last poll. Each name is reported once per poll,
+	 * editors saving through a temporary file included.
+	 */
+	void Poll(std::vector<std::string>& changed);
+
+private:
+	FileWatcher(const FileWatcher&);
+	FileWatcher& operator=(const FileWatcher&);
+
+private:
+#ifdef _WIN32
+	bool Read();
+
+	void* m_Directory;
+	void* m_Overlapped;
+	std::vector<uint32> m_Buffer; //FILE_NOTIFY_INFORMATION records, DWORD aligned
+#else
+	int m_Notify;
+	int m_Watch;
+#endif
+};
@@ -0,0 +1,337 @@
+#include "Inflate.h"
+#include <string.h>
+
+static const uint32 MaxCodeBits = 15;
+static const uint32 FastBits = 10;
+
+/**
+	bits are read least significant first, a refill keeps at least 56 buffered
+**/
+class BitReader
+{
+public:
+	BitReader(const uint8* data, size_t size)
+		: m_Data(data)
+		, m_Size(size)
+		, m_Position(0)
+		, m_Bits(0)
+		, m_Count(0)
+		, m_Consumed(0)
+	{
+	}
+
+	void Refill()
+	{
+		while (m_Count <= 56)
+		{
+			//past the end zeros are fed in, Overrun tells whether they were used
+			const uint64 byte = m_Position < m_Size ? m_Data[m_Position] : 0;
+			m_Bits |= byte << m_Count;
+			m_Count += 8;
+			++m_Position;
+		}
+	}
+
+	uint32 Peek(uint32 count)
+	{
+		if (m_Count < count)
+		{
+			Refill();
+		}
+		return (uint32)(m_Bits & ((1ull << count) - 1));
+	}
+
+	void Skip(uint32 count)
+	{
+		m_Bits >>= count;
+		m_Count -= count;
+		m_Consumed += count;
+	}
+
+	uint32 Take(uint32 count)
+	{
+		const uint32 value = Peek(count);
+		Skip(count);
+		return value;
+	}
+
+	void AlignToByte()
+	{
+		Skip(m_Count & 7);
+	}
+
+	bool Overrun() const { return m_Consumed > (uint64)m_Size * 8; }
+
+private:
+	const uint8* m_Data;
+	size_t m_Size;
+	size_t m_Position;
+	uint64 m_Bits;
+	uint32 m_Count;
+	uint64 m_Consumed;
+};
+
+/**
+	canonical Huffman code, m_Fast holds symbol << 4 | length for short codes and 0 otherwise
+**/
+struct Huffman
+{
+	uint16 m_Fast[1 << FastBits];
+	uint16 m_Count[MaxCodeBits + 1];
+	uint16 m_Symbol[288];
+};
+
+static bool BuildHuffman(Huffman& huffman, const uint8* lengths, uint32 count)
+{
+	memset(huffman.m_Count, 0, sizeof(huffman.m_Count));
+	memset(huffman.m_Fast, 0, sizeof(huffman.m_Fast));
+	for (uint32 i = 0; i < count; ++i)
+	{
+		++huffman.m_Count[lengths[i]];
+	}
+	if (huffman.m_Count[0] == count)
+		return true;
+
+	//over-subscribed codes are broken, incomplete ones are legal for single distance codes
+	int32 left = 1;
+	for (uint32 length = 1; length <= MaxCodeBits; ++length)
+	{
+		left = (left << 1) - huffman.m_Count[length];
+		if (left < 0)
+			return false;
+	}
+
+	uint16 offsets[MaxCodeBits + 2];
+	uint32 nextCode[MaxCodeBits + 1];
+	offsets[1] = 0;
+	nextCode[0] = 0;
+	uint32 code = 0;
+	for (uint32 length = 1; length <= MaxCodeBits; ++length)
+	{
+		offsets[length + 1] = offsets[length] + huffman.m_Count[length];
+		code = (code + (length > 1 ? huffman.m_Count[length - 1] : 0)) << 1;
+		nextCode[length] = code;
+	}
+
+	for (uint32 symbol = 0; symbol < count; ++symbol)
+	{
+		const uint32 length = lengths[symbol];
+		if (length == 0)
+			continue;
+
+		huffman.m_Symbol[offsets[length]++] = (uint16)symbol;
+		const uint32 symbolCode = nextCode[length]++;
+		if (length > FastBits)
+			continue;
+
+		//the stream holds codes most significant bit first, the table is indexed by peeked bits
+		uint32 reversed = 0;
+		for (uint32 bit = 0; bit < length; ++bit)
+		{
+			reversed |= ((symbolCode >> bit) & 1) << (length - 1 - bit);
+		}
+		for (uint32 i = reversed; i < (1u << FastBits); i += 1u << length)
+		{
+			huffman.m_Fast[i] = (uint16)((symbol << 4) | length);
+		}
+	}
+	return true;
+}
+
+static int32 Decode(BitReader& reader, const Huffman& huffman)
+{
+	const uint16 entry = huffman.m_Fast[reader.Peek(FastBits)];
+	if (entry != 0)
+	{
+		reader.Skip(entry & 15);
+		return entry >> 4;
+	}
+
+	int32 code = 0, first = 0, index = 0;
+	for (uint32 length = 1; length <= MaxCodeBits; ++length)
+	{
+		code |= (int32)reader.Take(1);
+		const int32 count = huffman.m_Count[length];
+		if (code - count < first)
+			return huffman.m_Symbol[index + (code - first)];
+
+		index += count;
+		first = (first + count) << 1;
+		code <<= 1;
+	}
+	return -1;
+}
+
+static const uint16 LengthBase[29] = { 3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31, 35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258 };
+static const uint8 LengthExtra[29] = { 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0 };
+static const uint16 DistanceBase[30] = { 1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193, 257, 385, 513, 769, 1025, 1537, 2049, 3073,
+	4097, 6145, 8193, 12289, 16385, 24577 };
+static const uint8 DistanceExtra[30] = { 0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6, 7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13 };
+
+static bool InflateBlock(BitReader& reader, const Huffman& literals, const Huffman& distances, std::vector<uint8>& out)
+{
+	for (;;)
+	{
+		const int32 symbol = Decode(reader, literals);
+		if (symbol < 0 || reader.Overrun())
+			return false;
+
+		if (symbol < 256)
+		{
+			out.push_back((uint8)symbol);
+			continue;
+		}
+		if (symbol == 256)
+			return true;
+
+		const int32 lengthSymbol = symbol - 257;
+		if (lengthSymbol >= 29)
+			return false;
+		const uint32 length = LengthBase[lengthSymbol] + reader.Take(LengthExtra[lengthSymbol]);
+
+		const int32 distanceSymbol = Decode(reader, distances);
+		if (distanceSymbol < 0 || distanceSymbol >= 30)
+			return false;
+		const uint32 distance = DistanceBase[distanceSymbol] + reader.Take(DistanceExtra[distanceSymbol]);
+		if (distance > out.size())
+			return false;
+
+		//byte by byte, the match may overlap what it produces
+		size_t from = out.size() - distance;
+		for (uint32 i = 0; i < length; ++i)
+		{
+			out.push_back(out[from + i]);
+		}
+	}
+}
+
+static bool ReadDynamicTables(BitReader& reader, Huffman& literals, Huffman& distances)
+{
+	static const uint8 order[19] = { 16, 17, 18, 0, 8, 7, 9, 6, 10, 5, 11, 4, 12, 3, 13, 2, 14, 1, 15 };
+
+	const uint32 literalCount = reader.Take(5) + 257;
+	const uint32 distanceCount = reader.Take(5) + 1;
+	const uint32 codeLengthCount = reader.Take(4) + 4;
+	if (literalCount > 286 || distanceCount > 30)
+		return false;
+
+	uint8 lengths[286 + 30];
+	memset(lengths, 0, sizeof(lengths));
+	for (uint32 i = 0; i < codeLengthCount; ++i)
+	{
+		lengths[order[i]] = (uint8)reader.Take(3);
+	}
+
+	Huffman codeLengths;
+	if (!BuildHuffman(codeLengths, lengths, 19))
+		return false;
+
+	uint32 index = 0;
+	while (index < literalCount + distanceCount)
+	{
+		const int32 symbol = Decode(reader, codeLengths);
+		if (symbol < 0 || reader.Overrun())
+			return false;
+
+		if (symbol < 16)
+		{
+			lengths[index++] = (uint8)symbol;
+			continue;
+		}
+
+		uint8 repeated = 0;
+		uint32 repeat = 0;
+		if (symbol == 16)
+		{
+			if (index == 0)
+				return false;
+			repeated = lengths[index - 1];
+			repeat = 3 + reader.Take(2);
+		}
+		else if (symbol == 17)
+		{
+			repeat = 3 + reader.Take(3);
+		}
+		else
+		{
+			repeat = 11 + reader.Take(7);
+		}
+
+		if (index + repeat > literalCount + distanceCount)
+			return false;
+		while (repeat-- > 0)
+		{
+			lengths[index++] = repeated;
+		}
+	}
+
+	//a block without an end of block code can't terminate
+	if (lengths[256] == 0)
+		return false;
+
+	return BuildHuffman(literals, lengths, literalCount) && BuildHuffman(distances, lengths + literalCount, distanceCount);
+}
+
+bool InflateRaw(const uint8* data, size_t size, std::vector<uint8>& out)
+{
+	BitReader reader(data, size);
+	Huffman literals, distances;
+
+	bool last = false;
+	while (!last)
+	{
+		last = reader.Take(1) != 0;
+		const uint32 type = reader.Take(2);
+
+		if (type == 0)
+		{
+			reader.AlignToByte();
+			const uint32 length = reader.Take(16);
+			const uint32 complement = reader.Take(16);
+			if ((length ^ 0xFFFF) != complement)
+				return false;
+
+			for (uint32 i = 0; i < length; ++i)
+			{
+				out.push_back((uint8)reader.Take(8));
+			}
+		}
+		else if (type == 1)
+		{
+			uint8 lengths[288 + 30];
+			memset(lengths, 8, 144);
+			memset(lengths + 144, 9, 112);
+			memset(lengths + 256, 7, 24);
+			memset(lengths + 280, 8, 8);
+			memset(lengths + 288, 5, 30);
+			BuildHuffman(literals, lengths, 288);
+			BuildHuffman(distances, lengths + 288, 30);
+			if (!InflateBlock(reader, literals, distances, out))
+				return false;
+		}
+		else if (type == 2)
+		{
+			if (!ReadDynamicTables(reader, literals, distances) || !InflateBlock(reader, literals, distances, out))
+				return false;
+		}
+		else
+		{
+			return false;
+		}
+
+		if (reader.Overrun())
+			return false;
+	}
+	return true;
+}
+
+bool Inflate(const uint8* data, size_t size, std::vector<uint8>& out, size_t expectedSize)
+{
+	//deflate with a window of at most 32k, no preset dictionary
+	if (size < 2 || (data[0] & 0x0F) != 8 || (data[0] >> 4) > 7 || ((data[0] << 8) | data[1]) % 31 != 0 || (data[1] & 0x20) != 0)
+		return false;
+
+	out.clear();
+	out.reserve(expectedSize);
+	return InflateRaw(data + 2, size - 2, out);
+}
@@ -0,0 +1,16 @@
+//===========================================================================
+// Inflate: decompression of zlib streams (RFC 1950/1951), as found in PNG
+// IDAT chunks. Huffman codes up to 10 bits are decoded with one table
+// lookup, longer ones a bit at a time.
+//===========================================================================
+
+#pragma once
+#include "../Config/WindowPlatform.h"
+#include <stddef.h>
+#include <vector>
+
+/* expectedSize only reserves the output, a stream may inflate to any size */
+bool Inflate(const uint8* data, size_t size, std::vector<uint8>& out, size_t expectedSize = 0);
+
+/* a raw deflate stream without the zlib header and checksum */
+bool InflateRaw(const uint8* data, size_t size, std::vector<uint8>& out);
@@ -0,0 +1,355 @@
+#include "Json.h"
+#include <stdlib.h>
+#include <string.h>
+
+static const JsonValue s_NullValue;
+
+/**
+	recursive descent over the text, values are built in place
+**/
+class JsonParser
+{
+public:
+	JsonParser(const char* text, size_t length)
+		: m_Text(text)
+		, m_End(text + length)
+		, m_Cursor(text)
+		, m_Depth(0)
+		, m_Error(nullptr)
+	{
+	}
+
+	bool ParseDocument(JsonValue& out)
+	{
+		if (!ParseValue(out))
+			return false;
+
+		SkipWhitespace();
+		return m_Cursor == m_End || Fail("trailing characters");
+	}
+
+	const char* GetError() const { return m_Error; }
+	size_t GetOffset() const { return m_Cursor - m_Text; }
+
+private:
+	static const int MaxDepth = 256;
+
+	bool Fail(const char* error)
+	{
+		m_Error = error;
+		return false;
+	}
+
+	void SkipWhitespace()
+	{
+		while (m_Cursor < m_End && (*m_Cursor == ' ' || *m_Cursor == '\t' || *m_Cursor == '\n' || *m_Cursor == '\r'))
+		{
+			++m_Cursor;
+		}
+	}
+
+	bool Match(const char* literal)
+	{
+		size_t length = strlen(literal);
+		if ((size_t)(m_End - m_Cursor) < length || memcmp(m_Cursor, literal, length) != 0)
+			return false;
+
+		m_Cursor += length;
+		return true;
+	}
+
+	bool ParseValue(JsonValue& out)
+	{
+		SkipWhitespace();
+		if (m_Cursor == m_End)
+			return Fail("unexpected end");
+
+		switch (*m_Cursor)
+		{
+		case '{':
+			return ParseObject(out);
+		case '[':
+			return ParseArray(out);
+		case '"':
+			out.m_Type = JsonValue::JT_String;
+			return ParseString(out.m_String);
+		case 't':
+			out.m_Type = JsonValue::JT_Bool;
+			out.m_Bool = true;
+			return Match("true") || Fail("bad literal");
+		case 'f':
+			out.m_Type = JsonValue::JT_Bool;
+			out.m_Bool = false;
+			return Match("false") || Fail("bad literal");
+		case 'n':
+			out.m_Type = JsonValue::JT_Null;
+			return Match("null") || Fail("bad literal");
+		default:
+			return ParseNumber(out);
+		}
+	}
+
+	bool ParseNumber(JsonValue& out)
+	{
+		//strtod needs a terminated string, numbers are short so copy them out
+		char buffer[64];
+		size_t length = 0;
+		while (m_Cursor + length < m_End && length < sizeof(buffer) - 1 && strchr("+-0123456789.eE", m_Cursor[length]) != nullptr)
+		{
+			buffer[length] = m_Cursor[length];
+			++length;
+		}
+		buffer[length] = 0;
+
+		char* end = nullptr;
+		out.m_Number = strtod(buffer, &end);
+		if (length == 0 || end != buffer + length)
+			return Fail("bad number");
+
+		out.m_Type = JsonValue::JT_Number;
+		m_Cursor += length;
+		return true;
+	}
+
+	bool ParseHex4(uint32& code)
+	{
+		if (m_End - m_Cursor < 4)
+			return Fail("bad escape");
+
+		code = 0;
+		for (int i = 0; i < 4; ++i)
+		{
+			char c = *m_Cursor++;
+			code <<= 4;
+			if (c >= '0' && c <= '9') code |= c - '0';
+			else if (c >= 'a' && c <= 'f') code |= c - 'a' + 10;
+			else if (c >= 'A' && c <= 'F') code |= c - 'A' + 10;
+			else return Fail("bad escape");
+		}
+		return true;
+	}
+
+	static void AppendUTF8(std::string& out, uint32 code)
+	{
+		if (code < 0x80)
+		{
+			out += (char)code;
+		}
+		else if (code < 0x800)
+		{
+			out += (char)(0xC0 | (code >> 6));
+			out += (char)(0x80 | (code & 0x3F));
+		}
+		else if (code < 0x10000)
+		{
+			out += (char)(0xE0 | (code >> 12));
+			out += (char)(0x80 | ((code >> 6) & 0x3F));
+			out += (char)(0x80 | (code & 0x3F));
+		}
+		else
+		{
+			out += (char)(0xF0 | (code >> 18));
+			out += (char)(0x80 | ((code >> 12) & 0x3F));
+			out += (char)(0x80 | ((code >> 6) & 0x3F));
+			out += (char)(0x80 | (code & 0x3F));
+		}
+	}
+
+	bool ParseString(std::string& out)
+	{
+		++m_Cursor; //opening quote
+		out.clear();
+
+		while (m_Cursor < m_End)
+		{
+			char c = *m_Cursor++;
+			if (c == '"')
+				return true;
+
+			if (c != '\\')
+			{
+				out += c;
+				continue;
+			}
+
+			if (m_Cursor == m_End)
+				break;
+
+			c = *m_Cursor++;
+			switch (c)
+			{
+			case '"': out += '"'; break;
+			case '\\': out += '\\'; break;
+			case '/': out += '/'; break;
+			case 'b': out += '\b'; break;
+			case 'f': out += '\f'; break;
+			case 'n': out += '\n'; break;
+			case 'r': out += '\r'; break;
+			case 't': out += '\t'; break;
+			case 'u':
+			{
+				uint32 code;
+				if (!ParseHex4(code))
+					return false;
+
+				//a high surrogate is followed by the low half of the pair
+				if (code >= 0xD800 && code < 0xDC00)
+				{
+					uint32 low;
+					if (!Match("\\u") || !ParseHex4(low) || low < 0xDC00 || low >= 0xE000)
+						return Fail("bad surrogate pair");
+					code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+				}
+				AppendUTF8(out, code);
+				break;
+			}
+			default:
+				return Fail("bad escape");
+			}
+		}
+
+		return Fail("unterminated string");
+	}
+
+	bool ParseArray(JsonValue& out)
+	{
+		if (++m_Depth > MaxDepth)
+			return Fail("nested too deep");
+
+		++m_Cursor;
+		out.m_Type = JsonValue::JT_Array;
+
+		SkipWhitespace();
+		if (m_Cursor < m_End && *m_Cursor == ']')
+		{
+			++m_Cursor;
+			--m_Depth;
+			return true;
+		}
+
+		for (;;)
+		{
+			out.m_Elements.push_back(JsonValue());
+			if (!ParseValue(out.m_Elements.back()))
+				return false;
+
+			SkipWhitespace();
+			if (m_Cursor == m_End)
+				return Fail("unterminated array");
+
+			char c = *m_Cursor++;
+			if (c == ']')
+				break;
+			if (c != ',')
+				return Fail("expected , or ]");
+		}
+
+		--m_Depth;
+		return true;
+	}
+
+	bool ParseObject(JsonValue& out)
+	{
+		if (++m_Depth > MaxDepth)
+			return Fail("nested too deep");
+
+		++m_Cursor;
+		out.m_Type = JsonValue::JT_Object;
+
+		SkipWhitespace();
+		if (m_Cursor < m_End && *m_Cursor == '}')
+		{
+			++m_Cursor;
+			--m_Depth;
+			return true;
+		}
+
+		for (;;)
+		{
+			SkipWhitespace();
+			if (m_Cursor == m_End || *m_Cursor != '"')
+				return Fail("expected a key");
+
+			out.m_Keys.push_back(std::string());
+			if (!ParseString(out.m_Keys.back()))
+				return false;
+
+			SkipWhitespace();
+			if (m_Cursor == m_End || *m_Cursor++ != ':')
+				return Fail("expected :");
+
+			out.m_Elements.push_back(JsonValue());
+			if (!ParseValue(out.m_Elements.back()))
+				return false;
+
+			SkipWhitespace();
+			if (m_Cursor == m_End)
+				return Fail("unterminated object");
+
+			char c = *m_Cursor++;
+			if (c == '}')
+				break;
+			if (c != ',')
+				return Fail("expected , or }");
+		}
+
+		--m_Depth;
+		return true;
+	}
+
+private:
+	const char* m_Text;
+	const char* m_End;
+	const char* m_Cursor;
+	int m_Depth;
+	const char* m_Error;
+};
+
+JsonValue::JsonValue()
+	: m_Type(JT_Null)
+	, m_Bool(false)
+	, m_Number(0.0)
+{
+}
+
+bool JsonValue::Parse(const char* text, size_t length, JsonValue& out, std::string* error)
+{
+	out = JsonValue();
+
+	JsonParser parser(text, length);
+	if (parser.ParseDocument(out))
+		return true;
+
+	if (error != nullptr)
+	{
+		*error = std::string(parser.GetError()) + " at offset " + std::to_string((uint64)parser.GetOffset());
+	}
+	out = JsonValue();
+	return false;
+}
+
+const JsonValue& JsonValue::GetElement(uint32 index) const
+{
+	if (index >= m_Elements.size())
+		return s_NullValue;
+
+	return m_Elements[index];
+}
+
+const JsonValue& JsonValue::operator[](const char* key) const
+{
+	if (m_Type == JT_Object)
+	{
+		for (size_t i = 0; i < m_Keys.size(); ++i)
+		{
+			if (m_Keys[i] == key)
+				return m_Elements[i];
+		}
+	}
+	return s_NullValue;
+}
+
+bool JsonValue::Has(const char* key) const
+{
+	return &(*this)[key] != &s_NullValue;
+}
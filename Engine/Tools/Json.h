@@ -0,0 +1,58 @@
+//===========================================================================
+// Json: a small read-only JSON document, enough for asset descriptions such
+// as glTF. Missing members and out of range elements read as null.
+//===========================================================================
+
+#pragma once
+#include "../Config/WindowPlatform.h"
+#include <string>
+#include <vector>
+
+class JsonValue
+{
+public:
+	enum Type
+	{
+		JT_Null,
+		JT_Bool,
+		JT_Number,
+		JT_String,
+		JT_Array,
+		JT_Object,
+	};
+
+	JsonValue();
+
+	/* parses a whole document, error gets a message with the offset it failed at */
+	static bool Parse(const char* text, size_t length, JsonValue& out, std::string* error = nullptr);
+
+	Type GetType() const { return m_Type; }
+	bool IsNull() const { return m_Type == JT_Null; }
+	bool IsNumber() const { return m_Type == JT_Number; }
+	bool IsString() const { return m_Type == JT_String; }
+	bool IsArray() const { return m_Type == JT_Array; }
+	bool IsObject() const { return m_Type == JT_Object; }
+
+	bool GetBool(bool fallback = false) const { return m_Type == JT_Bool ? m_Bool : fallback; }
+	double GetNumber(double fallback = 0.0) const { return m_Type == JT_Number ? m_Number : fallback; }
+	float GetFloat(float fallback = 0.0f) const { return m_Type == JT_Number ? (float)m_Number : fallback; }
+	uint32 GetUInt(uint32 fallback = 0) const { return m_Type == JT_Number && m_Number >= 0.0 ? (uint32)m_Number : fallback; }
+	const std::string& GetString() const { return m_String; }
+
+	/* elements of an array or members of an object */
+	uint32 GetSize() const { return (uint32)m_Elements.size(); }
+	const JsonValue& GetElement(uint32 index) const;
+	const JsonValue& operator[](const char* key) const;
+	bool Has(const char* key) const;
+	const std::string& GetKey(uint32 index) const { return m_Keys[index]; }
+
+private:
+	friend class JsonParser;
+
+	Type m_Type;
+	bool m_Bool;
+	double m_Number;
+	std::string m_String;
+	std::vector<JsonValue> m_Elements;
+	std::vector<std::string> m_Keys; //objects only, parallel to m_Elements
+};
@@ -0,0 +1,116 @@
+#include "MappedFile.h"
+#include "RayUtils.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile()
+#ifdef _WIN32
+	: m_File(INVALID_HANDLE_VALUE)
+	, m_Mapping(nullptr)
+#else
+	: m_File(-1)
+#endif
+	, m_Data(nullptr)
+	, m_Size(0)
+{
+}
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+bool MappedFile::Open(const std::string& path)
+{
+	Close();
+
+#ifdef _WIN32
+	m_File = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (m_File == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0)
+	{
+		Close();
+		return false;
+	}
+	m_Size = (uint64)size.QuadPart;
+
+	m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (m_Mapping == nullptr)
+	{
+		Close();
+		return false;
+	}
+
+	m_Data = (const uint8*)MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+	m_File = open(path.c_str(), O_RDONLY);
+	if (m_File < 0)
+		return false;
+
+	struct stat info;
+	if (fstat(m_File, &info) != 0 || info.st_size == 0)
+	{
+		Close();
+		return false;
+	}
+	m_Size = (uint64)info.st_size;
+
+	void* data = mmap(nullptr, (size_t)m_Size, PROT_READ, MAP_PRIVATE, m_File, 0);
+	if (data != MAP_FAILED)
+	{
+		madvise(data, (size_t)m_Size, MADV_SEQUENTIAL);
+		m_Data = (const uint8*)data;
+	}
+#endif
+
+	if (m_Data == nullptr)
+	{
+		DEBUG_MESSAGE(RAY_ERROR, "can't map %s", path.c_str());
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void MappedFile::Close()
+{
+#ifdef _WIN32
+	if (m_Data != nullptr)
+	{
+		UnmapViewOfFile(m_Data);
+	}
+	if (m_Mapping != nullptr)
+	{
+		CloseHandle(m_Mapping);
+		m_Mapping = nullptr;
+	}
+	if (m_File != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(m_File);
+		m_File = INVALID_HANDLE_VALUE;
+	}
+#else
+	if (m_Data != nullptr)
+	{
+		munmap((void*)m_Data, (size_t)m_Size);
+	}
+	if (m_File >= 0)
+	{
+		close(m_File);
+		m_File = -1;
+	}
+#endif
+
+	m_Data = nullptr;
+	m_Size = 0;
+}
@@ -0,0 +1,36 @@
+//===========================================================================
+// MappedFile: read-only memory mapping of a whole file, the os pages it in
+// on first touch instead of copying it through a read buffer.
+//===========================================================================
+
+#pragma once
+#include "../Config/WindowPlatform.h"
+#include <string>
+
+class MappedFile
+{
+public:
+	MappedFile();
+	~MappedFile();
+
+	bool Open(const std::string& path);
+	void Close();
+
+	bool IsOpen() const { return m_Data != nullptr; }
+	const uint8* GetData() const { return m_Data; }
+	uint64 GetSize() const { return m_Size; }
+
+private:
+	MappedFile(const MappedFile&);
+	MappedFile& operator=(const MappedFile&);
+
+private:
+#ifdef _WIN32
+	void* m_File;
+	void* m_Mapping;
+#else
+	int m_File;
+#endif
+	const uint8* m_Data;
+	uint64 m_Size;
+};
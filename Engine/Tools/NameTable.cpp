@@ -0,0 +1,27 @@
+#include "NameTable.h"
+
+NameTable::NameTable()
+{
+	m_Names.push_back(std::string());
+}
+
+NameId NameTable::Intern(const std::string& name)
+{
+	if (name.empty())
+		return NoName;
+
+	auto itr = m_Ids.find(name);
+	if (itr != m_Ids.end())
+		return itr->second;
+
+	const NameId id = (NameId)m_Names.size();
+	m_Names.push_back(name);
+	m_Ids[name] = id;
+	return id;
+}
+
+NameId NameTable::Find(const std::string& name) const
+{
+	auto itr = m_Ids.find(name);
+	return itr != m_Ids.end() ? itr->second : NoName;
+}
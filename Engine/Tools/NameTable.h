@@ -0,0 +1,38 @@
+//===========================================================================
+// NameTable: interns strings as small dense ids. A name is hashed once when
+// it's added, from then on it's compared and looked up as an integer and
+// the ids can index plain arrays.
+//===========================================================================
+
+#pragma once
+#include "../Config/WindowPlatform.h"
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+typedef uint32 NameId;
+
+class NameTable
+{
+public:
+	/* the empty string, never added */
+	static const NameId NoName = 0;
+
+	NameTable();
+
+	/* the id of name, added if it's new */
+	NameId Intern(const std::string& name);
+
+	/* the id of name, NoName if it was never added */
+	NameId Find(const std::string& name) const;
+
+	/* stays valid as names are added */
+	const std::string& GetName(NameId id) const { return m_Names[id]; }
+
+	/* ids are below this, arrays indexed by id need this many entries */
+	uint32 GetCount() const { return (uint32)m_Names.size(); }
+
+private:
+	std::deque<std::string> m_Names; //by id, a deque doesn't move them when it grows
+	std::unordered_map<std::string, NameId> m_Ids;
+};
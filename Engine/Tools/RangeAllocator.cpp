@@ -0,0 +1,80 @@
+#include "RangeAllocator.h"
+#include "RayUtils.h"
+#include <stdlib.h>
+
+RangeAllocator::RangeAllocator()
+	: m_Capacity(0)
+	, m_FreeSize(0)
+{
+}
+
+RangeAllocator::RangeAllocator(uint32 capacity)
+{
+	Reset(capacity);
+}
+
+void RangeAllocator::Reset(uint32 capacity)
+{
+	m_FreeRanges.clear();
+	m_Capacity = capacity;
+	m_FreeSize = capacity;
+	if (capacity > 0)
+	{
+		m_FreeRanges[0] = capacity;
+	}
+}
+
+uint32 RangeAllocator::Allocate(uint32 size)
+{
+	if (size == 0 || size > m_FreeSize)
+		return InvalidOffset;
+
+	for (auto itr = m_FreeRanges.begin(); itr != m_FreeRanges.end(); ++itr)
+	{
+		if (itr->second < size)
+			continue;
+
+		uint32 offset = itr->first;
+		uint32 remaining = itr->second - size;
+		m_FreeRanges.erase(itr);
+		if (remaining > 0)
+		{
+			m_FreeRanges[offset + size] = remaining;
+		}
+
+		m_FreeSize -= size;
+		return offset;
+	}
+	return InvalidOffset;
+}
+
+void RangeAllocator::Free(uint32 offset, uint32 size)
+{
+	if (offset == InvalidOffset || size == 0)
+		return;
+
+	ASSERT(offset + size <= m_Capacity);
+	m_FreeSize += size;
+
+	//merge with the following free range
+	auto next = m_FreeRanges.lower_bound(offset);
+	if (next != m_FreeRanges.end() && next->first == offset + size)
+	{
+		size += next->second;
+		next = m_FreeRanges.erase(next);
+	}
+
+	//merge with the preceding free range
+	if (next != m_FreeRanges.begin())
+	{
+		auto prev = next;
+		--prev;
+		if (prev->first + prev->second == offset)
+		{
+			prev->second += size;
+			return;
+		}
+	}
+
+	m_FreeRanges[offset] = size;
+}
@@ -0,0 +1,31 @@
+//===========================================================================
+// RangeAllocator: first-fit allocator handing out ranges of a fixed size
+// space, freed ranges are merged back with their free neighbours.
+//===========================================================================
+
+#pragma once
+#include "../Config/WindowPlatform.h"
+#include <map>
+
+class RangeAllocator
+{
+public:
+	static const uint32 InvalidOffset = 0xFFFFFFFF;
+
+	RangeAllocator();
+	explicit RangeAllocator(uint32 capacity);
+
+	void Reset(uint32 capacity);
+
+	/* returns the offset of the range, or InvalidOffset when no free range is big enough */
+	uint32 Allocate(uint32 size);
+	void Free(uint32 offset, uint32 size);
+
+	uint32 GetCapacity() const { return m_Capacity; }
+	uint32 GetFreeSize() const { return m_FreeSize; }
+
+private:
+	std::map<uint32, uint32> m_FreeRanges; //offset -> size, never adjacent
+	uint32 m_Capacity;
+	uint32 m_FreeSize;
+};
@@ -1,9 +0,0 @@
-#version 330
-
-in vec4 oColor;
-out vec4 FragColor;
-
-void main()
-{
-    FragColor = oColor;
-}
\ No newline at end of file
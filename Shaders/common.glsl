@@ -0,0 +1,9 @@
+// shared by every stage that includes it, the preprocessor expands it once per stage
+
+layout (std140, row_major) uniform PerFrame
+{
+	mat4 gView;
+	mat4 gProj;
+	mat4 gViewProj;
+	vec4 gTime;
+};
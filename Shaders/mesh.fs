@@ -0,0 +1,48 @@
+#version 330
+
+in vec4 oColor;
+out vec4 FragColor;
+
+#ifdef RAY_TEXTURED
+in vec2 oUV;
+flat in float oLayer;
+
+uniform sampler2D gDiffuse;
+uniform sampler2DArray gDiffuseArray;
+#endif
+
+#ifdef RAY_LOD_FADE
+flat in vec2 oFade;
+
+// 4x4 ordered dither thresholds
+const float Bayer[16] = float[16](
+	 0.0 / 16.0,  8.0 / 16.0,  2.0 / 16.0, 10.0 / 16.0,
+	12.0 / 16.0,  4.0 / 16.0, 14.0 / 16.0,  6.0 / 16.0,
+	 3.0 / 16.0, 11.0 / 16.0,  1.0 / 16.0,  9.0 / 16.0,
+	15.0 / 16.0,  7.0 / 16.0, 13.0 / 16.0,  5.0 / 16.0);
+#endif
+
+void main()
+{
+#ifdef RAY_LOD_FADE
+	// lod cross-fade: x is the fade, y is 1 on the incoming level and -1 on the outgoing one,
+	// the two levels keep complementary pixels
+	if (oFade.y != 0.0)
+	{
+		ivec2 pixel = ivec2(gl_FragCoord.xy) & 3;
+		float threshold = Bayer[pixel.y * 4 + pixel.x];
+		if ((oFade.y > 0.0) == (threshold >= oFade.x))
+			discard;
+	}
+#endif
+
+#ifdef RAY_TEXTURED
+	// pooled textures live in a layer of an array, the gradients are taken outside the branch
+	vec2 dx = dFdx(oUV);
+	vec2 dy = dFdy(oUV);
+	vec4 diffuse = oLayer >= 0.0 ? textureGrad(gDiffuseArray, vec3(oUV, oLayer), dx, dy) : textureGrad(gDiffuse, oUV, dx, dy);
+	FragColor = oColor * diffuse;
+#else
+	FragColor = oColor;
+#endif
+}
@@ -0,0 +1,74 @@
+#version 330
+
+#include "common.glsl"
+
+layout (location = 0) in vec3 Position;
+layout (location = 1) in vec4 Color;
+
+#ifdef RAY_INSTANCING
+// per-instance stream, the 3 columns of the affine world transform
+layout (location = 2) in vec4 InstanceTransform0;
+layout (location = 3) in vec4 InstanceTransform1;
+layout (location = 4) in vec4 InstanceTransform2;
+layout (location = 5) in vec4 InstanceColor;
+layout (location = 6) in vec4 InstanceParams;
+#else
+layout (std140, row_major) uniform PerObject
+{
+	mat4 gWorld;
+};
+#endif
+
+#ifdef RAY_TEXTURED
+// (0, 0) for meshes without texture coordinates, untextured draws sample a 1x1 white texture
+layout (location = 7) in vec2 UV;
+
+// two vectors per texture handle: the atlas rectangle (scale xy, offset zw) and the array layer in x, -1 outside a pool
+const int MaxTextureSlots = 512;
+layout (std140) uniform TextureSlots
+{
+	vec4 gTextureSlots[MaxTextureSlots * 2];
+};
+
+out vec2 oUV;
+flat out float oLayer;
+#endif
+
+#ifdef RAY_LOD_FADE
+flat out vec2 oFade;
+#endif
+
+out vec4 oColor;
+
+void main()
+{
+	vec4 localPos = vec4(Position, 1.0);
+#ifdef RAY_INSTANCING
+	vec4 worldPos = vec4(dot(localPos, InstanceTransform0), dot(localPos, InstanceTransform1), dot(localPos, InstanceTransform2), 1.0);
+	oColor = Color * InstanceColor;
+#else
+	vec4 worldPos = localPos * gWorld;
+	oColor = Color;
+#endif
+	gl_Position = worldPos * gViewProj;
+
+#ifdef RAY_TEXTURED
+	// handles past the table sample their whole texture like slot 0
+#ifdef RAY_INSTANCING
+	int handle = int(InstanceParams.z);
+#else
+	int handle = 0;
+#endif
+	int slot = handle < MaxTextureSlots ? handle * 2 : 0;
+	oUV = UV * gTextureSlots[slot].xy + gTextureSlots[slot].zw;
+	oLayer = gTextureSlots[slot + 1].x;
+#endif
+
+#ifdef RAY_LOD_FADE
+#ifdef RAY_INSTANCING
+	oFade = InstanceParams.xy;
+#else
+	oFade = vec2(0.0);
+#endif
+#endif
+}
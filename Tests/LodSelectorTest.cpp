@@ -0,0 +1,86 @@
+//=============================================================================================
+// LodSelectorTest: the lod bias has to rise while frames take longer than the budget, fall
+// back once they're under it again, and pick coarser levels while it's up.
+// Links against LodSelector.cpp, Camera.cpp and RayMath.cpp.
+//=============================================================================================
+
+#include "../Engine/Engine/LodSelector.h"
+#include "../Engine/Camera/Camera.h"
+#include <stdio.h>
+
+#define CHECK(condition) \
+	if (!(condition)) { fprintf(stderr, "%s(%d): %s failed\n", __FILE__, __LINE__, #condition); return 1; }
+
+int main()
+{
+	Camera camera;
+	camera.SetProjParameters(4.0f / 3.0f, 45, 1, 1000);
+	camera.Project(Perspective);
+	Vector position(0.0f, 0.0f, 0.0f);
+	Vector target(0.0f, 0.0f, -1.0f);
+	camera.SetPosition(position);
+	camera.LookAt(target);
+
+	const float budget = 1000.0f / 60.0f;
+	const float deltaTime = 1.0f / 60.0f;
+
+	LodChain chain;
+	chain.m_LevelCount = 3;
+	chain.m_ScreenSize[0] = 0.08f;
+	chain.m_ScreenSize[1] = 0.03f;
+
+	//a sphere well inside level 0, by a factor of 1.5 over its threshold
+	const Vector center(0.0f, 0.0f, -10.0f);
+	const float radius = 10.0f * 0.08f * 1.5f / 2.414f;
+
+	LodSelector selector;
+	selector.SetFadeTime(0.0f);
+
+	//without a budget frame times are ignored
+	for (int frame = 0; frame < 60; ++frame)
+	{
+		selector.BeginFrame(camera, deltaTime, budget * 2.0f);
+	}
+	CHECK(selector.GetBias() == 0.0f);
+
+	LodState state;
+	selector.SetFrameBudget(budget);
+	selector.BeginFrame(camera, deltaTime, budget);
+	CHECK(selector.Select(chain, center, radius, state) == 0);
+
+	//a second of slow frames raises the bias by about a level, the sphere drops one
+	float lastBias = selector.GetBias();
+	for (int frame = 0; frame < 60; ++frame)
+	{
+		selector.BeginFrame(camera, deltaTime, budget * 1.5f);
+		CHECK(selector.GetBias() >= lastBias);
+		lastBias = selector.GetBias();
+	}
+	CHECK(selector.GetBias() > 0.9f);
+	CHECK(selector.Select(chain, center, radius, state) == 1);
+
+	//it's clamped however long the frames stay slow
+	for (int frame = 0; frame < 600; ++frame)
+	{
+		selector.BeginFrame(camera, deltaTime, budget * 1.5f);
+	}
+	CHECK(selector.GetBias() <= 2.0f);
+
+	//frames just under the budget hold it where it is
+	lastBias = selector.GetBias();
+	selector.BeginFrame(camera, deltaTime, budget * 0.9f);
+	CHECK(selector.GetBias() == lastBias);
+
+	//fast frames bring it back down to 0 and the sphere back to level 0
+	for (int frame = 0; frame < 180; ++frame)
+	{
+		selector.BeginFrame(camera, deltaTime, budget * 0.5f);
+		CHECK(selector.GetBias() <= lastBias);
+		lastBias = selector.GetBias();
+	}
+	CHECK(selector.GetBias() == 0.0f);
+	CHECK(selector.Select(chain, center, radius, state) == 0);
+
+	printf("LodSelectorTest passed\n");
+	return 0;
+}
@@ -0,0 +1,229 @@
+//=============================================================================================
+// ShaderReloadTest: a shader source edited while its program is still linking has to be
+// compiled by the relink that follows, and the binary cache must only get programs built
+// from the sources their key was made from. GL is replaced by stubs, no context is needed.
+// Links against the engine's shader sources, glew32.lib, glfw3.lib and opengl32.lib.
+//=============================================================================================
+
+#include "../Engine/RenderSystem/OpenGL/OpenGLShader.h"
+#include "../Engine/RenderSystem/OpenGL/OpenGLExtensions.h"
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <map>
+#include <thread>
+#ifdef _WIN32
+#include <direct.h>
+#else
+#include <sys/stat.h>
+#endif
+
+#define CHECK(condition) \
+	if (!(condition)) { fprintf(stderr, "%s(%d): %s failed\n", __FILE__, __LINE__, #condition); return 1; }
+
+/**
+	the stub driver: a program's "binary" is the text of the stages it was linked from,
+	so a test can tell which sources ended up in a program or in the cache
+**/
+static GLuint s_NextObject = 1;
+static GLint s_LinkComplete = 1;
+static int s_Compiles = 0;
+static std::map<GLuint, std::string> s_Sources; //by shader
+static std::map<GLuint, std::vector<GLuint>> s_Attached; //by program
+static std::map<GLuint, std::string> s_Linked; //by program
+
+static GLuint GLAPIENTRY StubCreateObject() { return s_NextObject++; }
+static GLuint GLAPIENTRY StubCreateShader(GLenum) { return s_NextObject++; }
+static void GLAPIENTRY StubDeleteObject(GLuint) {}
+static void GLAPIENTRY StubCompileShader(GLuint) { ++s_Compiles; }
+static void GLAPIENTRY StubProgramParameteri(GLuint, GLenum, GLint) {}
+static void GLAPIENTRY StubValidateProgram(GLuint) {}
+static void GLAPIENTRY StubInfoLog(GLuint, GLsizei, GLsizei*, GLchar* log) { log[0] = 0; }
+
+static void GLAPIENTRY StubShaderSource(GLuint shader, GLsizei count, const GLchar* const* strings, const GLint* lengths)
+{
+	s_Sources[shader].clear();
+	for (GLsizei i = 0; i < count; ++i)
+	{
+		s_Sources[shader].append(strings[i], lengths != nullptr ? lengths[i] : strlen(strings[i]));
+	}
+}
+
+static void GLAPIENTRY StubGetShaderiv(GLuint, GLenum, GLint* value) { *value = GL_TRUE; }
+
+static void GLAPIENTRY StubAttachShader(GLuint program, GLuint shader) { s_Attached[program].push_back(shader); }
+
+static void GLAPIENTRY StubDetachShader(GLuint program, GLuint shader)
+{
+	std::vector<GLuint>& attached = s_Attached[program];
+	attached.erase(std::remove(attached.begin(), attached.end(), shader), attached.end());
+}
+
+static void GLAPIENTRY StubGetAttachedShaders(GLuint program, GLsizei maxCount, GLsizei* count, GLuint* shaders)
+{
+	const std::vector<GLuint>& attached = s_Attached[program];
+	*count = 0;
+	for (GLsizei i = 0; i < (GLsizei)attached.size() && i < maxCount; ++i)
+	{
+		shaders[(*count)++] = attached[i];
+	}
+}
+
+static void GLAPIENTRY StubLinkProgram(GLuint program)
+{
+	s_Linked[program].clear();
+	for (GLuint shader : s_Attached[program])
+	{
+		s_Linked[program] += s_Sources[shader];
+	}
+}
+
+static void GLAPIENTRY StubGetProgramiv(GLuint program, GLenum name, GLint* value)
+{
+	switch (name)
+	{
+	case GL_LINK_STATUS:
+	case GL_VALIDATE_STATUS:
+		*value = GL_TRUE;
+		break;
+	case GL_COMPLETION_STATUS_KHR:
+		*value = s_LinkComplete;
+		break;
+	case GL_PROGRAM_BINARY_LENGTH:
+		*value = (GLint)s_Linked[program].size();
+		break;
+	default:
+		*value = 0;
+		break;
+	}
+}
+
+static void GLAPIENTRY StubGetProgramBinary(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* format, void* binary)
+{
+	const std::string& linked = s_Linked[program];
+	*length = (GLsizei)linked.size() < bufSize ? (GLsizei)linked.size() : bufSize;
+	*format = 1;
+	memcpy(binary, linked.data(), *length);
+}
+
+static void GLAPIENTRY StubProgramBinary(GLuint program, GLenum, const void* binary, GLsizei length)
+{
+	s_Linked[program].assign((const char*)binary, length);
+}
+
+static void InstallStubs()
+{
+	__GLEW_ARB_get_program_binary = GL_TRUE;
+	__glewCreateProgram = StubCreateObject;
+	__glewCreateShader = StubCreateShader;
+	__glewDeleteProgram = StubDeleteObject;
+	__glewDeleteShader = StubDeleteObject;
+	__glewShaderSource = StubShaderSource;
+	__glewCompileShader = StubCompileShader;
+	__glewGetShaderiv = StubGetShaderiv;
+	__glewGetShaderInfoLog = StubInfoLog;
+	__glewAttachShader = StubAttachShader;
+	__glewDetachShader = StubDetachShader;
+	__glewGetAttachedShaders = StubGetAttachedShaders;
+	__glewLinkProgram = StubLinkProgram;
+	__glewValidateProgram = StubValidateProgram;
+	__glewGetProgramiv = StubGetProgramiv;
+	__glewGetProgramInfoLog = StubInfoLog;
+	__glewProgramParameteri = StubProgramParameteri;
+	__glewGetProgramBinary = StubGetProgramBinary;
+	__glewProgramBinary = StubProgramBinary;
+
+	//queued links stay pending until s_LinkComplete says otherwise
+	OpenGLExtensions::m_bParallelShaderCompile = true;
+}
+
+static void WriteSource(const char* path, const std::string& text)
+{
+	std::ofstream file(path, std::ios::trunc);
+	file << text;
+}
+
+/* gives the file watcher time to see an edit, then lets the manager pick it up */
+static void UpdateAfterEdit(ShaderManager& shaders)
+{
+	for (int i = 0; i < 10; ++i)
+	{
+		std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		shaders.Update();
+	}
+}
+
+int main()
+{
+	InstallStubs();
+
+#ifdef _WIN32
+	_mkdir("Shaders");
+#else
+	mkdir("Shaders", 0755);
+#endif
+
+	//the run's stamp keeps binaries cached by earlier runs from matching
+	const std::string stamp = "// " + std::to_string((long long)std::chrono::high_resolution_clock::now().time_since_epoch().count()) + "\n";
+	const char* vertexPath = "Shaders/reload_test.vs";
+	const char* pixelPath = "Shaders/reload_test.fs";
+	const std::string cache = "ReloadTestCache";
+	std::string effect = "reload_test";
+
+	WriteSource(vertexPath, stamp + "vertex 1\n");
+	WriteSource(pixelPath, stamp + "pixel\n");
+	{
+		ShaderManager shaders;
+		shaders.SetBinaryCache(cache);
+		shaders.CreateEffect(effect);
+		shaders.AddVertexShader(effect);
+		shaders.AddPixelShader(effect);
+		shaders.SetVS(effect, effect);
+		shaders.SetPS(effect, effect);
+		CHECK(shaders.LinkShaders(effect));
+		CHECK(shaders.EnableHotReload());
+		const GLuint live = shaders.GetProgram(effect)->m_Program;
+
+		//the first edit starts a relink the driver holds on to
+		s_LinkComplete = 0;
+		WriteSource(vertexPath, stamp + "vertex 2\n");
+		UpdateAfterEdit(shaders);
+		CHECK(shaders.GetPendingCount() == 1);
+
+		//the second lands while it's in flight
+		WriteSource(vertexPath, stamp + "vertex 3\n");
+		UpdateAfterEdit(shaders);
+		CHECK(shaders.GetPendingCount() == 1);
+
+		//finishing the first relink queues the next, which has to compile the latest text
+		s_LinkComplete = 1;
+		s_Compiles = 0;
+		UpdateAfterEdit(shaders);
+		CHECK(shaders.GetPendingCount() == 0);
+		CHECK(shaders.GetStatus(effect) == PS_Ready);
+		CHECK(s_Compiles > 0);
+		CHECK(s_Linked[live].find("vertex 3") != std::string::npos);
+	}
+
+	//the next launch loads the binary cached for the latest sources, it has to be built from them
+	{
+		ShaderManager shaders;
+		shaders.SetBinaryCache(cache);
+		shaders.CreateEffect(effect);
+		shaders.AddVertexShader(effect);
+		shaders.AddPixelShader(effect);
+		shaders.SetVS(effect, effect);
+		shaders.SetPS(effect, effect);
+		s_Compiles = 0;
+		CHECK(shaders.LinkShaders(effect));
+		CHECK(s_Compiles == 0);
+		CHECK(s_Linked[shaders.GetProgram(effect)->m_Program].find("vertex 3") != std::string::npos);
+	}
+
+	remove(vertexPath);
+	remove(pixelPath);
+	printf("ShaderReloadTest passed\n");
+	return 0;
+}
@@ -7,10 +7,77 @@
 */
 #include "Engine/Tools/RayUtils.h"
 #include "Engine/Engine/Engine.h"
+#include "Engine/Engine/JobSystem.h"
+#include "Engine/Engine/MeshImporter.h"
+#include "Engine/Engine/MeshOptimizer.h"
+#include "Engine/Engine/TextureAtlas.h"
+#include "Engine/Engine/TextureCompressor.h"
 #include "Engine/Math/RayMath.h"
+#include <string.h>
 
 int main(int argc, char* argv[])
 {
+	/* RayEngine -cook <source mesh> <cooked mesh> [float|half|compact]: offline conversion, no window */
+	if ((argc == 4 || argc == 5) && strcmp(argv[1], "-cook") == 0)
+	{
+		VertexProfile profile;
+		if (!VertexProfile::FromName(argc == 5 ? argv[4] : "compact", profile))
+		{
+			DEBUG_MESSAGE(RAY_ERROR, "unknown vertex profile %s", argv[4]);
+			return 1;
+		}
+
+		ImportedMesh mesh;
+		if (!MeshImporter::Import(argv[2], mesh))
+			return 1;
+
+		MeshOptimizer::Optimize(mesh);
+		return MeshImporter::Cook(mesh, argv[3], profile) ? 0 : 1;
+	}
+
+	/* RayEngine -cooktex <source image> <cooked dds> [bc1|bc3|bc4|bc5|bc7] [fast|normal|high]: block compression, cached under Cache/ */
+	if (argc >= 4 && argc <= 6 && strcmp(argv[1], "-cooktex") == 0)
+	{
+		TextureCookSettings settings;
+		if (argc >= 5 && !TextureCompressor::FormatFromName(argv[4], settings.m_Format))
+		{
+			DEBUG_MESSAGE(RAY_ERROR, "unknown block format %s", argv[4]);
+			return 1;
+		}
+		if (argc == 6 && !TextureCompressor::QualityFromName(argv[5], settings.m_Quality))
+		{
+			DEBUG_MESSAGE(RAY_ERROR, "unknown compression quality %s", argv[5]);
+			return 1;
+		}
+		//one and two channel formats hold data such as masks or normals, never color
+		settings.m_bSRGB = settings.m_Format != IF_BC4 && settings.m_Format != IF_BC5;
+
+		JobSystem jobSystem;
+		return TextureCompressor::Cook(argv[2], argv[3], settings) ? 0 : 1;
+	}
+
+	/* RayEngine -cookatlas <cooked dds> [bc1|bc3|bc7] <image>...: packs small images into one texture, the table goes next to it as .json */
+	if (argc >= 3 && strcmp(argv[1], "-cookatlas") == 0)
+	{
+		TextureCookSettings settings;
+		int first = 3;
+		if (argc >= 4 && TextureCompressor::FormatFromName(argv[3], settings.m_Format))
+		{
+			first = 4;
+		}
+
+		std::vector<std::string> sources(argv + first, argv + argc);
+		if (sources.empty())
+		{
+			DEBUG_MESSAGE(RAY_ERROR, "no images to pack into %s", argv[2]);
+			return 1;
+		}
+		settings.m_bSRGB = settings.m_Format != IF_BC4 && settings.m_Format != IF_BC5;
+
+		JobSystem jobSystem;
+		return TextureAtlas::Cook(sources, argv[2], settings) ? 0 : 1;
+	}
+
 	RayEngine::getInstance()->Start();
 	return 0;
 }
\ No newline at end of file